@@ -67,6 +67,44 @@ void CompilerGeneratedMatcherBenchmark(benchmark::State& st)
 
 BENCHMARK(CompilerGeneratedMatcherBenchmark)->DenseRange(0, int64_t(g_benchmark_data_size) - 1)->Unit(benchmark::kMillisecond);
 
+void CompilerGeneratedMatchesCounterBenchmark(benchmark::State& st)
+{
+	const auto& param= g_benchmark_data[st.range(0)];
+	const std::string function_name= "test_count_matches";
+	const std::string object_file_path= "test_count_matches.o";
+	const std::string compiler_program= "RegPanzerCompiler";
+
+	llvm::sys::ExecuteAndWait(
+		compiler_program,
+		{compiler_program, param.regex_str, "--count-matches", "--function-name", function_name, "-o", object_file_path, "-O2"});
+
+	auto target_machine= CreateTargetMachine();
+
+	llvm::LLVMContext llvm_context;
+	auto module= std::make_unique<llvm::Module>("id", llvm_context);
+	module->setDataLayout(target_machine->createDataLayout());
+
+	llvm::EngineBuilder builder(std::move(module));
+	builder.setEngineKind(llvm::EngineKind::JIT);
+	builder.setMemoryManager(std::make_unique<llvm::SectionMemoryManager>());
+	const std::unique_ptr<llvm::ExecutionEngine> engine(builder.create(target_machine.release())); // Engine takes ownership over target machine.
+
+	auto object_file= llvm::object::ObjectFile::createObjectFile(object_file_path);
+	engine->addObjectFile(std::move(*object_file));
+
+	const auto function= reinterpret_cast<MatchesCounterFunctionType>(engine->getFunctionAddress(function_name));
+
+	const auto test_data= param.data_generation_func();
+
+	for (auto _ : st)
+	{
+		const size_t count= function(test_data.data(), test_data.size());
+		benchmark::DoNotOptimize(count);
+	}
+}
+
+BENCHMARK(CompilerGeneratedMatchesCounterBenchmark)->DenseRange(0, int64_t(g_benchmark_data_size) - 1)->Unit(benchmark::kMillisecond);
+
 } // namespace
 
 } // namespace RegPanzer
@@ -67,6 +67,43 @@ void GeneratedBinaryMatcherBenchmark(benchmark::State& st)
 
 BENCHMARK(GeneratedBinaryMatcherBenchmark)->DenseRange(0, int64_t(g_benchmark_data_size) - 1)->Unit(benchmark::kMillisecond);
 
+void GeneratedBinaryMatchesCounterBenchmark(benchmark::State& st)
+{
+	const auto& param= g_benchmark_data[st.range(0)];
+
+	const auto parse_res= RegPanzer::ParseRegexString(param.regex_str);
+	const auto regex_chain= std::get_if<RegexElementsChain>(&parse_res);
+
+	const auto regex_graph= BuildRegexGraph(*regex_chain, Options());
+
+	const std::string function_name= "CountMatches";
+
+	auto target_machine= CreateTargetMachine();
+
+	llvm::LLVMContext llvm_context;
+	auto module= std::make_unique<llvm::Module>("id", llvm_context);
+	module->setDataLayout(target_machine->createDataLayout());
+
+	GenerateMatchesCounterFunction(*module, regex_graph, function_name);
+
+	llvm::EngineBuilder builder(std::move(module));
+	builder.setEngineKind(llvm::EngineKind::JIT);
+	builder.setMemoryManager(std::make_unique<llvm::SectionMemoryManager>());
+	const std::unique_ptr<llvm::ExecutionEngine> engine(builder.create(target_machine.release())); // Engine takes ownership over target machine.
+
+	const auto function= reinterpret_cast<MatchesCounterFunctionType>(engine->getFunctionAddress(function_name));
+
+	const auto test_data= param.data_generation_func();
+
+	for (auto _ : st)
+	{
+		const size_t count= function(test_data.data(), test_data.size());
+		benchmark::DoNotOptimize(count);
+	}
+}
+
+BENCHMARK(GeneratedBinaryMatchesCounterBenchmark)->DenseRange(0, int64_t(g_benchmark_data_size) - 1)->Unit(benchmark::kMillisecond);
+
 } // namespace
 
 } // namespace RegPanzer
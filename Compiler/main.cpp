@@ -1,12 +1,16 @@
+#include "../RegPanzerLib/CpuDispatchLLVM.hpp"
+#include "../RegPanzerLib/MatcherGeneratorCpp.hpp"
 #include "../RegPanzerLib/MatcherGeneratorLLVM.hpp"
 #include "../RegPanzerLib/Parser.hpp"
 #include "../RegPanzerLib/RegexGraphOptimizer.hpp"
 #include "../RegPanzerLib/PushDisableLLVMWarnings.hpp"
 #include <llvm/Analysis/TargetTransformInfo.h>
+#include <llvm/Bitcode/BitcodeReader.h>
 #include <llvm/Bitcode/BitcodeWriter.h>
 #include <llvm/CodeGen/TargetPassConfig.h>
 #include <llvm/InitializePasses.h>
 #include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Linker/Linker.h>
 #include <llvm/MC/SubtargetFeature.h>
 #include <llvm/MC/TargetRegistry.h>
 #include <llvm/Support/InitLLVM.h>
@@ -19,7 +23,15 @@
 #include <llvm/Transforms/IPO.h>
 #include <llvm/Transforms/IPO/PassManagerBuilder.h>
 #include "../RegPanzerLib/PopLLVMWarnings.hpp"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <optional>
+#include <sstream>
+#include <thread>
+#include <unordered_set>
 
 namespace RegPanzer
 {
@@ -72,7 +84,23 @@ cl::opt<std::string> input_regex(
 	cl::Positional,
 	cl::desc("<regex>"),
 	cl::value_desc("input regex"),
-	cl::Required,
+	cl::Optional,
+	cl::cat(options_category));
+
+cl::opt<std::string> manifest_file_name(
+	"manifest",
+	cl::desc("Manifest file with list of functions to generate (instead of single regex). Each line is \"function_name [options] regex\". "
+		"Supported options are --extract-groups, --count-matches, -m, -i, --encoding=, --utf8-validation=, use \"--\" to finish options list. "
+		"Empty lines and lines started with # are ignored. Options from command line are used as defaults."),
+	cl::value_desc("filename"),
+	cl::init(""),
+	cl::cat(options_category));
+
+cl::opt<uint32_t> num_threads(
+	"j",
+	cl::desc("Number of threads for functions generation and optimization (default - number of hardware threads)"),
+	cl::Prefix,
+	cl::init(0),
 	cl::cat(options_category));
 
 cl::opt<std::string> result_function_name(
@@ -94,19 +122,82 @@ cl::opt<bool> extract_groups(
 	cl::init(false),
 	cl::cat(options_category) );
 
+cl::opt<bool> count_matches(
+	"count-matches",
+	cl::desc("Generate function that counts non-overlapping matches instead of matcher function."),
+	cl::init(false),
+	cl::cat(options_category) );
+
 cl::opt<bool> no_graph_optimizations(
 	"no-graph-optimizations",
 	cl::desc("Disable graph optimizations."),
 	cl::init(false),
 	cl::cat(options_category) );
 
+cl::list<OptimizationPass> disabled_graph_optimizations(
+	"disable-graph-optimization",
+	cl::CommaSeparated,
+	cl::desc("Disable given graph optimization passes:"),
+	cl::values(
+		clEnumValN(OptimizationPass::OneOfNormalization, GetOptimizationPassName(OptimizationPass::OneOfNormalization), "Bring symbol sets into canonical form"),
+		clEnumValN(OptimizationPass::SymbolsCombining, GetOptimizationPassName(OptimizationPass::SymbolsCombining), "Combine sequential symbols into strings"),
+		clEnumValN(OptimizationPass::AlternativesStartUnite, GetOptimizationPassName(OptimizationPass::AlternativesStartUnite), "Extract common prefix of alternatives"),
+		clEnumValN(OptimizationPass::AlternativesSuffixFactoring, GetOptimizationPassName(OptimizationPass::AlternativesSuffixFactoring), "Share common suffixes of string alternatives"),
+		clEnumValN(OptimizationPass::AlternativesTrie, GetOptimizationPassName(OptimizationPass::AlternativesTrie), "Replace alternatives of strings with trie"),
+		clEnumValN(OptimizationPass::AlternativesPossessification, GetOptimizationPassName(OptimizationPass::AlternativesPossessification), "Disable backtracking for alternatives, where it is not needed"),
+		clEnumValN(OptimizationPass::SequenceCounterPossessification, GetOptimizationPassName(OptimizationPass::SequenceCounterPossessification), "Disable backtracking for sequences with counter, where it is not needed"),
+		clEnumValN(OptimizationPass::SingleRollbackPointSequence, GetOptimizationPassName(OptimizationPass::SingleRollbackPointSequence), "Match rest of the expression on each sequence iteration"),
+		clEnumValN(OptimizationPass::FixedLengthElementSequence, GetOptimizationPassName(OptimizationPass::FixedLengthElementSequence), "Scan sequences with fixed length element without per-iteration state"),
+		clEnumValN(OptimizationPass::AlternativesFirstCodeUnits, GetOptimizationPassName(OptimizationPass::AlternativesFirstCodeUnits), "Select alternatives by first code unit"),
+		clEnumValN(OptimizationPass::GraphCompaction, GetOptimizationPassName(OptimizationPass::GraphCompaction), "Drop unreachable nodes and share identical nodes")),
+	cl::cat(options_category) );
+
+cl::opt<bool> print_graph_optimization_statistics(
+	"print-graph-optimization-statistics",
+	cl::desc("Print number of nodes, rewritten by each graph optimization pass, and time spent in it (summarized for all functions)."),
+	cl::init(false),
+	cl::cat(options_category) );
+
+cl::opt<bool> single_function(
+	"single-function",
+	cl::desc("Generate each matcher as single function with basic blocks for regex elements and explicit backtracking stack instead of function for each element."),
+	cl::init(false),
+	cl::cat(options_category) );
+
 cl::opt<bool> multiline(
 	"m",
 	cl::desc("Multiline mode - ^ and $ matches not only at start/end of whole string but also at start/end of line"),
 	cl::init(false),
 	cl::cat(options_category) );
 
-enum class FileType{ BC, LL, Obj, Asm };
+cl::opt<bool> case_insensitive(
+	"i",
+	cl::desc("Case-insensitive mode - same as \"(?i)\" at regex start"),
+	cl::init(false),
+	cl::cat(options_category) );
+
+cl::opt<Encoding> encoding(
+	"encoding",
+	cl::init(Encoding::UTF8),
+	cl::desc("Encoding of input strings of generated function:"),
+	cl::values(
+		clEnumValN(Encoding::UTF8, "utf8", "UTF-8, 8-bit code units"),
+		clEnumValN(Encoding::UTF16, "utf16", "UTF-16, 16-bit code units in host byte order"),
+		clEnumValN(Encoding::UTF32, "utf32", "UTF-32, 32-bit code units in host byte order"),
+		clEnumValN(Encoding::Bytes, "bytes", "Bytes without decoding, each byte is single symbol (Latin-1)")),
+	cl::cat(options_category));
+
+cl::opt<Utf8Validation> utf8_validation(
+	"utf8-validation",
+	cl::init(Utf8Validation::PerSymbol),
+	cl::desc("Validation of UTF-8 input:"),
+	cl::values(
+		clEnumValN(Utf8Validation::PerSymbol, "per-symbol", "Check each decoded symbol, invalid bytes are matched as single symbols"),
+		clEnumValN(Utf8Validation::OnceAtEntry, "once", "Check whole input once, nothing is found in invalid input"),
+		clEnumValN(Utf8Validation::None, "none", "Trust input to be valid UTF-8")),
+	cl::cat(options_category));
+
+enum class FileType{ BC, LL, Obj, Asm, Cpp };
 cl::opt< FileType > file_type(
 	"filetype",
 	cl::init(FileType::Obj),
@@ -115,7 +206,8 @@ cl::opt< FileType > file_type(
 		clEnumValN(FileType::BC, "bc", "Emit an llvm bitcode ('.bc') file"),
 		clEnumValN(FileType::LL, "ll", "Emit an llvm asm ('.ll') file"),
 		clEnumValN(FileType::Obj, "obj", "Emit a native object ('.o') file"),
-		clEnumValN(FileType::Asm, "asm", "Emit an assembly ('.s') file")),
+		clEnumValN(FileType::Asm, "asm", "Emit an assembly ('.s') file"),
+		clEnumValN(FileType::Cpp, "cpp", "Emit a C++ source ('.cpp') file, LLVM is not used for code generation in this case")),
 	cl::cat(options_category));
 
 cl::opt<char> optimization_level(
@@ -160,6 +252,25 @@ cl::list<std::string> target_attributes(
 	cl::value_desc("a1,+a2,-a3,..."),
 	cl::cat(options_category));
 
+cl::list<std::string> cpu_versions(
+	"cpu-versions",
+	cl::CommaSeparated,
+	cl::desc("Generate versions of each function for given x86-64 feature levels (x86-64, x86-64-v2, x86-64-v3, x86-64-v4) "
+		"and select best version for current CPU at runtime. Baseline x86-64 version is always generated."),
+	cl::value_desc("x86-64,x86-64-v2,..."),
+	cl::cat(options_category));
+
+enum class CpuDispatch{ Auto, IFunc, Function };
+cl::opt<CpuDispatch> cpu_dispatch(
+	"cpu-dispatch",
+	cl::init(CpuDispatch::Auto),
+	cl::desc("Way to select function version for current CPU (if --cpu-versions is used):"),
+	cl::values(
+		clEnumValN(CpuDispatch::Auto, "auto", "Use ifunc for ELF targets, dispatcher function for others (default)"),
+		clEnumValN(CpuDispatch::IFunc, "ifunc", "Select version at load time via ifunc (ELF only)"),
+		clEnumValN(CpuDispatch::Function, "function", "Select version at first call via dispatcher function")),
+	cl::cat(options_category));
+
 cl::opt<llvm::Reloc::Model> relocation_model(
 	"relocation-model",
 	cl::desc("Choose relocation model"),
@@ -186,6 +297,341 @@ cl::opt<llvm::CodeModel::Model> code_model(
 
 } // namespace Options
 
+struct FunctionEntry
+{
+	std::string function_name;
+	std::string regex;
+	RegPanzer::Options options;
+	bool count_matches= false;
+};
+
+FunctionEntry GetCommandLineFunctionEntry()
+{
+	FunctionEntry entry;
+	entry.function_name= Options::result_function_name;
+	entry.regex= Options::input_regex;
+	entry.options.extract_groups= Options::extract_groups;
+	entry.options.multiline= Options::multiline;
+	entry.options.encoding= Options::encoding;
+	entry.options.utf8_validation= Options::utf8_validation;
+	entry.options.case_insensitive= Options::case_insensitive;
+	entry.options.single_function= Options::single_function;
+	entry.count_matches= Options::count_matches;
+	return entry;
+}
+
+// Parse manifest line in form "function_name [options] regex". Returns error message or empty string.
+std::string ParseManifestLine(const std::string_view line, FunctionEntry& entry)
+{
+	const auto is_space= [](const char c){ return c == ' ' || c == '\t'; };
+
+	size_t pos= 0;
+	const auto skip_spaces= [&]{ while(pos < line.size() && is_space(line[pos])) ++pos; };
+	const auto read_word=
+	[&]
+	{
+		const size_t start= pos;
+		while(pos < line.size() && !is_space(line[pos]))
+			++pos;
+		return line.substr(start, pos - start);
+	};
+
+	skip_spaces();
+	entry.function_name= std::string(read_word());
+
+	// Require C identifiers. This also guarantees, that names of CPU-specific function versions can't collide with other functions.
+	const auto is_identifier_start= [](const char c){ return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'; };
+	if(entry.function_name.empty() || !is_identifier_start(entry.function_name.front()))
+		return "invalid function name \"" + entry.function_name + "\"";
+	for(const char c : entry.function_name)
+		if(!is_identifier_start(c) && !(c >= '0' && c <= '9'))
+			return "invalid function name \"" + entry.function_name + "\"";
+
+	while(true)
+	{
+		skip_spaces();
+		if(pos >= line.size() || line[pos] != '-')
+			break;
+
+		const std::string_view option= read_word();
+		if(option == "--")
+		{
+			skip_spaces();
+			break;
+		}
+		else if(option == "--extract-groups")
+			entry.options.extract_groups= true;
+		else if(option == "--count-matches")
+			entry.count_matches= true;
+		else if(option == "-m")
+			entry.options.multiline= true;
+		else if(option == "-i")
+			entry.options.case_insensitive= true;
+		else if(option == "--encoding=utf8")
+			entry.options.encoding= Encoding::UTF8;
+		else if(option == "--encoding=utf16")
+			entry.options.encoding= Encoding::UTF16;
+		else if(option == "--encoding=utf32")
+			entry.options.encoding= Encoding::UTF32;
+		else if(option == "--encoding=bytes")
+			entry.options.encoding= Encoding::Bytes;
+		else if(option == "--utf8-validation=per-symbol")
+			entry.options.utf8_validation= Utf8Validation::PerSymbol;
+		else if(option == "--utf8-validation=once")
+			entry.options.utf8_validation= Utf8Validation::OnceAtEntry;
+		else if(option == "--utf8-validation=none")
+			entry.options.utf8_validation= Utf8Validation::None;
+		else
+			return "unknown option \"" + std::string(option) + "\"";
+	}
+
+	// Regex is whole rest of the line, it may contain spaces.
+	entry.regex= std::string(line.substr(pos));
+
+	if(entry.regex.empty())
+		return "expected regex";
+	if(entry.count_matches && entry.options.extract_groups)
+		return "groups extraction can not be used together with matches counting";
+
+	return "";
+}
+
+std::optional<std::vector<FunctionEntry>> ReadManifest(const std::string& file_name)
+{
+	std::ifstream file(file_name);
+	if(!file)
+	{
+		std::cerr << "Error, can not open manifest file \"" << file_name << "\"." << std::endl;
+		return std::nullopt;
+	}
+
+	std::vector<FunctionEntry> result;
+	std::unordered_set<std::string> function_names;
+	bool has_errors= false;
+
+	std::string line;
+	for(size_t line_number= 1; std::getline(file, line); ++line_number)
+	{
+		if(!line.empty() && line.back() == '\r')
+			line.pop_back();
+
+		const size_t first_non_space= line.find_first_not_of(" \t");
+		if(first_non_space == std::string::npos || line[first_non_space] == '#')
+			continue;
+
+		FunctionEntry entry= GetCommandLineFunctionEntry();
+		std::string error= ParseManifestLine(line, entry);
+		if(error.empty() && !function_names.insert(entry.function_name).second)
+			error= "duplicated function name \"" + entry.function_name + "\"";
+
+		if(!error.empty())
+		{
+			std::cerr << file_name << ":" << line_number << ": " << error << std::endl;
+			has_errors= true;
+			continue;
+		}
+
+		result.push_back(std::move(entry));
+	}
+
+	if(has_errors)
+		return std::nullopt;
+	return result;
+}
+
+OptimizationOptions GetOptimizationOptions()
+{
+	OptimizationOptions optimization_options;
+	for(const OptimizationPass pass : Options::disabled_graph_optimizations)
+		optimization_options.disabled_passes.set(size_t(pass));
+	return optimization_options;
+}
+
+// Returns nullopt and fills errors stream in case of parse errors.
+// Statistics of graph optimizations are added to given statistics.
+std::optional<RegexGraphBuildResult> BuildRegexGraphForEntry(const FunctionEntry& entry, std::ostream& errors_stream, OptimizationStatistics& optimization_statistics)
+{
+	const auto parse_res= ParseRegexString(entry.regex, entry.options);
+	if(const auto parse_errors= std::get_if<ParseErrors>(&parse_res))
+	{
+		errors_stream << "Errors, parsing regex";
+		if(!Options::manifest_file_name.empty())
+			errors_stream << " for function \"" << entry.function_name << "\"";
+		errors_stream << ":\n";
+		for(const ParseError& e : *parse_errors)
+			errors_stream << e.pos << ": " << e.message << "\n";
+		return std::nullopt;
+	}
+	const auto regex_chain= std::get_if<RegexElementsChain>(&parse_res);
+	assert(regex_chain != nullptr);
+
+	RegexGraphBuildResult regex_graph= BuildRegexGraph(*regex_chain, entry.options);
+	if(!Options::no_graph_optimizations)
+		regex_graph= OptimizeRegexGraph(std::move(regex_graph), GetOptimizationOptions(), &optimization_statistics);
+
+	return regex_graph;
+}
+
+void PrintOptimizationStatistics(const llvm::ArrayRef<OptimizationStatistics> functions_statistics)
+{
+	OptimizationStatistics total_statistics;
+	for(const OptimizationStatistics& statistics : functions_statistics)
+	{
+		for(size_t i= 0; i < c_num_optimization_passes; ++i)
+		{
+			total_statistics[i].runs+= statistics[i].runs;
+			total_statistics[i].nodes_rewritten+= statistics[i].nodes_rewritten;
+			total_statistics[i].time_spent+= statistics[i].time_spent;
+		}
+	}
+
+	std::cout << "Graph optimization statistics (pass: runs, nodes rewritten, time in microseconds):\n";
+	for(size_t i= 0; i < c_num_optimization_passes; ++i)
+	{
+		const OptimizationPassStatistics& pass_statistics= total_statistics[i];
+		std::cout << "  " << GetOptimizationPassName(OptimizationPass(i)) << ": "
+			<< pass_statistics.runs << ", "
+			<< pass_statistics.nodes_rewritten << ", "
+			<< std::chrono::duration_cast<std::chrono::microseconds>(pass_statistics.time_spent).count() << "\n";
+	}
+	std::cout << std::flush;
+}
+
+// Run given function for each task using several threads.
+void RunInParallel(const size_t num_tasks, const size_t num_threads, const std::function<void(size_t task_index, size_t thread_index)>& func)
+{
+	if(num_threads <= 1 || num_tasks <= 1)
+	{
+		for(size_t i= 0; i < num_tasks; ++i)
+			func(i, 0);
+		return;
+	}
+
+	std::atomic<size_t> next_task_index{0};
+	std::vector<std::thread> threads;
+	for(size_t thread_index= 0; thread_index < num_threads; ++thread_index)
+		threads.emplace_back(
+			[&, thread_index]
+			{
+				while(true)
+				{
+					const size_t task_index= next_task_index.fetch_add(1);
+					if(task_index >= num_tasks)
+						break;
+					func(task_index, thread_index);
+				}
+			});
+
+	for(std::thread& thread : threads)
+		thread.join();
+}
+
+std::unique_ptr<llvm::TargetMachine> CreateTargetMachineForOptions(const uint32_t optimization_level, const uint32_t size_optimization_level)
+{
+	const llvm::Target* target= nullptr;
+
+	llvm::Triple target_triple(llvm::sys::getDefaultTargetTriple());
+
+	if(!Options::architecture.empty() && Options::architecture != "native")
+		target_triple.setArchName(Options::architecture);
+	if(!Options::target_vendor.empty())
+		target_triple.setVendorName(Options::target_vendor);
+	if(!Options::target_os.empty())
+		target_triple.setOSName(Options::target_os);
+	if(!Options::target_environment.empty())
+		target_triple.setEnvironmentName(Options::target_environment);
+
+	const std::string target_triple_str= target_triple.normalize();
+
+	std::string error_str;
+	target= llvm::TargetRegistry::lookupTarget(target_triple_str, error_str);
+	if(target == nullptr)
+	{
+		std::cerr << "Error, selecting target: " << error_str << std::endl;
+		PrintAvailableTargets();
+		return nullptr;
+	}
+
+	const std::string cpu_name= (Options::architecture == "native" && Options::target_cpu.empty())
+		? llvm::sys::getHostCPUName().str()
+		: Options::target_cpu;
+
+	const std::string features_str= (Options::architecture == "native" && Options::target_attributes.empty())
+		? GetNativeTargetFeaturesStr()
+		: GetFeaturesStr(Options::target_attributes);
+
+	llvm::TargetOptions target_options;
+
+	auto code_gen_optimization_level= llvm::CodeGenOpt::None;
+	if (size_optimization_level > 0)
+		code_gen_optimization_level= llvm::CodeGenOpt::Default;
+	else if(optimization_level == 0)
+		code_gen_optimization_level= llvm::CodeGenOpt::None;
+	else if(optimization_level == 1)
+		code_gen_optimization_level= llvm::CodeGenOpt::Less;
+	else if(optimization_level == 2)
+		code_gen_optimization_level= llvm::CodeGenOpt::Default;
+	else if(optimization_level == 3)
+		code_gen_optimization_level= llvm::CodeGenOpt::Aggressive;
+
+	std::unique_ptr<llvm::TargetMachine> target_machine(
+		target->createTargetMachine(
+			target_triple_str,
+			cpu_name,
+			features_str,
+			target_options,
+			Options::relocation_model.getValue(),
+			Options::code_model.getNumOccurrences() > 0 ? Options::code_model.getValue() : llvm::Optional<llvm::CodeModel::Model>(),
+			code_gen_optimization_level));
+
+	if(target_machine == nullptr)
+		std::cerr << "Error, creating target machine." << std::endl;
+
+	return target_machine;
+}
+
+void OptimizeModule(llvm::Module& module, llvm::TargetMachine& target_machine, const uint32_t optimization_level, const uint32_t size_optimization_level)
+{
+	llvm::legacy::FunctionPassManager function_pass_manager(&module);
+	llvm::legacy::PassManager pass_manager;
+
+	// Setup target-dependent optimizations.
+	pass_manager.add(llvm::createTargetTransformInfoWrapperPass(target_machine.getTargetIRAnalysis()));
+
+	{
+		llvm::PassManagerBuilder pass_manager_builder;
+		pass_manager_builder.OptLevel = optimization_level;
+		pass_manager_builder.SizeLevel = size_optimization_level;
+
+		if(optimization_level == 0u)
+			pass_manager_builder.Inliner= nullptr;
+		else
+			pass_manager_builder.Inliner= llvm::createFunctionInliningPass(optimization_level, size_optimization_level, false);
+
+		// vectorization/unroll is same as in "opt"
+		pass_manager_builder.DisableUnrollLoops= optimization_level == 0;
+		pass_manager_builder.LoopVectorize= optimization_level > 1 && size_optimization_level < 2;
+		pass_manager_builder.SLPVectorize= optimization_level > 1 && size_optimization_level < 2;
+
+		target_machine.adjustPassManager(pass_manager_builder);
+
+		if (llvm::TargetPassConfig* const target_pass_config= static_cast<llvm::LLVMTargetMachine &>(target_machine).createPassConfig(pass_manager))
+			pass_manager.add(target_pass_config);
+
+		pass_manager_builder.populateFunctionPassManager(function_pass_manager);
+		pass_manager_builder.populateModulePassManager(pass_manager);
+	}
+
+	// Run per-function optimizations.
+	function_pass_manager.doInitialization();
+	for(llvm::Function& func : module)
+		function_pass_manager.run(func);
+	function_pass_manager.doFinalization();
+
+	// Run optimizations for module.
+	pass_manager.run(module);
+}
+
 int Main(int argc, const char* argv[])
 {
 	const llvm::InitLLVM llvm_initializer(argc, argv);
@@ -218,6 +664,150 @@ int Main(int argc, const char* argv[])
 		return 1;
 	};
 
+	// Collect list of functions to generate.
+	std::vector<FunctionEntry> function_entries;
+	if(Options::manifest_file_name.empty())
+	{
+		if(Options::input_regex.getNumOccurrences() == 0)
+		{
+			std::cerr << "Expected input regex or manifest file." << std::endl;
+			return 1;
+		}
+
+		if(Options::count_matches && Options::extract_groups)
+		{
+			std::cerr << "Groups extraction can not be used together with matches counting." << std::endl;
+			return 1;
+		}
+
+		function_entries.push_back(GetCommandLineFunctionEntry());
+	}
+	else
+	{
+		if(Options::input_regex.getNumOccurrences() > 0)
+		{
+			std::cerr << "Input regex can not be used together with manifest file." << std::endl;
+			return 1;
+		}
+
+		auto manifest_entries= ReadManifest(Options::manifest_file_name);
+		if(manifest_entries == std::nullopt)
+			return 1;
+		function_entries= std::move(*manifest_entries);
+	}
+
+	// Collect list of CPU versions. Empty CPU name means no multiversioning.
+	std::vector<std::string> function_cpu_versions;
+	if(Options::cpu_versions.empty())
+		function_cpu_versions.push_back("");
+	else
+	{
+		if(Options::file_type == Options::FileType::Cpp)
+		{
+			std::cerr << "CPU versions are not supported for C++ output." << std::endl;
+			return 1;
+		}
+
+		function_cpu_versions.push_back(c_dispatch_cpu_names[0]);
+		for(const std::string& cpu_name : Options::cpu_versions)
+		{
+			if(!IsDispatchCpuName(cpu_name))
+			{
+				std::cerr << "Unsupported CPU version \"" << cpu_name << "\"." << std::endl;
+				return 1;
+			}
+			if(std::find(function_cpu_versions.begin(), function_cpu_versions.end(), cpu_name) == function_cpu_versions.end())
+				function_cpu_versions.push_back(cpu_name);
+		}
+	}
+
+	// Generate each version of each function as separate task.
+	const size_t num_tasks= function_entries.size() * function_cpu_versions.size();
+	const auto get_version_function_name=
+	[&](const size_t task_index)
+	{
+		const FunctionEntry& entry= function_entries[task_index / function_cpu_versions.size()];
+		const std::string& cpu_name= function_cpu_versions[task_index % function_cpu_versions.size()];
+		if(cpu_name.empty())
+			return entry.function_name;
+
+		// Use "." as separator - it can't appear in function names from manifest, so, collisions are not possible.
+		return entry.function_name + "." + cpu_name;
+	};
+
+	const size_t num_threads=
+		std::min(
+			num_tasks,
+			Options::num_threads > 0 ? size_t(Options::num_threads) : size_t(std::max(1u, std::thread::hardware_concurrency())));
+
+	// Build graph of each function only once, all versions of the function are generated from it.
+	// Errors of each function are collected separately and printed later in order to avoid messing of output of different threads.
+	std::vector<std::optional<RegexGraphBuildResult>> regex_graphs(function_entries.size());
+	std::vector<std::string> function_errors(function_entries.size());
+	// Statistics are collected separately for each function too.
+	std::vector<OptimizationStatistics> function_optimization_statistics(function_entries.size());
+	RunInParallel(
+		function_entries.size(),
+		num_threads,
+		[&](const size_t entry_index, size_t)
+		{
+			std::ostringstream errors_stream;
+			regex_graphs[entry_index]= BuildRegexGraphForEntry(function_entries[entry_index], errors_stream, function_optimization_statistics[entry_index]);
+			if(regex_graphs[entry_index] == std::nullopt)
+				function_errors[entry_index]= errors_stream.str();
+		});
+
+	bool has_errors= false;
+	for(const std::string& errors : function_errors)
+	{
+		if(!errors.empty())
+		{
+			std::cerr << errors << std::endl;
+			has_errors= true;
+		}
+	}
+	if(has_errors)
+		return 1;
+	if(Options::print_graph_optimization_statistics)
+		PrintOptimizationStatistics(function_optimization_statistics);
+
+	if(Options::file_type == Options::FileType::Cpp)
+	{
+		// Just write generated sources. Target and optimization options are ignored here, since the result is compiled by C++ compiler.
+		// Each generated source is self-contained, so, it is possible to concatenate them.
+		std::vector<std::string> sources(function_entries.size());
+		RunInParallel(
+			function_entries.size(),
+			num_threads,
+			[&](const size_t task_index, size_t)
+			{
+				const FunctionEntry& entry= function_entries[task_index];
+				const RegexGraphBuildResult& regex_graph= *regex_graphs[task_index];
+				sources[task_index]=
+					entry.count_matches
+						? GenerateMatchesCounterFunctionCpp(regex_graph, entry.function_name)
+						: GenerateMatcherFunctionCpp(regex_graph, entry.function_name);
+			});
+
+		std::error_code file_error_code;
+		llvm::raw_fd_ostream out_file_stream(Options::output_file_name, file_error_code);
+		for(const std::string& source : sources)
+		{
+			if(&source != &sources.front())
+				out_file_stream << "\n";
+			out_file_stream << source;
+		}
+
+		out_file_stream.flush();
+		if(out_file_stream.has_error())
+		{
+			std::cerr << "Error while writing output file \"" << Options::output_file_name << "\": " << file_error_code.message() << std::endl;
+			return 1;
+		}
+
+		return 0;
+	}
+
 	// LLVM stuff initialization.
 	llvm::InitializeAllTargets();
 	llvm::InitializeAllTargetMCs();
@@ -240,142 +830,127 @@ int Main(int argc, const char* argv[])
 	}
 
 	// Prepare target machine.
-	std::string target_triple_str;
-	std::unique_ptr<llvm::TargetMachine> target_machine;
-	{
-		const llvm::Target* target= nullptr;
-
-		llvm::Triple target_triple(llvm::sys::getDefaultTargetTriple());
-
-		if(!Options::architecture.empty() && Options::architecture != "native")
-			target_triple.setArchName(Options::architecture);
-		if(!Options::target_vendor.empty())
-			target_triple.setVendorName(Options::target_vendor);
-		if(!Options::target_os.empty())
-			target_triple.setOSName(Options::target_os);
-		if(!Options::target_environment.empty())
-			target_triple.setEnvironmentName(Options::target_environment);
-
-		target_triple_str= target_triple.normalize();
+	const std::unique_ptr<llvm::TargetMachine> target_machine= CreateTargetMachineForOptions(optimization_level, size_optimization_level);
+	if(target_machine == nullptr)
+		return 1;
 
-		std::string error_str;
-		target= llvm::TargetRegistry::lookupTarget(target_triple_str, error_str);
-		if(target == nullptr)
+	if(function_cpu_versions.size() > 1)
+	{
+		const llvm::Triple& target_triple= target_machine->getTargetTriple();
+		if(target_triple.getArch() != llvm::Triple::x86_64)
 		{
-			std::cerr << "Error, selecting target: " << error_str << std::endl;
-			PrintAvailableTargets();
+			std::cerr << "CPU versions are supported only for x86_64 targets." << std::endl;
 			return 1;
 		}
-
-		const std::string cpu_name= (Options::architecture == "native" && Options::target_cpu.empty())
-			? llvm::sys::getHostCPUName().str()
-			: Options::target_cpu;
-
-		const std::string features_str= (Options::architecture == "native" && Options::target_attributes.empty())
-			? GetNativeTargetFeaturesStr()
-			: GetFeaturesStr(Options::target_attributes);
-
-		llvm::TargetOptions target_options;
-
-		auto code_gen_optimization_level= llvm::CodeGenOpt::None;
-		if (size_optimization_level > 0)
-			code_gen_optimization_level= llvm::CodeGenOpt::Default;
-		else if(optimization_level == 0)
-			code_gen_optimization_level= llvm::CodeGenOpt::None;
-		else if(optimization_level == 1)
-			code_gen_optimization_level= llvm::CodeGenOpt::Less;
-		else if(optimization_level == 2)
-			code_gen_optimization_level= llvm::CodeGenOpt::Default;
-		else if(optimization_level == 3)
-			code_gen_optimization_level= llvm::CodeGenOpt::Aggressive;
-
-		target_machine.reset(
-			target->createTargetMachine(
-				target_triple_str,
-				cpu_name,
-				features_str,
-				target_options,
-				Options::relocation_model.getValue(),
-				Options::code_model.getNumOccurrences() > 0 ? Options::code_model.getValue() : llvm::Optional<llvm::CodeModel::Model>(),
-				code_gen_optimization_level));
-
-		if(target_machine == nullptr)
+		if(Options::cpu_dispatch == Options::CpuDispatch::IFunc && !target_triple.isOSBinFormatELF())
 		{
-			std::cerr << "Error, creating target machine." << std::endl;
+			std::cerr << "ifunc is supported only for ELF targets." << std::endl;
 			return 1;
 		}
 	}
 
-	// Create llvm module.
-	llvm::LLVMContext llvm_context;
-	llvm::Module module("Reg module", llvm_context);
-	module.setDataLayout(target_machine->createDataLayout());
-	module.setTargetTriple(target_triple_str);
-
-	// Parse and build regex.
-	const auto parse_res= ParseRegexString(Options::input_regex);
-	if(const auto parse_errors= std::get_if<ParseErrors>(&parse_res))
+	// Target machine is not thread-safe, so, create separate instance for each thread.
+	std::vector<std::unique_ptr<llvm::TargetMachine>> thread_target_machines;
+	for(size_t i= 0; i < num_threads; ++i)
 	{
-		// TODO - show exact error what went wrong.
-		std::cerr << "Errors, parsing regex:\n";
-		for(const ParseError& e : *parse_errors)
-			std::cerr << e.pos << ": " << e.message << "\n";
-		std::cerr << std::endl;
-		return 1;
+		thread_target_machines.push_back(CreateTargetMachineForOptions(optimization_level, size_optimization_level));
+		if(thread_target_machines.back() == nullptr)
+			return 1;
 	}
-	const auto regex_chain= std::get_if<RegexElementsChain>(&parse_res);
-	assert(regex_chain != nullptr);
 
-	RegPanzer::Options regex_build_options;
-	regex_build_options.extract_groups= Options::extract_groups;
-	regex_build_options.multiline= Options::multiline;
+	// Generate and optimize each function in separate module with separate context, since LLVM context is not thread-safe.
+	// Pass result modules into main thread as bitcode.
+	std::vector<llvm::SmallVector<char, 0>> function_bitcodes(num_tasks);
+	RunInParallel(
+		num_tasks,
+		num_threads,
+		[&](const size_t task_index, const size_t thread_index)
+		{
+			const size_t entry_index= task_index / function_cpu_versions.size();
+			const FunctionEntry& entry= function_entries[entry_index];
+			const RegexGraphBuildResult& regex_graph= *regex_graphs[entry_index];
+			const std::string& cpu_name= function_cpu_versions[task_index % function_cpu_versions.size()];
+			const std::string function_name= get_version_function_name(task_index);
 
-	RegexGraphBuildResult regex_graph= BuildRegexGraph(*regex_chain, regex_build_options);
-	if(!Options::no_graph_optimizations)
-		regex_graph= OptimizeRegexGraph(std::move(regex_graph));
+			llvm::TargetMachine& thread_target_machine= *thread_target_machines[thread_index];
 
-	GenerateMatcherFunction(module, regex_graph, Options::result_function_name);
+			llvm::LLVMContext llvm_context;
+			llvm::Module module(function_name, llvm_context);
+			module.setDataLayout(thread_target_machine.createDataLayout());
+			module.setTargetTriple(thread_target_machine.getTargetTriple().str());
 
-	// Run optimizations.
-	if(optimization_level > 0u || size_optimization_level > 0u)
-	{
-		llvm::legacy::FunctionPassManager function_pass_manager(&module);
-		llvm::legacy::PassManager pass_manager;
+			if(entry.count_matches)
+				GenerateMatchesCounterFunction(module, regex_graph, function_name);
+			else
+				GenerateMatcherFunction(module, regex_graph, function_name);
 
-		// Setup target-dependent optimizations.
-		pass_manager.add(llvm::createTargetTransformInfoWrapperPass(target_machine->getTargetIRAnalysis()));
+			// Set CPU before optimizations in order to use proper target information for it.
+			if(!cpu_name.empty())
+				SetModuleFunctionsTargetCpu(module, cpu_name);
 
-		{
-			llvm::PassManagerBuilder pass_manager_builder;
-			pass_manager_builder.OptLevel = optimization_level;
-			pass_manager_builder.SizeLevel = size_optimization_level;
+			// Run optimizations.
+			if(optimization_level > 0u || size_optimization_level > 0u)
+				OptimizeModule(module, thread_target_machine, optimization_level, size_optimization_level);
 
-			if(optimization_level == 0u)
-				pass_manager_builder.Inliner= nullptr;
-			else
-				pass_manager_builder.Inliner= llvm::createFunctionInliningPass(optimization_level, size_optimization_level, false);
+			llvm::raw_svector_ostream bitcode_stream(function_bitcodes[task_index]);
+			llvm::WriteBitcodeToFile(module, bitcode_stream);
+		});
 
-			// vectorization/unroll is same as in "opt"
-			pass_manager_builder.DisableUnrollLoops= optimization_level == 0;
-			pass_manager_builder.LoopVectorize= optimization_level > 1 && size_optimization_level < 2;
-			pass_manager_builder.SLPVectorize= optimization_level > 1 && size_optimization_level < 2;
-
-			target_machine->adjustPassManager(pass_manager_builder);
+	// Create llvm module and link all functions into it in order of declaration.
+	llvm::LLVMContext llvm_context;
+	llvm::Module module("Reg module", llvm_context);
+	module.setDataLayout(target_machine->createDataLayout());
+	module.setTargetTriple(target_machine->getTargetTriple().str());
 
-			if (llvm::TargetPassConfig* const target_pass_config= static_cast<llvm::LLVMTargetMachine &>(*target_machine).createPassConfig(pass_manager))
-				pass_manager.add(target_pass_config);
+	for(size_t i= 0; i < num_tasks; ++i)
+	{
+		const std::string function_name= get_version_function_name(i);
+		auto function_module=
+			llvm::parseBitcodeFile(
+				llvm::MemoryBufferRef(llvm::StringRef(function_bitcodes[i].data(), function_bitcodes[i].size()), function_name),
+				llvm_context);
+		if(!function_module)
+		{
+			std::cerr << "Error, reading bitcode of function \"" << function_name << "\": " << llvm::toString(function_module.takeError()) << std::endl;
+			return 1;
+		}
 
-			pass_manager_builder.populateFunctionPassManager(function_pass_manager);
-			pass_manager_builder.populateModulePassManager(pass_manager);
+		if(llvm::Linker::linkModules(module, std::move(*function_module)))
+		{
+			std::cerr << "Error, linking function \"" << function_name << "\"." << std::endl;
+			return 1;
 		}
+	}
+
+	// Create dispatched functions for all versions.
+	if(function_cpu_versions.size() > 1)
+	{
+		const bool use_ifunc=
+			Options::cpu_dispatch == Options::CpuDispatch::IFunc ||
+			(Options::cpu_dispatch == Options::CpuDispatch::Auto && target_machine->getTargetTriple().isOSBinFormatELF());
+
+		for(size_t i= 0; i < function_entries.size(); ++i)
+		{
+			std::vector<CpuFunctionVersion> versions;
+			for(size_t j= 0; j < function_cpu_versions.size(); ++j)
+			{
+				CpuFunctionVersion version;
+				version.function= module.getFunction(get_version_function_name(i * function_cpu_versions.size() + j));
+				version.cpu_name= function_cpu_versions[j];
+				versions.push_back(std::move(version));
+			}
 
-		// Run per-function optimizations.
-		function_pass_manager.doInitialization();
-		for(llvm::Function& func : module)
-			function_pass_manager.run(func);
-		function_pass_manager.doFinalization();
+			GenerateCpuDispatchedFunction(module, function_entries[i].function_name, versions, use_ifunc);
+		}
+	}
 
-		// Run optimizations for module.
+	// Deduplicate helper functions and constant tables, generated for different functions.
+	if(num_tasks > 1 && (optimization_level > 0u || size_optimization_level > 0u))
+	{
+		llvm::legacy::PassManager pass_manager;
+		pass_manager.add(llvm::createConstantMergePass());
+		pass_manager.add(llvm::createMergeFunctionsPass());
+		pass_manager.add(llvm::createGlobalDCEPass());
 		pass_manager.run(module);
 	}
 
@@ -397,6 +972,7 @@ int Main(int argc, const char* argv[])
 			case Options::FileType::Asm: file_type= llvm::CGFT_AssemblyFile; break;
 			case Options::FileType::BC:
 			case Options::FileType::LL:
+			case Options::FileType::Cpp:
 			assert(false);
 			};
 
@@ -0,0 +1,22 @@
+#pragma once
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace RegPanzer
+{
+
+// Simple one-to-one case mapping for Latin, Greek, Cyrillic, Armenian and fullwidth Latin letters.
+// Both cases of each letter have same size in UTF-8 and UTF-16.
+// Special mappings (like Kelvin sign or dotless i) are not supported.
+
+// Returns lower case variant for upper case letter, upper case variant for lower case letter, none for other symbols.
+std::optional<char32_t> GetOtherCase(char32_t c);
+
+// Returns lower case variant for upper case letter, symbol itself for other symbols.
+char32_t FoldCase(char32_t c);
+
+// Returns ranges of other case variants for all letters in given range.
+std::vector< std::pair<char32_t, char32_t> > GetOtherCaseRanges(char32_t begin, char32_t end);
+
+} // namespace RegPanzer
@@ -0,0 +1,40 @@
+#pragma once
+#include "PushDisableLLVMWarnings.hpp"
+#include <llvm/IR/Module.h>
+#include "PopLLVMWarnings.hpp"
+#include <string>
+#include <vector>
+
+namespace RegPanzer
+{
+
+// Support for several versions of same function, generated for different x86-64 CPU feature levels.
+// Best version is selected at runtime, depending on features of current CPU.
+
+// Supported levels, from worst to best.
+// "x86-64" - baseline, "x86-64-v2" - SSE4.2, POPCNT, "x86-64-v3" - AVX2, BMI, FMA, "x86-64-v4" - AVX-512.
+extern const char* const c_dispatch_cpu_names[4];
+
+// Returns true if given name is one of supported feature levels.
+bool IsDispatchCpuName(const std::string& cpu_name);
+
+// Force code generation for given CPU for all functions in module, regardless of target machine CPU.
+void SetModuleFunctionsTargetCpu(llvm::Module& module, const std::string& cpu_name);
+
+struct CpuFunctionVersion
+{
+	llvm::Function* function= nullptr;
+	std::string cpu_name;
+};
+
+// Create exported symbol with given name, which calls best version for current CPU.
+// Versions become internal. Version for baseline ("x86-64") must be present.
+// If "use_ifunc" is true, version is selected once at load time via ifunc (supported for ELF targets only),
+// else dispatcher function is created, which selects version at first call.
+void GenerateCpuDispatchedFunction(
+	llvm::Module& module,
+	const std::string& function_name,
+	const std::vector<CpuFunctionVersion>& versions,
+	bool use_ifunc);
+
+} // namespace RegPanzer
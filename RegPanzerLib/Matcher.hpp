@@ -5,7 +5,7 @@
 namespace RegPanzer
 {
 
-// Match UTF-8 string.
+// Match UTF-8 string or string of bytes (if graph was built with bytes encoding option).
 
 // Returns 0 if found nothing, otherwise returns number of subpatetterns.
 size_t Match(
@@ -16,4 +16,20 @@ size_t Match(
 	size_t out_groups_count /* size of ouptut array of groups */
 	);
 
+// Match UTF-16 string. Graph should be built with UTF-16 encoding option. Positions are in code units.
+size_t Match(
+	const RegexGraphBuildResult& regex_graph,
+	std::u16string_view str,
+	size_t start_pos,
+	std::u16string_view* out_groups,
+	size_t out_groups_count);
+
+// Match UTF-32 string. Graph should be built with UTF-32 encoding option.
+size_t Match(
+	const RegexGraphBuildResult& regex_graph,
+	std::u32string_view str,
+	size_t start_pos,
+	std::u32string_view* out_groups,
+	size_t out_groups_count);
+
 } // namespace RegPanzer
@@ -0,0 +1,225 @@
+#pragma once
+#include "Options.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+
+// This header does not depend on LLVM and may be used together with precompiled matcher functions only.
+
+namespace RegPanzer
+{
+
+// Type of generated matcher function. sizeof(size_t) depends on target data layout.
+using MatcherFunctionType=
+	size_t (*)(
+		// str pointer should not be null, unless str_size is zero.
+		const char* str,
+		size_t str_size,
+		// Start offset should not be greater, thatstr_size.
+		// Input is validated once (if needed) only for zero start offset. Search with non-zero offset should be performed only after it.
+		size_t start_offset,
+		// Out subputterns array. May be empty.
+		size_t* out_subpatterns /* pairs */,
+		size_t number_of_subpatterns /* number of pairs */);
+
+// Types of generated matcher functions for UTF-16 and UTF-32 encodings.
+// Sizes and offsets are in code units.
+using MatcherFunctionUtf16Type= size_t (*)(const char16_t* str, size_t str_size, size_t start_offset, size_t* out_subpatterns, size_t number_of_subpatterns);
+using MatcherFunctionUtf32Type= size_t (*)(const char32_t* str, size_t str_size, size_t start_offset, size_t* out_subpatterns, size_t number_of_subpatterns);
+
+// Type of generated matches counter function.
+// Returns number of non-overlapping matches - same matches as produced by "MatchIterator".
+using MatchesCounterFunctionType=
+	size_t (*)(
+		// str pointer should not be null, unless str_size is zero.
+		const char* str,
+		size_t str_size);
+
+// Lazy iterator over all non-overlapping matches of given matcher function.
+// Matches are views into source string, nothing is allocated or copied.
+// Search is continued from the end of previous match. After empty match search is continued from next code point.
+// Encoding should be the same as encoding of matcher function - UTF-8 or Bytes.
+class MatchIterator
+{
+public:
+	using iterator_category= std::forward_iterator_tag;
+	using value_type= std::string_view;
+	using difference_type= std::ptrdiff_t;
+	using pointer= const std::string_view*;
+	using reference= const std::string_view&;
+
+public:
+	// Creates end iterator.
+	MatchIterator()= default;
+
+	MatchIterator(const MatcherFunctionType function, const std::string_view str, const Encoding encoding= Encoding::UTF8)
+		: function_(function), str_(str), encoding_(encoding)
+	{
+		FindMatch(0);
+	}
+
+	reference operator*() const { return match_; }
+	pointer operator->() const { return &match_; }
+
+	MatchIterator& operator++()
+	{
+		const size_t match_end= size_t(match_.data() - str_.data()) + match_.size();
+		FindMatch(match_.empty() ? GetNextCodePointOffset(match_end) : match_end);
+		return *this;
+	}
+
+	MatchIterator operator++(int)
+	{
+		MatchIterator prev= *this;
+		++*this;
+		return prev;
+	}
+
+	bool operator==(const MatchIterator& other) const
+	{
+		return
+			this->function_ == other.function_ &&
+			this->match_.data() == other.match_.data() &&
+			this->match_.size() == other.match_.size();
+	}
+
+	bool operator!=(const MatchIterator& other) const { return !(*this == other); }
+
+private:
+	void FindMatch(const size_t start_offset)
+	{
+		// Position right after string end is checked too, because some expressions may match empty string at the end.
+		if(start_offset <= str_.size())
+		{
+			size_t subpatterns[2]{};
+			if(function_(str_.data(), str_.size(), start_offset, subpatterns, 1) != 0)
+			{
+				match_= str_.substr(subpatterns[0], subpatterns[1] - subpatterns[0]);
+				return;
+			}
+		}
+
+		// Nothing found - become end iterator.
+		*this= MatchIterator();
+	}
+
+	size_t GetNextCodePointOffset(size_t offset) const
+	{
+		++offset;
+		// Skip UTF-8 continuation bytes, in order to not start search from the middle of code point.
+		if(encoding_ == Encoding::UTF8)
+		{
+			while(offset < str_.size() && (uint8_t(str_[offset]) & 0xC0) == 0x80)
+				++offset;
+		}
+		return offset;
+	}
+
+private:
+	MatcherFunctionType function_= nullptr;
+	std::string_view str_;
+	std::string_view match_;
+	Encoding encoding_= Encoding::UTF8;
+};
+
+// Lazy iterator over pieces of string between matches of given matcher function.
+// For N matches N + 1 pieces are produced, some of them may be empty.
+// Pieces are views into source string, nothing is allocated or copied.
+class SplitIterator
+{
+public:
+	using iterator_category= std::forward_iterator_tag;
+	using value_type= std::string_view;
+	using difference_type= std::ptrdiff_t;
+	using pointer= const std::string_view*;
+	using reference= const std::string_view&;
+
+public:
+	// Creates end iterator.
+	SplitIterator()= default;
+
+	SplitIterator(const MatcherFunctionType function, const std::string_view str, const Encoding encoding= Encoding::UTF8)
+		: match_it_(function, str, encoding), str_(str), is_end_(false)
+	{
+		UpdatePiece();
+	}
+
+	reference operator*() const { return piece_; }
+	pointer operator->() const { return &piece_; }
+
+	SplitIterator& operator++()
+	{
+		if(match_it_ == MatchIterator())
+		{
+			// Last piece was reached.
+			*this= SplitIterator();
+			return *this;
+		}
+
+		piece_begin_= size_t(match_it_->data() - str_.data()) + match_it_->size();
+		++match_it_;
+		UpdatePiece();
+		return *this;
+	}
+
+	SplitIterator operator++(int)
+	{
+		SplitIterator prev= *this;
+		++*this;
+		return prev;
+	}
+
+	bool operator==(const SplitIterator& other) const
+	{
+		return
+			this->is_end_ == other.is_end_ &&
+			this->match_it_ == other.match_it_ &&
+			this->piece_.data() == other.piece_.data() &&
+			this->piece_.size() == other.piece_.size();
+	}
+
+	bool operator!=(const SplitIterator& other) const { return !(*this == other); }
+
+private:
+	void UpdatePiece()
+	{
+		if(match_it_ == MatchIterator())
+			piece_= str_.substr(piece_begin_);
+		else
+			piece_= str_.substr(piece_begin_, size_t(match_it_->data() - str_.data()) - piece_begin_);
+	}
+
+private:
+	MatchIterator match_it_;
+	std::string_view str_;
+	std::string_view piece_;
+	size_t piece_begin_= 0;
+	bool is_end_= true;
+};
+
+template<typename Iterator>
+struct IteratorRange
+{
+	Iterator begin_it;
+	Iterator end_it;
+
+	Iterator begin() const { return begin_it; }
+	Iterator end() const { return end_it; }
+};
+
+// Usage example:
+// for(const std::string_view match : FindAllMatches(function, str)) { ... }
+inline IteratorRange<MatchIterator> FindAllMatches(const MatcherFunctionType function, const std::string_view str, const Encoding encoding= Encoding::UTF8)
+{
+	return IteratorRange<MatchIterator>{ MatchIterator(function, str, encoding), MatchIterator() };
+}
+
+// Usage example:
+// for(const std::string_view piece : SplitString(function, str)) { ... }
+inline IteratorRange<SplitIterator> SplitString(const MatcherFunctionType function, const std::string_view str, const Encoding encoding= Encoding::UTF8)
+{
+	return IteratorRange<SplitIterator>{ SplitIterator(function, str, encoding), SplitIterator() };
+}
+
+} // namespace RegPanzer
@@ -0,0 +1,20 @@
+#pragma once
+#include "RegexGraph.hpp"
+#include <string>
+
+namespace RegPanzer
+{
+
+// Generate C++ source code of matcher functions - alternative to LLVM generator.
+// Result is single self-contained translation unit, which requires only C++11 compiler and standard C headers.
+// It contains single exported function (with C linkage) with given name and with same signature as functions produced by LLVM generator.
+// Code unit type of input string of generated functions depends on encoding option (char, char16_t or char32_t).
+
+// Generate function of type "MatcherFunctionType".
+std::string GenerateMatcherFunctionCpp(const RegexGraphBuildResult& regex_graph, const std::string& function_name);
+
+// Generate function of type "MatchesCounterFunctionType".
+// Use graph built without groups extraction, since groups are not needed here.
+std::string GenerateMatchesCounterFunctionCpp(const RegexGraphBuildResult& regex_graph, const std::string& function_name);
+
+} // namespace RegPanzer
@@ -1,4 +1,5 @@
 #pragma once
+#include "MatcherFunction.hpp"
 #include "RegexGraph.hpp"
 #include "PushDisableLLVMWarnings.hpp"
 #include <llvm/IR/Module.h>
@@ -7,23 +8,19 @@
 namespace RegPanzer
 {
 
-// Type of generated matcher function. sizeof(size_t) depends on target data layout.
-using MatcherFunctionType=
-	size_t (*)(
-		// str pointer should not be null, unless str_size is zero.
-		const char* str,
-		size_t str_size,
-		// Start offset should not be greater, thatstr_size.
-		size_t start_offset,
-		// Out subputterns array. May be empty.
-		size_t* out_subpatterns /* pairs */,
-		size_t number_of_subpatterns /* number of pairs */);
-
 // Input module should contain valid data layout.
+// Code unit type of input string of generated functions depends on encoding option (8, 16 or 32 bits).
 
 void GenerateMatcherFunction(
 	llvm::Module& module,
 	const RegexGraphBuildResult& regex_graph,
 	const std::string& function_name);
 
+// Generate function of type "MatchesCounterFunctionType".
+// Use graph built without groups extraction, since groups are not needed here.
+void GenerateMatchesCounterFunction(
+	llvm::Module& module,
+	const RegexGraphBuildResult& regex_graph,
+	const std::string& function_name);
+
 } // namespace RegPanzer
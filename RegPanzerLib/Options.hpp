@@ -3,10 +3,38 @@
 namespace RegPanzer
 {
 
+// Encoding of input strings. Code unit size depends on it - 8, 16 or 32 bits.
+enum class Encoding
+{
+	UTF8,
+	UTF16, // Host byte order, surrogate pairs are supported.
+	UTF32,
+	Bytes, // Each byte is single code point (Latin-1). No decoding is performed, regex may contain only code points up to 0xFF.
+};
+
+// How UTF-8 input is validated. Used only for UTF-8 encoding.
+enum class Utf8Validation
+{
+	// Each decoded symbol is checked, invalid bytes are matched as single symbols.
+	// Character classes (including inverse classes) match only valid UTF-8 sequences, not invalid bytes or continuation bytes.
+	PerSymbol,
+	// Whole input is checked once before search, nothing is found in invalid input. Symbols decoding is faster.
+	// Check is performed only for search with zero start offset. Search with non-zero start offset (next match in the same string) relies on previous check.
+	// If such search is performed in not validated invalid input, result is unspecified, but no bytes outside input are read.
+	OnceAtEntry,
+	None, // Input is trusted to be valid UTF-8, result for invalid input is undefined. Symbols decoding is faster.
+};
+
 struct Options
 {
 	bool extract_groups= false;
 	bool multiline= false;
+	Encoding encoding= Encoding::UTF8;
+	Utf8Validation utf8_validation= Utf8Validation::PerSymbol;
+	bool case_insensitive= false; // Same as "(?i)" at regex start.
+	// Generate matcher as single function with basic block per node and explicit backtracking stack instead of function per node.
+	// Used only by LLVM backend. Ignored for regular expressions with subroutine calls.
+	bool single_function= false;
 };
 
 } // namespace RegPanzer
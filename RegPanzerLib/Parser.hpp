@@ -1,4 +1,5 @@
 #pragma once
+#include "Options.hpp"
 #include "RegexElements.hpp"
 #include <string>
 #include <string_view>
@@ -17,6 +18,7 @@ using ParseErrors= std::vector<ParseError>;
 using ParseResult= std::variant<RegexElementsChain, ParseErrors>;
 
 // Parse regex in UTF-8 format.
-ParseResult ParseRegexString(std::string_view str);
+// Encoding option is used to check symbols range - for bytes encoding only code points up to 0xFF are allowed.
+ParseResult ParseRegexString(std::string_view str, const Options& options= Options());
 
 } // namespace RegPanzer
@@ -20,8 +20,9 @@ struct AnySymbol
 struct SpecificSymbol
 {
 	CharType code= '\0';
+	bool case_insensitive= false; // Set only for symbols with case variants.
 
-	bool operator==(const SpecificSymbol& other) const { return code == other.code; }
+	bool operator==(const SpecificSymbol& other) const { return code == other.code && case_insensitive == other.case_insensitive; }
 	bool operator!=(const SpecificSymbol& other) const { return !(*this == other); }
 };
 
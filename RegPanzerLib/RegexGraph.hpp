@@ -1,8 +1,11 @@
 #pragma once
 #include "Options.hpp"
 #include "RegexElements.hpp"
+#include <algorithm>
+#include <functional>
 #include <memory>
 #include <map>
+#include <optional>
 #include <unordered_set>
 #include <variant>
 #include <vector>
@@ -21,6 +24,7 @@ struct String;
 struct OneOf;
 struct Alternatives;
 struct AlternativesPossessive;
+struct AlternativesTrie;
 struct GroupStart;
 struct GroupEnd;
 struct BackReference;
@@ -47,6 +51,7 @@ using Node= std::variant<
 	OneOf,
 	Alternatives,
 	AlternativesPossessive,
+	AlternativesTrie,
 	GroupStart,
 	GroupEnd,
 	BackReference,
@@ -84,7 +89,8 @@ struct SpecificSymbol
 struct String
 {
 	NodePtr next= nullptr;
-	std::string str; // UTF-8
+	std::string str; // UTF-8, regardless of input encoding.
+	bool case_insensitive= false; // If true, string is stored in folded (lower) case.
 };
 
 struct OneOf
@@ -96,9 +102,16 @@ struct OneOf
 	bool inverse_flag= false;
 };
 
+// Sorted, non-overlapping ranges of code units of input encoding.
+using CodeUnitRanges= std::vector< std::pair<CharType, CharType> >;
+
 struct Alternatives
 {
 	std::vector<NodePtr> next;
+	// Possible first code units for each alternative, calculated by optimizer in order to skip alternatives, which can't match.
+	// Contains none for alternatives, which may start with any code unit or match without consuming symbols.
+	// Empty if not calculated.
+	std::vector< std::optional<CodeUnitRanges> > next_first_code_units= {};
 };
 
 struct AlternativesPossessive
@@ -111,6 +124,21 @@ struct AlternativesPossessive
 	NodePtr path1_next= nullptr;
 };
 
+// Alternatives of case-sensitive non-empty strings.
+// All strings matching at current position are found at once (using trie),
+// than next nodes of matched strings are evaluated in order of alternatives, with state restoring between them.
+// This is equivalent to "Alternatives" node with "String" nodes in its alternatives.
+struct AlternativesTrie
+{
+	struct Alternative
+	{
+		std::string str; // UTF-8, regardless of input encoding.
+		NodePtr next= nullptr;
+	};
+
+	std::vector<Alternative> alternatives;
+};
+
 struct GroupStart
 {
 	NodePtr next= nullptr; // To contents of the group.
@@ -141,7 +169,7 @@ struct LookBehind
 	NodePtr next= nullptr;
 	NodePtr look_graph= nullptr;
 	bool positive= true;
-	size_t size= 0; // Size in UTF-8 bytes. Now we support look behind with fixed size only.
+	size_t size= 0; // Size in code units. Now we support look behind with fixed size only.
 };
 
 struct StringStartAssertion
@@ -192,6 +220,8 @@ struct SingleRollbackPointSequence
 {
 	NodePtr next= nullptr;
 	NodePtr sequence_element= nullptr;
+	size_t min_elements= 0u;
+	size_t max_elements= 0u;
 };
 
 struct FixedLengthElementSequence
@@ -200,7 +230,7 @@ struct FixedLengthElementSequence
 	NodePtr sequence_element= nullptr;
 	size_t min_elements= 0u;
 	size_t max_elements= 0u;
-	size_t element_length= 0u; // In UTF-8 bytes.
+	size_t element_length= 0u; // In code units.
 };
 
 struct AtomicGroup
@@ -237,9 +267,9 @@ struct StateRestore
 // Store all nodes inside this class.
 // Use only observer pointers inside nodes itself.
 // This is needed to prevent strong shared_ptr loops.
+// Nodes are allocated in blocks (arena), addresses of nodes are stable.
 // All nodes are destroyed when this storage is destroyed.
-// Noded deletion and any garbage collection is not supported,
-// so, optimized-out nodes will be destroyed only during destruction of this class.
+// Nodes deletion is not supported, in order to get rid of unreachable nodes copy graph into new storage (see graph compaction optimization).
 class NodesStorage
 {
 public:
@@ -254,12 +284,29 @@ public:
 public:
 	NodePtr Allocate(Node node)
 	{
-		nodes_.push_back(std::make_unique<Node>(std::move(node)));
-		return nodes_.back().get();
+		if(blocks_.empty() || blocks_.back().size() == blocks_.back().capacity())
+		{
+			// Use growing blocks - in order to have small overhead for small graphs and small number of allocations for large graphs.
+			const size_t block_size= blocks_.empty() ? c_first_block_size : std::min(blocks_.back().capacity() * 2, c_max_block_size);
+			blocks_.emplace_back();
+			blocks_.back().reserve(block_size);
+		}
+
+		// Block is never reallocated, since its capacity is never exceeded.
+		blocks_.back().push_back(std::move(node));
+		++size_;
+		return &blocks_.back().back();
 	}
 
+	size_t GetSize() const { return size_; }
+
+private:
+	static constexpr size_t c_first_block_size= 16;
+	static constexpr size_t c_max_block_size= 4096;
+
 private:
-	std::vector<std::unique_ptr<Node>> nodes_;
+	std::vector<std::vector<Node>> blocks_;
+	size_t size_= 0;
 };
 
 } // GraphElements
@@ -290,4 +337,12 @@ struct RegexGraphBuildResult
 
 RegexGraphBuildResult BuildRegexGraph(const RegexElementsChain& regex_chain, const Options& options);
 
+// Calls given function for each node reachable from start node. Each node is visited only once, in depth-first order.
+using NodeEnumerationFunction= std::function<void(GraphElements::NodePtr)>;
+void EnumerateAllNodesOnce(const NodeEnumerationFunction& func, GraphElements::NodePtr start_node);
+
+// Calls given function for each pointer to other node, stored inside given node (in same order as nodes enumeration does).
+using NodeChildPtrFunction= std::function<void(GraphElements::NodePtr&)>;
+void ForEachNodeChildPtr(GraphElements::Node& node, const NodeChildPtrFunction& func);
+
 } // namespace RegPanzer
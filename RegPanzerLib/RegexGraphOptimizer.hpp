@@ -1,11 +1,56 @@
 #pragma once
 #include "RegexGraph.hpp"
+#include <array>
+#include <bitset>
+#include <chrono>
 
 namespace RegPanzer
 {
 
+// Graph optimization passes in order of execution.
+enum class OptimizationPass
+{
+	OneOfNormalization,
+	SymbolsCombining,
+	AlternativesStartUnite,
+	AlternativesSuffixFactoring,
+	AlternativesTrie,
+	AlternativesPossessification,
+	SequenceCounterPossessification,
+	SingleRollbackPointSequence,
+	FixedLengthElementSequence,
+	AlternativesFirstCodeUnits,
+	GraphCompaction,
+};
+
+constexpr size_t c_num_optimization_passes= size_t(OptimizationPass::GraphCompaction) + 1;
+
+// Returns short pass name, like "symbols-combining".
+const char* GetOptimizationPassName(OptimizationPass pass);
+
+struct OptimizationOptions
+{
+	// All passes are enabled by default.
+	std::bitset<c_num_optimization_passes> disabled_passes;
+	// Symbols combining and alternatives start unite are repeated until nothing changes, but no more than this number of times.
+	size_t max_fixpoint_iterations= 16;
+};
+
+struct OptimizationPassStatistics
+{
+	size_t runs= 0;
+	size_t nodes_rewritten= 0;
+	std::chrono::nanoseconds time_spent{0};
+};
+
+using OptimizationStatistics= std::array<OptimizationPassStatistics, c_num_optimization_passes>;
+
 // Consumes input.
 // Shared nodes are (partially) reused.
-RegexGraphBuildResult OptimizeRegexGraph(RegexGraphBuildResult input_graph);
+// Statistics of executed passes are added to given statistics (if it is non-null).
+RegexGraphBuildResult OptimizeRegexGraph(
+	RegexGraphBuildResult input_graph,
+	const OptimizationOptions& optimization_options= {},
+	OptimizationStatistics* statistics= nullptr);
 
 } // namespace RegPanzer
@@ -0,0 +1,34 @@
+#pragma once
+#include "RegexGraph.hpp"
+#include <unordered_map>
+
+namespace RegPanzer
+{
+
+// Subset of matcher state fields, that may be changed during matching.
+struct StateFieldsSet
+{
+	GraphElements::SequenceIdSet sequence_counters;
+	GroupIdSet groups;
+};
+
+bool IsEmpty(const StateFieldsSet& fields);
+void Unite(StateFieldsSet& dst, const StateFieldsSet& src);
+StateFieldsSet Intersect(const StateFieldsSet& l, const StateFieldsSet& r);
+
+// Result of liveness analysis of state fields for all graph nodes (including null - end node).
+// Used to save and restore in backtracking points only fields, which actually should be restored.
+struct StateFieldsLiveness
+{
+	// Fields, which may be modified by given node or any node evaluated after it.
+	std::unordered_map<GraphElements::NodePtr, StateFieldsSet> modified_fields;
+	// Fields, which values may be read by given node or any node evaluated after it before they are overwritten.
+	// Groups, extracted after successfull match, are read by end node.
+	// End node is also end of sub-graphs, so, if there are sub-graphs, all fields, read by any node, are read by end node.
+	std::unordered_map<GraphElements::NodePtr, StateFieldsSet> live_fields;
+};
+
+// For regular expressions with subroutine calls all fields are considered to be modified and live for all nodes.
+StateFieldsLiveness AnalyzeStateFieldsLiveness(const RegexGraphBuildResult& regex_graph);
+
+} // namespace RegPanzer
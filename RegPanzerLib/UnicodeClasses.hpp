@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace RegPanzer
+{
+
+struct UnicodeClassRange
+{
+	char32_t begin;
+	char32_t end; // Inclusive.
+};
+
+struct UnicodeClassDescription
+{
+	const char* name;
+	size_t ranges_offset;
+	size_t ranges_count;
+};
+
+// Tables are generated by "GenerateUnicodeClasses.pl". Ranges of each class are sorted and non-overlapping.
+extern const UnicodeClassRange g_unicode_class_ranges[];
+extern const UnicodeClassDescription g_unicode_classes[];
+extern const size_t g_unicode_classes_count;
+
+// Returns code point ranges for given general category (like "L" or "Nd") or script (like "Greek").
+// Returns none if class is unknown.
+std::optional< std::vector< std::pair<char32_t, char32_t> > > GetUnicodeClassRanges(std::string_view name);
+
+} // namespace RegPanzer
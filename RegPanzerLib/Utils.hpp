@@ -1,8 +1,11 @@
 #pragma once
+#include "Options.hpp"
 #include "../RegPanzerLib/PushDisableLLVMWarnings.hpp"
 #include <llvm/Target/TargetMachine.h>
 #include "../RegPanzerLib/PopLLVMWarnings.hpp"
+#include <map>
 #include <string>
+#include <vector>
 
 namespace RegPanzer
 {
@@ -35,5 +38,24 @@ std::unique_ptr<llvm::TargetMachine> CreateTargetMachine();
 
 std::string Utf32ToUtf8(std::basic_string_view<char32_t> str);
 std::basic_string<char32_t> Utf8ToUtf32(std::string_view str);
+std::u16string Utf8ToUtf16(std::string_view str);
+bool IsValidUtf8(std::string_view str);
+
+// Returns number of code units of given encoding needed for given code point.
+size_t GetCodePointSize(char32_t code_point, Encoding encoding);
+// Returns number of code units of given encoding needed for given UTF-8 string.
+size_t GetUtf8StringSize(std::string_view str, Encoding encoding);
+
+// Trie of strings of code units. Node 0 is root. Children have greater indices than their parents.
+struct CodeUnitsTrieNode
+{
+	std::map<uint32_t, size_t> children; // Code unit -> child node index.
+	std::vector<size_t> matched_strings; // Sorted indices of strings, ending in this node or in its parents.
+	size_t depth= 0; // Number of code units from root.
+};
+
+using CodeUnitsTrie= std::vector<CodeUnitsTrieNode>;
+
+CodeUnitsTrie BuildCodeUnitsTrie(const std::vector< std::vector<uint32_t> >& strings);
 
 } // namespace RegPanzer
@@ -0,0 +1,118 @@
+#include "../CaseFolding.hpp"
+#include <algorithm>
+
+namespace RegPanzer
+{
+
+namespace
+{
+
+struct CaseRange
+{
+	// Range of upper case letters.
+	// For non-alternating ranges lower case letter is upper case letter + delta.
+	// For alternating ranges upper and lower case letters are interleaved - upper case letters have same parity as range begin, delta is 1.
+	char32_t begin;
+	char32_t end;
+	char32_t delta;
+	bool alternating;
+};
+
+const CaseRange g_case_ranges[]
+{
+	{ 0x0041, 0x005A, 0x20, false }, // Basic Latin.
+	{ 0x00C0, 0x00D6, 0x20, false }, // Latin-1 Supplement.
+	{ 0x00D8, 0x00DE, 0x20, false },
+	{ 0x0100, 0x012E, 1, true }, // Latin Extended-A.
+	{ 0x0132, 0x0136, 1, true },
+	{ 0x0139, 0x0147, 1, true },
+	{ 0x014A, 0x0176, 1, true },
+	{ 0x0178, 0x0178, char32_t(0x00FF - 0x0178), false },
+	{ 0x0179, 0x017D, 1, true },
+	{ 0x0391, 0x03A1, 0x20, false }, // Greek.
+	{ 0x03A3, 0x03AB, 0x20, false },
+	{ 0x0400, 0x040F, 0x50, false }, // Cyrillic.
+	{ 0x0410, 0x042F, 0x20, false },
+	{ 0x0460, 0x0480, 1, true },
+	{ 0x048A, 0x04BE, 1, true },
+	{ 0x04C1, 0x04CD, 1, true },
+	{ 0x04D0, 0x052E, 1, true },
+	{ 0x0531, 0x0556, 0x30, false }, // Armenian.
+	{ 0x1E00, 0x1E94, 1, true }, // Latin Extended Additional.
+	{ 0x1EA0, 0x1EFE, 1, true },
+	{ 0xFF21, 0xFF3A, 0x20, false }, // Fullwidth Latin.
+};
+
+bool IsUpperInRange(const CaseRange& range, const char32_t c)
+{
+	return c >= range.begin && c <= range.end && (!range.alternating || ((c - range.begin) & 1) == 0);
+}
+
+bool IsLowerInRange(const CaseRange& range, const char32_t c)
+{
+	return IsUpperInRange(range, c - range.delta);
+}
+
+} // namespace
+
+std::optional<char32_t> GetOtherCase(const char32_t c)
+{
+	for(const CaseRange& range : g_case_ranges)
+	{
+		if(IsUpperInRange(range, c))
+			return c + range.delta;
+		if(IsLowerInRange(range, c))
+			return c - range.delta;
+	}
+
+	return std::nullopt;
+}
+
+char32_t FoldCase(const char32_t c)
+{
+	for(const CaseRange& range : g_case_ranges)
+		if(IsUpperInRange(range, c))
+			return c + range.delta;
+
+	return c;
+}
+
+std::vector< std::pair<char32_t, char32_t> > GetOtherCaseRanges(const char32_t begin, const char32_t end)
+{
+	std::vector< std::pair<char32_t, char32_t> > result;
+
+	for(const CaseRange& range : g_case_ranges)
+	{
+		// Upper case letters in given range.
+		{
+			const char32_t intersection_begin= std::max(begin, range.begin);
+			const char32_t intersection_end= std::min(end, range.end);
+			if(range.alternating)
+			{
+				for(char32_t c= intersection_begin; c <= intersection_end; ++c)
+					if(IsUpperInRange(range, c))
+						result.emplace_back(c + range.delta, c + range.delta);
+			}
+			else if(intersection_begin <= intersection_end)
+				result.emplace_back(intersection_begin + range.delta, intersection_end + range.delta);
+		}
+
+		// Lower case letters in given range.
+		{
+			const char32_t intersection_begin= std::max(begin, char32_t(range.begin + range.delta));
+			const char32_t intersection_end= std::min(end, char32_t(range.end + range.delta));
+			if(range.alternating)
+			{
+				for(char32_t c= intersection_begin; c <= intersection_end; ++c)
+					if(IsLowerInRange(range, c))
+						result.emplace_back(c - range.delta, c - range.delta);
+			}
+			else if(intersection_begin <= intersection_end)
+				result.emplace_back(intersection_begin - range.delta, intersection_end - range.delta);
+		}
+	}
+
+	return result;
+}
+
+} // namespace RegPanzer
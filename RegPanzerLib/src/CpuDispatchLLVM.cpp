@@ -0,0 +1,354 @@
+#include "../CpuDispatchLLVM.hpp"
+#include "../PushDisableLLVMWarnings.hpp"
+#include <llvm/IR/GlobalIFunc.h>
+#include <llvm/IR/InlineAsm.h>
+#include <llvm/IR/IRBuilder.h>
+#include "../PopLLVMWarnings.hpp"
+#include <algorithm>
+#include <cassert>
+
+namespace RegPanzer
+{
+
+const char* const c_dispatch_cpu_names[4]
+{
+	"x86-64",
+	"x86-64-v2",
+	"x86-64-v3",
+	"x86-64-v4",
+};
+
+namespace
+{
+
+uint32_t GetDispatchCpuLevel(const std::string& cpu_name)
+{
+	for(uint32_t i= 0; i < std::size(c_dispatch_cpu_names); ++i)
+		if(cpu_name == c_dispatch_cpu_names[i])
+			return i;
+
+	assert(false);
+	return 0;
+}
+
+// Features bits (see Intel documentation of "cpuid" instruction).
+
+// Leaf 1, ecx: SSE3, SSSE3, CX16, SSE4.1, SSE4.2, POPCNT.
+const uint32_t c_v2_leaf1_ecx_mask= (1u << 0) | (1u << 9) | (1u << 13) | (1u << 19) | (1u << 20) | (1u << 23);
+// Leaf 0x80000001, ecx: LAHF/SAHF.
+const uint32_t c_v2_ext_leaf1_ecx_mask= 1u << 0;
+
+// Leaf 1, ecx: FMA, MOVBE, OSXSAVE, AVX, F16C.
+const uint32_t c_v3_leaf1_ecx_mask= (1u << 12) | (1u << 22) | (1u << 27) | (1u << 28) | (1u << 29);
+// Leaf 7, ebx: BMI1, AVX2, BMI2.
+const uint32_t c_v3_leaf7_ebx_mask= (1u << 3) | (1u << 5) | (1u << 8);
+// Leaf 0x80000001, ecx: LZCNT.
+const uint32_t c_v3_ext_leaf1_ecx_mask= 1u << 5;
+// XCR0: SSE and AVX states are enabled by OS.
+const uint32_t c_v3_xcr0_mask= (1u << 1) | (1u << 2);
+
+// Leaf 7, ebx: AVX512F, AVX512DQ, AVX512CD, AVX512BW, AVX512VL.
+const uint32_t c_v4_leaf7_ebx_mask= (1u << 16) | (1u << 17) | (1u << 28) | (1u << 30) | (1u << 31);
+// XCR0: also opmask and ZMM states are enabled by OS.
+const uint32_t c_v4_xcr0_mask= c_v3_xcr0_mask | (1u << 5) | (1u << 6) | (1u << 7);
+
+const uint32_t c_osxsave_bit= 1u << 27;
+
+class DispatchGenerator
+{
+public:
+	explicit DispatchGenerator(llvm::Module& module)
+		: module_(module)
+		, context_(module.getContext())
+		, int32_type_(llvm::Type::getInt32Ty(context_))
+	{}
+
+	// Returns function, which returns index of best supported CPU level. Result is cached.
+	llvm::Function* GetOrCreateCpuLevelFunction()
+	{
+		const std::string function_name= "get_x86_cpu_level";
+		if(const auto prev_function= module_.getFunction(function_name))
+			return prev_function;
+
+		const auto cache=
+			new llvm::GlobalVariable(
+				module_,
+				int32_type_,
+				false,
+				llvm::GlobalValue::PrivateLinkage,
+				GetConstant(~0u),
+				"x86_cpu_level_cache");
+
+		const auto function=
+			llvm::Function::Create(llvm::FunctionType::get(int32_type_, false), llvm::GlobalValue::PrivateLinkage, function_name, module_);
+
+		const auto start_block= llvm::BasicBlock::Create(context_, "", function);
+		const auto detect_block= llvm::BasicBlock::Create(context_, "detect", function);
+		const auto xgetbv_block= llvm::BasicBlock::Create(context_, "xgetbv", function);
+		const auto compute_level_block= llvm::BasicBlock::Create(context_, "compute_level", function);
+		const auto ret_cached_block= llvm::BasicBlock::Create(context_, "ret_cached", function);
+
+		llvm::IRBuilder<> llvm_ir_builder(start_block);
+
+		// Concurrent first calls are possible. All of them compute same level, so, just use atomic operations.
+		const auto cached_level= llvm_ir_builder.CreateLoad(int32_type_, cache, "cached_level");
+		cached_level->setAtomic(llvm::AtomicOrdering::Monotonic);
+		cached_level->setAlignment(module_.getDataLayout().getABITypeAlign(int32_type_));
+		llvm_ir_builder.CreateCondBr(llvm_ir_builder.CreateICmpNE(cached_level, GetConstant(~0u)), ret_cached_block, detect_block);
+
+		llvm_ir_builder.SetInsertPoint(ret_cached_block);
+		llvm_ir_builder.CreateRet(cached_level);
+
+		// Detect block.
+		llvm_ir_builder.SetInsertPoint(detect_block);
+
+		const auto leaf0= CreateCpuid(llvm_ir_builder, 0);
+		const auto max_leaf= llvm_ir_builder.CreateExtractValue(leaf0, {0}, "max_leaf");
+		const auto leaf1_ecx= llvm_ir_builder.CreateExtractValue(CreateCpuid(llvm_ir_builder, 1), {2}, "leaf1_ecx");
+
+		// It is safe to execute "cpuid" with unsupported leaf, just ignore its result.
+		const auto leaf7_ebx=
+			llvm_ir_builder.CreateSelect(
+				llvm_ir_builder.CreateICmpUGE(max_leaf, GetConstant(7)),
+				llvm_ir_builder.CreateExtractValue(CreateCpuid(llvm_ir_builder, 7), {1}),
+				GetConstant(0),
+				"leaf7_ebx");
+
+		const auto max_ext_leaf= llvm_ir_builder.CreateExtractValue(CreateCpuid(llvm_ir_builder, 0x80000000u), {0}, "max_ext_leaf");
+		const auto ext_leaf1_ecx=
+			llvm_ir_builder.CreateSelect(
+				llvm_ir_builder.CreateICmpUGE(max_ext_leaf, GetConstant(0x80000001u)),
+				llvm_ir_builder.CreateExtractValue(CreateCpuid(llvm_ir_builder, 0x80000001u), {2}),
+				GetConstant(0),
+				"ext_leaf1_ecx");
+
+		// "xgetbv" instruction may be executed only if OS supports it.
+		const auto has_osxsave= CreateMaskCheck(llvm_ir_builder, leaf1_ecx, c_osxsave_bit);
+		llvm_ir_builder.CreateCondBr(has_osxsave, xgetbv_block, compute_level_block);
+
+		llvm_ir_builder.SetInsertPoint(xgetbv_block);
+		const auto xgetbv_asm=
+			llvm::InlineAsm::get(
+				llvm::FunctionType::get(llvm::StructType::get(int32_type_, int32_type_), {int32_type_}, false),
+				"xgetbv",
+				"={ax},={dx},{cx},~{dirflag},~{fpsr},~{flags}",
+				true);
+		const auto xcr0_value= llvm_ir_builder.CreateExtractValue(llvm_ir_builder.CreateCall(xgetbv_asm, {GetConstant(0)}), {0}, "xcr0_value");
+		llvm_ir_builder.CreateBr(compute_level_block);
+
+		// Compute level block.
+		llvm_ir_builder.SetInsertPoint(compute_level_block);
+		const auto xcr0= llvm_ir_builder.CreatePHI(int32_type_, 2, "xcr0");
+		xcr0->addIncoming(GetConstant(0), detect_block);
+		xcr0->addIncoming(xcr0_value, xgetbv_block);
+
+		const auto v2_supported=
+			llvm_ir_builder.CreateAnd(
+				CreateMaskCheck(llvm_ir_builder, leaf1_ecx, c_v2_leaf1_ecx_mask),
+				CreateMaskCheck(llvm_ir_builder, ext_leaf1_ecx, c_v2_ext_leaf1_ecx_mask),
+				"v2_supported");
+
+		llvm::Value* v3_supported= v2_supported;
+		v3_supported= llvm_ir_builder.CreateAnd(v3_supported, CreateMaskCheck(llvm_ir_builder, leaf1_ecx, c_v3_leaf1_ecx_mask));
+		v3_supported= llvm_ir_builder.CreateAnd(v3_supported, CreateMaskCheck(llvm_ir_builder, leaf7_ebx, c_v3_leaf7_ebx_mask));
+		v3_supported= llvm_ir_builder.CreateAnd(v3_supported, CreateMaskCheck(llvm_ir_builder, ext_leaf1_ecx, c_v3_ext_leaf1_ecx_mask));
+		v3_supported= llvm_ir_builder.CreateAnd(v3_supported, CreateMaskCheck(llvm_ir_builder, xcr0, c_v3_xcr0_mask), "v3_supported");
+
+		llvm::Value* v4_supported= v3_supported;
+		v4_supported= llvm_ir_builder.CreateAnd(v4_supported, CreateMaskCheck(llvm_ir_builder, leaf7_ebx, c_v4_leaf7_ebx_mask));
+		v4_supported= llvm_ir_builder.CreateAnd(v4_supported, CreateMaskCheck(llvm_ir_builder, xcr0, c_v4_xcr0_mask), "v4_supported");
+
+		// Levels are nested, so, level is just sum of flags.
+		llvm::Value* level= llvm_ir_builder.CreateZExt(v2_supported, int32_type_);
+		level= llvm_ir_builder.CreateAdd(level, llvm_ir_builder.CreateZExt(v3_supported, int32_type_));
+		level= llvm_ir_builder.CreateAdd(level, llvm_ir_builder.CreateZExt(v4_supported, int32_type_), "level");
+
+		const auto store= llvm_ir_builder.CreateStore(level, cache);
+		store->setAtomic(llvm::AtomicOrdering::Monotonic);
+		store->setAlignment(module_.getDataLayout().getABITypeAlign(int32_type_));
+		llvm_ir_builder.CreateRet(level);
+
+		return function;
+	}
+
+	// Create function, which returns pointer to best version.
+	llvm::Function* CreateResolverFunction(const std::string& function_name, const std::vector<CpuFunctionVersion>& versions_sorted)
+	{
+		const auto function_type= versions_sorted.front().function->getFunctionType();
+		const auto function_ptr_type= llvm::PointerType::get(function_type, 0);
+
+		const auto resolver=
+			llvm::Function::Create(
+				llvm::FunctionType::get(function_ptr_type, false),
+				llvm::GlobalValue::PrivateLinkage,
+				function_name + "_resolver",
+				module_);
+
+		llvm::IRBuilder<> llvm_ir_builder(llvm::BasicBlock::Create(context_, "", resolver));
+		const auto level= llvm_ir_builder.CreateCall(GetOrCreateCpuLevelFunction(), {}, "level");
+
+		// Check versions from best to worst.
+		for(auto it= versions_sorted.rbegin(); it != versions_sorted.rend(); ++it)
+		{
+			const uint32_t version_level= GetDispatchCpuLevel(it->cpu_name);
+			if(version_level == 0)
+			{
+				llvm_ir_builder.CreateRet(it->function);
+				break;
+			}
+
+			const auto ret_block= llvm::BasicBlock::Create(context_, "ret_" + it->cpu_name, resolver);
+			const auto next_block= llvm::BasicBlock::Create(context_, "", resolver);
+			llvm_ir_builder.CreateCondBr(llvm_ir_builder.CreateICmpUGE(level, GetConstant(version_level)), ret_block, next_block);
+
+			llvm_ir_builder.SetInsertPoint(ret_block);
+			llvm_ir_builder.CreateRet(it->function);
+
+			llvm_ir_builder.SetInsertPoint(next_block);
+		}
+
+		return resolver;
+	}
+
+	// Create function, which calls resolver at first call and than calls resolved function.
+	void CreateDispatcherFunction(const std::string& function_name, llvm::Function* const resolver)
+	{
+		const auto function_ptr_type= resolver->getReturnType();
+		const auto function_type= llvm::cast<llvm::FunctionType>(function_ptr_type->getPointerElementType());
+
+		const auto resolved_function_ptr=
+			new llvm::GlobalVariable(
+				module_,
+				function_ptr_type,
+				false,
+				llvm::GlobalValue::PrivateLinkage,
+				llvm::ConstantPointerNull::get(llvm::cast<llvm::PointerType>(function_ptr_type)),
+				function_name + "_resolved");
+
+		const auto function= llvm::Function::Create(function_type, llvm::GlobalValue::ExternalLinkage, function_name, module_);
+
+		const auto start_block= llvm::BasicBlock::Create(context_, "", function);
+		const auto resolve_block= llvm::BasicBlock::Create(context_, "resolve", function);
+		const auto call_block= llvm::BasicBlock::Create(context_, "call", function);
+
+		llvm::IRBuilder<> llvm_ir_builder(start_block);
+
+		// Concurrent first calls are possible. Resolver returns same result for all of them, so, just use atomic operations.
+		const auto prev_value= llvm_ir_builder.CreateLoad(function_ptr_type, resolved_function_ptr, "prev_value");
+		prev_value->setAtomic(llvm::AtomicOrdering::Monotonic);
+		prev_value->setAlignment(module_.getDataLayout().getPointerABIAlignment(0));
+		llvm_ir_builder.CreateCondBr(llvm_ir_builder.CreateIsNull(prev_value), resolve_block, call_block);
+
+		llvm_ir_builder.SetInsertPoint(resolve_block);
+		const auto resolved_value= llvm_ir_builder.CreateCall(resolver, {}, "resolved_value");
+		const auto store= llvm_ir_builder.CreateStore(resolved_value, resolved_function_ptr);
+		store->setAtomic(llvm::AtomicOrdering::Monotonic);
+		store->setAlignment(module_.getDataLayout().getPointerABIAlignment(0));
+		llvm_ir_builder.CreateBr(call_block);
+
+		llvm_ir_builder.SetInsertPoint(call_block);
+		const auto callee= llvm_ir_builder.CreatePHI(function_ptr_type, 2, "callee");
+		callee->addIncoming(prev_value, start_block);
+		callee->addIncoming(resolved_value, resolve_block);
+
+		llvm::SmallVector<llvm::Value*, 8> args;
+		for(llvm::Argument& arg : function->args())
+			args.push_back(&arg);
+
+		const auto call= llvm_ir_builder.CreateCall(function_type, callee, args);
+		call->setTailCall(true);
+		if(function_type->getReturnType()->isVoidTy())
+			llvm_ir_builder.CreateRetVoid();
+		else
+			llvm_ir_builder.CreateRet(call);
+	}
+
+private:
+	llvm::ConstantInt* GetConstant(const uint32_t value) const
+	{
+		return llvm::ConstantInt::get(int32_type_, uint64_t(value));
+	}
+
+	// Returns struct of eax, ebx, ecx, edx.
+	llvm::Value* CreateCpuid(llvm::IRBuilder<>& llvm_ir_builder, const uint32_t leaf) const
+	{
+		const auto cpuid_asm=
+			llvm::InlineAsm::get(
+				llvm::FunctionType::get(llvm::StructType::get(int32_type_, int32_type_, int32_type_, int32_type_), {int32_type_, int32_type_}, false),
+				"cpuid",
+				"={ax},={bx},={cx},={dx},{ax},{cx},~{dirflag},~{fpsr},~{flags}",
+				false);
+		return llvm_ir_builder.CreateCall(cpuid_asm, {GetConstant(leaf), GetConstant(0)});
+	}
+
+	llvm::Value* CreateMaskCheck(llvm::IRBuilder<>& llvm_ir_builder, llvm::Value* const value, const uint32_t mask) const
+	{
+		return llvm_ir_builder.CreateICmpEQ(llvm_ir_builder.CreateAnd(value, GetConstant(mask)), GetConstant(mask));
+	}
+
+private:
+	llvm::Module& module_;
+	llvm::LLVMContext& context_;
+	llvm::IntegerType* const int32_type_;
+};
+
+} // namespace
+
+bool IsDispatchCpuName(const std::string& cpu_name)
+{
+	for(const char* const name : c_dispatch_cpu_names)
+		if(cpu_name == name)
+			return true;
+	return false;
+}
+
+void SetModuleFunctionsTargetCpu(llvm::Module& module, const std::string& cpu_name)
+{
+	for(llvm::Function& function : module)
+	{
+		if(function.isDeclaration())
+			continue;
+
+		// CPU name implies all its features, so, reset features, which may be set for target machine.
+		function.addFnAttr("target-cpu", cpu_name);
+		function.addFnAttr("target-features", "");
+	}
+}
+
+void GenerateCpuDispatchedFunction(
+	llvm::Module& module,
+	const std::string& function_name,
+	const std::vector<CpuFunctionVersion>& versions,
+	const bool use_ifunc)
+{
+	assert(!versions.empty());
+
+	std::vector<CpuFunctionVersion> versions_sorted= versions;
+	std::sort(
+		versions_sorted.begin(),
+		versions_sorted.end(),
+		[](const CpuFunctionVersion& l, const CpuFunctionVersion& r)
+		{
+			return GetDispatchCpuLevel(l.cpu_name) < GetDispatchCpuLevel(r.cpu_name);
+		});
+	assert(GetDispatchCpuLevel(versions_sorted.front().cpu_name) == 0);
+
+	for(const CpuFunctionVersion& version : versions_sorted)
+		version.function->setLinkage(llvm::GlobalValue::InternalLinkage);
+
+	DispatchGenerator generator(module);
+	const auto resolver= generator.CreateResolverFunction(function_name, versions_sorted);
+
+	if(use_ifunc)
+		llvm::GlobalIFunc::create(
+			versions_sorted.front().function->getFunctionType(),
+			0,
+			llvm::GlobalValue::ExternalLinkage,
+			function_name,
+			resolver,
+			&module);
+	else
+		generator.CreateDispatcherFunction(function_name, resolver);
+}
+
+} // namespace RegPanzer
@@ -0,0 +1,68 @@
+#!/usr/bin/perl
+# Generates "UnicodeClassesTables.cpp" with code point ranges of Unicode general categories and scripts.
+# Data is taken from Unicode database of Perl installation.
+# Usage: perl GenerateUnicodeClasses.pl > UnicodeClassesTables.cpp
+
+use strict;
+use warnings;
+use Unicode::UCD qw(prop_invlist);
+
+# Only categories of assigned code points are used, so, "C" (which includes unassigned code points), "Cn", "Co", "Cs" are not listed.
+my @general_categories= qw(
+	Cc Cf
+	L Lu Ll Lt Lm Lo
+	M Mn Mc Me
+	N Nd Nl No
+	P Pc Pd Ps Pe Pi Pf Po
+	S Sm Sc Sk So
+	Z Zs Zl Zp);
+
+my @scripts= qw(
+	Arabic Armenian Bengali Bopomofo Common Cyrillic Devanagari Ethiopic Georgian Greek Gujarati Gurmukhi
+	Han Hangul Hebrew Hiragana Inherited Kannada Katakana Khmer Lao Latin Malayalam Mongolian Myanmar
+	Oriya Sinhala Tamil Telugu Thaana Thai Tibetan);
+
+my @classes;
+foreach my $category (@general_categories)
+{
+	push @classes, [$category, [prop_invlist("Gc=$category")]];
+}
+foreach my $script (@scripts)
+{
+	push @classes, [$script, [prop_invlist("Script=$script")]];
+}
+
+print "// This file is generated by GenerateUnicodeClasses.pl from Unicode ", Unicode::UCD::UnicodeVersion(), " data. Do not edit it manually.\n";
+print "#include \"../UnicodeClasses.hpp\"\n#include <iterator>\n\n";
+print "namespace RegPanzer\n{\n\n";
+print "const UnicodeClassRange g_unicode_class_ranges[]\n{\n";
+
+my @descriptions;
+my $offset= 0;
+foreach my $class (@classes)
+{
+	my ($name, $list)= @$class;
+	my @ranges;
+	for(my $i= 0; $i < @$list; $i+= 2)
+	{
+		my $end= $i + 1 < @$list ? $list->[$i + 1] : 0x110000;
+		push @ranges, sprintf("{0x%04X, 0x%04X}", $list->[$i], $end - 1);
+	}
+
+	print "\t// $name\n";
+	for(my $i= 0; $i < @ranges; $i+= 6)
+	{
+		my $last= $i + 5 < $#ranges ? $i + 5 : $#ranges;
+		print "\t", join(", ", @ranges[$i .. $last]), ",\n";
+	}
+
+	push @descriptions, sprintf("\t{ \"%s\", %d, %d },\n", $name, $offset, scalar(@ranges));
+	$offset+= @ranges;
+}
+
+print "};\n\n";
+print "const UnicodeClassDescription g_unicode_classes[]\n{\n";
+print @descriptions;
+print "};\n\n";
+print "const size_t g_unicode_classes_count= std::size(g_unicode_classes);\n\n";
+print "} // namespace RegPanzer\n";
@@ -1,4 +1,6 @@
+#include "../CaseFolding.hpp"
 #include "../Matcher.hpp"
+#include "../Utils.hpp"
 #include "../PushDisableLLVMWarnings.hpp"
 #include <llvm/ADT/SmallVector.h>
 #include <llvm/ADT/DenseMap.h>
@@ -14,27 +16,40 @@ namespace RegPanzer
 namespace
 {
 
+// CharT - code unit type, depending on encoding.
+template<typename CharT>
 struct State
 {
-	std::string_view str;
-	std::string_view str_initial;
-	std::string_view groups[10];
+	using StringView= std::basic_string_view<CharT>;
+
+	StringView str;
+	StringView str_initial;
+	StringView groups[10];
 	llvm::DenseMap<GraphElements::SequenceId, size_t> sequence_counters;
 	llvm::SmallVector<GraphElements::NodePtr, 8> subroutines_return_stack;
 
 	struct SubroutineEnterSaveState
 	{
 		llvm::SmallVector<std::pair<GraphElements::SequenceId, size_t>, 6> sequence_counters;
-		llvm::SmallVector<std::pair<size_t, std::string_view>, 4> groups;
+		llvm::SmallVector<std::pair<size_t, StringView>, 4> groups;
 		const SubroutineEnterSaveState* prev= nullptr;
 	};
 
 	const SubroutineEnterSaveState* saved_state= nullptr;
+
+	// For "char" code units - UTF-8 or bytes.
+	Encoding encoding= Encoding::UTF8;
 };
 
-std::optional<CharType> ExtractCodePoint(State& state)
+std::optional<CharType> ExtractCodePoint(std::string_view& str)
 {
-	std::string_view& str= state.str;
+	if(str.empty())
+		return std::nullopt;
+
+	// Convert only first sequence, since conversion fails if next sequences are invalid.
+	const size_t size= size_t(llvm::getNumBytesForUTF8(llvm::UTF8(str.front())));
+	if(size > str.size())
+		return std::nullopt;
 
 	llvm::UTF32 code= 0;
 
@@ -42,7 +57,7 @@ std::optional<CharType> ExtractCodePoint(State& state)
 	auto src_start= src_start_initial;
 	auto target_start= &code;
 
-	const auto res= llvm::ConvertUTF8toUTF32(&src_start, src_start + str.size(), &target_start, target_start + 1, llvm::strictConversion);
+	const auto res= llvm::ConvertUTF8toUTF32(&src_start, src_start + size, &target_start, target_start + 1, llvm::strictConversion);
 
 	if(target_start != &code + 1 || !(res == llvm::conversionOK || res == llvm::targetExhausted))
 		return std::nullopt;
@@ -51,30 +66,120 @@ std::optional<CharType> ExtractCodePoint(State& state)
 	return CharType(code);
 }
 
-bool MatchNode(GraphElements::NodePtr node, State& state);
+std::optional<CharType> ExtractCodePoint(std::u16string_view& str)
+{
+	if(str.empty())
+		return std::nullopt;
+
+	const char16_t c0= str[0];
+	if(c0 < 0xD800 || c0 > 0xDFFF)
+	{
+		str.remove_prefix(1);
+		return CharType(c0);
+	}
 
-bool MatchNodeImpl(const GraphElements::AnySymbol& node, State& state)
+	// Surrogate pair.
+	if(c0 > 0xDBFF || str.size() < 2)
+		return std::nullopt;
+	const char16_t c1= str[1];
+	if(c1 < 0xDC00 || c1 > 0xDFFF)
+		return std::nullopt;
+
+	str.remove_prefix(2);
+	return CharType(0x10000 + ((CharType(c0) - 0xD800) << 10) + (CharType(c1) - 0xDC00));
+}
+
+std::optional<CharType> ExtractCodePoint(std::u32string_view& str)
+{
+	if(str.empty())
+		return std::nullopt;
+
+	const CharType c= str[0];
+	str.remove_prefix(1);
+	return c;
+}
+
+template<typename CharT>
+std::optional<CharType> ExtractCodePoint(State<CharT>& state)
+{
+	if constexpr(std::is_same_v<CharT, char>)
+	{
+		if(state.encoding == Encoding::Bytes)
+		{
+			// No decoding - each byte is single code point.
+			if(state.str.empty())
+				return std::nullopt;
+
+			const auto c= CharType(uint8_t(state.str.front()));
+			state.str.remove_prefix(1);
+			return c;
+		}
+	}
+
+	return ExtractCodePoint(state.str);
+}
+
+template<typename CharT> bool MatchNode(GraphElements::NodePtr node, State<CharT>& state);
+
+template<typename CharT>
+bool MatchNodeImpl(const GraphElements::AnySymbol& node, State<CharT>& state)
 {
 	return ExtractCodePoint(state) && MatchNode(node.next, state);
 }
 
-bool MatchNodeImpl(const GraphElements::SpecificSymbol& node, State& state)
+template<typename CharT>
+bool MatchNodeImpl(const GraphElements::SpecificSymbol& node, State<CharT>& state)
 {
 	return ExtractCodePoint(state) == node.code && MatchNode(node.next, state);
 }
 
-bool MatchNodeImpl(const GraphElements::String& node, State& state)
+// Extracts given case-sensitive string (in UTF-8) from input. Returns false if input doesn't start with this string.
+template<typename CharT>
+bool ExtractString(const std::string& str, State<CharT>& state)
+{
+	if constexpr(std::is_same_v<CharT, char>)
+	{
+		if(state.encoding == Encoding::UTF8)
+		{
+			if(state.str.size() >= str.size() && state.str.substr(0, str.size()) == str)
+			{
+				state.str.remove_prefix(str.size());
+				return true;
+			}
+
+			return false;
+		}
+	}
+
+	// String is stored in UTF-8, so, compare it code point by code point.
+	for(const CharType c : Utf8ToUtf32(str))
+		if(ExtractCodePoint(state) != c)
+			return false;
+
+	return true;
+}
+
+template<typename CharT>
+bool MatchNodeImpl(const GraphElements::String& node, State<CharT>& state)
 {
-	if(state.str.size() >= node.str.size() && state.str.substr(0, node.str.size()) == node.str)
+	if(node.case_insensitive)
 	{
-		state.str.remove_prefix(node.str.size());
+		// String is stored in folded case, so, fold input symbols too.
+		for(const CharType c : Utf8ToUtf32(node.str))
+		{
+			const auto code= ExtractCodePoint(state);
+			if(code == std::nullopt || FoldCase(*code) != c)
+				return false;
+		}
+
 		return MatchNode(node.next, state);
 	}
 
-	return false;
+	return ExtractString(node.str, state) && MatchNode(node.next, state);
 }
 
-bool MatchNodeImpl(const GraphElements::OneOf& node, State& state)
+template<typename CharT>
+bool MatchNodeImpl(const GraphElements::OneOf& node, State<CharT>& state)
 {
 	const auto code= ExtractCodePoint(state);
 	if(code == std::nullopt)
@@ -92,11 +197,12 @@ bool MatchNodeImpl(const GraphElements::OneOf& node, State& state)
 	return (found ^ node.inverse_flag) && MatchNode(node.next, state);
 }
 
-bool MatchNodeImpl(const GraphElements::Alternatives& node, State& state)
+template<typename CharT>
+bool MatchNodeImpl(const GraphElements::Alternatives& node, State<CharT>& state)
 {
 	for(const GraphElements::NodePtr alternative : node.next)
 	{
-		State state_copy= state;
+		State<CharT> state_copy= state;
 		if(MatchNode(alternative, state_copy))
 		{
 			state= state_copy;
@@ -107,9 +213,10 @@ bool MatchNodeImpl(const GraphElements::Alternatives& node, State& state)
 	return false;
 }
 
-bool MatchNodeImpl(const GraphElements::AlternativesPossessive& node, State& state)
+template<typename CharT>
+bool MatchNodeImpl(const GraphElements::AlternativesPossessive& node, State<CharT>& state)
 {
-	State state_copy= state;
+	State<CharT> state_copy= state;
 	if(MatchNode(node.path0_element, state))
 		return MatchNode(node.path0_next, state);
 
@@ -117,7 +224,25 @@ bool MatchNodeImpl(const GraphElements::AlternativesPossessive& node, State& sta
 	return MatchNode(node.path1_next, state);
 }
 
-bool MatchNodeImpl(const GraphElements::GroupStart& node, State& state)
+template<typename CharT>
+bool MatchNodeImpl(const GraphElements::AlternativesTrie& node, State<CharT>& state)
+{
+	// Just check strings one by one - this is the simplest way to preserve alternatives order.
+	for(const auto& alternative : node.alternatives)
+	{
+		State<CharT> state_copy= state;
+		if(ExtractString(alternative.str, state_copy) && MatchNode(alternative.next, state_copy))
+		{
+			state= state_copy;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+template<typename CharT>
+bool MatchNodeImpl(const GraphElements::GroupStart& node, State<CharT>& state)
 {
 	if(node.index >= 1 && node.index <= 9)
 		state.groups[node.index]= state.str.substr(0, 0);
@@ -125,23 +250,25 @@ bool MatchNodeImpl(const GraphElements::GroupStart& node, State& state)
 	return MatchNode(node.next, state);
 }
 
-bool MatchNodeImpl(const GraphElements::GroupEnd& node, State& state)
+template<typename CharT>
+bool MatchNodeImpl(const GraphElements::GroupEnd& node, State<CharT>& state)
 {
 	if(node.index >= 1 && node.index <= 9)
 	{
-		const char* const ptr= state.groups[node.index].data();
+		const CharT* const ptr= state.groups[node.index].data();
 		const auto size= size_t(state.str.data() - ptr);
-		state.groups[node.index]= std::string_view(ptr, size);
+		state.groups[node.index]= typename State<CharT>::StringView(ptr, size);
 	}
 
 	return MatchNode(node.next, state);
 }
 
-bool MatchNodeImpl(const GraphElements::BackReference& node, State& state)
+template<typename CharT>
+bool MatchNodeImpl(const GraphElements::BackReference& node, State<CharT>& state)
 {
 	if(node.index >= 1 && node.index <= 9)
 	{
-		const std::string_view prev_value= state.groups[node.index];
+		const auto prev_value= state.groups[node.index];
 		if(state.str.size() >= prev_value.size() && state.str.substr(0, prev_value.size()) == prev_value)
 		{
 			state.str.remove_prefix(prev_value.size());
@@ -152,54 +279,61 @@ bool MatchNodeImpl(const GraphElements::BackReference& node, State& state)
 	return false;
 }
 
-bool MatchNodeImpl(const GraphElements::StringStartAssertion& node, State& state)
+template<typename CharT>
+bool MatchNodeImpl(const GraphElements::StringStartAssertion& node, State<CharT>& state)
 {
 	return
 		state.str.data() == state.str_initial.data() &&
 		MatchNode(node.next, state);
 }
 
-bool MatchNodeImpl(const GraphElements::StringEndAssertion& node, State& state)
+template<typename CharT>
+bool MatchNodeImpl(const GraphElements::StringEndAssertion& node, State<CharT>& state)
 {
 	return
 		state.str.data() == (state.str_initial.data() + state.str_initial.size()) &&
 		MatchNode(node.next, state);
 }
 
-bool MatchNodeImpl(const GraphElements::LookAhead& node, State& state)
+template<typename CharT>
+bool MatchNodeImpl(const GraphElements::LookAhead& node, State<CharT>& state)
 {
-	State state_copy= state;
+	State<CharT> state_copy= state;
 	return (!node.positive ^ MatchNode(node.look_graph, state_copy)) && MatchNode(node.next, state);
 }
 
-bool MatchNodeImpl(const GraphElements::LookBehind& node, State& state)
+template<typename CharT>
+bool MatchNodeImpl(const GraphElements::LookBehind& node, State<CharT>& state)
 {
 	const auto current_pos= size_t(state.str.data() - state.str_initial.data());
 	if(current_pos < node.size)
 		return (!node.positive) && MatchNode(node.next, state);
 
-	State state_copy= state;
+	State<CharT> state_copy= state;
 	state_copy.str= state_copy.str_initial.substr(current_pos - node.size);
 
 	return (!node.positive ^ MatchNode(node.look_graph, state_copy)) && MatchNode(node.next, state);
 }
 
-bool MatchNodeImpl(const GraphElements::ConditionalElement& node, State& state)
+template<typename CharT>
+bool MatchNodeImpl(const GraphElements::ConditionalElement& node, State<CharT>& state)
 {
-	State state_copy= state;
+	State<CharT> state_copy= state;
 	if(MatchNode(node.condition_node, state_copy))
 		return MatchNode(node.next_true, state);
 	else
 		return MatchNode(node.next_false, state);
 }
 
-bool MatchNodeImpl(const GraphElements::SequenceCounterReset& node, State& state)
+template<typename CharT>
+bool MatchNodeImpl(const GraphElements::SequenceCounterReset& node, State<CharT>& state)
 {
 	state.sequence_counters[node.id]= 0;
 	return MatchNode(node.next, state);
 }
 
-bool MatchNodeImpl(const GraphElements::SequenceCounter& node, State& state)
+template<typename CharT>
+bool MatchNodeImpl(const GraphElements::SequenceCounter& node, State<CharT>& state)
 {
 	const size_t sequence_counter= state.sequence_counters[node.id];
 	++state.sequence_counters[node.id];
@@ -210,7 +344,7 @@ bool MatchNodeImpl(const GraphElements::SequenceCounter& node, State& state)
 		return MatchNode(node.next_sequence_end, state);
 	else
 	{
-		State state_copy= state;
+		State<CharT> state_copy= state;
 		if(node.greedy)
 		{
 			if(MatchNode(node.next_iteration, state_copy))
@@ -234,11 +368,12 @@ bool MatchNodeImpl(const GraphElements::SequenceCounter& node, State& state)
 	}
 }
 
-bool MatchNodeImpl(const GraphElements::PossessiveSequence& node, State& state)
+template<typename CharT>
+bool MatchNodeImpl(const GraphElements::PossessiveSequence& node, State<CharT>& state)
 {
 	for(size_t i= 0; i < node.max_elements; ++i)
 	{
-		State state_copy= state;
+		State<CharT> state_copy= state;
 		if(!MatchNode(node.sequence_element, state_copy))
 		{
 			if(i < node.min_elements)
@@ -251,20 +386,22 @@ bool MatchNodeImpl(const GraphElements::PossessiveSequence& node, State& state)
 	return MatchNode(node.next, state);
 }
 
-bool MatchNodeImpl(const GraphElements::SingleRollbackPointSequence& node, State& state)
+template<typename CharT>
+bool MatchNodeImpl(const GraphElements::SingleRollbackPointSequence& node, State<CharT>& state)
 {
-	std::optional<State> next_state;
+	std::optional<State<CharT>> next_state;
 
-	while(true)
+	for(size_t count= 0; ; ++count)
 	{
+		if(count >= node.min_elements)
 		{
-			State state_copy= state;
+			State<CharT> state_copy= state;
 			if(MatchNode(node.next, state))
 				next_state= state;
 			state= std::move(state_copy);
 		}
 
-		if(!MatchNode(node.sequence_element, state))
+		if(count == node.max_elements || !MatchNode(node.sequence_element, state))
 			break;
 	}
 
@@ -277,9 +414,10 @@ bool MatchNodeImpl(const GraphElements::SingleRollbackPointSequence& node, State
 	return false;
 }
 
-bool MatchNodeImpl(const GraphElements::FixedLengthElementSequence& node, State& state)
+template<typename CharT>
+bool MatchNodeImpl(const GraphElements::FixedLengthElementSequence& node, State<CharT>& state)
 {
-	const std::string_view str_initial= state.str;
+	const auto str_initial= state.str;
 	size_t count= 0;
 
 	// First, scan string until first fail or until maximum element count is reached.
@@ -298,7 +436,7 @@ bool MatchNodeImpl(const GraphElements::FixedLengthElementSequence& node, State&
 	// Than perform back steps until first match of expression tail is reached.
 	while(true)
 	{
-		State state_copy= state;
+		State<CharT> state_copy= state;
 		state_copy.str= str_initial;
 		state_copy.str.remove_prefix(count * node.element_length);
 		if(MatchNode(node.next, state_copy))
@@ -313,7 +451,8 @@ bool MatchNodeImpl(const GraphElements::FixedLengthElementSequence& node, State&
 	}
 }
 
-bool MatchNodeImpl(const GraphElements::AtomicGroup& node, State& state)
+template<typename CharT>
+bool MatchNodeImpl(const GraphElements::AtomicGroup& node, State<CharT>& state)
 {
 	if(MatchNode(node.group_element, state))
 		return MatchNode(node.next, state);
@@ -321,13 +460,15 @@ bool MatchNodeImpl(const GraphElements::AtomicGroup& node, State& state)
 	return false;
 }
 
-bool MatchNodeImpl(const GraphElements::SubroutineEnter& node, State& state)
+template<typename CharT>
+bool MatchNodeImpl(const GraphElements::SubroutineEnter& node, State<CharT>& state)
 {
 	state.subroutines_return_stack.push_back(node.next);
 	return MatchNode(node.subroutine_node, state);
 }
 
-bool MatchNodeImpl(const GraphElements::SubroutineLeave&, State& state)
+template<typename CharT>
+bool MatchNodeImpl(const GraphElements::SubroutineLeave&, State<CharT>& state)
 {
 	if(state.subroutines_return_stack.empty())
 		return MatchNode(nullptr, state);
@@ -337,9 +478,10 @@ bool MatchNodeImpl(const GraphElements::SubroutineLeave&, State& state)
 	return MatchNode(next_node, state);
 }
 
-bool MatchNodeImpl(const GraphElements::StateSave& node, State& state)
+template<typename CharT>
+bool MatchNodeImpl(const GraphElements::StateSave& node, State<CharT>& state)
 {
-	State::SubroutineEnterSaveState state_to_save;
+	typename State<CharT>::SubroutineEnterSaveState state_to_save;
 
 	state_to_save.sequence_counters.reserve(node.sequence_counters_to_save.size());
 	for(const GraphElements::SequenceId sequence_id : node.sequence_counters_to_save)
@@ -352,7 +494,7 @@ bool MatchNodeImpl(const GraphElements::StateSave& node, State& state)
 	for(const size_t group_id : node.groups_to_save)
 	{
 		state_to_save.groups.emplace_back(group_id, state.groups[group_id]);
-		state.groups[group_id] = std::string_view(); // TODO - do we need to reset it here?
+		state.groups[group_id] = typename State<CharT>::StringView(); // TODO - do we need to reset it here?
 	}
 
 	state_to_save.prev= state.saved_state;
@@ -361,7 +503,8 @@ bool MatchNodeImpl(const GraphElements::StateSave& node, State& state)
 	return MatchNode(node.next, state);
 }
 
-bool MatchNodeImpl(const GraphElements::StateRestore& node, State& state)
+template<typename CharT>
+bool MatchNodeImpl(const GraphElements::StateRestore& node, State<CharT>& state)
 {
 	assert(state.saved_state != nullptr);
 
@@ -376,7 +519,8 @@ bool MatchNodeImpl(const GraphElements::StateRestore& node, State& state)
 	return MatchNode(node.next, state);
 }
 
-bool MatchNode(const GraphElements::NodePtr node, State& state)
+template<typename CharT>
+bool MatchNode(const GraphElements::NodePtr node, State<CharT>& state)
 {
 	if(node == nullptr)
 		return true;
@@ -384,19 +528,18 @@ bool MatchNode(const GraphElements::NodePtr node, State& state)
 	return std::visit([&](const auto& el){ return MatchNodeImpl(el, state); }, *node);
 }
 
-} // namespace
-
-size_t Match(
+template<typename CharT>
+size_t MatchImpl(
 	const RegexGraphBuildResult& regex_graph,
-	const std::string_view str,
+	const std::basic_string_view<CharT> str,
 	const size_t start_pos,
-	std::string_view* const out_groups, /* 0 - whole pattern, 1 - first subpattern, etc.*/
-	const size_t out_groups_count /* size of ouptut array of groups */
-	)
+	std::basic_string_view<CharT>* const out_groups,
+	const size_t out_groups_count)
 {
 	for(size_t i= start_pos; i < str.size(); ++i)
 	{
-		State state;
+		State<CharT> state;
+		state.encoding= regex_graph.options.encoding;
 		state.str= str.substr(i);
 		state.str_initial = str;
 		if(MatchNode(regex_graph.root, state))
@@ -419,4 +562,44 @@ size_t Match(
 	return 0u;
 }
 
+} // namespace
+
+size_t Match(
+	const RegexGraphBuildResult& regex_graph,
+	const std::string_view str,
+	const size_t start_pos,
+	std::string_view* const out_groups,
+	const size_t out_groups_count)
+{
+	assert(regex_graph.options.encoding == Encoding::UTF8 || regex_graph.options.encoding == Encoding::Bytes);
+
+	// Find nothing in invalid input, like generated code does. Input is validated only if search starts from string beginning.
+	if(regex_graph.options.encoding == Encoding::UTF8 && regex_graph.options.utf8_validation == Utf8Validation::OnceAtEntry && start_pos == 0 && !IsValidUtf8(str))
+		return 0;
+
+	return MatchImpl(regex_graph, str, start_pos, out_groups, out_groups_count);
+}
+
+size_t Match(
+	const RegexGraphBuildResult& regex_graph,
+	const std::u16string_view str,
+	const size_t start_pos,
+	std::u16string_view* const out_groups,
+	const size_t out_groups_count)
+{
+	assert(regex_graph.options.encoding == Encoding::UTF16);
+	return MatchImpl(regex_graph, str, start_pos, out_groups, out_groups_count);
+}
+
+size_t Match(
+	const RegexGraphBuildResult& regex_graph,
+	const std::u32string_view str,
+	const size_t start_pos,
+	std::u32string_view* const out_groups,
+	const size_t out_groups_count)
+{
+	assert(regex_graph.options.encoding == Encoding::UTF32);
+	return MatchImpl(regex_graph, str, start_pos, out_groups, out_groups_count);
+}
+
 } // namespace RegPanzer
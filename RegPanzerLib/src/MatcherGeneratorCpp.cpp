@@ -0,0 +1,1365 @@
+#include "../CaseFolding.hpp"
+#include "../MatcherGeneratorCpp.hpp"
+#include "../Utils.hpp"
+#include <algorithm>
+#include <cassert>
+#include <sstream>
+#include <unordered_map>
+
+namespace RegPanzer
+{
+
+namespace
+{
+
+using CharType= GraphElements::CharType;
+
+const char* GetNodeName(const GraphElements::AnySymbol&) { return "any_symbol"; }
+const char* GetNodeName(const GraphElements::SpecificSymbol&) { return "specific_symbol"; }
+const char* GetNodeName(const GraphElements::String&) { return "string"; }
+const char* GetNodeName(const GraphElements::OneOf&) { return "one_of"; }
+const char* GetNodeName(const GraphElements::Alternatives&) { return "alternatives"; }
+const char* GetNodeName(const GraphElements::AlternativesPossessive&) { return "alternatives_possessive"; }
+const char* GetNodeName(const GraphElements::AlternativesTrie&) { return "alternatives_trie"; }
+const char* GetNodeName(const GraphElements::GroupStart&) { return "group_start"; }
+const char* GetNodeName(const GraphElements::GroupEnd&) { return "group_end"; }
+const char* GetNodeName(const GraphElements::BackReference&) { return "back_reference"; }
+const char* GetNodeName(const GraphElements::LookAhead&) { return "look_ahead"; }
+const char* GetNodeName(const GraphElements::LookBehind&) { return "look_behind"; }
+const char* GetNodeName(const GraphElements::StringStartAssertion&) { return "string_start_assertion"; }
+const char* GetNodeName(const GraphElements::StringEndAssertion&) { return "string_end_assertion"; }
+const char* GetNodeName(const GraphElements::ConditionalElement&) { return "condtinonal_element"; }
+const char* GetNodeName(const GraphElements::SequenceCounterReset&) { return "sequence_counter_reset"; }
+const char* GetNodeName(const GraphElements::SequenceCounter&) { return "sequence_counter"; }
+const char* GetNodeName(const GraphElements::PossessiveSequence&) { return "possessive_sequence"; }
+const char* GetNodeName(const GraphElements::SingleRollbackPointSequence&) { return "single_rollback_point_sequence"; }
+const char* GetNodeName(const GraphElements::FixedLengthElementSequence&) { return "fixed_length_element_sequence"; }
+const char* GetNodeName(const GraphElements::AtomicGroup&) { return "atomic_group"; }
+const char* GetNodeName(const GraphElements::SubroutineEnter&) { return "subroutine_enter"; }
+const char* GetNodeName(const GraphElements::SubroutineLeave&) { return "subroutine_leave"; }
+const char* GetNodeName(const GraphElements::StateSave&) { return "state_save"; }
+const char* GetNodeName(const GraphElements::StateRestore&) { return "state_restore"; }
+
+std::string HexConstant(const uint32_t value)
+{
+	std::ostringstream stream;
+	stream << "0x" << std::hex << std::uppercase << value << "u";
+	return stream.str();
+}
+
+std::string UnitRef(const size_t index)
+{
+	return "CodeUnit(s[" + std::to_string(index) + "])";
+}
+
+// Returns sorted non-overlapping ranges of code points, matched by given node (ignoring inverse flag).
+std::vector<std::pair<CharType, CharType>> GetMergedRanges(const GraphElements::OneOf& node, const Encoding encoding)
+{
+	std::vector<std::pair<CharType, CharType>> ranges= node.ranges;
+	for(const CharType c : node.variants)
+		ranges.emplace_back(c, c);
+
+	std::sort(ranges.begin(), ranges.end());
+
+	std::vector<std::pair<CharType, CharType>> result;
+	for(const auto& range : ranges)
+	{
+		if(!result.empty() && range.first <= result.back().second + 1)
+			result.back().second= std::max(result.back().second, range.second);
+		else
+			result.push_back(range);
+	}
+
+	if(encoding == Encoding::Bytes)
+	{
+		// Symbols above 0xFF are not possible.
+		while(!result.empty() && result.back().first > 0xFF)
+			result.pop_back();
+		if(!result.empty())
+			result.back().second= std::min(result.back().second, CharType(0xFF));
+	}
+
+	return result;
+}
+
+class CppGenerator
+{
+public:
+	explicit CppGenerator(const RegexGraphBuildResult& regex_graph, const std::string& function_name);
+
+	std::string GenerateMatcherFunction();
+	std::string GenerateMatchesCounterFunction();
+
+private:
+	std::string GetCharTypeName() const;
+	std::string GetCodeUnitTypeName() const;
+	// Returns expression, checking if given code unit is not first code unit of code point, or empty string if code unit is always code point.
+	std::string GetContinuationCodeUnitCheck(const std::string& code_unit) const;
+	bool NeedsInputValidation() const;
+
+	void GenerateNodeFunctions();
+	std::string BuildResult(const std::string& exported_function);
+
+	void GenerateStateType(std::ostream& out) const;
+	void GenerateCodePointExtractionFunction(std::ostream& out) const;
+	void GenerateValidUtf8DecodingFunction(std::ostream& out) const;
+	void GenerateValidCodePointExtractionFunction(std::ostream& out) const;
+	void GenerateUtf8ValidationFunction(std::ostream& out) const;
+	void GenerateInitStateFunction(std::ostream& out) const;
+	void GenerateSearchLoopStart(std::ostream& out, bool has_start_offset) const;
+
+	std::string GetNodeFunctionName(GraphElements::NodePtr node);
+	// Returns expression for call of next node function.
+	std::string GetNextCall(GraphElements::NodePtr node);
+
+	void GenerateNodeFunctionBodyImpl(const GraphElements::AnySymbol& node);
+	void GenerateNodeFunctionBodyImpl(const GraphElements::SpecificSymbol& node);
+	void GenerateNodeFunctionBodyImpl(const GraphElements::String& node);
+	void GenerateNodeFunctionBodyImpl(const GraphElements::OneOf& node);
+	void GenerateNodeFunctionBodyImpl(const GraphElements::Alternatives& node);
+	void GenerateNodeFunctionBodyImpl(const GraphElements::AlternativesPossessive& node);
+	void GenerateNodeFunctionBodyImpl(const GraphElements::AlternativesTrie& node);
+	void GenerateNodeFunctionBodyImpl(const GraphElements::GroupStart& node);
+	void GenerateNodeFunctionBodyImpl(const GraphElements::GroupEnd& node);
+	void GenerateNodeFunctionBodyImpl(const GraphElements::BackReference& node);
+	void GenerateNodeFunctionBodyImpl(const GraphElements::LookAhead& node);
+	void GenerateNodeFunctionBodyImpl(const GraphElements::LookBehind& node);
+	void GenerateNodeFunctionBodyImpl(const GraphElements::StringStartAssertion& node);
+	void GenerateNodeFunctionBodyImpl(const GraphElements::StringEndAssertion& node);
+	void GenerateNodeFunctionBodyImpl(const GraphElements::ConditionalElement& node);
+	void GenerateNodeFunctionBodyImpl(const GraphElements::SequenceCounterReset& node);
+	void GenerateNodeFunctionBodyImpl(const GraphElements::SequenceCounter& node);
+	void GenerateNodeFunctionBodyImpl(const GraphElements::PossessiveSequence& node);
+	void GenerateNodeFunctionBodyImpl(const GraphElements::SingleRollbackPointSequence& node);
+	void GenerateNodeFunctionBodyImpl(const GraphElements::FixedLengthElementSequence& node);
+	void GenerateNodeFunctionBodyImpl(const GraphElements::AtomicGroup& node);
+	void GenerateNodeFunctionBodyImpl(const GraphElements::SubroutineEnter& node);
+	void GenerateNodeFunctionBodyImpl(const GraphElements::SubroutineLeave& node);
+	void GenerateNodeFunctionBodyImpl(const GraphElements::StateSave& node);
+	void GenerateNodeFunctionBodyImpl(const GraphElements::StateRestore& node);
+
+	void GenerateAlternativesTrieNode(
+		const GraphElements::AlternativesTrie& node,
+		const CodeUnitsTrie& trie,
+		size_t trie_node_index,
+		const std::vector< std::vector<uint32_t> >& strings,
+		const std::string& indent);
+
+	std::string GetCaseInsensitiveCodePointCondition(CharType c, size_t offset) const;
+	std::vector<uint32_t> EncodeString(const std::string& str_utf8) const;
+
+	std::vector<size_t> GetSequenceCounterIndices(const GraphElements::SequenceIdSet& sequence_ids) const;
+	std::vector<size_t> GetGroupIndices(const std::unordered_set<size_t>& group_numbers) const;
+
+private:
+	const RegexGraphBuildResult& regex_graph_;
+	const std::string function_name_;
+	const Encoding encoding_;
+	const Utf8Validation utf8_validation_;
+	const bool has_subroutine_calls_;
+
+	std::unordered_map<GraphElements::NodePtr, size_t> node_indices_;
+	// Generate functions only for nodes actually called, since unused static functions are not allowed in strict compilation modes.
+	std::vector<GraphElements::NodePtr> used_nodes_;
+	std::unordered_set<GraphElements::NodePtr> used_nodes_set_;
+	std::unordered_map<GraphElements::SequenceId, size_t> sequence_id_to_counter_index_;
+	std::unordered_map<size_t, size_t> group_number_to_index_;
+
+	std::ostringstream functions_out_;
+	bool end_function_used_= false;
+	bool ranges_check_function_used_= false;
+	bool valid_code_point_extraction_function_used_= false;
+};
+
+CppGenerator::CppGenerator(const RegexGraphBuildResult& regex_graph, const std::string& function_name)
+	: regex_graph_(regex_graph)
+	, function_name_(function_name)
+	, encoding_(regex_graph.options.encoding)
+	, utf8_validation_(regex_graph.options.utf8_validation)
+	, has_subroutine_calls_(!regex_graph.group_stats.at(0).internal_calls.empty())
+{
+	// Number nodes and sequence counters in graph traversal order in order to produce same code for same regex.
+	EnumerateAllNodesOnce(
+		[&](const GraphElements::NodePtr node)
+		{
+			node_indices_.emplace(node, node_indices_.size());
+
+			GraphElements::SequenceId sequence_id= nullptr;
+			if(const auto sequence_counter_reset= std::get_if<GraphElements::SequenceCounterReset>(node))
+				sequence_id= sequence_counter_reset->id;
+			else if(const auto sequence_counter= std::get_if<GraphElements::SequenceCounter>(node))
+				sequence_id= sequence_counter->id;
+
+			if(sequence_id != nullptr && sequence_id_to_counter_index_.count(sequence_id) == 0)
+				sequence_id_to_counter_index_.emplace(sequence_id, sequence_id_to_counter_index_.size());
+		},
+		regex_graph.root);
+
+	for(const auto& group_pair : regex_graph.group_stats)
+		if(regex_graph.options.extract_groups || group_pair.second.backreference_count > 0)
+			group_number_to_index_.emplace(group_pair.first, group_number_to_index_.size());
+}
+
+std::string CppGenerator::GenerateMatcherFunction()
+{
+	const std::string char_type_name= GetCharTypeName();
+
+	// Root function look like this:
+	// size_t Match(const char* str, size_t str_size, size_t start_offset, size_t* out_subpatterns, size_t number_of_subpatterns);
+	// It returns number of matched subpatterns (including whole expression) or 0.
+	std::ostringstream out;
+	out << "extern \"C\" size_t " << function_name_ << "(const " << char_type_name << "* const str, const size_t str_size, const size_t start_offset, size_t* const out_subpatterns, const size_t number_of_subpatterns)\n";
+	out << "{\n";
+	out << "\tusing namespace " << function_name_ << "_impl;\n\n";
+	GenerateSearchLoopStart(out, true);
+	out << "\tsize_t current_start_offset= start_offset;\n";
+	out << "\twhile(true)\n";
+	out << "\t{\n";
+	out << "\t\tInitState(state, str + current_start_offset);\n";
+	out << "\t\tif(" << GetNextCall(regex_graph_.root) << ")\n";
+	out << "\t\t\tbreak;\n\n";
+	if(std::get_if<GraphElements::StringStartAssertion>(regex_graph_.root) != nullptr)
+		out << "\t\treturn 0; // Finish loop after single iteration in case if first regex element is string start assertion.\n";
+	else
+	{
+		out << "\t\t++current_start_offset;\n";
+		out << "\t\tif(current_start_offset >= str_size)\n";
+		out << "\t\t\treturn 0;\n";
+	}
+	out << "\t}\n\n";
+
+	out << "\tif(out_subpatterns != nullptr)\n";
+	out << "\t{\n";
+	for(const auto& group_pair : regex_graph_.group_stats)
+	{
+		const size_t group_number= group_pair.first;
+
+		std::string group_offset_begin, group_offset_end;
+		if(group_number == 0)
+		{
+			group_offset_begin= "current_start_offset";
+			group_offset_end= "size_t(state.str_begin - str)";
+		}
+		else if(const auto index_it= group_number_to_index_.find(group_number); index_it != group_number_to_index_.end())
+		{
+			const std::string group= "state.groups[" + std::to_string(index_it->second) + "]";
+			group_offset_begin= "size_t(" + group + ".begin - str)";
+			group_offset_end= "size_t(" + group + ".end - str)";
+		}
+		else
+		{
+			group_offset_begin= "str_size";
+			group_offset_end= "str_size";
+		}
+
+		out << "\t\tif(number_of_subpatterns <= " << group_number << ")\n";
+		out << "\t\t\treturn " << regex_graph_.group_stats.size() << ";\n";
+		out << "\t\tout_subpatterns[" << group_number * 2 + 0 << "]= " << group_offset_begin << ";\n";
+		out << "\t\tout_subpatterns[" << group_number * 2 + 1 << "]= " << group_offset_end << ";\n";
+	}
+	out << "\t}\n\n";
+	out << "\treturn " << regex_graph_.group_stats.size() << ";\n";
+	out << "}\n";
+
+	return BuildResult(out.str());
+}
+
+std::string CppGenerator::GenerateMatchesCounterFunction()
+{
+	// Counter function look like this:
+	// size_t CountMatches(const char* str, size_t str_size);
+	// It returns number of non-overlapping matches. Search is continued from the end of previous match, or from next code point after empty match.
+	std::ostringstream out;
+	out << "extern \"C\" size_t " << function_name_ << "(const " << GetCharTypeName() << "* const str, const size_t str_size)\n";
+	out << "{\n";
+	out << "\tusing namespace " << function_name_ << "_impl;\n\n";
+	GenerateSearchLoopStart(out, false);
+	if(std::get_if<GraphElements::StringStartAssertion>(regex_graph_.root) != nullptr)
+	{
+		// Only one match is possible in case if first regex element is string start assertion.
+		out << "\tInitState(state, str);\n";
+		out << "\treturn " << GetNextCall(regex_graph_.root) << " ? 1 : 0;\n";
+		out << "}\n";
+		return BuildResult(out.str());
+	}
+
+	out << "\tsize_t count= 0;\n";
+	out << "\tsize_t current_start_offset= 0;\n";
+	out << "\twhile(true)\n";
+	out << "\t{\n";
+	out << "\t\tInitState(state, str + current_start_offset);\n";
+	out << "\t\tsize_t next_start_offset= current_start_offset + 1;\n";
+	out << "\t\tif(" << GetNextCall(regex_graph_.root) << ")\n";
+	out << "\t\t{\n";
+	out << "\t\t\t++count;\n";
+	out << "\t\t\t// Continue from match end, but avoid looping on empty match.\n";
+	out << "\t\t\tconst size_t match_end_offset= size_t(state.str_begin - str);\n";
+	out << "\t\t\tif(match_end_offset != current_start_offset)\n";
+	out << "\t\t\t\tnext_start_offset= match_end_offset;\n";
+	if(const auto continuation_check= GetContinuationCodeUnitCheck("str[next_start_offset]"); !continuation_check.empty())
+	{
+		out << "\t\t\telse\n";
+		out << "\t\t\t{\n";
+		out << "\t\t\t\t// Continue from next code point, not from the middle of current code point.\n";
+		out << "\t\t\t\twhile(next_start_offset < str_size && " << continuation_check << ")\n";
+		out << "\t\t\t\t\t++next_start_offset;\n";
+		out << "\t\t\t}\n";
+	}
+	out << "\t\t}\n\n";
+	out << "\t\t// Check also position at string end, because empty match is possible here.\n";
+	out << "\t\tif(next_start_offset > str_size)\n";
+	out << "\t\t\tbreak;\n";
+	out << "\t\tcurrent_start_offset= next_start_offset;\n";
+	out << "\t}\n\n";
+	out << "\treturn count;\n";
+	out << "}\n";
+
+	return BuildResult(out.str());
+}
+
+std::string CppGenerator::GetCharTypeName() const
+{
+	switch(encoding_)
+	{
+	case Encoding::UTF8:
+	case Encoding::Bytes:
+		return "char";
+	case Encoding::UTF16:
+		return "char16_t";
+	case Encoding::UTF32:
+		return "char32_t";
+	};
+
+	assert(false);
+	return "char";
+}
+
+std::string CppGenerator::GetCodeUnitTypeName() const
+{
+	// Use unsigned type for code units comparison.
+	if(encoding_ == Encoding::UTF8 || encoding_ == Encoding::Bytes)
+		return "unsigned char";
+	return GetCharTypeName();
+}
+
+std::string CppGenerator::GetContinuationCodeUnitCheck(const std::string& code_unit) const
+{
+	switch(encoding_)
+	{
+	case Encoding::UTF8:
+		return "(CodeUnit(" + code_unit + ") & 0xC0u) == 0x80u";
+	case Encoding::UTF16:
+		return "(CodeUnit(" + code_unit + ") & 0xFC00u) == 0xDC00u";
+	case Encoding::UTF32:
+	case Encoding::Bytes:
+		break;
+	};
+
+	// Code unit is code point.
+	return "";
+}
+
+bool CppGenerator::NeedsInputValidation() const
+{
+	return encoding_ == Encoding::UTF8 && utf8_validation_ == Utf8Validation::OnceAtEntry;
+}
+
+void CppGenerator::GenerateNodeFunctions()
+{
+	// List of used nodes may grow during generation.
+	for(size_t i= 0; i < used_nodes_.size(); ++i)
+	{
+		const GraphElements::NodePtr node= used_nodes_[i];
+		functions_out_ << "bool " << GetNodeFunctionName(node) << "(State& state)\n";
+		functions_out_ << "{\n";
+		std::visit([&](const auto& el){ GenerateNodeFunctionBodyImpl(el); }, *node);
+		functions_out_ << "}\n\n";
+	}
+}
+
+std::string CppGenerator::BuildResult(const std::string& exported_function)
+{
+	GenerateNodeFunctions();
+
+	std::ostringstream out;
+
+	out << "// Generated by RegPanzer. Do not edit.\n";
+	out << "#include <stddef.h>\n";
+	out << "#include <stdint.h>\n\n";
+
+	// Use private namespace for all internal stuff to avoid possible name conflicts.
+	out << "namespace " << function_name_ << "_impl\n";
+	out << "{\n\n";
+	out << "namespace\n";
+	out << "{\n\n";
+
+	out << "typedef " << GetCharTypeName() << " CharType;\n";
+	out << "typedef " << GetCodeUnitTypeName() << " CodeUnit;\n\n";
+
+	GenerateStateType(out);
+	GenerateCodePointExtractionFunction(out);
+	if(NeedsInputValidation() || valid_code_point_extraction_function_used_)
+		GenerateValidUtf8DecodingFunction(out);
+	if(valid_code_point_extraction_function_used_)
+		GenerateValidCodePointExtractionFunction(out);
+	if(NeedsInputValidation())
+		GenerateUtf8ValidationFunction(out);
+	GenerateInitStateFunction(out);
+
+	if(ranges_check_function_used_)
+	{
+		out << "// Binary search in sorted ranges list.\n";
+		out << "bool CodePointInRanges(const uint32_t code, const uint32_t (* const ranges)[2], const size_t range_count)\n";
+		out << "{\n";
+		out << "\tsize_t begin= 0, end= range_count;\n";
+		out << "\twhile(begin < end)\n";
+		out << "\t{\n";
+		out << "\t\tconst size_t middle= (begin + end) / 2;\n";
+		out << "\t\tif(code < ranges[middle][0])\n";
+		out << "\t\t\tend= middle;\n";
+		out << "\t\telse if(code > ranges[middle][1])\n";
+		out << "\t\t\tbegin= middle + 1;\n";
+		out << "\t\telse\n";
+		out << "\t\t\treturn true;\n";
+		out << "\t}\n";
+		out << "\treturn false;\n";
+		out << "}\n\n";
+	}
+
+	if(end_function_used_)
+		out << "bool match_end(State&)\n{\n\treturn true;\n}\n\n";
+
+	for(const GraphElements::NodePtr node : used_nodes_)
+		out << "bool " << GetNodeFunctionName(node) << "(State& state);\n";
+	out << "\n";
+
+	out << functions_out_.str();
+
+	out << "} // namespace\n\n";
+	out << "} // namespace " << function_name_ << "_impl\n\n";
+
+	out << exported_function;
+
+	return out.str();
+}
+
+void CppGenerator::GenerateStateType(std::ostream& out) const
+{
+	out << "struct Group\n";
+	out << "{\n";
+	out << "\tconst CharType* begin;\n";
+	out << "\tconst CharType* end;\n";
+	out << "};\n\n";
+
+	if(has_subroutine_calls_)
+	{
+		out << "struct SubroutineCallReturnChainNode;\n";
+		out << "struct SubroutineCallStateSaveChainNode;\n\n";
+	}
+
+	// Zero-sized arrays are not allowed, so, skip empty arrays.
+	const auto write_arrays=
+	[&]
+	{
+		if(!sequence_id_to_counter_index_.empty())
+			out << "\tsize_t sequence_counters[" << sequence_id_to_counter_index_.size() << "];\n";
+		if(!group_number_to_index_.empty())
+			out << "\tGroup groups[" << group_number_to_index_.size() << "];\n";
+	};
+
+	out << "struct State\n";
+	out << "{\n";
+	out << "\tconst CharType* str_begin;\n";
+	out << "\tconst CharType* str_end;\n";
+	out << "\tconst CharType* str_begin_initial;\n";
+	write_arrays();
+	if(has_subroutine_calls_)
+	{
+		out << "\tconst SubroutineCallReturnChainNode* subroutine_call_return_chain_head;\n";
+		out << "\tconst SubroutineCallStateSaveChainNode* subroutine_call_state_save_chain_head;\n";
+	}
+	out << "};\n\n";
+
+	if(has_subroutine_calls_)
+	{
+		out << "typedef bool (*NodeFunction)(State& state);\n\n";
+
+		out << "struct SubroutineCallReturnChainNode\n";
+		out << "{\n";
+		out << "\tNodeFunction next_function;\n";
+		out << "\tconst SubroutineCallReturnChainNode* prev;\n";
+		out << "};\n\n";
+
+		out << "struct SubroutineCallStateSaveChainNode\n";
+		out << "{\n";
+		write_arrays();
+		out << "\tconst SubroutineCallStateSaveChainNode* prev;\n";
+		out << "};\n\n";
+	}
+}
+
+void CppGenerator::GenerateCodePointExtractionFunction(std::ostream& out) const
+{
+	out << "// Returns false if there is not enough data.\n";
+	out << "inline bool ExtractCodePoint(State& state, uint32_t& code)\n";
+	out << "{\n";
+	out << "\tconst CharType* const s= state.str_begin;\n";
+	out << "\tif(s == state.str_end)\n";
+	out << "\t\treturn false;\n\n";
+	out << "\tconst uint32_t c0= CodeUnit(s[0]);\n";
+
+	switch(encoding_)
+	{
+	case Encoding::UTF8:
+		if(utf8_validation_ == Utf8Validation::PerSymbol)
+		{
+			out << "\tconst size_t size= size_t(state.str_end - s);\n";
+			out << "\tif((c0 & 0x80u) == 0u)\n";
+			out << "\t{\n";
+			out << "\t\tcode= c0;\n";
+			out << "\t\tstate.str_begin= s + 1;\n";
+			out << "\t}\n";
+			out << "\telse if((c0 & 0xE0u) == 0xC0u)\n";
+			out << "\t{\n";
+			out << "\t\tif(size < 2)\n";
+			out << "\t\t\treturn false;\n";
+			out << "\t\tcode= ((c0 & 0x1Fu) << 6) | (CodeUnit(s[1]) & 0x3Fu);\n";
+			out << "\t\tstate.str_begin= s + 2;\n";
+			out << "\t}\n";
+			out << "\telse if((c0 & 0xF0u) == 0xE0u)\n";
+			out << "\t{\n";
+			out << "\t\tif(size < 3)\n";
+			out << "\t\t\treturn false;\n";
+			out << "\t\tcode= ((c0 & 0x0Fu) << 12) | ((CodeUnit(s[1]) & 0x3Fu) << 6) | (CodeUnit(s[2]) & 0x3Fu);\n";
+			out << "\t\tstate.str_begin= s + 3;\n";
+			out << "\t}\n";
+			out << "\telse if((c0 & 0xF8u) == 0xF0u)\n";
+			out << "\t{\n";
+			out << "\t\tif(size < 4)\n";
+			out << "\t\t\treturn false;\n";
+			out << "\t\tcode= ((c0 & 0x07u) << 18) | ((CodeUnit(s[1]) & 0x3Fu) << 12) | ((CodeUnit(s[2]) & 0x3Fu) << 6) | (CodeUnit(s[3]) & 0x3Fu);\n";
+			out << "\t\tstate.str_begin= s + 4;\n";
+			out << "\t}\n";
+			out << "\telse\n";
+			out << "\t{\n";
+			out << "\t\t// Invalid UTF-8 - match single byte.\n";
+			out << "\t\tcode= c0;\n";
+			out << "\t\tstate.str_begin= s + 1;\n";
+			out << "\t}\n";
+		}
+		else
+		{
+			// Input is valid UTF-8, so, continuation bytes are not checked.
+			// But string end is checked, since search with non-zero start offset relies on validation of previous search and input may be actually invalid.
+			out << "\tif(c0 < 0xC0u)\n";
+			out << "\t{\n";
+			out << "\t\t// ASCII symbol or continuation byte (if search is started inside sequence).\n";
+			out << "\t\tcode= c0;\n";
+			out << "\t\tstate.str_begin= s + 1;\n";
+			out << "\t}\n";
+			out << "\telse if(c0 < 0xE0u)\n";
+			out << "\t{\n";
+			out << "\t\tif(state.str_end - s < 2)\n";
+			out << "\t\t\treturn false;\n";
+			out << "\t\tcode= ((c0 & 0x1Fu) << 6) | (CodeUnit(s[1]) & 0x3Fu);\n";
+			out << "\t\tstate.str_begin= s + 2;\n";
+			out << "\t}\n";
+			out << "\telse if(c0 < 0xF0u)\n";
+			out << "\t{\n";
+			out << "\t\tif(state.str_end - s < 3)\n";
+			out << "\t\t\treturn false;\n";
+			out << "\t\tcode= ((c0 & 0x0Fu) << 12) | ((CodeUnit(s[1]) & 0x3Fu) << 6) | (CodeUnit(s[2]) & 0x3Fu);\n";
+			out << "\t\tstate.str_begin= s + 3;\n";
+			out << "\t}\n";
+			out << "\telse\n";
+			out << "\t{\n";
+			out << "\t\tif(state.str_end - s < 4)\n";
+			out << "\t\t\treturn false;\n";
+			out << "\t\tcode= ((c0 & 0x07u) << 18) | ((CodeUnit(s[1]) & 0x3Fu) << 12) | ((CodeUnit(s[2]) & 0x3Fu) << 6) | (CodeUnit(s[3]) & 0x3Fu);\n";
+			out << "\t\tstate.str_begin= s + 4;\n";
+			out << "\t}\n";
+		}
+		break;
+
+	case Encoding::UTF16:
+		out << "\tif((c0 & 0xFC00u) == 0xD800u)\n";
+		out << "\t{\n";
+		out << "\t\tif(state.str_end - s < 2)\n";
+		out << "\t\t\treturn false;\n";
+		out << "\t\tconst uint32_t c1= CodeUnit(s[1]);\n";
+		out << "\t\tif((c1 & 0xFC00u) == 0xDC00u)\n";
+		out << "\t\t{\n";
+		out << "\t\t\tcode= (((c0 & 0x3FFu) << 10) | (c1 & 0x3FFu)) + 0x10000u;\n";
+		out << "\t\t\tstate.str_begin= s + 2;\n";
+		out << "\t\t\treturn true;\n";
+		out << "\t\t}\n";
+		out << "\t}\n\n";
+		out << "\t// Single unit. Process also unpaired surrogates here.\n";
+		out << "\tcode= c0;\n";
+		out << "\tstate.str_begin= s + 1;\n";
+		break;
+
+	case Encoding::UTF32:
+	case Encoding::Bytes:
+		out << "\t// Code unit is code point.\n";
+		out << "\tcode= c0;\n";
+		out << "\tstate.str_begin= s + 1;\n";
+		break;
+	};
+
+	out << "\treturn true;\n";
+	out << "}\n\n";
+}
+
+void CppGenerator::GenerateValidUtf8DecodingFunction(std::ostream& out) const
+{
+	// Reject overlong sequences, surrogates and code points above 0x10FFFF.
+	out << "// Returns size of code point or 0 if there is not enough data or sequence is not valid UTF-8.\n";
+	out << "inline size_t DecodeValidUtf8(const CharType* const s, const CharType* const end, uint32_t& code)\n";
+	out << "{\n";
+	out << "\tif(s == end)\n";
+	out << "\t\treturn 0;\n\n";
+	out << "\tconst uint32_t c0= CodeUnit(s[0]);\n";
+	out << "\tif(c0 < 0x80u)\n";
+	out << "\t{\n";
+	out << "\t\tcode= c0;\n";
+	out << "\t\treturn 1;\n";
+	out << "\t}\n\n";
+	out << "\tsize_t size= 0;\n";
+	out << "\tuint32_t min_code= 0;\n";
+	out << "\tif((c0 & 0xE0u) == 0xC0u)\n";
+	out << "\t{\n";
+	out << "\t\tsize= 2;\n";
+	out << "\t\tcode= c0 & 0x1Fu;\n";
+	out << "\t\tmin_code= 0x80u;\n";
+	out << "\t}\n";
+	out << "\telse if((c0 & 0xF0u) == 0xE0u)\n";
+	out << "\t{\n";
+	out << "\t\tsize= 3;\n";
+	out << "\t\tcode= c0 & 0x0Fu;\n";
+	out << "\t\tmin_code= 0x800u;\n";
+	out << "\t}\n";
+	out << "\telse if((c0 & 0xF8u) == 0xF0u)\n";
+	out << "\t{\n";
+	out << "\t\tsize= 4;\n";
+	out << "\t\tcode= c0 & 0x07u;\n";
+	out << "\t\tmin_code= 0x10000u;\n";
+	out << "\t}\n";
+	out << "\telse\n";
+	out << "\t\treturn 0;\n\n";
+	out << "\tif(size_t(end - s) < size)\n";
+	out << "\t\treturn 0;\n\n";
+	out << "\tfor(size_t i= 1; i < size; ++i)\n";
+	out << "\t{\n";
+	out << "\t\tconst uint32_t c= CodeUnit(s[i]);\n";
+	out << "\t\tif((c & 0xC0u) != 0x80u)\n";
+	out << "\t\t\treturn 0;\n";
+	out << "\t\tcode= (code << 6) | (c & 0x3Fu);\n";
+	out << "\t}\n\n";
+	out << "\tif(code < min_code || code > 0x10FFFFu || (code >= 0xD800u && code <= 0xDFFFu))\n";
+	out << "\t\treturn 0;\n\n";
+	out << "\treturn size;\n";
+	out << "}\n\n";
+}
+
+void CppGenerator::GenerateValidCodePointExtractionFunction(std::ostream& out) const
+{
+	// Used for classes, which should not match invalid UTF-8 sequences and continuation bytes, like in LLVM backend.
+	out << "// Returns false if there is not enough data or sequence is not valid UTF-8.\n";
+	out << "inline bool ExtractValidCodePoint(State& state, uint32_t& code)\n";
+	out << "{\n";
+	out << "\tconst size_t size= DecodeValidUtf8(state.str_begin, state.str_end, code);\n";
+	out << "\tif(size == 0)\n";
+	out << "\t\treturn false;\n";
+	out << "\tstate.str_begin+= size;\n";
+	out << "\treturn true;\n";
+	out << "}\n\n";
+}
+
+void CppGenerator::GenerateUtf8ValidationFunction(std::ostream& out) const
+{
+	out << "bool IsValidUtf8(const CharType* s, const CharType* const end)\n";
+	out << "{\n";
+	out << "\twhile(s != end)\n";
+	out << "\t{\n";
+	out << "\t\tuint32_t code= 0;\n";
+	out << "\t\tconst size_t size= DecodeValidUtf8(s, end, code);\n";
+	out << "\t\tif(size == 0)\n";
+	out << "\t\t\treturn false;\n";
+	out << "\t\ts+= size;\n";
+	out << "\t}\n\n";
+	out << "\treturn true;\n";
+	out << "}\n\n";
+}
+
+void CppGenerator::GenerateInitStateFunction(std::ostream& out) const
+{
+	out << "void InitState(State& state, const CharType* const str_begin)\n";
+	out << "{\n";
+	out << "\tstate.str_begin= str_begin;\n";
+	if(!sequence_id_to_counter_index_.empty())
+	{
+		out << "\tfor(size_t i= 0; i < " << sequence_id_to_counter_index_.size() << "; ++i)\n";
+		out << "\t\tstate.sequence_counters[i]= 0;\n";
+	}
+	if(!group_number_to_index_.empty())
+	{
+		out << "\tfor(size_t i= 0; i < " << group_number_to_index_.size() << "; ++i)\n";
+		out << "\t{\n";
+		out << "\t\tstate.groups[i].begin= state.str_end;\n";
+		out << "\t\tstate.groups[i].end= state.str_end;\n";
+		out << "\t}\n";
+	}
+	if(has_subroutine_calls_)
+	{
+		out << "\tstate.subroutine_call_return_chain_head= nullptr;\n";
+		out << "\tstate.subroutine_call_state_save_chain_head= nullptr;\n";
+	}
+	out << "}\n\n";
+}
+
+void CppGenerator::GenerateSearchLoopStart(std::ostream& out, const bool has_start_offset) const
+{
+	out << "\tState state;\n";
+	out << "\tstate.str_end= str + str_size;\n";
+	out << "\tstate.str_begin_initial= str;\n\n";
+
+	if(NeedsInputValidation())
+	{
+		out << "\t// Find nothing in invalid input.\n";
+		if(has_start_offset)
+		{
+			// Searches of next matches in the same string rely on check, performed for search from string beginning.
+			out << "\t// Input is validated only if search starts from string beginning.\n";
+			out << "\tif(start_offset == 0 && !IsValidUtf8(str, state.str_end))\n";
+		}
+		else
+			out << "\tif(!IsValidUtf8(str, state.str_end))\n";
+		out << "\t\treturn 0;\n\n";
+	}
+}
+
+std::string CppGenerator::GetNodeFunctionName(const GraphElements::NodePtr node)
+{
+	if(node == nullptr)
+	{
+		end_function_used_= true;
+		return "match_end";
+	}
+
+	if(used_nodes_set_.insert(node).second)
+		used_nodes_.push_back(node);
+
+	const char* const name= std::visit([](const auto& el){ return GetNodeName(el); }, *node);
+	return std::string(name) + "_" + std::to_string(node_indices_.at(node));
+}
+
+std::string CppGenerator::GetNextCall(const GraphElements::NodePtr node)
+{
+	if(node == nullptr)
+		return "true";
+
+	return GetNodeFunctionName(node) + "(state)";
+}
+
+void CppGenerator::GenerateNodeFunctionBodyImpl(const GraphElements::AnySymbol& node)
+{
+	functions_out_ << "\tuint32_t code= 0;\n";
+	functions_out_ << "\tif(!ExtractCodePoint(state, code))\n";
+	functions_out_ << "\t\treturn false;\n";
+	functions_out_ << "\treturn " << GetNextCall(node.next) << ";\n";
+}
+
+void CppGenerator::GenerateNodeFunctionBodyImpl(const GraphElements::SpecificSymbol& node)
+{
+	functions_out_ << "\tuint32_t code= 0;\n";
+	functions_out_ << "\tif(!ExtractCodePoint(state, code) || code != " << HexConstant(node.code) << ")\n";
+	functions_out_ << "\t\treturn false;\n";
+	functions_out_ << "\treturn " << GetNextCall(node.next) << ";\n";
+}
+
+void CppGenerator::GenerateNodeFunctionBodyImpl(const GraphElements::String& node)
+{
+	std::vector<std::string> conditions;
+	size_t total_code_units= 0;
+
+	if(node.case_insensitive)
+	{
+		for(const CharType c : Utf8ToUtf32(node.str))
+		{
+			conditions.push_back(GetCaseInsensitiveCodePointCondition(c, total_code_units));
+			total_code_units+= GetCodePointSize(c, encoding_);
+		}
+	}
+	else
+	{
+		for(const uint32_t code_unit : EncodeString(node.str))
+		{
+			conditions.push_back(UnitRef(total_code_units) + " == " + HexConstant(code_unit));
+			++total_code_units;
+		}
+	}
+
+	if(total_code_units > 0)
+	{
+		functions_out_ << "\tconst CharType* const s= state.str_begin;\n";
+		functions_out_ << "\tif(size_t(state.str_end - s) < " << total_code_units << ")\n";
+		functions_out_ << "\t\treturn false;\n";
+		functions_out_ << "\tif(!(\n";
+		for(size_t i= 0; i < conditions.size(); ++i)
+			functions_out_ << "\t\t" << conditions[i] << (i + 1 < conditions.size() ? " &&\n" : "))\n");
+		functions_out_ << "\t\treturn false;\n";
+		functions_out_ << "\tstate.str_begin= s + " << total_code_units << ";\n";
+	}
+	functions_out_ << "\treturn " << GetNextCall(node.next) << ";\n";
+}
+
+void CppGenerator::GenerateNodeFunctionBodyImpl(const GraphElements::OneOf& node)
+{
+	const auto ranges= GetMergedRanges(node, encoding_);
+
+	// Classes don't match invalid UTF-8 sequences and continuation bytes (like in LLVM backend), except any symbol (empty inverse set).
+	// Checks of ASCII symbols may use regular extraction, since non-ASCII bytes don't match anyway.
+	const bool needs_valid_code_point=
+		encoding_ == Encoding::UTF8 &&
+		(node.inverse_flag ? !ranges.empty() : (!ranges.empty() && ranges.back().second > 0x7F));
+
+	functions_out_ << "\tuint32_t code= 0;\n";
+	if(needs_valid_code_point)
+	{
+		functions_out_ << "\tif(!ExtractValidCodePoint(state, code))\n";
+		valid_code_point_extraction_function_used_= true;
+	}
+	else
+		functions_out_ << "\tif(!ExtractCodePoint(state, code))\n";
+	functions_out_ << "\t\treturn false;\n";
+
+	std::string condition;
+	if(ranges.empty())
+		condition= "false";
+	else if(ranges.size() <= 8)
+	{
+		for(const auto& range : ranges)
+		{
+			if(!condition.empty())
+				condition+= " || ";
+
+			if(range.first == range.second)
+				condition+= "code == " + HexConstant(range.first);
+			else if(range.first == 0)
+				condition+= "code <= " + HexConstant(range.second);
+			else
+				condition+= "(code >= " + HexConstant(range.first) + " && code <= " + HexConstant(range.second) + ")";
+		}
+	}
+	else
+	{
+		// Use binary search for large sets, like Unicode classes.
+		functions_out_ << "\tstatic const uint32_t ranges[][2]=\n";
+		functions_out_ << "\t{\n";
+		for(const auto& range : ranges)
+			functions_out_ << "\t\t{ " << HexConstant(range.first) << ", " << HexConstant(range.second) << " },\n";
+		functions_out_ << "\t};\n";
+
+		condition= "CodePointInRanges(code, ranges, " + std::to_string(ranges.size()) + ")";
+		ranges_check_function_used_= true;
+	}
+
+	functions_out_ << "\tif(" << (node.inverse_flag ? "" : "!") << "(" << condition << "))\n";
+	functions_out_ << "\t\treturn false;\n";
+	functions_out_ << "\treturn " << GetNextCall(node.next) << ";\n";
+}
+
+void CppGenerator::GenerateNodeFunctionBodyImpl(const GraphElements::Alternatives& node)
+{
+	assert(!node.next.empty());
+
+	functions_out_ << "\tconst State state_backup= state;\n";
+	// Compare indices, not pointers, since same node may be used in several alternatives.
+	for(size_t i= 0; i < node.next.size(); ++i)
+	{
+		if(i + 1 < node.next.size())
+		{
+			functions_out_ << "\tif(" << GetNextCall(node.next[i]) << ")\n";
+			functions_out_ << "\t\treturn true;\n";
+			functions_out_ << "\tstate= state_backup;\n";
+		}
+		else
+		{
+			// Do not restore state after last alternative, just return its result.
+			functions_out_ << "\treturn " << GetNextCall(node.next[i]) << ";\n";
+		}
+	}
+}
+
+void CppGenerator::GenerateNodeFunctionBodyImpl(const GraphElements::AlternativesPossessive& node)
+{
+	functions_out_ << "\tconst State state_backup= state;\n";
+	functions_out_ << "\tif(" << GetNextCall(node.path0_element) << ")\n";
+	functions_out_ << "\t\treturn " << GetNextCall(node.path0_next) << ";\n";
+	functions_out_ << "\tstate= state_backup;\n";
+	functions_out_ << "\treturn " << GetNextCall(node.path1_next) << ";\n";
+}
+
+void CppGenerator::GenerateNodeFunctionBodyImpl(const GraphElements::AlternativesTrie& node)
+{
+	std::vector< std::vector<uint32_t> > strings;
+	strings.reserve(node.alternatives.size());
+	for(const auto& alternative : node.alternatives)
+		strings.push_back(EncodeString(alternative.str));
+
+	const CodeUnitsTrie trie= BuildCodeUnitsTrie(strings);
+
+	functions_out_ << "\tconst CharType* const s= state.str_begin;\n";
+	functions_out_ << "\tconst size_t size= size_t(state.str_end - s);\n";
+
+	// State backup is needed only if more than one string may match.
+	for(const CodeUnitsTrieNode& trie_node : trie)
+	{
+		if(trie_node.matched_strings.size() > 1)
+		{
+			functions_out_ << "\tconst State state_backup= state;\n";
+			break;
+		}
+	}
+
+	GenerateAlternativesTrieNode(node, trie, 0, strings, "\t");
+}
+
+void CppGenerator::GenerateAlternativesTrieNode(
+	const GraphElements::AlternativesTrie& node,
+	const CodeUnitsTrie& trie,
+	const size_t trie_node_index,
+	const std::vector< std::vector<uint32_t> >& strings,
+	const std::string& indent)
+{
+	const CodeUnitsTrieNode& trie_node= trie[trie_node_index];
+
+	// Select child node by next code unit via switch.
+	if(!trie_node.children.empty())
+	{
+		functions_out_ << indent << "if(size > " << trie_node.depth << ")\n";
+		functions_out_ << indent << "{\n";
+		functions_out_ << indent << "\tswitch(" << UnitRef(trie_node.depth) << ")\n";
+		functions_out_ << indent << "\t{\n";
+		for(const auto& child_pair : trie_node.children)
+		{
+			functions_out_ << indent << "\tcase " << HexConstant(child_pair.first) << ":\n";
+			functions_out_ << indent << "\t\t{\n";
+			GenerateAlternativesTrieNode(node, trie, child_pair.second, strings, indent + "\t\t\t");
+			functions_out_ << indent << "\t\t}\n";
+		}
+		functions_out_ << indent << "\tdefault:\n";
+		functions_out_ << indent << "\t\tbreak;\n";
+		functions_out_ << indent << "\t}\n";
+		functions_out_ << indent << "}\n";
+	}
+
+	// No more matching code units - try alternatives of strings, matched so far.
+	for(const size_t i : trie_node.matched_strings)
+	{
+		functions_out_ << indent << "state.str_begin= s + " << strings[i].size() << ";\n";
+		if(i != trie_node.matched_strings.back())
+		{
+			functions_out_ << indent << "if(" << GetNextCall(node.alternatives[i].next) << ")\n";
+			functions_out_ << indent << "\treturn true;\n";
+			functions_out_ << indent << "state= state_backup;\n";
+		}
+		else
+			functions_out_ << indent << "return " << GetNextCall(node.alternatives[i].next) << ";\n";
+	}
+
+	if(trie_node.matched_strings.empty())
+		functions_out_ << indent << "return false;\n";
+}
+
+void CppGenerator::GenerateNodeFunctionBodyImpl(const GraphElements::GroupStart& node)
+{
+	const size_t index= group_number_to_index_.at(node.index);
+	functions_out_ << "\tstate.groups[" << index << "].begin= state.str_begin;\n";
+	functions_out_ << "\tstate.groups[" << index << "].end= state.str_begin;\n";
+	functions_out_ << "\treturn " << GetNextCall(node.next) << ";\n";
+}
+
+void CppGenerator::GenerateNodeFunctionBodyImpl(const GraphElements::GroupEnd& node)
+{
+	functions_out_ << "\tstate.groups[" << group_number_to_index_.at(node.index) << "].end= state.str_begin;\n";
+	functions_out_ << "\treturn " << GetNextCall(node.next) << ";\n";
+}
+
+void CppGenerator::GenerateNodeFunctionBodyImpl(const GraphElements::BackReference& node)
+{
+	functions_out_ << "\tconst Group group= state.groups[" << group_number_to_index_.at(node.index) << "];\n";
+	functions_out_ << "\tconst size_t group_size= size_t(group.end - group.begin);\n";
+	functions_out_ << "\tif(size_t(state.str_end - state.str_begin) < group_size)\n";
+	functions_out_ << "\t\treturn false;\n";
+	functions_out_ << "\tfor(size_t i= 0; i < group_size; ++i)\n";
+	functions_out_ << "\t\tif(state.str_begin[i] != group.begin[i])\n";
+	functions_out_ << "\t\t\treturn false;\n";
+	functions_out_ << "\tstate.str_begin+= group_size;\n";
+	functions_out_ << "\treturn " << GetNextCall(node.next) << ";\n";
+}
+
+void CppGenerator::GenerateNodeFunctionBodyImpl(const GraphElements::LookAhead& node)
+{
+	functions_out_ << "\tconst State state_backup= state;\n";
+	functions_out_ << "\tconst bool look_result= " << GetNextCall(node.look_graph) << ";\n";
+	functions_out_ << "\tstate= state_backup;\n";
+	functions_out_ << "\tif(" << (node.positive ? "!" : "") << "look_result)\n";
+	functions_out_ << "\t\treturn false;\n";
+	functions_out_ << "\treturn " << GetNextCall(node.next) << ";\n";
+}
+
+void CppGenerator::GenerateNodeFunctionBodyImpl(const GraphElements::LookBehind& node)
+{
+	functions_out_ << "\tbool look_result= false;\n";
+	if(node.size > 0)
+		functions_out_ << "\tif(size_t(state.str_begin - state.str_begin_initial) >= " << node.size << ")\n";
+	functions_out_ << "\t{\n";
+	functions_out_ << "\t\tconst State state_backup= state;\n";
+	functions_out_ << "\t\tstate.str_begin-= " << node.size << ";\n";
+	functions_out_ << "\t\tlook_result= " << GetNextCall(node.look_graph) << ";\n";
+	functions_out_ << "\t\tstate= state_backup;\n";
+	functions_out_ << "\t}\n";
+	functions_out_ << "\tif(" << (node.positive ? "!" : "") << "look_result)\n";
+	functions_out_ << "\t\treturn false;\n";
+	functions_out_ << "\treturn " << GetNextCall(node.next) << ";\n";
+}
+
+void CppGenerator::GenerateNodeFunctionBodyImpl(const GraphElements::StringStartAssertion& node)
+{
+	functions_out_ << "\tif(state.str_begin != state.str_begin_initial)\n";
+	functions_out_ << "\t\treturn false;\n";
+	functions_out_ << "\treturn " << GetNextCall(node.next) << ";\n";
+}
+
+void CppGenerator::GenerateNodeFunctionBodyImpl(const GraphElements::StringEndAssertion& node)
+{
+	functions_out_ << "\tif(state.str_begin != state.str_end)\n";
+	functions_out_ << "\t\treturn false;\n";
+	functions_out_ << "\treturn " << GetNextCall(node.next) << ";\n";
+}
+
+void CppGenerator::GenerateNodeFunctionBodyImpl(const GraphElements::ConditionalElement& node)
+{
+	functions_out_ << "\tconst State state_backup= state;\n";
+	functions_out_ << "\tconst bool condition_result= " << GetNextCall(node.condition_node) << ";\n";
+	functions_out_ << "\tstate= state_backup;\n";
+	functions_out_ << "\tif(condition_result)\n";
+	functions_out_ << "\t\treturn " << GetNextCall(node.next_true) << ";\n";
+	functions_out_ << "\treturn " << GetNextCall(node.next_false) << ";\n";
+}
+
+void CppGenerator::GenerateNodeFunctionBodyImpl(const GraphElements::SequenceCounterReset& node)
+{
+	functions_out_ << "\tstate.sequence_counters[" << sequence_id_to_counter_index_.at(node.id) << "]= 0;\n";
+	functions_out_ << "\treturn " << GetNextCall(node.next) << ";\n";
+}
+
+void CppGenerator::GenerateNodeFunctionBodyImpl(const GraphElements::SequenceCounter& node)
+{
+	const std::string counter= "state.sequence_counters[" + std::to_string(sequence_id_to_counter_index_.at(node.id)) + "]";
+
+	if(node.max_elements == 0)
+	{
+		// Sequence with zero elements - no need to check counter.
+		functions_out_ << "\t++" << counter << ";\n";
+		functions_out_ << "\treturn " << GetNextCall(node.next_sequence_end) << ";\n";
+		return;
+	}
+
+	functions_out_ << "\tconst size_t counter= " << counter << ";\n";
+	functions_out_ << "\t++" << counter << ";\n";
+
+	if(node.min_elements > 0)
+	{
+		functions_out_ << "\tif(counter < " << node.min_elements << ")\n";
+		functions_out_ << "\t\treturn " << GetNextCall(node.next_iteration) << ";\n";
+	}
+	if(node.max_elements < Sequence::c_max)
+	{
+		functions_out_ << "\tif(counter >= " << node.max_elements << ")\n";
+		functions_out_ << "\t\treturn " << GetNextCall(node.next_sequence_end) << ";\n";
+	}
+
+	const GraphElements::NodePtr first_branch= node.greedy ? node.next_iteration : node.next_sequence_end;
+	const GraphElements::NodePtr second_branch= node.greedy ? node.next_sequence_end : node.next_iteration;
+
+	functions_out_ << "\tconst State state_backup= state;\n";
+	functions_out_ << "\tif(" << GetNextCall(first_branch) << ")\n";
+	functions_out_ << "\t\treturn true;\n";
+	functions_out_ << "\tstate= state_backup;\n";
+	functions_out_ << "\treturn " << GetNextCall(second_branch) << ";\n";
+}
+
+void CppGenerator::GenerateNodeFunctionBodyImpl(const GraphElements::PossessiveSequence& node)
+{
+	if(node.max_elements < Sequence::c_max)
+		functions_out_ << "\tfor(size_t i= 0; i < " << node.max_elements << "; ++i)\n";
+	else
+		functions_out_ << "\tfor(size_t i= 0; ; ++i)\n";
+	functions_out_ << "\t{\n";
+	functions_out_ << "\t\tconst State state_backup= state;\n";
+	functions_out_ << "\t\tif(!" << GetNextCall(node.sequence_element) << ")\n";
+	functions_out_ << "\t\t{\n";
+	functions_out_ << "\t\t\tstate= state_backup;\n";
+	if(node.min_elements > 0)
+	{
+		functions_out_ << "\t\t\tif(i < " << node.min_elements << ")\n";
+		functions_out_ << "\t\t\t\treturn false;\n";
+	}
+	functions_out_ << "\t\t\tbreak;\n";
+	functions_out_ << "\t\t}\n";
+	functions_out_ << "\t}\n";
+	functions_out_ << "\treturn " << GetNextCall(node.next) << ";\n";
+}
+
+void CppGenerator::GenerateNodeFunctionBodyImpl(const GraphElements::SingleRollbackPointSequence& node)
+{
+	// Remember state after last successful match of sequence tail.
+	functions_out_ << "\tState next_state= state;\n";
+	functions_out_ << "\tbool next_state_found= false;\n";
+	functions_out_ << "\tfor(size_t count= 0; ; ++count)\n";
+	functions_out_ << "\t{\n";
+	if(node.min_elements > 0)
+		functions_out_ << "\t\tif(count >= " << node.min_elements << ")\n";
+	functions_out_ << "\t\t{\n";
+	functions_out_ << "\t\t\tconst State state_backup= state;\n";
+	functions_out_ << "\t\t\tif(" << GetNextCall(node.next) << ")\n";
+	functions_out_ << "\t\t\t{\n";
+	functions_out_ << "\t\t\t\tnext_state= state;\n";
+	functions_out_ << "\t\t\t\tnext_state_found= true;\n";
+	functions_out_ << "\t\t\t}\n";
+	functions_out_ << "\t\t\tstate= state_backup;\n";
+	functions_out_ << "\t\t}\n";
+	if(node.max_elements < Sequence::c_max)
+	{
+		functions_out_ << "\t\tif(count == " << node.max_elements << ")\n";
+		functions_out_ << "\t\t\tbreak;\n";
+	}
+	functions_out_ << "\t\tif(!" << GetNextCall(node.sequence_element) << ")\n";
+	functions_out_ << "\t\t\tbreak;\n";
+	functions_out_ << "\t}\n";
+	functions_out_ << "\tif(!next_state_found)\n";
+	functions_out_ << "\t\treturn false;\n";
+	functions_out_ << "\tstate= next_state;\n";
+	functions_out_ << "\treturn true;\n";
+}
+
+void CppGenerator::GenerateNodeFunctionBodyImpl(const GraphElements::FixedLengthElementSequence& node)
+{
+	// First, scan string until first fail or until maximum element count is reached.
+	// We do not need to backup state here, because no sequences with counters, captured groups or backreferences are allowed inside such sequence element.
+	functions_out_ << "\tconst CharType* const str_begin_initial= state.str_begin;\n";
+	functions_out_ << "\tsize_t count= 0;\n";
+	if(node.max_elements < Sequence::c_max)
+		functions_out_ << "\tfor(; count < " << node.max_elements << "; ++count)\n";
+	else
+		functions_out_ << "\tfor(; ; ++count)\n";
+	functions_out_ << "\t{\n";
+	functions_out_ << "\t\tstate.str_begin= str_begin_initial + count * " << node.element_length << ";\n";
+	functions_out_ << "\t\tif(!" << GetNextCall(node.sequence_element) << ")\n";
+	functions_out_ << "\t\t\tbreak;\n";
+	functions_out_ << "\t}\n";
+	if(node.min_elements > 0)
+	{
+		functions_out_ << "\tif(count < " << node.min_elements << ")\n";
+		functions_out_ << "\t\treturn false;\n";
+	}
+
+	// Than perform back steps until first match of expression tail is reached.
+	functions_out_ << "\tconst State state_backup= state;\n";
+	functions_out_ << "\twhile(true)\n";
+	functions_out_ << "\t{\n";
+	functions_out_ << "\t\tstate.str_begin= str_begin_initial + count * " << node.element_length << ";\n";
+	functions_out_ << "\t\tif(" << GetNextCall(node.next) << ")\n";
+	functions_out_ << "\t\t\treturn true;\n";
+	functions_out_ << "\t\tstate= state_backup;\n";
+	functions_out_ << "\t\tif(count == " << node.min_elements << ")\n";
+	functions_out_ << "\t\t\treturn false;\n";
+	functions_out_ << "\t\t--count;\n";
+	functions_out_ << "\t}\n";
+}
+
+void CppGenerator::GenerateNodeFunctionBodyImpl(const GraphElements::AtomicGroup& node)
+{
+	functions_out_ << "\tif(!" << GetNextCall(node.group_element) << ")\n";
+	functions_out_ << "\t\treturn false;\n";
+	functions_out_ << "\treturn " << GetNextCall(node.next) << ";\n";
+}
+
+void CppGenerator::GenerateNodeFunctionBodyImpl(const GraphElements::SubroutineEnter& node)
+{
+	functions_out_ << "\tSubroutineCallReturnChainNode return_chain_node;\n";
+	functions_out_ << "\treturn_chain_node.next_function= " << GetNodeFunctionName(node.next) << ";\n";
+	functions_out_ << "\treturn_chain_node.prev= state.subroutine_call_return_chain_head;\n";
+	functions_out_ << "\tstate.subroutine_call_return_chain_head= &return_chain_node;\n";
+	functions_out_ << "\treturn " << GetNextCall(node.subroutine_node) << ";\n";
+}
+
+void CppGenerator::GenerateNodeFunctionBodyImpl(const GraphElements::SubroutineLeave& node)
+{
+	(void)node;
+
+	if(!has_subroutine_calls_)
+	{
+		functions_out_ << "\t(void)state;\n";
+		functions_out_ << "\treturn true;\n";
+		return;
+	}
+
+	// Leave of whole expression, called not as subroutine.
+	functions_out_ << "\tconst SubroutineCallReturnChainNode* const return_chain_node= state.subroutine_call_return_chain_head;\n";
+	functions_out_ << "\tif(return_chain_node == nullptr)\n";
+	functions_out_ << "\t\treturn true;\n";
+	functions_out_ << "\tstate.subroutine_call_return_chain_head= return_chain_node->prev;\n";
+	functions_out_ << "\treturn return_chain_node->next_function(state);\n";
+}
+
+void CppGenerator::GenerateNodeFunctionBodyImpl(const GraphElements::StateSave& node)
+{
+	functions_out_ << "\tSubroutineCallStateSaveChainNode state_save_chain_node;\n";
+	for(const size_t index : GetSequenceCounterIndices(node.sequence_counters_to_save))
+		functions_out_ << "\tstate_save_chain_node.sequence_counters[" << index << "]= state.sequence_counters[" << index << "];\n";
+	for(const size_t index : GetGroupIndices(node.groups_to_save))
+		functions_out_ << "\tstate_save_chain_node.groups[" << index << "]= state.groups[" << index << "];\n";
+	functions_out_ << "\tstate_save_chain_node.prev= state.subroutine_call_state_save_chain_head;\n";
+	functions_out_ << "\tstate.subroutine_call_state_save_chain_head= &state_save_chain_node;\n";
+	functions_out_ << "\treturn " << GetNextCall(node.next) << ";\n";
+}
+
+void CppGenerator::GenerateNodeFunctionBodyImpl(const GraphElements::StateRestore& node)
+{
+	functions_out_ << "\tconst SubroutineCallStateSaveChainNode* const state_save_chain_node= state.subroutine_call_state_save_chain_head;\n";
+	functions_out_ << "\tstate.subroutine_call_state_save_chain_head= state_save_chain_node->prev;\n";
+	for(const size_t index : GetSequenceCounterIndices(node.sequence_counters_to_restore))
+		functions_out_ << "\tstate.sequence_counters[" << index << "]= state_save_chain_node->sequence_counters[" << index << "];\n";
+	for(const size_t index : GetGroupIndices(node.groups_to_restore))
+		functions_out_ << "\tstate.groups[" << index << "]= state_save_chain_node->groups[" << index << "];\n";
+	functions_out_ << "\treturn " << GetNextCall(node.next) << ";\n";
+}
+
+std::string CppGenerator::GetCaseInsensitiveCodePointCondition(const CharType c, const size_t offset) const
+{
+	const CharType c_utf32[]{c};
+	const std::vector<uint32_t> code_units= EncodeString(Utf32ToUtf8(std::basic_string_view<CharType>(c_utf32, 1)));
+
+	std::vector<uint32_t> other_case_code_units;
+	if(const auto other_case= GetOtherCase(c); other_case != std::nullopt && !(encoding_ == Encoding::Bytes && *other_case > 0xFF))
+	{
+		const CharType other_case_utf32[]{*other_case};
+		other_case_code_units= EncodeString(Utf32ToUtf8(std::basic_string_view<CharType>(other_case_utf32, 1)));
+		assert(other_case_code_units.size() == code_units.size());
+	}
+
+	size_t num_different_code_units= 0;
+	for(size_t i= 0; i < other_case_code_units.size(); ++i)
+		if(code_units[i] != other_case_code_units[i])
+			++num_different_code_units;
+
+	const auto make_variant_condition=
+	[&](const std::vector<uint32_t>& units)
+	{
+		std::string condition;
+		for(size_t i= 0; i < units.size(); ++i)
+		{
+			if(i > 0)
+				condition+= " && ";
+			condition+= UnitRef(offset + i) + " == " + HexConstant(units[i]);
+		}
+		return condition;
+	};
+
+	if(num_different_code_units == 0)
+		return make_variant_condition(code_units);
+
+	if(num_different_code_units == 1)
+	{
+		// Check common code units and both variants of different code unit.
+		std::string condition;
+		for(size_t i= 0; i < code_units.size(); ++i)
+		{
+			if(i > 0)
+				condition+= " && ";
+
+			const std::string unit= UnitRef(offset + i);
+			if(code_units[i] == other_case_code_units[i])
+				condition+= unit + " == " + HexConstant(code_units[i]);
+			else
+				condition+= "(" + unit + " == " + HexConstant(code_units[i]) + " || " + unit + " == " + HexConstant(other_case_code_units[i]) + ")";
+		}
+		return condition;
+	}
+
+	return "((" + make_variant_condition(code_units) + ") || (" + make_variant_condition(other_case_code_units) + "))";
+}
+
+std::vector<uint32_t> CppGenerator::EncodeString(const std::string& str_utf8) const
+{
+	std::vector<uint32_t> result;
+	switch(encoding_)
+	{
+	case Encoding::UTF8:
+		for(const char c : str_utf8)
+			result.push_back(uint8_t(c));
+		break;
+	case Encoding::UTF16:
+		for(const char16_t c : Utf8ToUtf16(str_utf8))
+			result.push_back(c);
+		break;
+	case Encoding::UTF32:
+		for(const char32_t c : Utf8ToUtf32(str_utf8))
+			result.push_back(c);
+		break;
+	case Encoding::Bytes:
+		for(const char32_t c : Utf8ToUtf32(str_utf8))
+		{
+			assert(c <= 0xFF);
+			result.push_back(c);
+		}
+		break;
+	};
+
+	return result;
+}
+
+std::vector<size_t> CppGenerator::GetSequenceCounterIndices(const GraphElements::SequenceIdSet& sequence_ids) const
+{
+	std::vector<size_t> result;
+	for(const GraphElements::SequenceId sequence_id : sequence_ids)
+	{
+		const auto it= sequence_id_to_counter_index_.find(sequence_id);
+		if(it != sequence_id_to_counter_index_.end()) // Sequence counter may be not actually used.
+			result.push_back(it->second);
+	}
+
+	// Sort indices in order to produce same code for same regex.
+	std::sort(result.begin(), result.end());
+	return result;
+}
+
+std::vector<size_t> CppGenerator::GetGroupIndices(const std::unordered_set<size_t>& group_numbers) const
+{
+	std::vector<size_t> result;
+	for(const size_t group_number : group_numbers)
+		result.push_back(group_number_to_index_.at(group_number));
+
+	std::sort(result.begin(), result.end());
+	return result;
+}
+
+} // namespace
+
+std::string GenerateMatcherFunctionCpp(const RegexGraphBuildResult& regex_graph, const std::string& function_name)
+{
+	CppGenerator generator(regex_graph, function_name);
+	return generator.GenerateMatcherFunction();
+}
+
+std::string GenerateMatchesCounterFunctionCpp(const RegexGraphBuildResult& regex_graph, const std::string& function_name)
+{
+	CppGenerator generator(regex_graph, function_name);
+	return generator.GenerateMatchesCounterFunction();
+}
+
+} // namespace RegPanzer
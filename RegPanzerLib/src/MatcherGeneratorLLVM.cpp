@@ -1,8 +1,15 @@
+#include "../CaseFolding.hpp"
 #include "../MatcherGeneratorLLVM.hpp"
+#include "../StateFieldsLiveness.hpp"
+#include "../Utils.hpp"
 #include "../PushDisableLLVMWarnings.hpp"
 #include <llvm/IR/IRBuilder.h>
-#include <llvm/Support/ConvertUTF.h>
 #include "../PopLLVMWarnings.hpp"
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <optional>
+#include <sstream>
 
 namespace RegPanzer
 {
@@ -18,6 +25,7 @@ const char* GetNodeName(const GraphElements::String&) { return "string"; }
 const char* GetNodeName(const GraphElements::OneOf&) { return "one_of"; }
 const char* GetNodeName(const GraphElements::Alternatives&) { return "alternatives"; }
 const char* GetNodeName(const GraphElements::AlternativesPossessive&) { return "alternatives_possessive"; }
+const char* GetNodeName(const GraphElements::AlternativesTrie&) { return "alternatives_trie"; }
 const char* GetNodeName(const GraphElements::GroupStart&) { return "group_start"; }
 const char* GetNodeName(const GraphElements::GroupEnd&) { return "group_end"; }
 const char* GetNodeName(const GraphElements::BackReference&) { return "back_reference"; }
@@ -49,8 +57,6 @@ struct StateFieldIndex
 {
 	enum
 	{
-		StrBegin,
-		StrEnd,
 		StrBeginInitial,
 		SequenceContersArray,
 		GroupsArray,
@@ -80,110 +86,612 @@ struct SubroutineCallStateSaveChainNodeFieldIndex
 	};
 };
 
+struct ContinuationFrameFieldIndex
+{
+	enum
+	{
+		StackPointer, // Stack pointer before frame allocation, restored after frame pop.
+		Prev,
+		ResumePoint,
+		StrBegin,
+		State,
+	};
+};
+
 using IRBuilder= llvm::IRBuilder<>;
 
+llvm::IntegerType* GetCodeUnitType(llvm::LLVMContext& context, const Encoding encoding)
+{
+	switch(encoding)
+	{
+	case Encoding::UTF8: return llvm::Type::getInt8Ty(context);
+	case Encoding::UTF16: return llvm::Type::getInt16Ty(context);
+	case Encoding::UTF32: return llvm::Type::getInt32Ty(context);
+	case Encoding::Bytes: return llvm::Type::getInt8Ty(context);
+	};
+
+	assert(false);
+	return llvm::Type::getInt8Ty(context);
+}
+
 const bool no_unsiged_wrap= true;
 
+//
+// UTF-8 automaton.
+// Sets of code points are converted into automaton, working directly with UTF-8 bytes, so, no code point decoding is needed.
+//
+
+using CodePointRanges= std::vector< std::pair<CharType, CharType> >;
+
+// Returns sorted non-overlapping ranges of variants and ranges of given node. Inverse flag is ignored.
+CodePointRanges GetMergedCodePointRanges(const GraphElements::OneOf& node)
+{
+	CodePointRanges ranges= node.ranges;
+	for(const CharType c : node.variants)
+		ranges.emplace_back(c, c);
+	std::sort(ranges.begin(), ranges.end());
+
+	CodePointRanges merged_ranges;
+	for(const auto& range : ranges)
+	{
+		if(!merged_ranges.empty() && range.first <= merged_ranges.back().second + 1)
+			merged_ranges.back().second= std::max(merged_ranges.back().second, range.second);
+		else
+			merged_ranges.push_back(range);
+	}
+
+	return merged_ranges;
+}
+
+// Returns sorted non-overlapping ranges. Surrogates are excluded, since they can't be encoded in UTF-8.
+CodePointRanges GetNormalizedCodePointRanges(const GraphElements::OneOf& node)
+{
+	CodePointRanges merged_ranges= GetMergedCodePointRanges(node);
+
+	const CharType c_max_code_point= 0x10FFFF;
+	if(node.inverse_flag)
+	{
+		CodePointRanges inverse_ranges;
+		CharType next_begin= 0;
+		for(const auto& range : merged_ranges)
+		{
+			if(range.first > next_begin)
+				inverse_ranges.emplace_back(next_begin, range.first - 1);
+			next_begin= range.second + 1;
+		}
+		if(next_begin <= c_max_code_point)
+			inverse_ranges.emplace_back(next_begin, c_max_code_point);
+		merged_ranges= std::move(inverse_ranges);
+	}
+
+	const CharType c_surrogates_begin= 0xD800, c_surrogates_end= 0xDFFF;
+	CodePointRanges result;
+	for(const auto& range : merged_ranges)
+	{
+		if(range.first > c_max_code_point)
+			break;
+		const CharType end= std::min(range.second, c_max_code_point);
+
+		if(range.first < c_surrogates_begin)
+			result.emplace_back(range.first, std::min(end, CharType(c_surrogates_begin - 1)));
+		if(end > c_surrogates_end)
+			result.emplace_back(std::max(range.first, CharType(c_surrogates_end + 1)), end);
+	}
+
+	return result;
+}
+
+// Returns name suffix, that contains all ranges. Helper functions for different sets are shared by name, so, names should never clash.
+std::string GetCodePointRangesName(const CodePointRanges& ranges)
+{
+	std::ostringstream stream;
+	stream << std::hex << std::uppercase;
+	for(const auto& range : ranges)
+	{
+		stream << "_" << range.first;
+		if(range.second != range.first)
+			stream << "-" << range.second;
+	}
+	return stream.str();
+}
+
+// Sequence of byte ranges - one range for each byte of UTF-8 sequence.
+using Utf8ByteRanges= std::vector< std::pair<uint8_t, uint8_t> >;
+
+void SplitCodePointRangeIntoUtf8Sequences(const CharType begin, const CharType end, std::vector<Utf8ByteRanges>& out_sequences)
+{
+	// Split range into parts with same UTF-8 sequence length.
+	for(const CharType max_code_point : { 0x7F, 0x7FF, 0xFFFF })
+	{
+		if(begin <= max_code_point && end > max_code_point)
+		{
+			SplitCodePointRangeIntoUtf8Sequences(begin, max_code_point, out_sequences);
+			SplitCodePointRangeIntoUtf8Sequences(max_code_point + 1, end, out_sequences);
+			return;
+		}
+	}
+
+	// Split range into parts, where each byte may be checked independently.
+	for(uint32_t i= 1; i < 4; ++i)
+	{
+		const CharType mask= (CharType(1) << (6 * i)) - 1;
+		if((begin & ~mask) == (end & ~mask))
+			continue;
+
+		if((begin & mask) != 0)
+		{
+			SplitCodePointRangeIntoUtf8Sequences(begin, begin | mask, out_sequences);
+			SplitCodePointRangeIntoUtf8Sequences((begin | mask) + 1, end, out_sequences);
+			return;
+		}
+		if((end & mask) != mask)
+		{
+			SplitCodePointRangeIntoUtf8Sequences(begin, (end & ~mask) - 1, out_sequences);
+			SplitCodePointRangeIntoUtf8Sequences(end & ~mask, end, out_sequences);
+			return;
+		}
+	}
+
+	// Use explicit size, since code point may be zero.
+	const std::string begin_utf8= Utf32ToUtf8(std::basic_string_view<CharType>(&begin, 1));
+	const std::string end_utf8= Utf32ToUtf8(std::basic_string_view<CharType>(&end, 1));
+	assert(begin_utf8.size() == end_utf8.size());
+
+	Utf8ByteRanges sequence;
+	for(size_t i= 0; i < begin_utf8.size(); ++i)
+		sequence.emplace_back(uint8_t(begin_utf8[i]), uint8_t(end_utf8[i]));
+	out_sequences.push_back(std::move(sequence));
+}
+
+struct Utf8AutomatonState
+{
+	struct Transition
+	{
+		uint8_t begin= 0;
+		uint8_t end= 0; // Inclusive.
+		std::optional<size_t> next_state; // None for final transition.
+	};
+
+	size_t depth= 0; // Number of bytes before this state.
+	std::vector<Transition> transitions; // Sorted.
+};
+
+// Deterministic automaton. Each state checks single byte. State 0 is start state.
+class Utf8AutomatonBuilder
+{
+public:
+	explicit Utf8AutomatonBuilder(const CodePointRanges& ranges)
+	{
+		std::vector<Utf8ByteRanges> sequences;
+		for(const auto& range : ranges)
+			SplitCodePointRangeIntoUtf8Sequences(range.first, range.second, sequences);
+
+		GetOrCreateState(0, std::move(sequences));
+	}
+
+	std::vector<Utf8AutomatonState> TakeStates() { return std::move(states_); }
+
+private:
+	size_t GetOrCreateState(const size_t depth, std::vector<Utf8ByteRanges> sequences)
+	{
+		std::sort(sequences.begin(), sequences.end());
+		sequences.erase(std::unique(sequences.begin(), sequences.end()), sequences.end());
+
+		auto key= std::make_pair(depth, std::move(sequences));
+		if(const auto it= states_map_.find(key); it != states_map_.end())
+			return it->second;
+
+		const size_t state_index= states_.size();
+		states_.emplace_back();
+		states_.back().depth= depth;
+		const auto& state_sequences= states_map_.emplace(std::move(key), state_index).first->first.second;
+
+		// Split all bytes into intervals with same set of sequence tails.
+		std::vector<uint32_t> bounds{ 0, 256 };
+		for(const Utf8ByteRanges& sequence : state_sequences)
+		{
+			bounds.push_back(sequence.front().first);
+			bounds.push_back(uint32_t(sequence.front().second) + 1);
+		}
+		std::sort(bounds.begin(), bounds.end());
+		bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+		std::vector<Utf8AutomatonState::Transition> transitions;
+		for(size_t i= 0; i + 1 < bounds.size(); ++i)
+		{
+			const uint32_t byte= bounds[i];
+
+			std::vector<Utf8ByteRanges> tails;
+			bool is_final= false;
+			for(const Utf8ByteRanges& sequence : state_sequences)
+			{
+				if(byte < sequence.front().first || byte > sequence.front().second)
+					continue;
+
+				if(sequence.size() == 1)
+					is_final= true; // UTF-8 is prefix code, so, all tails are empty in such case.
+				else
+					tails.emplace_back(sequence.begin() + 1, sequence.end());
+			}
+
+			if(!is_final && tails.empty())
+				continue;
+
+			Utf8AutomatonState::Transition transition;
+			transition.begin= uint8_t(byte);
+			transition.end= uint8_t(bounds[i + 1] - 1);
+			if(!is_final)
+				transition.next_state= GetOrCreateState(depth + 1, std::move(tails));
+
+			if(!transitions.empty() &&
+				transitions.back().end + 1 == transition.begin &&
+				transitions.back().next_state == transition.next_state)
+				transitions.back().end= transition.end;
+			else
+				transitions.push_back(transition);
+		}
+
+		states_[state_index].transitions= std::move(transitions);
+		return state_index;
+	}
+
+private:
+	std::vector<Utf8AutomatonState> states_;
+	std::map<std::pair<size_t, std::vector<Utf8ByteRanges>>, size_t> states_map_;
+};
+
+//
+// Alternatives dispatch.
+//
+
+struct AlternativesCodeUnitsInterval
+{
+	GraphElements::CharType begin= 0;
+	GraphElements::CharType end= 0; // Inclusive.
+	std::vector<size_t> alternatives; // Indices of alternatives, which may start with code units of this interval.
+};
+
+// Splits code units space into intervals with same lists of possible alternatives.
+// Intervals, where only alternatives without first code units restriction are possible, are not returned.
+std::vector<AlternativesCodeUnitsInterval> GetAlternativesCodeUnitsIntervals(
+	const std::vector< std::optional<GraphElements::CodeUnitRanges> >& first_code_units)
+{
+	std::vector<GraphElements::CharType> bounds;
+	for(const auto& ranges : first_code_units)
+	{
+		if(ranges == std::nullopt)
+			continue;
+		for(const auto& range : *ranges)
+		{
+			bounds.push_back(range.first);
+			bounds.push_back(range.second + 1);
+		}
+	}
+
+	std::sort(bounds.begin(), bounds.end());
+	bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+	std::vector<AlternativesCodeUnitsInterval> result;
+	for(size_t i= 0; i + 1 < bounds.size(); ++i)
+	{
+		AlternativesCodeUnitsInterval interval;
+		interval.begin= bounds[i];
+		interval.end= bounds[i + 1] - 1;
+
+		bool has_restricted_alternatives= false;
+		for(size_t j= 0; j < first_code_units.size(); ++j)
+		{
+			const auto& ranges= first_code_units[j];
+			if(ranges == std::nullopt)
+			{
+				interval.alternatives.push_back(j);
+				continue;
+			}
+
+			// Interval is whole inside one of ranges or outside all ranges.
+			const auto it=
+				std::upper_bound(
+					ranges->begin(), ranges->end(), interval.begin,
+					[](const GraphElements::CharType c, const auto& range){ return c < range.first; });
+			if(it != ranges->begin() && std::prev(it)->second >= interval.begin)
+			{
+				interval.alternatives.push_back(j);
+				has_restricted_alternatives= true;
+			}
+		}
+
+		if(!has_restricted_alternatives)
+			continue;
+
+		if(!result.empty() &&
+			result.back().end + 1 == interval.begin &&
+			result.back().alternatives == interval.alternatives)
+			result.back().end= interval.end;
+		else
+			result.push_back(std::move(interval));
+	}
+
+	return result;
+}
+
+// Data of function, which is currently built in single function mode.
+struct SingleFunctionData
+{
+	using BlockWithPosition= std::pair<llvm::BasicBlock*, llvm::PHINode*>;
+
+	llvm::Function* function= nullptr;
+	llvm::Value* continuation_head_ptr= nullptr; // Pointer to top frame of backtracking stack.
+	llvm::BasicBlock* backtrack_block= nullptr;
+
+	std::unordered_map<GraphElements::NodePtr, BlockWithPosition> node_blocks;
+	std::vector<GraphElements::NodePtr> nodes_to_build;
+	struct ResumePoint
+	{
+		BlockWithPosition block;
+		StateFieldsSet fields_to_restore;
+	};
+	std::vector<ResumePoint> resume_points; // Index is resume point number.
+};
+
+// Function ptr(ptr begin, ptr end), that returns pointer after longest sequence of code points of some class, starting from begin.
+struct SpanFunction
+{
+	llvm::Function* function= nullptr;
+	size_t element_length= 0; // In code units. 0 if code points of class have different length.
+};
+
 class Generator
 {
 public:
-	explicit Generator(llvm::Module& module);
+	Generator(llvm::Module& module, const Options& options);
 
 	void GenerateMatcherFunction(const RegexGraphBuildResult& regex_graph, const std::string& function_name);
+	void GenerateMatchesCounterFunction(const RegexGraphBuildResult& regex_graph, const std::string& function_name);
 
 private:
 	void CreateStateType(const RegexGraphBuildResult& regex_graph);
+	void ClearInternalStructures();
+
+	// Returns true if input validation at entry of root function is needed.
+	bool NeedsInputValidation() const;
+	// Function "bool(const char* begin, const char* end)", that checks if given string is valid UTF-8.
+	llvm::Function* GetOrCreateUtf8ValidationFunction();
+
+	void InitStateConstantFields(IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, llvm::Value* str_begin);
+	void InitStateNonConstantFields(IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, llvm::Value* str_end);
+
+	// Null pointer is not a valid string pointer for node functions, since it is used as failure result.
+	// Replace it with pointer to some empty string.
+	llvm::Value* CreateNonNullStrBegin(IRBuilder& llvm_ir_builder, llvm::Value* str_begin);
+
+	// Returns offset of next code point after code point at given offset (or offset + 1 at string end).
+	// Continuation code units (UTF-8 trailing bytes, UTF-16 low surrogates) are skipped. Insert point is changed.
+	llvm::Value* CreateNextCodePointOffset(IRBuilder& llvm_ir_builder, llvm::Value* str_begin, llvm::Value* str_size, llvm::Value* offset);
 
 	llvm::Function* GetOrCreateNodeFunction(const GraphElements::NodePtr node);
 
 	void BuildNodeFunctionBody(GraphElements::NodePtr node, llvm::Function* function);
 
+	// Build function in single function mode. Given node and all nodes reachable from it are basic blocks of this function.
+	// Only graphs of look, atomic groups, etc. and continuations of loops, that call their next nodes, are separate functions.
+	void BuildSingleFunctionBody(GraphElements::NodePtr node, llvm::Function* function);
+
+	// Returns block of given node in function, which is currently built in single function mode.
+	// Block starts with PHI for current position.
+	SingleFunctionData::BlockWithPosition GetOrCreateNodeBlock(GraphElements::NodePtr node);
+
 	void BuildNodeFunctionBodyImpl(
-		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, const GraphElements::AnySymbol& node);
+		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, llvm::Value* str_begin_value, llvm::Value* str_end_value, const GraphElements::AnySymbol& node);
 
 	void BuildNodeFunctionBodyImpl(
-		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, const GraphElements::SpecificSymbol& node);
+		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, llvm::Value* str_begin_value, llvm::Value* str_end_value, const GraphElements::SpecificSymbol& node);
 
 	void BuildNodeFunctionBodyImpl(
-		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, const GraphElements::String& node);
+		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, llvm::Value* str_begin_value, llvm::Value* str_end_value, const GraphElements::String& node);
+
+	void BuildCaseInsensitiveStringCheck(
+		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, llvm::Value* str_begin_value, llvm::Value* str_end_value, const GraphElements::String& node);
 
 	void BuildNodeFunctionBodyImpl(
-		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, const GraphElements::OneOf& node);
+		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, llvm::Value* str_begin_value, llvm::Value* str_end_value, const GraphElements::OneOf& node);
 
 	void BuildNodeFunctionBodyImpl(
-		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, const GraphElements::Alternatives& node);
+		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, llvm::Value* str_begin_value, llvm::Value* str_end_value, const GraphElements::Alternatives& node);
 
 	void BuildNodeFunctionBodyImpl(
-		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, const GraphElements::AlternativesPossessive& node);
+		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, llvm::Value* str_begin_value, llvm::Value* str_end_value, const GraphElements::AlternativesPossessive& node);
 
 	void BuildNodeFunctionBodyImpl(
-		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, const GraphElements::GroupStart& node);
+		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, llvm::Value* str_begin_value, llvm::Value* str_end_value, const GraphElements::AlternativesTrie& node);
 
 	void BuildNodeFunctionBodyImpl(
-		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, const GraphElements::GroupEnd& node);
+		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, llvm::Value* str_begin_value, llvm::Value* str_end_value, const GraphElements::GroupStart& node);
 
 	void BuildNodeFunctionBodyImpl(
-		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, const GraphElements::BackReference& node);
+		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, llvm::Value* str_begin_value, llvm::Value* str_end_value, const GraphElements::GroupEnd& node);
 
 	void BuildNodeFunctionBodyImpl(
-		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, const GraphElements::LookAhead& node);
+		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, llvm::Value* str_begin_value, llvm::Value* str_end_value, const GraphElements::BackReference& node);
 
 	void BuildNodeFunctionBodyImpl(
-		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, const GraphElements::LookBehind& node);
+		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, llvm::Value* str_begin_value, llvm::Value* str_end_value, const GraphElements::LookAhead& node);
 
 	void BuildNodeFunctionBodyImpl(
-		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, const GraphElements::StringStartAssertion& node);
+		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, llvm::Value* str_begin_value, llvm::Value* str_end_value, const GraphElements::LookBehind& node);
 
 	void BuildNodeFunctionBodyImpl(
-		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, const GraphElements::StringEndAssertion& node);
+		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, llvm::Value* str_begin_value, llvm::Value* str_end_value, const GraphElements::StringStartAssertion& node);
 
 	void BuildNodeFunctionBodyImpl(
-		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, const GraphElements::ConditionalElement& node);
+		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, llvm::Value* str_begin_value, llvm::Value* str_end_value, const GraphElements::StringEndAssertion& node);
 
 	void BuildNodeFunctionBodyImpl(
-		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, const GraphElements::SequenceCounterReset& node);
+		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, llvm::Value* str_begin_value, llvm::Value* str_end_value, const GraphElements::ConditionalElement& node);
 
 	void BuildNodeFunctionBodyImpl(
-		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, const GraphElements::SequenceCounter& node);
+		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, llvm::Value* str_begin_value, llvm::Value* str_end_value, const GraphElements::SequenceCounterReset& node);
 
 	void BuildNodeFunctionBodyImpl(
-		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, const GraphElements::PossessiveSequence& node);
+		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, llvm::Value* str_begin_value, llvm::Value* str_end_value, const GraphElements::SequenceCounter& node);
 
 	void BuildNodeFunctionBodyImpl(
-		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, const GraphElements::SingleRollbackPointSequence& node);
+		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, llvm::Value* str_begin_value, llvm::Value* str_end_value, const GraphElements::PossessiveSequence& node);
 
 	void BuildNodeFunctionBodyImpl(
-		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, const GraphElements::FixedLengthElementSequence& node);
+		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, llvm::Value* str_begin_value, llvm::Value* str_end_value, const GraphElements::SingleRollbackPointSequence& node);
 
 	void BuildNodeFunctionBodyImpl(
-		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, const GraphElements::AtomicGroup& node);
+		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, llvm::Value* str_begin_value, llvm::Value* str_end_value, const GraphElements::FixedLengthElementSequence& node);
 
 	void BuildNodeFunctionBodyImpl(
-		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, const GraphElements::SubroutineEnter& node);
+		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, llvm::Value* str_begin_value, llvm::Value* str_end_value, const GraphElements::AtomicGroup& node);
 
 	void BuildNodeFunctionBodyImpl(
-		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, const GraphElements::SubroutineLeave& node);
+		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, llvm::Value* str_begin_value, llvm::Value* str_end_value, const GraphElements::SubroutineEnter& node);
 
 	void BuildNodeFunctionBodyImpl(
-		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, const GraphElements::StateSave& node);
+		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, llvm::Value* str_begin_value, llvm::Value* str_end_value, const GraphElements::SubroutineLeave& node);
 
 	void BuildNodeFunctionBodyImpl(
-		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, const GraphElements::StateRestore& node);
+		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, llvm::Value* str_begin_value, llvm::Value* str_end_value, const GraphElements::StateSave& node);
 
+	void BuildNodeFunctionBodyImpl(
+		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, llvm::Value* str_begin_value, llvm::Value* str_end_value, const GraphElements::StateRestore& node);
+
+	// Returns pair of code point value and string begin after this code point.
+	// Jumps to "not_enough_data_block" if string ends in the middle of code point.
+	std::pair<llvm::Value*, llvm::Value*> CreateCodePointExtraction(
+		IRBuilder& llvm_ir_builder,
+		llvm::Value* str_begin_value,
+		llvm::Value* str_end_value,
+		llvm::Value* char_value,
+		llvm::BasicBlock* not_enough_data_block);
+
+	std::pair<llvm::Value*, llvm::Value*> CreateCodePointExtractionUTF8(
+		IRBuilder& llvm_ir_builder,
+		llvm::Value* str_begin_value,
+		llvm::Value* str_end_value,
+		llvm::Value* char_value,
+		llvm::BasicBlock* not_enough_data_block);
+
+	// Decoding for valid UTF-8 input - without checks for continuation bytes.
+	// String end is still checked, since search with non-zero start offset may be performed in not validated input.
+	std::pair<llvm::Value*, llvm::Value*> CreateCodePointExtractionUTF8Trusted(
+		IRBuilder& llvm_ir_builder,
+		llvm::Value* str_begin_value,
+		llvm::Value* str_end_value,
+		llvm::Value* char_value,
+		llvm::BasicBlock* not_enough_data_block);
+
+	std::pair<llvm::Value*, llvm::Value*> CreateCodePointExtractionUTF16(
+		IRBuilder& llvm_ir_builder,
+		llvm::Value* str_begin_value,
+		llvm::Value* str_end_value,
+		llvm::Value* char_value,
+		llvm::BasicBlock* not_enough_data_block);
+
+	// Returns maximum code point, that is represented via single code unit, equal to this code point.
+	CharType GetMaxSingleCodeUnitCodePoint() const;
+
+	// Convert UTF-8 string into sequence of code units of current encoding.
+	std::vector<uint32_t> EncodeString(const std::string& str_utf8) const;
+
+	// Returns true if UTF-8 automaton should be used instead of code point extraction and comparison.
+	bool ShouldUseUtf8Automaton(const GraphElements::OneOf& node) const;
+
+	// Creates function ptr(ptr begin, ptr end), that returns pointer after matched code point or null.
+	// Functions for same sets are shared by all matchers in module.
+	llvm::Function* GetOrCreateUtf8AutomatonFunction(const GraphElements::OneOf& node);
+
+	// Returns span function, if sequence element is class check and it is last node of sequence element.
+	// Sequences of such elements are matched via span functions.
+	std::optional<SpanFunction> GetSpanFunction(GraphElements::NodePtr sequence_element);
+
+	// Returns sorted ranges of bytes, if node is check of single byte class.
+	std::optional<CodePointRanges> GetSingleByteClassRanges(const GraphElements::OneOf& node) const;
+
+	// Creates span function, that returns pointer to first byte not in given ranges or end.
+	// Checks many bytes at once using vector instructions.
+	// Functions for same sets are shared by all matchers in module.
+	llvm::Function* GetOrCreateSpanFunction(const CodePointRanges& byte_ranges);
+
+	// Creates span function for UTF-8 input and set, checked via UTF-8 automaton.
+	// Checks many bytes at once using vector instructions, code points are decoded in vector lanes.
+	// Code points, which can't be checked in such way (outside BMP or in invalid sequences), are checked via UTF-8 automaton.
+	// Functions for same sets are shared by all matchers in module.
+	llvm::Function* GetOrCreateUtf8SpanFunction(const GraphElements::OneOf& node);
+
+	// Returns pointer after span, but no more than "max_elements" elements.
+	// Elements of span function should have same length if number of elements is limited.
+	llvm::Value* CreateSpanCall(
+		IRBuilder& llvm_ir_builder, const SpanFunction& span_function, llvm::Value* str_begin_value, llvm::Value* str_end_value, size_t max_elements);
+
+	// Creates branch to "found_block" if value is in one of given sorted non-overlapping ranges, else - to "not_found_block".
+	// Depending on number of ranges and their values uses sequence of comparisons, bitmap, two-level table or binary search.
+	void CreateCodePointRangesCheck(
+		IRBuilder& llvm_ir_builder,
+		llvm::Value* value,
+		llvm::ArrayRef< std::pair<CharType, CharType> > ranges,
+		llvm::BasicBlock* found_block,
+		llvm::BasicBlock* not_found_block);
+
+	// Returns i1 value - is bit with index of given value set in bitmap. Value should be less than bitmap size.
+	llvm::Value* CreateBitmapCheck(IRBuilder& llvm_ir_builder, llvm::Value* value, llvm::GlobalVariable* bitmap);
+
+	// Returns i1 value - is given value (less than 65536) in set, specified by two-level table.
+	llvm::Value* CreateTwoLevelTableCheck(
+		IRBuilder& llvm_ir_builder, llvm::Value* value, llvm::GlobalVariable* first_level_table, llvm::GlobalVariable* second_level_table);
+
+	// Tables with same contents are shared by all matchers in module.
+	llvm::GlobalVariable* GetOrCreateConstantTable(const std::vector<uint8_t>& data, const std::string& name_prefix);
+
+	llvm::CallInst* CreateNodeCall(
+		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, llvm::Value* str_begin_value, llvm::Value* str_end_value, GraphElements::NodePtr node);
+
+	// In single function mode jumps to block of next node instead.
 	void CreateNextCallRet(
-		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, GraphElements::NodePtr next_node);
-
-	void SaveState(IRBuilder& llvm_ir_builder, llvm::Value* state, llvm::Value* state_backup);
-	void RestoreState(IRBuilder& llvm_ir_builder, llvm::Value* state, llvm::Value* state_backup);
-	void CopyState(IRBuilder& llvm_ir_builder, llvm::Value* dst, llvm::Value* src);
+		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, llvm::Value* str_begin_value, llvm::Value* str_end_value, GraphElements::NodePtr next_node);
+
+	// Try given next nodes one by one, restoring state before each try, return result of first successfull node.
+	// In single function mode continuations for all nodes except first are pushed into backtracking stack instead.
+	// Each node is called with position, shifted by given offset (in code units), if offsets are specified.
+	void CreateNextAlternativesCallRet(
+		IRBuilder& llvm_ir_builder,
+		llvm::Value* state_ptr,
+		llvm::Value* str_begin_value,
+		llvm::Value* str_end_value,
+		llvm::ArrayRef<GraphElements::NodePtr> next_nodes,
+		llvm::ArrayRef<size_t> next_nodes_offsets= {});
+
+	// Return null or jump to backtracking in single function mode.
+	void CreateFailRet(IRBuilder& llvm_ir_builder);
+
+	// Push frame with copy of state and given position into backtracking stack.
+	// After backtracking into this frame execution continues in returned block with position from frame.
+	SingleFunctionData::BlockWithPosition CreateContinuationPush(
+		IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, llvm::Value* str_begin_value, const StateFieldsSet& fields_to_restore);
+
+	// Allocate state in entry block of current function, since current block may be executed many times in single function mode.
+	llvm::Value* CreateStateAlloca(IRBuilder& llvm_ir_builder, const char* name);
+
+	// Returns fields, which may be modified by evaluated nodes and read after that by next nodes.
+	StateFieldsSet GetFieldsToRestore(llvm::ArrayRef<GraphElements::NodePtr> evaluated_nodes, llvm::ArrayRef<GraphElements::NodePtr> next_nodes) const;
+
+	// Only given fields are copied (and subroutine call chains, if present).
+	void SaveState(IRBuilder& llvm_ir_builder, llvm::Value* state, llvm::Value* state_backup, const StateFieldsSet& fields);
+	void RestoreState(IRBuilder& llvm_ir_builder, llvm::Value* state, llvm::Value* state_backup, const StateFieldsSet& fields);
+	void CopyState(IRBuilder& llvm_ir_builder, llvm::Value* dst, llvm::Value* src, const StateFieldsSet& fields);
 
 	llvm::ConstantInt* GetConstant(llvm::IntegerType* type, uint64_t value) const;
+	llvm::Constant* GetNullStrPtr() const;
 	llvm::Constant* GetZeroGEPIndex() const;
 	llvm::Constant* GetFieldGEPIndex(uint32_t field_index) const;
 
 private:
 	llvm::LLVMContext& context_;
 	llvm::Module& module_;
+	const Encoding encoding_;
+	const Utf8Validation utf8_validation_;
 
 	llvm::IntegerType* const gep_index_type_;
 	llvm::IntegerType* const ptr_size_int_type_;
@@ -196,6 +704,12 @@ private:
 	llvm::FunctionType* node_function_type_= nullptr;
 	llvm::StructType* subroutine_call_return_chain_node_type_= nullptr;
 	llvm::StructType* subroutine_call_state_save_chain_node_type_= nullptr;
+	llvm::StructType* continuation_frame_type_= nullptr;
+
+	bool single_function_mode_= false;
+	SingleFunctionData* single_function_data_= nullptr;
+
+	StateFieldsLiveness state_fields_liveness_;
 
 	std::unordered_map<GraphElements::SequenceId, uint32_t> sequence_id_to_counter_filed_number_;
 	std::unordered_map<size_t, uint32_t> group_number_to_field_number_;
@@ -203,12 +717,14 @@ private:
 	std::unordered_map<GraphElements::NodePtr, llvm::Function*> node_functions_;
 };
 
-Generator::Generator(llvm::Module& module)
+Generator::Generator(llvm::Module& module, const Options& options)
 	: context_(module.getContext())
 	, module_(module)
+	, encoding_(options.encoding)
+	, utf8_validation_(options.utf8_validation)
 	, gep_index_type_(llvm::IntegerType::getInt32Ty(context_))
 	, ptr_size_int_type_(module.getDataLayout().getIntPtrType(context_, 0))
-	, char_type_(llvm::Type::getInt8Ty(context_))
+	, char_type_(GetCodeUnitType(context_, options.encoding))
 	, char_type_ptr_(llvm::PointerType::get(char_type_, 0))
 	, code_point_type_(llvm::Type::getInt32Ty(context_))
 	, group_type_(llvm::StructType::get(char_type_ptr_, char_type_ptr_))
@@ -248,7 +764,7 @@ void Generator::GenerateMatcherFunction(const RegexGraphBuildResult& regex_graph
 	++args_it;
 	const auto arg_subpattern_count= &*args_it;
 
-	arg_str_begin->setName("str_begin");
+	arg_str_begin->setName("arg_str_begin");
 	arg_str_size->setName("str_size");
 	arg_start_offset->setName("arg_start_offset");
 	arg_out_subpatterns->setName("out_subpatterns");
@@ -264,70 +780,45 @@ void Generator::GenerateMatcherFunction(const RegexGraphBuildResult& regex_graph
 
 	const auto state_ptr= llvm_ir_builder.CreateAlloca(state_type_, 0, "state");
 
-	// Initialize state constant fields.
+	const auto str_begin_value= CreateNonNullStrBegin(llvm_ir_builder, arg_str_begin);
+	const auto str_end_value= llvm_ir_builder.CreateGEP(char_type_, str_begin_value, arg_str_size, "str_end");
+	InitStateConstantFields(llvm_ir_builder, state_ptr, str_begin_value);
+	llvm::BasicBlock* validation_block= nullptr;
+	if(NeedsInputValidation())
 	{
-		// Set begin/end pointers.
-		const auto str_begin_initial_ptr= llvm_ir_builder.CreateGEP(state_type_, state_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(StateFieldIndex::StrBeginInitial)});
-		llvm_ir_builder.CreateStore(arg_str_begin, str_begin_initial_ptr);
-
-		const auto str_end_ptr= llvm_ir_builder.CreateGEP(state_type_, state_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(StateFieldIndex::StrEnd)});
-		const auto str_end_value= llvm_ir_builder.CreateGEP(char_type_, arg_str_begin, arg_str_size);
-		llvm_ir_builder.CreateStore(str_end_value, str_end_ptr);
+		// Validate input only if search starts from string beginning.
+		// Searches of next matches in the same string (with non-zero start offset) rely on this check, so whole input isn't scanned again for each match.
+		validation_block= llvm::BasicBlock::Create(context_, "validation", root_function);
+		const auto is_first_search= llvm_ir_builder.CreateICmpEQ(arg_start_offset, GetConstant(ptr_size_int_type_, 0), "is_first_search");
+		llvm_ir_builder.CreateCondBr(is_first_search, validation_block, search_loop_block);
+
+		// Find nothing in invalid input.
+		llvm_ir_builder.SetInsertPoint(validation_block);
+		const auto is_valid= llvm_ir_builder.CreateCall(GetOrCreateUtf8ValidationFunction(), {str_begin_value, str_end_value}, "is_valid");
+		llvm_ir_builder.CreateCondBr(is_valid, search_loop_block, not_found_block);
 	}
-	llvm_ir_builder.CreateBr(search_loop_block);
+	else
+		llvm_ir_builder.CreateBr(search_loop_block);
 
 	// Search loop block.
 	llvm_ir_builder.SetInsertPoint(search_loop_block);
-	const auto current_start_offset= llvm_ir_builder.CreatePHI(arg_start_offset->getType(), 2, "current_start_offset");
+	const auto current_start_offset= llvm_ir_builder.CreatePHI(arg_start_offset->getType(), 3, "current_start_offset");
 	current_start_offset->addIncoming(arg_start_offset, start_basic_block);
+	if(validation_block != nullptr)
+		current_start_offset->addIncoming(arg_start_offset, validation_block);
 
-	// Initialize non-constant fields.
-	{
-		const auto str_begin_ptr= llvm_ir_builder.CreateGEP(state_type_, state_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(StateFieldIndex::StrBegin)});
-		const auto str_begin_value= llvm_ir_builder.CreateGEP(char_type_, arg_str_begin, current_start_offset);
-		llvm_ir_builder.CreateStore(str_begin_value, str_begin_ptr);
-	}
-	{
-		// Zero groups.
-		const uint64_t groups_array_size= state_type_->elements()[StateFieldIndex::GroupsArray]->getArrayNumElements();
-		for(uint64_t i= 0; i < groups_array_size; ++i)
-		{
-			const auto group_ptr=
-				llvm_ir_builder.CreateGEP(
-					state_type_,
-					state_ptr,
-					{
-						GetZeroGEPIndex(),
-						GetFieldGEPIndex(StateFieldIndex::GroupsArray),
-						GetFieldGEPIndex(uint32_t(i)),
-					});
-
-			const auto group_begin_ptr= llvm_ir_builder.CreateGEP(group_type_, group_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(0)});
-			const auto group_end_ptr  = llvm_ir_builder.CreateGEP(group_type_, group_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(1)});
-
-			const auto end_value= llvm_ir_builder.CreateGEP(char_type_, arg_str_begin, arg_str_size);
-			llvm_ir_builder.CreateStore(end_value, group_begin_ptr);
-			llvm_ir_builder.CreateStore(end_value, group_end_ptr  );
-		}
-	}
-	if(state_type_->getNumElements() > StateFieldIndex::SubroutineCallReturnChainHead)
-	{
-		// Zero subroutine call return chain head.
-		const auto ptr= llvm_ir_builder.CreateGEP(state_type_, state_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(StateFieldIndex::SubroutineCallReturnChainHead)});
-		const auto null= llvm::Constant::getNullValue(llvm::PointerType::get(subroutine_call_return_chain_node_type_, 0));
-		llvm_ir_builder.CreateStore(null, ptr);
-	}
-	if(state_type_->getNumElements() > StateFieldIndex::SubroutineCallStateSaveChainHead)
-	{
-		// Zero subroutine call state save chain head.
-		const auto ptr= llvm_ir_builder.CreateGEP(state_type_, state_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(StateFieldIndex::SubroutineCallStateSaveChainHead)});
-		const auto null= llvm::Constant::getNullValue(llvm::PointerType::get(subroutine_call_state_save_chain_node_type_, 0));
-		llvm_ir_builder.CreateStore(null, ptr);
-	}
+	InitStateNonConstantFields(llvm_ir_builder, state_ptr, str_end_value);
 
-	// Call match function.
-	const auto match_res= llvm_ir_builder.CreateCall(GetOrCreateNodeFunction(regex_graph.root), {state_ptr}, "root_call_res");
-	llvm_ir_builder.CreateCondBr(match_res, found_block, next_iteration_block);
+	// Call match function. It returns match end or null.
+	const auto match_end=
+		CreateNodeCall(
+			llvm_ir_builder,
+			state_ptr,
+			llvm_ir_builder.CreateGEP(char_type_, str_begin_value, current_start_offset),
+			str_end_value,
+			regex_graph.root);
+	match_end->setName("match_end");
+	llvm_ir_builder.CreateCondBr(llvm_ir_builder.CreateIsNull(match_end), next_iteration_block, found_block);
 
 	// Go to next iteration.
 	llvm_ir_builder.SetInsertPoint(next_iteration_block);
@@ -380,11 +871,7 @@ void Generator::GenerateMatcherFunction(const RegexGraphBuildResult& regex_graph
 		if(group_number == 0)
 		{
 			group_offset_begin= current_start_offset;
-
-			const auto current_str_pos_ptr= llvm_ir_builder.CreateGEP(state_type_, state_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(StateFieldIndex::StrBegin)});
-			const auto current_str_pos= llvm_ir_builder.CreateLoad(char_type_ptr_, current_str_pos_ptr);
-
-			group_offset_end= llvm_ir_builder.CreatePtrDiff(char_type_, current_str_pos, arg_str_begin);
+			group_offset_end= llvm_ir_builder.CreatePtrDiff(char_type_, match_end, str_begin_value);
 		}
 		else if(const auto field_number_it= group_number_to_field_number_.find(group_number); field_number_it != group_number_to_field_number_.end())
 		{
@@ -401,8 +888,8 @@ void Generator::GenerateMatcherFunction(const RegexGraphBuildResult& regex_graph
 			const auto src_group_begin= llvm_ir_builder.CreateLoad(char_type_ptr_, llvm_ir_builder.CreateGEP(group_type_, src_group_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(0)}));
 			const auto src_group_end  = llvm_ir_builder.CreateLoad(char_type_ptr_, llvm_ir_builder.CreateGEP(group_type_, src_group_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(1)}));
 
-			group_offset_begin= llvm_ir_builder.CreatePtrDiff(char_type_, src_group_begin, arg_str_begin);
-			group_offset_end  = llvm_ir_builder.CreatePtrDiff(char_type_, src_group_end  , arg_str_begin);
+			group_offset_begin= llvm_ir_builder.CreatePtrDiff(char_type_, src_group_begin, str_begin_value);
+			group_offset_end  = llvm_ir_builder.CreatePtrDiff(char_type_, src_group_end  , str_begin_value);
 		}
 		else
 		{
@@ -421,28 +908,148 @@ void Generator::GenerateMatcherFunction(const RegexGraphBuildResult& regex_graph
 	llvm_ir_builder.SetInsertPoint(end_block);
 	llvm_ir_builder.CreateRet(GetConstant(ptr_size_int_type_, regex_graph.group_stats.size()));
 
-	// Clear internal structures.
-	state_type_= nullptr;
-	node_function_type_= nullptr;
-	subroutine_call_return_chain_node_type_= nullptr;
-	subroutine_call_state_save_chain_node_type_= nullptr;
-	sequence_id_to_counter_filed_number_.clear();
-	group_number_to_field_number_.clear();
-	node_functions_.clear();
+	ClearInternalStructures();
+}
+
+void Generator::GenerateMatchesCounterFunction(const RegexGraphBuildResult& regex_graph, const std::string& function_name)
+{
+	CreateStateType(regex_graph);
+
+	// Counter function look like this:
+	// size_t CountMatches(const char* begin, size_t size);
+	// It returns number of non-overlapping matches. Search is continued from the end of previous match, or from next code point after empty match.
+	// Groups are never extracted here.
+
+	const auto counter_function_type=
+		llvm::FunctionType::get(
+			ptr_size_int_type_,
+			{
+				char_type_ptr_,
+				ptr_size_int_type_,
+			},
+			false);
+
+	const auto counter_function= llvm::Function::Create(counter_function_type, llvm::GlobalValue::ExternalLinkage, function_name, module_);
+
+	const auto arg_str_begin= &*counter_function->arg_begin();
+	const auto arg_str_size= &*std::next(counter_function->arg_begin());
+	arg_str_begin->setName("arg_str_begin");
+	arg_str_size->setName("str_size");
+
+	const auto start_basic_block= llvm::BasicBlock::Create(context_, "init", counter_function);
+	const auto search_loop_block= llvm::BasicBlock::Create(context_, "search_loop", counter_function);
+	const auto found_block= llvm::BasicBlock::Create(context_, "found", counter_function);
+	const auto empty_match_block= llvm::BasicBlock::Create(context_, "empty_match", counter_function);
+	const auto next_iteration_block= llvm::BasicBlock::Create(context_, "next_iteration", counter_function);
+	const auto end_block= llvm::BasicBlock::Create(context_, "end", counter_function);
+
+	IRBuilder llvm_ir_builder(start_basic_block);
+
+	const auto state_ptr= llvm_ir_builder.CreateAlloca(state_type_, 0, "state");
+
+	const auto str_begin_value= CreateNonNullStrBegin(llvm_ir_builder, arg_str_begin);
+	const auto str_end_value= llvm_ir_builder.CreateGEP(char_type_, str_begin_value, arg_str_size, "str_end");
+	InitStateConstantFields(llvm_ir_builder, state_ptr, str_begin_value);
+	if(NeedsInputValidation())
+	{
+		// No matches in invalid input.
+		const auto invalid_input_block= llvm::BasicBlock::Create(context_, "invalid_input", counter_function);
+		const auto is_valid= llvm_ir_builder.CreateCall(GetOrCreateUtf8ValidationFunction(), {str_begin_value, str_end_value}, "is_valid");
+		llvm_ir_builder.CreateCondBr(is_valid, search_loop_block, invalid_input_block);
+
+		llvm_ir_builder.SetInsertPoint(invalid_input_block);
+		llvm_ir_builder.CreateRet(GetConstant(ptr_size_int_type_, 0));
+	}
+	else
+		llvm_ir_builder.CreateBr(search_loop_block);
+
+	// Search loop block.
+	llvm_ir_builder.SetInsertPoint(search_loop_block);
+	const auto current_start_offset= llvm_ir_builder.CreatePHI(ptr_size_int_type_, 2, "current_start_offset");
+	current_start_offset->addIncoming(GetConstant(ptr_size_int_type_, 0), start_basic_block);
+	const auto current_count= llvm_ir_builder.CreatePHI(ptr_size_int_type_, 2, "current_count");
+	current_count->addIncoming(GetConstant(ptr_size_int_type_, 0), start_basic_block);
+
+	InitStateNonConstantFields(llvm_ir_builder, state_ptr, str_end_value);
+
+	const auto offset_plus_one= llvm_ir_builder.CreateAdd(current_start_offset, GetConstant(ptr_size_int_type_, 1), "offset_plus_one", no_unsiged_wrap);
+
+	const auto match_end=
+		CreateNodeCall(
+			llvm_ir_builder,
+			state_ptr,
+			llvm_ir_builder.CreateGEP(char_type_, str_begin_value, current_start_offset),
+			str_end_value,
+			regex_graph.root);
+	match_end->setName("match_end");
+	llvm_ir_builder.CreateCondBr(llvm_ir_builder.CreateIsNull(match_end), next_iteration_block, found_block);
+
+	// Found block.
+	llvm_ir_builder.SetInsertPoint(found_block);
+	const auto count_next= llvm_ir_builder.CreateAdd(current_count, GetConstant(ptr_size_int_type_, 1), "count_next", no_unsiged_wrap);
+
+	// Continue from match end, but avoid looping on empty match.
+	const auto match_end_offset= llvm_ir_builder.CreatePtrDiff(char_type_, match_end, str_begin_value, "match_end_offset");
+	const auto match_is_empty= llvm_ir_builder.CreateICmpEQ(match_end_offset, current_start_offset, "match_is_empty");
+	llvm_ir_builder.CreateCondBr(match_is_empty, empty_match_block, next_iteration_block);
+
+	// Empty match block. Continue from next code point, not from the middle of current code point.
+	llvm_ir_builder.SetInsertPoint(empty_match_block);
+	const auto offset_after_empty_match= CreateNextCodePointOffset(llvm_ir_builder, str_begin_value, arg_str_size, current_start_offset);
+	const auto empty_match_end_block= llvm_ir_builder.GetInsertBlock();
+	llvm_ir_builder.CreateBr(next_iteration_block);
+
+	// Next iteration block.
+	llvm_ir_builder.SetInsertPoint(next_iteration_block);
+	const auto count_for_next_iteration= llvm_ir_builder.CreatePHI(ptr_size_int_type_, 3, "count_for_next_iteration");
+	count_for_next_iteration->addIncoming(current_count, search_loop_block);
+	count_for_next_iteration->addIncoming(count_next, found_block);
+	count_for_next_iteration->addIncoming(count_next, empty_match_end_block);
+
+	const auto next_start_offset= llvm_ir_builder.CreatePHI(ptr_size_int_type_, 3, "next_start_offset");
+	next_start_offset->addIncoming(offset_plus_one, search_loop_block);
+	next_start_offset->addIncoming(match_end_offset, found_block);
+	next_start_offset->addIncoming(offset_after_empty_match, empty_match_end_block);
+
+	current_start_offset->addIncoming(next_start_offset, next_iteration_block);
+	current_count->addIncoming(count_for_next_iteration, next_iteration_block);
+
+	if(std::get_if<GraphElements::StringStartAssertion>(regex_graph.root) != nullptr)
+		llvm_ir_builder.CreateBr(end_block); // Only one match is possible in case if first regex element is string start assertion.
+	else
+	{
+		// Check also position at string end, because empty match is possible here.
+		const auto string_end_condition= llvm_ir_builder.CreateICmpULE(next_start_offset, arg_str_size);
+		llvm_ir_builder.CreateCondBr(string_end_condition, search_loop_block, end_block);
+	}
+
+	// End block.
+	llvm_ir_builder.SetInsertPoint(end_block);
+	llvm_ir_builder.CreateRet(count_for_next_iteration);
+
+	ClearInternalStructures();
 }
 
 void Generator::CreateStateType(const RegexGraphBuildResult& regex_graph)
 {
+	// Subroutine calls require separate function for each return point, so, single function mode is not possible for them.
+	single_function_mode_= regex_graph.options.single_function && regex_graph.group_stats.at(0).internal_calls.empty();
+
 	state_type_= llvm::StructType::create(context_, "State");
+	state_fields_liveness_= AnalyzeStateFieldsLiveness(regex_graph);
 
 	// All match node functions looks like this:
-	// bool MatchNode0123(State& state);
-	node_function_type_= llvm::FunctionType::get(llvm::Type::getInt1Ty(context_), {llvm::PointerType::get(state_type_, 0)}, false);
+	// const char* MatchNode0123(State& state, const char* str_begin, const char* str_end);
+	// Current position is passed via arguments, only backtracking-relevant data is stored in state.
+	// Result is end of whole match or null if match failed.
+	node_function_type_=
+		llvm::FunctionType::get(
+			char_type_ptr_,
+			{llvm::PointerType::get(state_type_, 0), char_type_ptr_, char_type_ptr_},
+			false);
 
 	llvm::SmallVector<llvm::Type*, 6> members;
 
-	members.push_back(char_type_ptr_); // StrBegin
-	members.push_back(char_type_ptr_); // StrEnd
 	members.push_back(char_type_ptr_); // StrBeginInitial
 
 	const GroupStat& regex_stat= regex_graph.group_stats.at(0);
@@ -489,17 +1096,349 @@ void Generator::CreateStateType(const RegexGraphBuildResult& regex_graph)
 	}
 
 	state_type_->setBody(members);
-}
 
-llvm::Function* Generator::GetOrCreateNodeFunction(const GraphElements::NodePtr node)
-{
-	if(const auto it= node_functions_.find(node); it != node_functions_.end())
-		return it->second;
+	if(single_function_mode_)
+	{
+		continuation_frame_type_= llvm::StructType::create(context_, "ContinuationFrame");
+
+		llvm::Type* const elements[]
+		{
+			llvm::Type::getInt8PtrTy(context_),
+			llvm::PointerType::get(continuation_frame_type_, 0),
+			llvm::Type::getInt32Ty(context_),
+			char_type_ptr_,
+			state_type_,
+		};
+		continuation_frame_type_->setBody(elements);
+	}
+}
+
+void Generator::ClearInternalStructures()
+{
+	state_type_= nullptr;
+	node_function_type_= nullptr;
+	subroutine_call_return_chain_node_type_= nullptr;
+	subroutine_call_state_save_chain_node_type_= nullptr;
+	continuation_frame_type_= nullptr;
+	single_function_mode_= false;
+	state_fields_liveness_= StateFieldsLiveness();
+	sequence_id_to_counter_filed_number_.clear();
+	group_number_to_field_number_.clear();
+	node_functions_.clear();
+}
+
+bool Generator::NeedsInputValidation() const
+{
+	return encoding_ == Encoding::UTF8 && utf8_validation_ == Utf8Validation::OnceAtEntry;
+}
+
+llvm::Function* Generator::GetOrCreateUtf8ValidationFunction()
+{
+	const std::string function_name= "validate_utf8";
+	if(const auto prev_function= module_.getFunction(function_name))
+		return prev_function;
+
+	const auto bool_type= llvm::Type::getInt1Ty(context_);
+	const auto byte_type= llvm::Type::getInt8Ty(context_);
+	const auto function_type= llvm::FunctionType::get(bool_type, {char_type_ptr_, char_type_ptr_}, false);
+	const auto function= llvm::Function::Create(function_type, llvm::GlobalValue::PrivateLinkage, function_name, module_);
+
+	const auto arg_begin= &*function->arg_begin();
+	const auto arg_end= &*std::next(function->arg_begin());
+	arg_begin->setName("begin");
+	arg_end->setName("end");
+
+	const auto start_block= llvm::BasicBlock::Create(context_, "start", function);
+	const auto loop_block= llvm::BasicBlock::Create(context_, "loop", function);
+	const auto vector_check_block= llvm::BasicBlock::Create(context_, "vector_check", function);
+	const auto vector_next_block= llvm::BasicBlock::Create(context_, "vector_next", function);
+	const auto scalar_check_block= llvm::BasicBlock::Create(context_, "scalar_check", function);
+	const auto byte_check_block= llvm::BasicBlock::Create(context_, "byte_check", function);
+	const auto ascii_next_block= llvm::BasicBlock::Create(context_, "ascii_next", function);
+	const auto lead_byte_block= llvm::BasicBlock::Create(context_, "lead_byte", function);
+	const auto second_byte_block= llvm::BasicBlock::Create(context_, "second_byte", function);
+	const auto third_byte_block= llvm::BasicBlock::Create(context_, "third_byte", function);
+	const auto fourth_byte_block= llvm::BasicBlock::Create(context_, "fourth_byte", function);
+	const auto sequence_next_block= llvm::BasicBlock::Create(context_, "sequence_next", function);
+	const auto valid_block= llvm::BasicBlock::Create(context_, "valid", function);
+	const auto invalid_block= llvm::BasicBlock::Create(context_, "invalid", function);
+
+	IRBuilder llvm_ir_builder(start_block);
+	llvm_ir_builder.CreateBr(loop_block);
+
+	// Loop block.
+	llvm_ir_builder.SetInsertPoint(loop_block);
+	const auto pos= llvm_ir_builder.CreatePHI(char_type_ptr_, 4, "pos");
+	pos->addIncoming(arg_begin, start_block);
+	const auto remaining_size= llvm_ir_builder.CreatePtrDiff(char_type_, arg_end, pos, "remaining_size");
+
+	// Skip ASCII symbols using vector checks.
+	const uint32_t vector_size= 16;
+	llvm_ir_builder.CreateCondBr(
+		llvm_ir_builder.CreateICmpUGE(remaining_size, GetConstant(ptr_size_int_type_, vector_size)),
+		vector_check_block,
+		scalar_check_block);
+
+	// Vector check block.
+	llvm_ir_builder.SetInsertPoint(vector_check_block);
+	const auto vector_type= llvm::FixedVectorType::get(byte_type, vector_size);
+	const auto vector_value=
+		llvm_ir_builder.CreateAlignedLoad(
+			vector_type,
+			llvm_ir_builder.CreateBitCast(pos, llvm::PointerType::get(vector_type, 0)),
+			llvm::MaybeAlign(1),
+			"vector_value");
+	const auto vector_bits= llvm_ir_builder.CreateOrReduce(vector_value);
+	const auto vector_is_ascii=
+		llvm_ir_builder.CreateICmpEQ(
+			llvm_ir_builder.CreateAnd(vector_bits, GetConstant(byte_type, 0x80)),
+			GetConstant(byte_type, 0));
+	llvm_ir_builder.CreateCondBr(vector_is_ascii, vector_next_block, scalar_check_block);
+
+	// Vector next block.
+	llvm_ir_builder.SetInsertPoint(vector_next_block);
+	const auto pos_vector_next= llvm_ir_builder.CreateGEP(char_type_, pos, GetFieldGEPIndex(vector_size));
+	pos->addIncoming(pos_vector_next, vector_next_block);
+	llvm_ir_builder.CreateBr(loop_block);
+
+	// Scalar check block.
+	llvm_ir_builder.SetInsertPoint(scalar_check_block);
+	llvm_ir_builder.CreateCondBr(llvm_ir_builder.CreateICmpEQ(pos, arg_end), valid_block, byte_check_block);
+
+	// Byte check block.
+	llvm_ir_builder.SetInsertPoint(byte_check_block);
+	const auto b0= llvm_ir_builder.CreateLoad(byte_type, pos, "b0");
+	llvm_ir_builder.CreateCondBr(llvm_ir_builder.CreateICmpULT(b0, GetConstant(byte_type, 0x80)), ascii_next_block, lead_byte_block);
+
+	// ASCII next block.
+	llvm_ir_builder.SetInsertPoint(ascii_next_block);
+	const auto pos_ascii_next= llvm_ir_builder.CreateGEP(char_type_, pos, GetFieldGEPIndex(1));
+	pos->addIncoming(pos_ascii_next, ascii_next_block);
+	llvm_ir_builder.CreateBr(loop_block);
+
+	// Lead byte block. Valid lead bytes are 0xC2-0xF4.
+	llvm_ir_builder.SetInsertPoint(lead_byte_block);
+	const auto is_valid_lead_byte=
+		llvm_ir_builder.CreateAnd(
+			llvm_ir_builder.CreateICmpUGE(b0, GetConstant(byte_type, 0xC2)),
+			llvm_ir_builder.CreateICmpULE(b0, GetConstant(byte_type, 0xF4)));
+	const auto sequence_size=
+		llvm_ir_builder.CreateSelect(
+			llvm_ir_builder.CreateICmpULT(b0, GetConstant(byte_type, 0xE0)),
+			GetConstant(ptr_size_int_type_, 2),
+			llvm_ir_builder.CreateSelect(
+				llvm_ir_builder.CreateICmpULT(b0, GetConstant(byte_type, 0xF0)),
+				GetConstant(ptr_size_int_type_, 3),
+				GetConstant(ptr_size_int_type_, 4)),
+			"sequence_size");
+	const auto is_enough_data= llvm_ir_builder.CreateICmpULE(sequence_size, remaining_size);
+	llvm_ir_builder.CreateCondBr(llvm_ir_builder.CreateAnd(is_valid_lead_byte, is_enough_data), second_byte_block, invalid_block);
+
+	// Second byte block. Range of second byte depends on lead byte - overlong sequences, surrogates and code points above 0x10FFFF are invalid.
+	llvm_ir_builder.SetInsertPoint(second_byte_block);
+	const auto b1= llvm_ir_builder.CreateLoad(byte_type, llvm_ir_builder.CreateGEP(char_type_, pos, GetFieldGEPIndex(1)), "b1");
+	const auto b1_min=
+		llvm_ir_builder.CreateSelect(
+			llvm_ir_builder.CreateICmpEQ(b0, GetConstant(byte_type, 0xE0)),
+			GetConstant(byte_type, 0xA0),
+			llvm_ir_builder.CreateSelect(
+				llvm_ir_builder.CreateICmpEQ(b0, GetConstant(byte_type, 0xF0)),
+				GetConstant(byte_type, 0x90),
+				GetConstant(byte_type, 0x80)));
+	const auto b1_max=
+		llvm_ir_builder.CreateSelect(
+			llvm_ir_builder.CreateICmpEQ(b0, GetConstant(byte_type, 0xED)),
+			GetConstant(byte_type, 0x9F),
+			llvm_ir_builder.CreateSelect(
+				llvm_ir_builder.CreateICmpEQ(b0, GetConstant(byte_type, 0xF4)),
+				GetConstant(byte_type, 0x8F),
+				GetConstant(byte_type, 0xBF)));
+	const auto b1_is_valid=
+		llvm_ir_builder.CreateAnd(
+			llvm_ir_builder.CreateICmpUGE(b1, b1_min),
+			llvm_ir_builder.CreateICmpULE(b1, b1_max));
+	const auto sequence_end_after_b1= llvm_ir_builder.CreateICmpEQ(sequence_size, GetConstant(ptr_size_int_type_, 2));
+	const auto after_b1_block= llvm::BasicBlock::Create(context_, "after_b1", function, third_byte_block);
+	llvm_ir_builder.CreateCondBr(b1_is_valid, after_b1_block, invalid_block);
+	llvm_ir_builder.SetInsertPoint(after_b1_block);
+	llvm_ir_builder.CreateCondBr(sequence_end_after_b1, sequence_next_block, third_byte_block);
+
+	// Third and fourth bytes are just continuation bytes.
+	const auto create_continuation_byte_check=
+	[&](llvm::BasicBlock* const block, const uint32_t index, llvm::BasicBlock* const next_block)
+	{
+		llvm_ir_builder.SetInsertPoint(block);
+		const auto b= llvm_ir_builder.CreateLoad(byte_type, llvm_ir_builder.CreateGEP(char_type_, pos, GetFieldGEPIndex(index)));
+		const auto is_continuation=
+			llvm_ir_builder.CreateICmpEQ(
+				llvm_ir_builder.CreateAnd(b, GetConstant(byte_type, 0b11000000)),
+				GetConstant(byte_type, 0b10000000));
+		llvm_ir_builder.CreateCondBr(is_continuation, next_block, invalid_block);
+	};
+
+	const auto after_b2_block= llvm::BasicBlock::Create(context_, "after_b2", function, fourth_byte_block);
+	create_continuation_byte_check(third_byte_block, 2, after_b2_block);
+	llvm_ir_builder.SetInsertPoint(after_b2_block);
+	llvm_ir_builder.CreateCondBr(
+		llvm_ir_builder.CreateICmpEQ(sequence_size, GetConstant(ptr_size_int_type_, 3)),
+		sequence_next_block,
+		fourth_byte_block);
+
+	create_continuation_byte_check(fourth_byte_block, 3, sequence_next_block);
+
+	// Sequence next block.
+	llvm_ir_builder.SetInsertPoint(sequence_next_block);
+	const auto pos_sequence_next= llvm_ir_builder.CreateGEP(char_type_, pos, sequence_size);
+	pos->addIncoming(pos_sequence_next, sequence_next_block);
+	llvm_ir_builder.CreateBr(loop_block);
+
+	// Result blocks.
+	llvm_ir_builder.SetInsertPoint(valid_block);
+	llvm_ir_builder.CreateRet(llvm::ConstantInt::getTrue(context_));
+
+	llvm_ir_builder.SetInsertPoint(invalid_block);
+	llvm_ir_builder.CreateRet(llvm::ConstantInt::getFalse(context_));
+
+	return function;
+}
+
+void Generator::InitStateConstantFields(IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, llvm::Value* const str_begin)
+{
+	// Set begin pointer. Current position and end pointer are passed via node function arguments.
+	const auto str_begin_initial_ptr= llvm_ir_builder.CreateGEP(state_type_, state_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(StateFieldIndex::StrBeginInitial)});
+	llvm_ir_builder.CreateStore(str_begin, str_begin_initial_ptr);
+}
+
+void Generator::InitStateNonConstantFields(IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, llvm::Value* const str_end)
+{
+	{
+		// Zero groups.
+		const uint64_t groups_array_size= state_type_->elements()[StateFieldIndex::GroupsArray]->getArrayNumElements();
+		for(uint64_t i= 0; i < groups_array_size; ++i)
+		{
+			const auto group_ptr=
+				llvm_ir_builder.CreateGEP(
+					state_type_,
+					state_ptr,
+					{
+						GetZeroGEPIndex(),
+						GetFieldGEPIndex(StateFieldIndex::GroupsArray),
+						GetFieldGEPIndex(uint32_t(i)),
+					});
+
+			const auto group_begin_ptr= llvm_ir_builder.CreateGEP(group_type_, group_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(0)});
+			const auto group_end_ptr  = llvm_ir_builder.CreateGEP(group_type_, group_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(1)});
+
+			llvm_ir_builder.CreateStore(str_end, group_begin_ptr);
+			llvm_ir_builder.CreateStore(str_end, group_end_ptr  );
+		}
+	}
+	if(state_type_->getNumElements() > StateFieldIndex::SubroutineCallReturnChainHead)
+	{
+		// Zero subroutine call return chain head.
+		const auto ptr= llvm_ir_builder.CreateGEP(state_type_, state_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(StateFieldIndex::SubroutineCallReturnChainHead)});
+		const auto null= llvm::Constant::getNullValue(llvm::PointerType::get(subroutine_call_return_chain_node_type_, 0));
+		llvm_ir_builder.CreateStore(null, ptr);
+	}
+	if(state_type_->getNumElements() > StateFieldIndex::SubroutineCallStateSaveChainHead)
+	{
+		// Zero subroutine call state save chain head.
+		const auto ptr= llvm_ir_builder.CreateGEP(state_type_, state_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(StateFieldIndex::SubroutineCallStateSaveChainHead)});
+		const auto null= llvm::Constant::getNullValue(llvm::PointerType::get(subroutine_call_state_save_chain_node_type_, 0));
+		llvm_ir_builder.CreateStore(null, ptr);
+	}
+}
+
+llvm::Value* Generator::CreateNonNullStrBegin(IRBuilder& llvm_ir_builder, llvm::Value* const str_begin)
+{
+	// Use separate global for each code unit size, since several functions with different encodings may be generated in the same module.
+	const std::string global_name= "empty_string_" + std::to_string(char_type_->getBitWidth());
+	llvm::GlobalVariable* empty_string= module_.getGlobalVariable(global_name, true);
+	if(empty_string == nullptr)
+	{
+		empty_string=
+			new llvm::GlobalVariable(
+				module_,
+				char_type_,
+				true,
+				llvm::GlobalValue::PrivateLinkage,
+				llvm::Constant::getNullValue(char_type_),
+				global_name);
+		empty_string->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+	}
+
+	return llvm_ir_builder.CreateSelect(llvm_ir_builder.CreateIsNull(str_begin), empty_string, str_begin, "str_begin");
+}
+
+llvm::Value* Generator::CreateNextCodePointOffset(
+	IRBuilder& llvm_ir_builder,
+	llvm::Value* const str_begin,
+	llvm::Value* const str_size,
+	llvm::Value* const offset)
+{
+	const auto offset_plus_one= llvm_ir_builder.CreateAdd(offset, GetConstant(ptr_size_int_type_, 1), "offset_plus_one", no_unsiged_wrap);
+
+	uint32_t continuation_mask= 0, continuation_value= 0;
+	switch(encoding_)
+	{
+	case Encoding::UTF8:
+		continuation_mask= 0b11000000;
+		continuation_value= 0b10000000;
+		break;
+	case Encoding::UTF16:
+		continuation_mask= 0xFC00;
+		continuation_value= 0xDC00;
+		break;
+	case Encoding::UTF32:
+	case Encoding::Bytes:
+		// Code unit is code point.
+		return offset_plus_one;
+	};
+
+	const auto function= llvm_ir_builder.GetInsertBlock()->getParent();
+	const auto start_block= llvm_ir_builder.GetInsertBlock();
+	const auto loop_block= llvm::BasicBlock::Create(context_, "skip_continuation_loop", function);
+	const auto check_block= llvm::BasicBlock::Create(context_, "skip_continuation_check", function);
+	const auto end_block= llvm::BasicBlock::Create(context_, "skip_continuation_end", function);
+
+	llvm_ir_builder.CreateBr(loop_block);
+
+	// Loop block.
+	llvm_ir_builder.SetInsertPoint(loop_block);
+	const auto current_offset= llvm_ir_builder.CreatePHI(ptr_size_int_type_, 2, "current_offset");
+	current_offset->addIncoming(offset_plus_one, start_block);
+	llvm_ir_builder.CreateCondBr(llvm_ir_builder.CreateICmpULT(current_offset, str_size), check_block, end_block);
+
+	// Check block.
+	llvm_ir_builder.SetInsertPoint(check_block);
+	const auto code_unit= llvm_ir_builder.CreateLoad(char_type_, llvm_ir_builder.CreateGEP(char_type_, str_begin, current_offset), "code_unit");
+	const auto is_continuation=
+		llvm_ir_builder.CreateICmpEQ(
+			llvm_ir_builder.CreateAnd(code_unit, GetConstant(char_type_, continuation_mask)),
+			GetConstant(char_type_, continuation_value),
+			"is_continuation");
+	current_offset->addIncoming(
+		llvm_ir_builder.CreateAdd(current_offset, GetConstant(ptr_size_int_type_, 1), "current_offset_next", no_unsiged_wrap),
+		check_block);
+	llvm_ir_builder.CreateCondBr(is_continuation, loop_block, end_block);
+
+	// End block.
+	llvm_ir_builder.SetInsertPoint(end_block);
+	return current_offset;
+}
+
+llvm::Function* Generator::GetOrCreateNodeFunction(const GraphElements::NodePtr node)
+{
+	if(const auto it= node_functions_.find(node); it != node_functions_.end())
+		return it->second;
 
 	// Use private linkage for all node functions to avoid possible name conflicts.
 	const auto function= llvm::Function::Create(node_function_type_, llvm::GlobalValue::PrivateLinkage, GetNodeName(node), module_);
 	node_functions_.emplace(node, function);
-	BuildNodeFunctionBody(node, function);
+	if(single_function_mode_)
+		BuildSingleFunctionBody(node, function);
+	else
+		BuildNodeFunctionBody(node, function);
 	return function;
 }
 
@@ -508,47 +1447,162 @@ void Generator::BuildNodeFunctionBody(const GraphElements::NodePtr node, llvm::F
 	const auto basic_block= llvm::BasicBlock::Create(context_, "", function);
 	IRBuilder llvm_ir_builder(basic_block);
 
+	const auto state_ptr= &*function->arg_begin();
+	state_ptr->setName("state");
+	const auto str_begin_value= &*std::next(function->arg_begin(), 1);
+	str_begin_value->setName("str_begin");
+	const auto str_end_value= &*std::next(function->arg_begin(), 2);
+	str_end_value->setName("str_end");
+
 	if(node == nullptr)
 	{
-		// for end node create "return true" function.
-		llvm_ir_builder.CreateRet(llvm::ConstantInt::getTrue(context_));
+		// For end node create function, that returns current position as match end.
+		llvm_ir_builder.CreateRet(str_begin_value);
 		return;
 	}
 
+	std::visit([&](const auto& el){ BuildNodeFunctionBodyImpl(llvm_ir_builder, state_ptr, str_begin_value, str_end_value, el); }, *node);
+}
+
+void Generator::BuildSingleFunctionBody(const GraphElements::NodePtr node, llvm::Function* const function)
+{
+	// This function may be called recursively - for look graph, sequence element, etc.
+	SingleFunctionData function_data;
+	function_data.function= function;
+	SingleFunctionData* const prev_function_data= single_function_data_;
+	single_function_data_= &function_data;
+
 	const auto state_ptr= &*function->arg_begin();
 	state_ptr->setName("state");
+	const auto str_begin_value= &*std::next(function->arg_begin(), 1);
+	str_begin_value->setName("str_begin");
+	const auto str_end_value= &*std::next(function->arg_begin(), 2);
+	str_end_value->setName("str_end");
+
+	const auto start_block= llvm::BasicBlock::Create(context_, "", function);
+	IRBuilder llvm_ir_builder(start_block);
+
+	// Backtracking stack is a list of frames, allocated on native stack. Initially it is empty.
+	const auto continuation_frame_ptr_type= llvm::PointerType::get(continuation_frame_type_, 0);
+	function_data.continuation_head_ptr= llvm_ir_builder.CreateAlloca(continuation_frame_ptr_type, 0, "continuation_head");
+	llvm_ir_builder.CreateStore(llvm::Constant::getNullValue(continuation_frame_ptr_type), function_data.continuation_head_ptr);
+
+	function_data.backtrack_block= llvm::BasicBlock::Create(context_, "backtrack");
+
+	const auto root_block= GetOrCreateNodeBlock(node);
+	root_block.second->addIncoming(str_begin_value, start_block);
+	llvm_ir_builder.CreateBr(root_block.first);
+
+	while(!function_data.nodes_to_build.empty())
+	{
+		const GraphElements::NodePtr current_node= function_data.nodes_to_build.back();
+		function_data.nodes_to_build.pop_back();
+
+		const SingleFunctionData::BlockWithPosition block= function_data.node_blocks.at(current_node);
+		llvm_ir_builder.SetInsertPoint(block.first);
+
+		if(current_node == nullptr)
+		{
+			// End node - return current position as match end. Remaining backtracking stack frames are just discarded.
+			llvm_ir_builder.CreateRet(block.second);
+			continue;
+		}
+
+		std::visit([&](const auto& el){ BuildNodeFunctionBodyImpl(llvm_ir_builder, state_ptr, block.second, str_end_value, el); }, *current_node);
+	}
+
+	// Backtrack block - pop top frame and continue from its resume point or return null if stack is empty.
+	function_data.backtrack_block->insertInto(function);
+	llvm_ir_builder.SetInsertPoint(function_data.backtrack_block);
+	if(function_data.resume_points.empty())
+		llvm_ir_builder.CreateRet(GetNullStrPtr());
+	else
+	{
+		const auto pop_block= llvm::BasicBlock::Create(context_, "pop", function);
+		const auto fail_block= llvm::BasicBlock::Create(context_, "fail", function);
+		const auto unreachable_block= llvm::BasicBlock::Create(context_, "unreachable", function);
+
+		const auto frame= llvm_ir_builder.CreateLoad(continuation_frame_ptr_type, function_data.continuation_head_ptr, "frame");
+		llvm_ir_builder.CreateCondBr(llvm_ir_builder.CreateIsNull(frame), fail_block, pop_block);
+
+		// Fail block.
+		llvm_ir_builder.SetInsertPoint(fail_block);
+		llvm_ir_builder.CreateRet(GetNullStrPtr());
+
+		// Pop block.
+		llvm_ir_builder.SetInsertPoint(pop_block);
+
+		const auto get_frame_field_ptr=
+		[&](const uint32_t field_index)
+		{
+			return llvm_ir_builder.CreateGEP(continuation_frame_type_, frame, {GetZeroGEPIndex(), GetFieldGEPIndex(field_index)});
+		};
+
+		const auto resume_point= llvm_ir_builder.CreateLoad(llvm::Type::getInt32Ty(context_), get_frame_field_ptr(ContinuationFrameFieldIndex::ResumePoint), "resume_point");
+		const auto resumed_str_begin= llvm_ir_builder.CreateLoad(char_type_ptr_, get_frame_field_ptr(ContinuationFrameFieldIndex::StrBegin), "resumed_str_begin");
+		const auto stack_pointer= llvm_ir_builder.CreateLoad(llvm::Type::getInt8PtrTy(context_), get_frame_field_ptr(ContinuationFrameFieldIndex::StackPointer), "stack_pointer");
+		const auto frame_state_ptr= get_frame_field_ptr(ContinuationFrameFieldIndex::State);
+
+		const auto prev_frame= llvm_ir_builder.CreateLoad(continuation_frame_ptr_type, get_frame_field_ptr(ContinuationFrameFieldIndex::Prev), "prev_frame");
+		llvm_ir_builder.CreateStore(prev_frame, function_data.continuation_head_ptr);
+
+		const auto resume_switch= llvm_ir_builder.CreateSwitch(resume_point, unreachable_block, uint32_t(function_data.resume_points.size()));
+		for(size_t i= 0; i < function_data.resume_points.size(); ++i)
+		{
+			const SingleFunctionData::ResumePoint& point= function_data.resume_points[i];
+			resume_switch->addCase(llvm::ConstantInt::get(llvm::Type::getInt32Ty(context_), uint64_t(i)), point.block.first);
+			point.block.second->addIncoming(resumed_str_begin, pop_block);
+
+			// Restore state fields, saved for this point, at start of resume block, then free frame memory. Frame data should not be accessed after this.
+			IRBuilder resume_block_builder(point.block.first, point.block.first->getFirstInsertionPt());
+			RestoreState(resume_block_builder, state_ptr, frame_state_ptr, point.fields_to_restore);
+			resume_block_builder.CreateIntrinsic(llvm::Intrinsic::stackrestore, {}, {stack_pointer});
+		}
+
+		// Unreachable block.
+		llvm_ir_builder.SetInsertPoint(unreachable_block);
+		llvm_ir_builder.CreateUnreachable();
+	}
+
+	single_function_data_= prev_function_data;
+}
+
+SingleFunctionData::BlockWithPosition Generator::GetOrCreateNodeBlock(const GraphElements::NodePtr node)
+{
+	SingleFunctionData& function_data= *single_function_data_;
+	if(const auto it= function_data.node_blocks.find(node); it != function_data.node_blocks.end())
+		return it->second;
 
-	std::visit([&](const auto& el){ BuildNodeFunctionBodyImpl(llvm_ir_builder, state_ptr, el); }, *node);
+	const auto block= llvm::BasicBlock::Create(context_, GetNodeName(node), function_data.function);
+	const auto str_begin= llvm::PHINode::Create(char_type_ptr_, 1, "str_begin", block);
+
+	const SingleFunctionData::BlockWithPosition result(block, str_begin);
+	function_data.node_blocks.emplace(node, result);
+	function_data.nodes_to_build.push_back(node);
+	return result;
 }
 
 void Generator::BuildNodeFunctionBodyImpl(
-	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, const GraphElements::AnySymbol& node)
+	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, llvm::Value* const str_begin_value, llvm::Value* const str_end_value, const GraphElements::AnySymbol& node)
 {
 	GraphElements::OneOf one_of;
 	one_of.next= node.next;
 	one_of.inverse_flag= true;
-	BuildNodeFunctionBodyImpl(llvm_ir_builder, state_ptr, one_of);
+	BuildNodeFunctionBodyImpl(llvm_ir_builder, state_ptr, str_begin_value, str_end_value, one_of);
 }
 
 void Generator::BuildNodeFunctionBodyImpl(
-	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, const GraphElements::SpecificSymbol& node)
+	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, llvm::Value* const str_begin_value, llvm::Value* const str_end_value, const GraphElements::SpecificSymbol& node)
 {
 	const auto function= llvm_ir_builder.GetInsertBlock()->getParent();
 
-	const auto str_begin_ptr= llvm_ir_builder.CreateGEP(state_type_, state_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(StateFieldIndex::StrBegin)});
-	const auto str_begin_value= llvm_ir_builder.CreateLoad(char_type_ptr_, str_begin_ptr);
-
-	const auto str_end_ptr= llvm_ir_builder.CreateGEP(state_type_, state_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(StateFieldIndex::StrEnd)});
-	const auto str_end_value= llvm_ir_builder.CreateLoad(char_type_ptr_, str_end_ptr);
-
 	const auto check_content_block= llvm::BasicBlock::Create(context_, "check_content", function);
 	const auto ok_block= llvm::BasicBlock::Create(context_, "ok", function);
 	const auto fail_block= llvm::BasicBlock::Create(context_, "fail", function);
 
-	char buff[UNI_MAX_UTF8_BYTES_PER_CODE_POINT+4];
-	char* buff_ptr= buff;
-	llvm::ConvertCodePointToUTF8(node.code, buff_ptr);
-	const auto char_size= uint32_t(buff_ptr - buff);
+	const CharType str_utf32[]{node.code, 0};
+	const std::vector<uint32_t> code_units= EncodeString(Utf32ToUtf8(str_utf32));
+	const auto char_size= uint32_t(code_units.size());
 
 	llvm::Value* next_str_begin_value= nullptr;
 	if(char_size == 1)
@@ -561,7 +1615,7 @@ void Generator::BuildNodeFunctionBodyImpl(
 		// Check content block.
 		llvm_ir_builder.SetInsertPoint(check_content_block);
 		const auto char_value= llvm_ir_builder.CreateLoad(char_type_, str_begin_value, "char_value");
-		const auto is_same_symbol= llvm_ir_builder.CreateICmpEQ(char_value, GetConstant(char_type_, node.code));
+		const auto is_same_symbol= llvm_ir_builder.CreateICmpEQ(char_value, GetConstant(char_type_, code_units[0]));
 		llvm_ir_builder.CreateCondBr(is_same_symbol, ok_block, fail_block);
 	}
 	else
@@ -579,7 +1633,7 @@ void Generator::BuildNodeFunctionBodyImpl(
 		{
 			const auto char_ptr= llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(i));
 			const auto char_value= llvm_ir_builder.CreateLoad(char_type_, char_ptr, "char_value");
-			const auto eq= llvm_ir_builder.CreateICmpEQ(char_value, GetConstant(char_type_, uint64_t(buff[i])), "eq");
+			const auto eq= llvm_ir_builder.CreateICmpEQ(char_value, GetConstant(char_type_, code_units[i]), "eq");
 			if(all_eq_value == nullptr)
 				all_eq_value = eq;
 			else
@@ -590,32 +1644,31 @@ void Generator::BuildNodeFunctionBodyImpl(
 
 	// Ok block.
 	llvm_ir_builder.SetInsertPoint(ok_block);
-	llvm_ir_builder.CreateStore(next_str_begin_value, str_begin_ptr);
-	CreateNextCallRet(llvm_ir_builder, state_ptr, node.next);
+	CreateNextCallRet(llvm_ir_builder, state_ptr, next_str_begin_value, str_end_value, node.next);
 
 	// Fail block
 	llvm_ir_builder.SetInsertPoint(fail_block);
-	llvm_ir_builder.CreateRet(llvm::ConstantInt::getFalse(context_));
+	CreateFailRet(llvm_ir_builder);
 }
 
 void Generator::BuildNodeFunctionBodyImpl(
-	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, const GraphElements::String& node)
+	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, llvm::Value* const str_begin_value, llvm::Value* const str_end_value, const GraphElements::String& node)
 {
-	const std::string& str_utf8= node.str;
-
-	const auto function= llvm_ir_builder.GetInsertBlock()->getParent();
+	if(node.case_insensitive)
+	{
+		BuildCaseInsensitiveStringCheck(llvm_ir_builder, state_ptr, str_begin_value, str_end_value, node);
+		return;
+	}
 
-	const auto str_begin_ptr= llvm_ir_builder.CreateGEP(state_type_, state_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(StateFieldIndex::StrBegin)});
-	const auto str_begin_value= llvm_ir_builder.CreateLoad(char_type_ptr_, str_begin_ptr, "str_begin_value");
+	const std::vector<uint32_t> code_units= EncodeString(node.str);
 
-	const auto str_end_ptr= llvm_ir_builder.CreateGEP(state_type_, state_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(StateFieldIndex::StrEnd)});
-	const auto str_end_value= llvm_ir_builder.CreateLoad(char_type_ptr_, str_end_ptr, "str_end_value");
+	const auto function= llvm_ir_builder.GetInsertBlock()->getParent();
 
-	const auto next_str_begin_value= llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(uint32_t(str_utf8.size())), "next_str_begin_value");
+	const auto next_str_begin_value= llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(uint32_t(code_units.size())), "next_str_begin_value");
 	const auto not_enough_condition= llvm_ir_builder.CreateICmpULE(next_str_begin_value, str_end_value);
 
 	const size_t c_loop_unroll_size= 16; // Constant optimal for 128-bit registers.
-	if(str_utf8.size() <= c_loop_unroll_size)
+	if(code_units.size() <= c_loop_unroll_size)
 	{
 		const auto check_content_block= llvm::BasicBlock::Create(context_, "check_content", function);
 		const auto ok_block= llvm::BasicBlock::Create(context_, "ok", function);
@@ -627,11 +1680,11 @@ void Generator::BuildNodeFunctionBodyImpl(
 		llvm_ir_builder.SetInsertPoint(check_content_block);
 
 		llvm::Value* all_eq_value= nullptr;
-		for(uint32_t i= 0; i < str_utf8.size(); ++i)
+		for(uint32_t i= 0; i < code_units.size(); ++i)
 		{
 			const auto char_ptr= llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(i));
 			const auto char_value= llvm_ir_builder.CreateLoad(char_type_, char_ptr, "char_value");
-			const auto eq= llvm_ir_builder.CreateICmpEQ(char_value, GetConstant(char_type_, uint64_t(str_utf8[i])), "eq");
+			const auto eq= llvm_ir_builder.CreateICmpEQ(char_value, GetConstant(char_type_, code_units[i]), "eq");
 			if(all_eq_value == nullptr)
 				all_eq_value = eq;
 			else
@@ -641,16 +1694,19 @@ void Generator::BuildNodeFunctionBodyImpl(
 
 		// Ok block.
 		llvm_ir_builder.SetInsertPoint(ok_block);
-		llvm_ir_builder.CreateStore(next_str_begin_value, str_begin_ptr);
-		CreateNextCallRet(llvm_ir_builder, state_ptr, node.next);
+		CreateNextCallRet(llvm_ir_builder, state_ptr, next_str_begin_value, str_end_value, node.next);
 
 		// Fail block
 		llvm_ir_builder.SetInsertPoint(fail_block);
-		llvm_ir_builder.CreateRet(llvm::ConstantInt::getFalse(context_));
+		CreateFailRet(llvm_ir_builder);
 	}
 	else
 	{
-		const auto constant_initializer= llvm::ConstantDataArray::getString(context_, str_utf8, false);
+		llvm::SmallVector<llvm::Constant*, 32> code_unit_constants;
+		for(const uint32_t code_unit : code_units)
+			code_unit_constants.push_back(GetConstant(char_type_, code_unit));
+
+		const auto constant_initializer= llvm::ConstantArray::get(llvm::ArrayType::get(char_type_, code_units.size()), code_unit_constants);
 		const auto constant_str_array=
 			new llvm::GlobalVariable(
 				module_,
@@ -659,6 +1715,8 @@ void Generator::BuildNodeFunctionBodyImpl(
 				llvm::GlobalValue::PrivateLinkage,
 				constant_initializer,
 				"string_literal");
+		// Address is not significant, allow merging of equal constants.
+		constant_str_array->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
 
 		const auto start_block= llvm_ir_builder.GetInsertBlock();
 		const auto loop_counter_check_block= llvm::BasicBlock::Create(context_, "loop_counter_check", function);
@@ -674,7 +1732,7 @@ void Generator::BuildNodeFunctionBodyImpl(
 		const auto loop_counter_current= llvm_ir_builder.CreatePHI(ptr_size_int_type_, 2, "loop_counter_current");
 		loop_counter_current->addIncoming(llvm::ConstantInt::getNullValue(ptr_size_int_type_), start_block);
 
-		const auto loop_end_condition= llvm_ir_builder.CreateICmpULT(loop_counter_current, GetConstant(ptr_size_int_type_, uint64_t(str_utf8.size())));
+		const auto loop_end_condition= llvm_ir_builder.CreateICmpULT(loop_counter_current, GetConstant(ptr_size_int_type_, uint64_t(code_units.size())));
 		llvm_ir_builder.CreateCondBr(loop_end_condition, loop_body_block, end_block);
 
 		// Loop body block.
@@ -701,378 +1759,498 @@ void Generator::BuildNodeFunctionBodyImpl(
 
 		// End block.
 		llvm_ir_builder.SetInsertPoint(end_block);
-		llvm_ir_builder.CreateStore(next_str_begin_value, str_begin_ptr);
-		CreateNextCallRet(llvm_ir_builder, state_ptr, node.next);
+		CreateNextCallRet(llvm_ir_builder, state_ptr, next_str_begin_value, str_end_value, node.next);
 
 		// Fail block.
 		llvm_ir_builder.SetInsertPoint(fail_block);
-		llvm_ir_builder.CreateRet(llvm::ConstantInt::getFalse(context_));
+		CreateFailRet(llvm_ir_builder);
 	}
 }
 
-void Generator::BuildNodeFunctionBodyImpl(
-	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, const GraphElements::OneOf& node)
+void Generator::BuildCaseInsensitiveStringCheck(
+	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, llvm::Value* const str_begin_value, llvm::Value* const str_end_value, const GraphElements::String& node)
 {
-	static const CharType c_bit_masks[9]=
+	// Code unit matches if (code_unit | mask) == value.
+	// Mask is non-zero if case variants differ only in single bit of single code unit - like ASCII letters, differing in 0x20 bit.
+	// Other letters are checked against both variants.
+	struct CodePointVariants
 	{
-		(1 << 0) - 1,
-		(1 << 1) - 1,
-		(1 << 2) - 1,
-		(1 << 3) - 1,
-		(1 << 4) - 1,
-		(1 << 5) - 1,
-		(1 << 6) - 1,
-		(1 << 7) - 1,
-		(1 << 8) - 1,
+		std::vector<uint32_t> values;
+		std::vector<uint32_t> masks;
+		std::vector<uint32_t> other_case_code_units; // Empty if masks are used.
 	};
 
-	bool has_multi_byte_code_points= false;
+	std::vector<CodePointVariants> code_points;
+	uint32_t total_code_units= 0;
+	bool all_masked= true;
+	for(const CharType c : Utf8ToUtf32(node.str))
 	{
-		const CharType c_last_onle_byte_code_point= 0x7F;
-		for(const CharType c : node.variants)
-			has_multi_byte_code_points|= c > c_last_onle_byte_code_point;
-		for(const auto& range : node.ranges)
-			has_multi_byte_code_points= range.second >=c_last_onle_byte_code_point;
-	}
+		const CharType str_utf32[]{c, 0};
 
-	const auto function= llvm_ir_builder.GetInsertBlock()->getParent();
+		CodePointVariants variants;
+		variants.values= EncodeString(Utf32ToUtf8(str_utf32));
+		variants.masks.resize(variants.values.size(), 0);
+		total_code_units+= uint32_t(variants.values.size());
 
-	const auto str_begin_ptr= llvm_ir_builder.CreateGEP(state_type_, state_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(StateFieldIndex::StrBegin)});
-	const auto str_begin_value= llvm_ir_builder.CreateLoad(char_type_ptr_, str_begin_ptr);
+		const auto other_case= GetOtherCase(c);
+		if(other_case != std::nullopt && !(encoding_ == Encoding::Bytes && *other_case > 0xFF))
+		{
+			const CharType other_case_str_utf32[]{*other_case, 0};
+			std::vector<uint32_t> other_case_code_units= EncodeString(Utf32ToUtf8(other_case_str_utf32));
+			assert(other_case_code_units.size() == variants.values.size());
 
-	const auto str_end_ptr= llvm_ir_builder.CreateGEP(state_type_, state_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(StateFieldIndex::StrEnd)});
-	const auto str_end_value= llvm_ir_builder.CreateLoad(char_type_ptr_, str_end_ptr);
+			size_t num_different_code_units= 0, different_code_unit_index= 0;
+			for(size_t i= 0; i < variants.values.size(); ++i)
+			{
+				if(variants.values[i] != other_case_code_units[i])
+				{
+					++num_different_code_units;
+					different_code_unit_index= i;
+				}
+			}
 
-	auto found_block= llvm::BasicBlock::Create(context_, "found");
-	const auto empty_block= llvm::BasicBlock::Create(context_, "empty");
-	const auto non_empty_block= llvm::BasicBlock::Create(context_, "non_empty", function);
+			const uint32_t diff= variants.values[different_code_unit_index] ^ other_case_code_units[different_code_unit_index];
+			if(num_different_code_units == 1 && (diff & (diff - 1)) == 0)
+			{
+				variants.masks[different_code_unit_index]= diff;
+				variants.values[different_code_unit_index]|= diff;
+			}
+			else
+			{
+				variants.other_case_code_units= std::move(other_case_code_units);
+				all_masked= false;
+			}
+		}
 
-	const auto is_empty= llvm_ir_builder.CreateICmpEQ(str_begin_value, str_end_value);
-	llvm_ir_builder.CreateCondBr(is_empty, empty_block, non_empty_block);
+		code_points.push_back(std::move(variants));
+	}
 
-	// Non-empty block.
-	llvm_ir_builder.SetInsertPoint(non_empty_block);
-	const auto char_value= llvm_ir_builder.CreateLoad(char_type_, str_begin_value, "char_value");
+	const auto function= llvm_ir_builder.GetInsertBlock()->getParent();
 
-	llvm::Value* new_str_begin_value= nullptr;
-	if(has_multi_byte_code_points || node.inverse_flag)
-	{
-		// In negative checks or in checks with multi-byte code points extract code point from UTF-8 and compare it against UTF-32 constants.
-
-		const auto block_0= llvm::BasicBlock::Create(context_, "block_0", function);
-		const auto block_1_check= llvm::BasicBlock::Create(context_, "block_check1", function);
-		const auto block_1= llvm::BasicBlock::Create(context_, "block_1", function);
-		const auto block_1_after_size_check= llvm::BasicBlock::Create(context_, "block_1_after_size_check", function);
-		const auto block_2_check= llvm::BasicBlock::Create(context_, "block_2_check", function);
-		const auto block_2= llvm::BasicBlock::Create(context_, "block_2", function);
-		const auto block_2_after_size_check= llvm::BasicBlock::Create(context_, "block_2_after_size_check", function);
-		const auto block_3_check= llvm::BasicBlock::Create(context_, "block_3_check", function);
-		const auto block_3= llvm::BasicBlock::Create(context_, "block_3", function);
-		const auto block_3_after_size_check= llvm::BasicBlock::Create(context_, "block_3_after_size_check", function);
-		const auto block_invalid_utf8= llvm::BasicBlock::Create(context_, "block_invalid_utf8", function);
-		const auto extract_end_block= llvm::BasicBlock::Create(context_, "extract_end", function);
-
-		const auto first_char_value= llvm_ir_builder.CreateZExt(char_value, code_point_type_, "first_char_value");
-
-		// Block 0 check.
-		const auto and_mask0= llvm_ir_builder.CreateAnd(first_char_value, GetConstant(code_point_type_, 0b10000000));
-		const auto cond_0= llvm_ir_builder.CreateICmpEQ(and_mask0, GetConstant(code_point_type_, 0));
-		llvm_ir_builder.CreateCondBr(cond_0, block_0, block_1_check);
-
-		// Block 0.
-		llvm_ir_builder.SetInsertPoint(block_0);
-		const auto char_code0= first_char_value;
-		const auto str_begin0= llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(1), "str_begin0");
-		llvm_ir_builder.CreateBr(extract_end_block);
-
-		// Block 1 check.
-		llvm_ir_builder.SetInsertPoint(block_1_check);
-		const auto and_mask1= llvm_ir_builder.CreateAnd(first_char_value, GetConstant(code_point_type_, 0b11100000));
-		const auto cond_1= llvm_ir_builder.CreateICmpEQ(and_mask1, GetConstant(code_point_type_, 0b11000000));
-		llvm_ir_builder.CreateCondBr(cond_1, block_1, block_2_check);
-
-		// Block 1.
-		llvm_ir_builder.SetInsertPoint(block_1);
-		const auto str_begin1= llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(2), "str_begin1");
-		llvm_ir_builder.CreateCondBr(
-			llvm_ir_builder.CreateICmpULE(str_begin1, str_end_value),
-			block_1_after_size_check,
-			empty_block);
+	const auto next_str_begin_value= llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(total_code_units), "next_str_begin_value");
+	const auto not_enough_condition= llvm_ir_builder.CreateICmpULE(next_str_begin_value, str_end_value);
 
-		// Block 1 after size check.
-		llvm_ir_builder.SetInsertPoint(block_1_after_size_check);
-		const auto char_code1= [&]
-		{
-			const auto b0= first_char_value;
-			const auto b1=
-				llvm_ir_builder.CreateZExt(
-					llvm_ir_builder.CreateLoad(char_type_, llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(1))),
-					code_point_type_);
-			const auto and0= llvm_ir_builder.CreateAnd(b0, GetConstant(code_point_type_, c_bit_masks[5]));
-			const auto and1= llvm_ir_builder.CreateAnd(b1, GetConstant(code_point_type_, c_bit_masks[6]));
-			const auto shift0= llvm_ir_builder.CreateShl(and0, GetConstant(code_point_type_, 6));
-			const auto shift1= and1;
-			return llvm_ir_builder.CreateOr(shift0, shift1, "char_code1");
-		}();
-		llvm_ir_builder.CreateBr(extract_end_block);
-
-		// Block 2 check.
-		llvm_ir_builder.SetInsertPoint(block_2_check);
-		const auto and_mask2= llvm_ir_builder.CreateAnd(first_char_value, GetConstant(code_point_type_, 0b11110000));
-		const auto cond_2= llvm_ir_builder.CreateICmpEQ(and_mask2, GetConstant(code_point_type_, 0b11100000));
-		llvm_ir_builder.CreateCondBr(cond_2, block_2, block_3_check);
-
-		// Block 2.
-		llvm_ir_builder.SetInsertPoint(block_2);
-		const auto str_begin2= llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(3), "str_begin2");
-		llvm_ir_builder.CreateCondBr(
-			llvm_ir_builder.CreateICmpULE(str_begin2, str_end_value),
-			block_2_after_size_check,
-			empty_block);
+	const auto check_content_block= llvm::BasicBlock::Create(context_, "check_content", function);
+	const auto ok_block= llvm::BasicBlock::Create(context_, "ok", function);
+	const auto fail_block= llvm::BasicBlock::Create(context_, "fail", function);
 
-		// Block 2 after size check.
-		llvm_ir_builder.SetInsertPoint(block_2_after_size_check);
-		const auto char_code2= [&]
-		{
-			const auto b0= first_char_value;
-			const auto b1=
-				llvm_ir_builder.CreateZExt(
-					llvm_ir_builder.CreateLoad(char_type_, llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(1))),
-					code_point_type_);
-			const auto b2=
-				llvm_ir_builder.CreateZExt(
-					llvm_ir_builder.CreateLoad(char_type_, llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(2))),
-					code_point_type_);
-			const auto and0= llvm_ir_builder.CreateAnd(b0, GetConstant(code_point_type_, c_bit_masks[4]));
-			const auto and1= llvm_ir_builder.CreateAnd(b1, GetConstant(code_point_type_, c_bit_masks[6]));
-			const auto and2= llvm_ir_builder.CreateAnd(b2, GetConstant(code_point_type_, c_bit_masks[6]));
-			const auto shift0= llvm_ir_builder.CreateShl(and0, GetConstant(code_point_type_, 12));
-			const auto shift1= llvm_ir_builder.CreateShl(and1, GetConstant(code_point_type_,  6));
-			const auto shift2= and2;
-			return llvm_ir_builder.CreateOr(llvm_ir_builder.CreateOr(shift0, shift1), shift2, "char_code2");
-		}();
-		llvm_ir_builder.CreateBr(extract_end_block);
-
-		// Block 3 check.
-		llvm_ir_builder.SetInsertPoint(block_3_check);
-		const auto and_mask3= llvm_ir_builder.CreateAnd(first_char_value, GetConstant(code_point_type_, 0b11111000));
-		const auto cond_3= llvm_ir_builder.CreateICmpEQ(and_mask3, GetConstant(code_point_type_, 0b11110000));
-		llvm_ir_builder.CreateCondBr(cond_3, block_3, block_invalid_utf8);
-
-		// Block 3.
-		llvm_ir_builder.SetInsertPoint(block_3);
-		const auto str_begin3= llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(4), "str_begin2");
-		llvm_ir_builder.CreateCondBr(
-			llvm_ir_builder.CreateICmpULE(str_begin3, str_end_value),
-			block_3_after_size_check,
-			empty_block);
+	llvm_ir_builder.CreateCondBr(not_enough_condition, check_content_block, fail_block);
 
-		// Block 3 after size check.
-		llvm_ir_builder.SetInsertPoint(block_3_after_size_check);
-		const auto char_code3= [&]
-		{
-			const auto b0= first_char_value;
-			const auto b1=
-				llvm_ir_builder.CreateZExt(
-					llvm_ir_builder.CreateLoad(char_type_, llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(1))),
-					code_point_type_);
-			const auto b2=
-				llvm_ir_builder.CreateZExt(
-					llvm_ir_builder.CreateLoad(char_type_, llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(2))),
-					code_point_type_);
-			const auto b3=
-				llvm_ir_builder.CreateZExt(
-					llvm_ir_builder.CreateLoad(char_type_, llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(3))),
-					code_point_type_);
-			const auto and0= llvm_ir_builder.CreateAnd(b0, GetConstant(code_point_type_, c_bit_masks[3]));
-			const auto and1= llvm_ir_builder.CreateAnd(b1, GetConstant(code_point_type_, c_bit_masks[6]));
-			const auto and2= llvm_ir_builder.CreateAnd(b2, GetConstant(code_point_type_, c_bit_masks[6]));
-			const auto and3= llvm_ir_builder.CreateAnd(b3, GetConstant(code_point_type_, c_bit_masks[6]));
-			const auto shift0= llvm_ir_builder.CreateShl(and0, GetConstant(code_point_type_, 18));
-			const auto shift1= llvm_ir_builder.CreateShl(and1, GetConstant(code_point_type_, 12));
-			const auto shift2= llvm_ir_builder.CreateShl(and2, GetConstant(code_point_type_,  6));
-			const auto shift3= and3;
-			return llvm_ir_builder.CreateOr(llvm_ir_builder.CreateOr(shift0, shift1), llvm_ir_builder.CreateOr(shift2, shift3), "char_code3");
-		}();
-		llvm_ir_builder.CreateBr(extract_end_block);
-
-		// Invalid UTF-8 block.
-		llvm_ir_builder.SetInsertPoint(block_invalid_utf8);
-		const auto str_invalid_utf8= llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(1), "str_invalid_utf8");
-		llvm_ir_builder.CreateBr(extract_end_block);
-
-		// Extract end block.
-		llvm_ir_builder.SetInsertPoint(extract_end_block);
-
-		const auto result_char_value= llvm_ir_builder.CreatePHI(code_point_type_, 5, "result_char_value");
-		result_char_value->addIncoming(char_code0, block_0);
-		result_char_value->addIncoming(char_code1, block_1_after_size_check);
-		result_char_value->addIncoming(char_code2, block_2_after_size_check);
-		result_char_value->addIncoming(char_code3, block_3_after_size_check);
-		result_char_value->addIncoming(first_char_value, block_invalid_utf8);
-
-		const auto new_str_begin_value_phi= llvm_ir_builder.CreatePHI(char_type_ptr_, 5, "new_str_begin_value");
-		new_str_begin_value= new_str_begin_value_phi;
-		new_str_begin_value_phi->addIncoming(str_begin0, block_0);
-		new_str_begin_value_phi->addIncoming(str_begin1, block_1_after_size_check);
-		new_str_begin_value_phi->addIncoming(str_begin2, block_2_after_size_check);
-		new_str_begin_value_phi->addIncoming(str_begin3, block_3_after_size_check);
-		new_str_begin_value_phi->addIncoming(str_invalid_utf8, block_invalid_utf8);
+	// Check content block.
+	llvm_ir_builder.SetInsertPoint(check_content_block);
 
-		for(const CharType c : node.variants)
+	if(all_masked && total_code_units >= 2)
+	{
+		// Check masked code units using vector operations - by chunks of 128 bits.
+		std::vector<uint32_t> values, masks;
+		for(const CodePointVariants& variants : code_points)
 		{
-			const auto is_same_symbol= llvm_ir_builder.CreateICmpEQ(result_char_value, GetConstant(code_point_type_, c));
-
-			const auto next_block= llvm::BasicBlock::Create(context_, "next", function);
-
-			llvm_ir_builder.CreateCondBr(is_same_symbol, found_block, next_block);
-			llvm_ir_builder.SetInsertPoint(next_block);
+			values.insert(values.end(), variants.values.begin(), variants.values.end());
+			masks.insert(masks.end(), variants.masks.begin(), variants.masks.end());
 		}
 
-		for(const auto& range : node.ranges)
+		const uint32_t chunk_max_size= 128 / char_type_->getBitWidth();
+		for(uint32_t chunk_start= 0; chunk_start < total_code_units; chunk_start+= chunk_max_size)
 		{
-			const auto ge= llvm_ir_builder.CreateICmpUGE(result_char_value, GetConstant(code_point_type_, range.first ));
-			const auto le= llvm_ir_builder.CreateICmpULE(result_char_value, GetConstant(code_point_type_, range.second));
-			const auto in_range= llvm_ir_builder.CreateAnd(ge, le);
+			const uint32_t chunk_size= std::min(chunk_max_size, total_code_units - chunk_start);
 
-			const auto next_block= llvm::BasicBlock::Create(context_, "next", function);
+			llvm::SmallVector<llvm::Constant*, 16> value_constants, mask_constants;
+			for(uint32_t i= chunk_start; i < chunk_start + chunk_size; ++i)
+			{
+				value_constants.push_back(GetConstant(char_type_, values[i]));
+				mask_constants.push_back(GetConstant(char_type_, masks[i]));
+			}
 
-			llvm_ir_builder.CreateCondBr(in_range, found_block, next_block);
+			const auto vector_type= llvm::FixedVectorType::get(char_type_, chunk_size);
+			const auto chunk_ptr= llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(chunk_start));
+			const auto vector_value=
+				llvm_ir_builder.CreateAlignedLoad(
+					vector_type,
+					llvm_ir_builder.CreateBitCast(chunk_ptr, llvm::PointerType::get(vector_type, 0)),
+					llvm::MaybeAlign(1),
+					"vector_value");
+			const auto vector_masked= llvm_ir_builder.CreateOr(vector_value, llvm::ConstantVector::get(mask_constants), "vector_masked");
+			const auto vector_eq= llvm_ir_builder.CreateICmpEQ(vector_masked, llvm::ConstantVector::get(value_constants), "vector_eq");
+			// Use mask of equal code units instead of reduction intrinsic, since it isn't supported by LLVM interpreter.
+			const auto mask_type= llvm::IntegerType::get(context_, chunk_size);
+			const auto all_eq_value=
+				llvm_ir_builder.CreateICmpEQ(
+					llvm_ir_builder.CreateBitCast(vector_eq, mask_type, "eq_mask"),
+					llvm::ConstantInt::getAllOnesValue(mask_type),
+					"all_eq");
+
+			const bool is_last_chunk= chunk_start + chunk_size == total_code_units;
+			const auto next_block= is_last_chunk ? ok_block : llvm::BasicBlock::Create(context_, "check_content_next", function);
+			llvm_ir_builder.CreateCondBr(all_eq_value, next_block, fail_block);
 			llvm_ir_builder.SetInsertPoint(next_block);
 		}
 	}
 	else
 	{
-		// In positive checks with ASCII-only variants and ranges read only first byte and compare it against byte contants.
-
-		new_str_begin_value= llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(1), "new_str_begin_value");
-		for(const CharType c : node.variants)
+		llvm::Value* all_eq_value= llvm::ConstantInt::getTrue(context_);
+		uint32_t offset= 0;
+		for(const CodePointVariants& variants : code_points)
 		{
-			const auto is_same_symbol= llvm_ir_builder.CreateICmpEQ(char_value, GetConstant(char_type_, c));
+			llvm::SmallVector<llvm::Value*, 4> code_unit_values;
+			for(size_t i= 0; i < variants.values.size(); ++i)
+			{
+				const auto char_ptr= llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(offset + uint32_t(i)));
+				code_unit_values.push_back(llvm_ir_builder.CreateLoad(char_type_, char_ptr, "char_value"));
+			}
+			offset+= uint32_t(variants.values.size());
+
+			llvm::Value* eq_value= llvm::ConstantInt::getTrue(context_);
+			for(size_t i= 0; i < variants.values.size(); ++i)
+			{
+				llvm::Value* code_unit_value= code_unit_values[i];
+				if(variants.masks[i] != 0)
+					code_unit_value= llvm_ir_builder.CreateOr(code_unit_value, GetConstant(char_type_, variants.masks[i]));
+				eq_value= llvm_ir_builder.CreateAnd(eq_value, llvm_ir_builder.CreateICmpEQ(code_unit_value, GetConstant(char_type_, variants.values[i])));
+			}
 
-			const auto next_block= llvm::BasicBlock::Create(context_, "next", function);
+			if(!variants.other_case_code_units.empty())
+			{
+				llvm::Value* other_case_eq_value= llvm::ConstantInt::getTrue(context_);
+				for(size_t i= 0; i < variants.other_case_code_units.size(); ++i)
+					other_case_eq_value=
+						llvm_ir_builder.CreateAnd(
+							other_case_eq_value,
+							llvm_ir_builder.CreateICmpEQ(code_unit_values[i], GetConstant(char_type_, variants.other_case_code_units[i])));
+
+				eq_value= llvm_ir_builder.CreateOr(eq_value, other_case_eq_value);
+			}
 
-			llvm_ir_builder.CreateCondBr(is_same_symbol, found_block, next_block);
-			llvm_ir_builder.SetInsertPoint(next_block);
+			all_eq_value= llvm_ir_builder.CreateAnd(all_eq_value, eq_value, "all_eq");
 		}
+		llvm_ir_builder.CreateCondBr(all_eq_value, ok_block, fail_block);
+	}
 
-		for(const auto& range : node.ranges)
-		{
-			const auto ge= llvm_ir_builder.CreateICmpUGE(char_value, GetConstant(char_type_, range.first ));
-			const auto le= llvm_ir_builder.CreateICmpULE(char_value, GetConstant(char_type_, range.second));
-			const auto in_range= llvm_ir_builder.CreateAnd(ge, le);
+	// Ok block.
+	llvm_ir_builder.SetInsertPoint(ok_block);
+	CreateNextCallRet(llvm_ir_builder, state_ptr, next_str_begin_value, str_end_value, node.next);
 
-			const auto next_block= llvm::BasicBlock::Create(context_, "next", function);
+	// Fail block.
+	llvm_ir_builder.SetInsertPoint(fail_block);
+	CreateFailRet(llvm_ir_builder);
+}
 
-			llvm_ir_builder.CreateCondBr(in_range, found_block, next_block);
-			llvm_ir_builder.SetInsertPoint(next_block);
-		}
+void Generator::BuildNodeFunctionBodyImpl(
+	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, llvm::Value* const str_begin_value, llvm::Value* const str_end_value, const GraphElements::OneOf& node)
+{
+	if(ShouldUseUtf8Automaton(node))
+	{
+		const auto function= llvm_ir_builder.GetInsertBlock()->getParent();
+
+		const auto new_str_begin_value= llvm_ir_builder.CreateCall(GetOrCreateUtf8AutomatonFunction(node), {str_begin_value, str_end_value}, "new_str_begin_value");
+
+		const auto found_block= llvm::BasicBlock::Create(context_, "found", function);
+		const auto not_found_block= llvm::BasicBlock::Create(context_, "not_found", function);
+		llvm_ir_builder.CreateCondBr(llvm_ir_builder.CreateIsNull(new_str_begin_value), not_found_block, found_block);
+
+		llvm_ir_builder.SetInsertPoint(found_block);
+		CreateNextCallRet(llvm_ir_builder, state_ptr, new_str_begin_value, str_end_value, node.next);
+
+		llvm_ir_builder.SetInsertPoint(not_found_block);
+		CreateFailRet(llvm_ir_builder);
+		return;
 	}
 
-	if(node.ranges.empty() && node.variants.empty())
+	// Inverse checks require code point extraction, since any code point may be matched, unless single code unit is always single code point.
+	bool needs_code_point_extraction= node.inverse_flag && (encoding_ == Encoding::UTF8 || encoding_ == Encoding::UTF16);
 	{
-		delete found_block;
-		found_block= nullptr;
+		const CharType max_single_code_unit_code_point= GetMaxSingleCodeUnitCodePoint();
+		for(const CharType c : node.variants)
+			needs_code_point_extraction|= c > max_single_code_unit_code_point;
+		for(const auto& range : node.ranges)
+			needs_code_point_extraction|= range.second > max_single_code_unit_code_point;
 	}
 
-	llvm_ir_builder.GetInsertBlock()->setName("not_found");
-	if(node.inverse_flag)
-	{
-		// Not found anything - continue.
-		llvm_ir_builder.CreateStore(new_str_begin_value, str_begin_ptr);
-		CreateNextCallRet(llvm_ir_builder, state_ptr, node.next);
+	const auto function= llvm_ir_builder.GetInsertBlock()->getParent();
 
-		// Found something - return false.
-		if(found_block != nullptr)
-		{
-			found_block->insertInto(function);
-			llvm_ir_builder.SetInsertPoint(found_block);
-			llvm_ir_builder.CreateRet(llvm::ConstantInt::getFalse(context_));
-		}
+	auto found_block= llvm::BasicBlock::Create(context_, "found");
+	const auto empty_block= llvm::BasicBlock::Create(context_, "empty");
+	const auto non_empty_block= llvm::BasicBlock::Create(context_, "non_empty", function);
+
+	const auto is_empty= llvm_ir_builder.CreateICmpEQ(str_begin_value, str_end_value);
+	llvm_ir_builder.CreateCondBr(is_empty, empty_block, non_empty_block);
+
+	// Non-empty block.
+	llvm_ir_builder.SetInsertPoint(non_empty_block);
+	const auto char_value= llvm_ir_builder.CreateLoad(char_type_, str_begin_value, "char_value");
+
+	llvm::Value* new_str_begin_value= nullptr;
+	llvm::Value* checked_value= nullptr;
+	if(needs_code_point_extraction)
+	{
+		// In negative checks or in checks with multi-unit code points extract code point and check it against UTF-32 ranges.
+		std::tie(checked_value, new_str_begin_value)= CreateCodePointExtraction(llvm_ir_builder, str_begin_value, str_end_value, char_value, empty_block);
+	}
+	else
+	{
+		// If all code points are single-unit, read only first code unit and check it.
+		checked_value= char_value;
+		new_str_begin_value= llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(1), "new_str_begin_value");
+	}
+
+	const auto not_found_block= llvm::BasicBlock::Create(context_, "not_found", function);
+	CreateCodePointRangesCheck(llvm_ir_builder, checked_value, GetMergedCodePointRanges(node), found_block, not_found_block);
+	llvm_ir_builder.SetInsertPoint(not_found_block);
+
+	if(node.ranges.empty() && node.variants.empty())
+	{
+		delete found_block;
+		found_block= nullptr;
+	}
+
+	if(node.inverse_flag)
+	{
+		// Not found anything - continue.
+		CreateNextCallRet(llvm_ir_builder, state_ptr, new_str_begin_value, str_end_value, node.next);
+
+		// Found something - return false.
+		if(found_block != nullptr)
+		{
+			found_block->insertInto(function);
+			llvm_ir_builder.SetInsertPoint(found_block);
+			CreateFailRet(llvm_ir_builder);
+		}
 	}
 	else
 	{
 		// Not found anything - return false.
-		llvm_ir_builder.CreateRet(llvm::ConstantInt::getFalse(context_));
+		CreateFailRet(llvm_ir_builder);
 
 		// Found - continue.
 		if(found_block != nullptr)
 		{
 			found_block->insertInto(function);
 			llvm_ir_builder.SetInsertPoint(found_block);
-			llvm_ir_builder.CreateStore(new_str_begin_value, str_begin_ptr);
-			CreateNextCallRet(llvm_ir_builder, state_ptr, node.next);
+			CreateNextCallRet(llvm_ir_builder, state_ptr, new_str_begin_value, str_end_value, node.next);
 		}
 	}
 
 	// Empty block.
 	empty_block->insertInto(function);
 	llvm_ir_builder.SetInsertPoint(empty_block);
-	llvm_ir_builder.CreateRet(llvm::ConstantInt::getFalse(context_));
+	CreateFailRet(llvm_ir_builder);
 }
 
 void Generator::BuildNodeFunctionBodyImpl(
-	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, const GraphElements::Alternatives& node)
+	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, llvm::Value* const str_begin_value, llvm::Value* const str_end_value, const GraphElements::Alternatives& node)
 {
 	assert(!node.next.empty());
+	if(node.next_first_code_units.empty())
+	{
+		CreateNextAlternativesCallRet(llvm_ir_builder, state_ptr, str_begin_value, str_end_value, node.next);
+		return;
+	}
+
+	// Select alternatives, which may start with current code unit, via switch.
+	// Try only them and skip state saving if only one alternative is possible.
+	// Alternatives without first code units restriction are tried for all code units and at the end of the string.
+
+	assert(node.next_first_code_units.size() == node.next.size());
+	const std::vector<AlternativesCodeUnitsInterval> intervals= GetAlternativesCodeUnitsIntervals(node.next_first_code_units);
+
+	std::vector<size_t> default_alternatives;
+	for(size_t i= 0; i < node.next.size(); ++i)
+		if(node.next_first_code_units[i] == std::nullopt)
+			default_alternatives.push_back(i);
 
 	const auto function= llvm_ir_builder.GetInsertBlock()->getParent();
 
-	const auto state_backup_ptr= llvm_ir_builder.CreateAlloca(state_type_, 0, "state_backup");
+	// Many intervals may have same list of alternatives, so, create single block for each list.
+	std::map< std::vector<size_t>, llvm::BasicBlock* > alternatives_blocks;
+	alternatives_blocks.emplace(default_alternatives, llvm::BasicBlock::Create(context_, "default_alternatives", function));
+	for(const AlternativesCodeUnitsInterval& interval : intervals)
+		if(alternatives_blocks.count(interval.alternatives) == 0)
+			alternatives_blocks.emplace(interval.alternatives, llvm::BasicBlock::Create(context_, "selected_alternatives", function));
 
-	const auto found_block= llvm::BasicBlock::Create(context_, "found");
+	const auto default_block= alternatives_blocks.at(default_alternatives);
+	const auto check_code_unit_block= llvm::BasicBlock::Create(context_, "check_code_unit", function);
+	const auto range_checks_block= llvm::BasicBlock::Create(context_, "range_checks", function);
 
-	for(const GraphElements::NodePtr possible_next : node.next)
+	llvm_ir_builder.CreateCondBr(llvm_ir_builder.CreateICmpEQ(str_begin_value, str_end_value), default_block, check_code_unit_block);
+
+	llvm_ir_builder.SetInsertPoint(check_code_unit_block);
+	const auto code_unit_value= llvm_ir_builder.CreateLoad(char_type_, str_begin_value, "code_unit_value");
+
+	// Add small intervals into switch, check large intervals (possible for UTF-16 and UTF-32) via comparisons.
+	const size_t c_max_switch_cases= 256;
+	size_t num_switch_cases= 0;
+	std::vector<const AlternativesCodeUnitsInterval*> large_intervals;
+
+	const auto switch_instruction= llvm_ir_builder.CreateSwitch(code_unit_value, range_checks_block);
+	for(const AlternativesCodeUnitsInterval& interval : intervals)
 	{
-		if(possible_next != node.next.back())
+		const size_t interval_size= size_t(interval.end - interval.begin) + 1;
+		if(num_switch_cases + interval_size > c_max_switch_cases)
 		{
-			SaveState(llvm_ir_builder, state_ptr, state_backup_ptr);
-			const auto variant_res= llvm_ir_builder.CreateCall(GetOrCreateNodeFunction(possible_next), {state_ptr});
-			const auto next_block= llvm::BasicBlock::Create(context_, "", function);
-
-			llvm_ir_builder.CreateCondBr(variant_res, found_block, next_block);
-			llvm_ir_builder.SetInsertPoint(next_block);
-			RestoreState(llvm_ir_builder, state_ptr, state_backup_ptr);
+			large_intervals.push_back(&interval);
+			continue;
 		}
-		else
+
+		const auto block= alternatives_blocks.at(interval.alternatives);
+		for(GraphElements::CharType c= interval.begin; c <= interval.end; ++c)
+			switch_instruction->addCase(GetConstant(char_type_, c), block);
+		num_switch_cases+= interval_size;
+	}
+
+	llvm_ir_builder.SetInsertPoint(range_checks_block);
+	for(const AlternativesCodeUnitsInterval* const interval : large_intervals)
+	{
+		const auto next_check_block= llvm::BasicBlock::Create(context_, "range_checks", function);
+		llvm_ir_builder.CreateCondBr(
+			llvm_ir_builder.CreateICmpULE(
+				llvm_ir_builder.CreateSub(code_unit_value, GetConstant(char_type_, interval->begin)),
+				GetConstant(char_type_, interval->end - interval->begin)),
+			alternatives_blocks.at(interval->alternatives),
+			next_check_block);
+		llvm_ir_builder.SetInsertPoint(next_check_block);
+	}
+	llvm_ir_builder.CreateBr(default_block);
+
+	for(const auto& alternatives_block_pair : alternatives_blocks)
+	{
+		llvm_ir_builder.SetInsertPoint(alternatives_block_pair.second);
+
+		const std::vector<size_t>& alternatives= alternatives_block_pair.first;
+		if(alternatives.empty())
 		{
-			// Do not call state copy functions in last alternative, just call alternative node function with initial state and return call result.
-			CreateNextCallRet(llvm_ir_builder, state_ptr, possible_next);
+			CreateFailRet(llvm_ir_builder);
+			continue;
 		}
-	}
 
-	// Return true if one of next variants were successfull.
-	found_block->insertInto(function);
-	llvm_ir_builder.SetInsertPoint(found_block);
-	llvm_ir_builder.CreateRet(llvm::ConstantInt::getTrue(context_));
+		std::vector<GraphElements::NodePtr> next_nodes;
+		next_nodes.reserve(alternatives.size());
+		for(const size_t alternative_index : alternatives)
+			next_nodes.push_back(node.next[alternative_index]);
+
+		if(next_nodes.size() == 1)
+			CreateNextCallRet(llvm_ir_builder, state_ptr, str_begin_value, str_end_value, next_nodes.front());
+		else
+			CreateNextAlternativesCallRet(llvm_ir_builder, state_ptr, str_begin_value, str_end_value, next_nodes);
+	}
 }
 
 void Generator::BuildNodeFunctionBodyImpl(
-	IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, const GraphElements::AlternativesPossessive& node)
+	IRBuilder& llvm_ir_builder, llvm::Value* state_ptr, llvm::Value* str_begin_value, llvm::Value* str_end_value, const GraphElements::AlternativesPossessive& node)
 {
-	const auto state_backup_ptr= llvm_ir_builder.CreateAlloca(state_type_, 0, "state_backup");
+	if(std::get_if<GraphElements::AlternativesPossessive>(node.path0_next) == &node)
+	{
+		if(const auto span_function= GetSpanFunction(node.path0_element))
+		{
+			// Possessive loop of class - skip all matching code points at once.
+			const auto span_end= CreateSpanCall(llvm_ir_builder, *span_function, str_begin_value, str_end_value, Sequence::c_max);
+			CreateNextCallRet(llvm_ir_builder, state_ptr, span_end, str_end_value, node.path1_next);
+			return;
+		}
+	}
+
+	const auto state_backup_ptr= CreateStateAlloca(llvm_ir_builder, "state_backup");
+	const StateFieldsSet fields_to_restore= GetFieldsToRestore({node.path0_element}, {node.path1_next});
 
 	const auto function= llvm_ir_builder.GetInsertBlock()->getParent();
 	const auto path0_block= llvm::BasicBlock::Create(context_, "path0", function);
 	const auto path1_block= llvm::BasicBlock::Create(context_, "path1", function);
 
-	SaveState(llvm_ir_builder, state_ptr, state_backup_ptr);
-	const auto path0_element_res= llvm_ir_builder.CreateCall(GetOrCreateNodeFunction(node.path0_element), {state_ptr});
+	SaveState(llvm_ir_builder, state_ptr, state_backup_ptr, fields_to_restore);
+	const auto path0_element_res= CreateNodeCall(llvm_ir_builder, state_ptr, str_begin_value, str_end_value, node.path0_element);
+	path0_element_res->setName("path0_element_res");
 
-	llvm_ir_builder.CreateCondBr(path0_element_res, path0_block, path1_block);
+	llvm_ir_builder.CreateCondBr(llvm_ir_builder.CreateIsNull(path0_element_res), path1_block, path0_block);
 
-	// Path0 block.
+	// Path0 block - continue from path0 element end.
 	llvm_ir_builder.SetInsertPoint(path0_block);
-	CreateNextCallRet(llvm_ir_builder, state_ptr, node.path0_next);
+	CreateNextCallRet(llvm_ir_builder, state_ptr, path0_element_res, str_end_value, node.path0_next);
 
 	// Path1 block.
 	llvm_ir_builder.SetInsertPoint(path1_block);
-	RestoreState(llvm_ir_builder, state_ptr, state_backup_ptr);
-	CreateNextCallRet(llvm_ir_builder, state_ptr, node.path1_next);
+	RestoreState(llvm_ir_builder, state_ptr, state_backup_ptr, fields_to_restore);
+	CreateNextCallRet(llvm_ir_builder, state_ptr, str_begin_value, str_end_value, node.path1_next);
+}
+
+void Generator::BuildNodeFunctionBodyImpl(
+	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, llvm::Value* const str_begin_value, llvm::Value* const str_end_value, const GraphElements::AlternativesTrie& node)
+{
+	// Walk over trie, selecting child by next code unit via switch.
+	// When walk stops - try alternatives of strings, matched so far.
+
+	std::vector< std::vector<uint32_t> > strings;
+	strings.reserve(node.alternatives.size());
+	for(const auto& alternative : node.alternatives)
+		strings.push_back(EncodeString(alternative.str));
+
+	const CodeUnitsTrie trie= BuildCodeUnitsTrie(strings);
+
+	const auto function= llvm_ir_builder.GetInsertBlock()->getParent();
+	const auto str_size= llvm_ir_builder.CreatePtrDiff(char_type_, str_end_value, str_begin_value, "str_size");
+
+	std::vector<llvm::BasicBlock*> trie_node_blocks;
+	trie_node_blocks.reserve(trie.size());
+	for(size_t i= 0; i < trie.size(); ++i)
+		trie_node_blocks.push_back(llvm::BasicBlock::Create(context_, "trie_node", function));
+
+	// Many trie nodes have same list of matched strings, so, create single block for each list.
+	std::map< std::vector<size_t>, llvm::BasicBlock* > matched_strings_blocks;
+	for(const CodeUnitsTrieNode& trie_node : trie)
+		if(matched_strings_blocks.count(trie_node.matched_strings) == 0)
+			matched_strings_blocks.emplace(trie_node.matched_strings, llvm::BasicBlock::Create(context_, "matched_strings", function));
+
+	llvm_ir_builder.CreateBr(trie_node_blocks.front());
+
+	for(size_t i= 0; i < trie.size(); ++i)
+	{
+		const CodeUnitsTrieNode& trie_node= trie[i];
+		const auto matched_strings_block= matched_strings_blocks.at(trie_node.matched_strings);
+
+		llvm_ir_builder.SetInsertPoint(trie_node_blocks[i]);
+		if(trie_node.children.empty())
+		{
+			llvm_ir_builder.CreateBr(matched_strings_block);
+			continue;
+		}
+
+		const auto check_code_unit_block= llvm::BasicBlock::Create(context_, "check_code_unit", function);
+		llvm_ir_builder.CreateCondBr(
+			llvm_ir_builder.CreateICmpUGT(str_size, GetConstant(ptr_size_int_type_, trie_node.depth)),
+			check_code_unit_block,
+			matched_strings_block);
+
+		llvm_ir_builder.SetInsertPoint(check_code_unit_block);
+		const auto code_unit_ptr= llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(uint32_t(trie_node.depth)));
+		const auto code_unit_value= llvm_ir_builder.CreateLoad(char_type_, code_unit_ptr, "code_unit_value");
+
+		const auto switch_instruction= llvm_ir_builder.CreateSwitch(code_unit_value, matched_strings_block, uint32_t(trie_node.children.size()));
+		for(const auto& child_pair : trie_node.children)
+			switch_instruction->addCase(GetConstant(char_type_, child_pair.first), trie_node_blocks[child_pair.second]);
+	}
+
+	for(const auto& matched_strings_block_pair : matched_strings_blocks)
+	{
+		llvm_ir_builder.SetInsertPoint(matched_strings_block_pair.second);
+
+		const std::vector<size_t>& matched_strings= matched_strings_block_pair.first;
+		if(matched_strings.empty())
+		{
+			CreateFailRet(llvm_ir_builder);
+			continue;
+		}
+
+		std::vector<GraphElements::NodePtr> next_nodes;
+		std::vector<size_t> next_nodes_offsets;
+		for(const size_t string_index : matched_strings)
+		{
+			next_nodes.push_back(node.alternatives[string_index].next);
+			next_nodes_offsets.push_back(strings[string_index].size());
+		}
+
+		CreateNextAlternativesCallRet(llvm_ir_builder, state_ptr, str_begin_value, str_end_value, next_nodes, next_nodes_offsets);
+	}
 }
 
 void Generator::BuildNodeFunctionBodyImpl(
-	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, const GraphElements::GroupStart& node)
+	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, llvm::Value* const str_begin_value, llvm::Value* const str_end_value, const GraphElements::GroupStart& node)
 {
 	const auto group_ptr=
 		llvm_ir_builder.CreateGEP(
@@ -1087,17 +2265,14 @@ void Generator::BuildNodeFunctionBodyImpl(
 	const auto group_begin_ptr= llvm_ir_builder.CreateGEP(group_type_, group_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(0)});
 	const auto group_end_ptr  = llvm_ir_builder.CreateGEP(group_type_, group_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(1)});
 
-	const auto str_begin_ptr= llvm_ir_builder.CreateGEP(state_type_, state_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(StateFieldIndex::StrBegin)});
-	const auto str_begin_value= llvm_ir_builder.CreateLoad(char_type_ptr_, str_begin_ptr);
-
 	llvm_ir_builder.CreateStore(str_begin_value, group_begin_ptr);
 	llvm_ir_builder.CreateStore(str_begin_value, group_end_ptr  );
 
-	CreateNextCallRet(llvm_ir_builder, state_ptr, node.next);
+	CreateNextCallRet(llvm_ir_builder, state_ptr, str_begin_value, str_end_value, node.next);
 }
 
 void Generator::BuildNodeFunctionBodyImpl(
-	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, const GraphElements::GroupEnd& node)
+	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, llvm::Value* const str_begin_value, llvm::Value* const str_end_value, const GraphElements::GroupEnd& node)
 {
 	const auto group_end_ptr=
 		llvm_ir_builder.CreateGEP(
@@ -1110,16 +2285,13 @@ void Generator::BuildNodeFunctionBodyImpl(
 				GetFieldGEPIndex(1),
 			});
 
-	const auto str_begin_ptr= llvm_ir_builder.CreateGEP(group_type_, state_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(StateFieldIndex::StrBegin)});
-	const auto str_begin_value= llvm_ir_builder.CreateLoad(char_type_ptr_, str_begin_ptr);
-
 	llvm_ir_builder.CreateStore(str_begin_value, group_end_ptr);
 
-	CreateNextCallRet(llvm_ir_builder, state_ptr, node.next);
+	CreateNextCallRet(llvm_ir_builder, state_ptr, str_begin_value, str_end_value, node.next);
 }
 
 void Generator::BuildNodeFunctionBodyImpl(
-	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, const GraphElements::BackReference& node)
+	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, llvm::Value* const str_begin_value, llvm::Value* const str_end_value, const GraphElements::BackReference& node)
 {
 	// Generate here code, equivalent to.
 	/*
@@ -1154,12 +2326,6 @@ void Generator::BuildNodeFunctionBodyImpl(
 				GetFieldGEPIndex(group_number_to_field_number_.at(node.index)),
 			});
 
-	const auto str_begin_ptr= llvm_ir_builder.CreateGEP(state_type_, state_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(StateFieldIndex::StrBegin)});
-	const auto str_begin_value= llvm_ir_builder.CreateLoad(char_type_ptr_, str_begin_ptr, "str_begin_value");
-
-	const auto str_end_ptr= llvm_ir_builder.CreateGEP(state_type_, state_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(StateFieldIndex::StrEnd)});
-	const auto str_end_value= llvm_ir_builder.CreateLoad(char_type_ptr_, str_end_ptr, "str_end_value");
-
 	const auto group_begin_ptr= llvm_ir_builder.CreateGEP(group_type_, group_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(0)});
 	const auto group_end_ptr  = llvm_ir_builder.CreateGEP(group_type_, group_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(1)});
 
@@ -1213,102 +2379,99 @@ void Generator::BuildNodeFunctionBodyImpl(
 	// End block.
 	llvm_ir_builder.SetInsertPoint(end_block);
 	const auto new_str_begin_value= llvm_ir_builder.CreateGEP(char_type_, str_begin_value, group_size);
-	llvm_ir_builder.CreateStore(new_str_begin_value, str_begin_ptr);
-	CreateNextCallRet(llvm_ir_builder, state_ptr, node.next);
+	CreateNextCallRet(llvm_ir_builder, state_ptr, new_str_begin_value, str_end_value, node.next);
 
 	// Fail block.
 	llvm_ir_builder.SetInsertPoint(fail_block);
-	llvm_ir_builder.CreateRet(llvm::ConstantInt::getFalse(context_));
+	CreateFailRet(llvm_ir_builder);
 }
 
 void Generator::BuildNodeFunctionBodyImpl(
-	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, const GraphElements::LookAhead& node)
+	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, llvm::Value* const str_begin_value, llvm::Value* const str_end_value, const GraphElements::LookAhead& node)
 {
 	const auto function= llvm_ir_builder.GetInsertBlock()->getParent();
 
-	const auto state_backup_ptr= llvm_ir_builder.CreateAlloca(state_type_, 0, "state_backup");
+	const auto state_backup_ptr= CreateStateAlloca(llvm_ir_builder, "state_backup");
+	const StateFieldsSet fields_to_restore= GetFieldsToRestore({node.look_graph}, {node.next});
 
-	SaveState(llvm_ir_builder, state_ptr, state_backup_ptr);
-	const auto call_res= llvm_ir_builder.CreateCall(GetOrCreateNodeFunction(node.look_graph), {state_ptr});
+	SaveState(llvm_ir_builder, state_ptr, state_backup_ptr, fields_to_restore);
+	const auto call_res= CreateNodeCall(llvm_ir_builder, state_ptr, str_begin_value, str_end_value, node.look_graph);
+	const auto look_failed= llvm_ir_builder.CreateIsNull(call_res, "look_failed");
 
 	const auto ok_block= llvm::BasicBlock::Create(context_, "ok", function);
 	const auto fail_block= llvm::BasicBlock::Create(context_, "fail", function);
 
 	if(node.positive)
-		llvm_ir_builder.CreateCondBr(call_res, ok_block, fail_block);
+		llvm_ir_builder.CreateCondBr(look_failed, fail_block, ok_block);
 	else
-		llvm_ir_builder.CreateCondBr(call_res, fail_block, ok_block);
+		llvm_ir_builder.CreateCondBr(look_failed, ok_block, fail_block);
 
 	// Ok block.
 	llvm_ir_builder.SetInsertPoint(ok_block);
-	RestoreState(llvm_ir_builder, state_ptr, state_backup_ptr);
-	CreateNextCallRet(llvm_ir_builder, state_ptr, node.next);
+	RestoreState(llvm_ir_builder, state_ptr, state_backup_ptr, fields_to_restore);
+	CreateNextCallRet(llvm_ir_builder, state_ptr, str_begin_value, str_end_value, node.next);
 
 	// Fail block.
 	llvm_ir_builder.SetInsertPoint(fail_block);
-	llvm_ir_builder.CreateRet(llvm::ConstantInt::getFalse(context_));
+	CreateFailRet(llvm_ir_builder);
 }
 
 void Generator::BuildNodeFunctionBodyImpl(
-	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, const GraphElements::LookBehind& node)
+	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, llvm::Value* const str_begin_value, llvm::Value* const str_end_value, const GraphElements::LookBehind& node)
 {
 	const auto function= llvm_ir_builder.GetInsertBlock()->getParent();
 
-	const auto state_backup_ptr= llvm_ir_builder.CreateAlloca(state_type_, 0, "state_backup");
+	const auto state_backup_ptr= CreateStateAlloca(llvm_ir_builder, "state_backup");
+	const StateFieldsSet fields_to_restore= GetFieldsToRestore({node.look_graph}, {node.next});
 
 	const auto do_look_block= llvm::BasicBlock::Create(context_, "do_look", function);
 	const auto look_ok_block= llvm::BasicBlock::Create(context_, "ok", function);
 	const auto look_fail_block= llvm::BasicBlock::Create(context_, "fail", function);
 
-	const auto str_begin= llvm_ir_builder.CreateLoad(char_type_ptr_, llvm_ir_builder.CreateGEP(state_type_, state_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(StateFieldIndex::StrBegin)}));
 	const auto str_begin_initial= llvm_ir_builder.CreateLoad(char_type_ptr_, llvm_ir_builder.CreateGEP(state_type_, state_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(StateFieldIndex::StrBeginInitial)}));
 
-	const auto str_begin_for_look= llvm_ir_builder.CreateGEP(char_type_, str_begin, GetConstant(ptr_size_int_type_, uint64_t(0) - uint64_t(node.size)));
+	const auto str_begin_for_look= llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetConstant(ptr_size_int_type_, uint64_t(0) - uint64_t(node.size)));
 
 	const auto can_perfrom_look_condition= llvm_ir_builder.CreateICmpUGE(str_begin_for_look, str_begin_initial);
 	llvm_ir_builder.CreateCondBr(can_perfrom_look_condition, do_look_block, look_fail_block);
 
 	// Do look block.
 	llvm_ir_builder.SetInsertPoint(do_look_block);
-	SaveState(llvm_ir_builder, state_ptr, state_backup_ptr);
-	llvm_ir_builder.CreateStore(
-		str_begin_for_look,
-		llvm_ir_builder.CreateGEP(state_type_, state_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(StateFieldIndex::StrBegin)}));
-	const auto look_res= llvm_ir_builder.CreateCall(GetOrCreateNodeFunction(node.look_graph), {state_ptr});
-	RestoreState(llvm_ir_builder, state_ptr, state_backup_ptr);
-	llvm_ir_builder.CreateCondBr(look_res, look_ok_block, look_fail_block);
+	SaveState(llvm_ir_builder, state_ptr, state_backup_ptr, fields_to_restore);
+	const auto look_res= CreateNodeCall(llvm_ir_builder, state_ptr, str_begin_for_look, str_end_value, node.look_graph);
+	RestoreState(llvm_ir_builder, state_ptr, state_backup_ptr, fields_to_restore);
+	llvm_ir_builder.CreateCondBr(llvm_ir_builder.CreateIsNull(look_res), look_fail_block, look_ok_block);
 
 	if(node.positive)
 	{
 		// Look ok block.
 		llvm_ir_builder.SetInsertPoint(look_ok_block);
-		CreateNextCallRet(llvm_ir_builder, state_ptr, node.next);
+		CreateNextCallRet(llvm_ir_builder, state_ptr, str_begin_value, str_end_value, node.next);
 
 		// Look fail block.
 		llvm_ir_builder.SetInsertPoint(look_fail_block);
-		llvm_ir_builder.CreateRet(llvm::ConstantInt::getFalse(context_));
+		CreateFailRet(llvm_ir_builder);
 	}
 	else
 	{
 		// Look ok block.
 		llvm_ir_builder.SetInsertPoint(look_ok_block);
-		llvm_ir_builder.CreateRet(llvm::ConstantInt::getFalse(context_));
+		CreateFailRet(llvm_ir_builder);
 
 		// Look fail block.
 		llvm_ir_builder.SetInsertPoint(look_fail_block);
-		CreateNextCallRet(llvm_ir_builder, state_ptr, node.next);
+		CreateNextCallRet(llvm_ir_builder, state_ptr, str_begin_value, str_end_value, node.next);
 	}
 }
 
 void Generator::BuildNodeFunctionBodyImpl(
-	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, const GraphElements::StringStartAssertion& node)
+	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, llvm::Value* const str_begin_value, llvm::Value* const str_end_value, const GraphElements::StringStartAssertion& node)
 {
 	const auto function= llvm_ir_builder.GetInsertBlock()->getParent();
 
-	const auto str_begin= llvm_ir_builder.CreateLoad(char_type_ptr_, llvm_ir_builder.CreateGEP(state_type_, state_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(StateFieldIndex::StrBegin)}));
 	const auto str_begin_initial= llvm_ir_builder.CreateLoad(char_type_ptr_, llvm_ir_builder.CreateGEP(state_type_, state_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(StateFieldIndex::StrBeginInitial)}));
 
-	const auto is_start= llvm_ir_builder.CreateICmpEQ(str_begin, str_begin_initial);
+	const auto is_start= llvm_ir_builder.CreateICmpEQ(str_begin_value, str_begin_initial);
 
 	const auto ok_block= llvm::BasicBlock::Create(context_, "ok", function);
 	const auto fail_block= llvm::BasicBlock::Create(context_, "fail", function);
@@ -1316,22 +2479,19 @@ void Generator::BuildNodeFunctionBodyImpl(
 
 	// Ok block.
 	llvm_ir_builder.SetInsertPoint(ok_block);
-	CreateNextCallRet(llvm_ir_builder, state_ptr, node.next);
+	CreateNextCallRet(llvm_ir_builder, state_ptr, str_begin_value, str_end_value, node.next);
 
 	// Fail block.
 	llvm_ir_builder.SetInsertPoint(fail_block);
-	llvm_ir_builder.CreateRet(llvm::ConstantInt::getFalse(context_));
+	CreateFailRet(llvm_ir_builder);
 }
 
 void Generator::BuildNodeFunctionBodyImpl(
-	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, const GraphElements::StringEndAssertion& node)
+	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, llvm::Value* const str_begin_value, llvm::Value* const str_end_value, const GraphElements::StringEndAssertion& node)
 {
 	const auto function= llvm_ir_builder.GetInsertBlock()->getParent();
 
-	const auto str_begin= llvm_ir_builder.CreateLoad(char_type_ptr_,llvm_ir_builder.CreateGEP(state_type_, state_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(StateFieldIndex::StrBegin)}));
-	const auto str_end= llvm_ir_builder.CreateLoad(char_type_ptr_,llvm_ir_builder.CreateGEP(state_type_, state_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(StateFieldIndex::StrEnd)}));
-
-	const auto is_start= llvm_ir_builder.CreateICmpEQ(str_begin, str_end);
+	const auto is_start= llvm_ir_builder.CreateICmpEQ(str_begin_value, str_end_value);
 
 	const auto ok_block= llvm::BasicBlock::Create(context_, "ok", function);
 	const auto fail_block= llvm::BasicBlock::Create(context_, "fail", function);
@@ -1339,40 +2499,41 @@ void Generator::BuildNodeFunctionBodyImpl(
 
 	// Ok block.
 	llvm_ir_builder.SetInsertPoint(ok_block);
-	CreateNextCallRet(llvm_ir_builder, state_ptr, node.next);
+	CreateNextCallRet(llvm_ir_builder, state_ptr, str_begin_value, str_end_value, node.next);
 
 	// Fail block.
 	llvm_ir_builder.SetInsertPoint(fail_block);
-	llvm_ir_builder.CreateRet(llvm::ConstantInt::getFalse(context_));
+	CreateFailRet(llvm_ir_builder);
 }
 
 void Generator::BuildNodeFunctionBodyImpl(
-	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, const GraphElements::ConditionalElement& node)
+	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, llvm::Value* const str_begin_value, llvm::Value* const str_end_value, const GraphElements::ConditionalElement& node)
 {
 	const auto function= llvm_ir_builder.GetInsertBlock()->getParent();
 
-	const auto state_backup_ptr= llvm_ir_builder.CreateAlloca(state_type_, 0, "state_backup");
+	const auto state_backup_ptr= CreateStateAlloca(llvm_ir_builder, "state_backup");
+	const StateFieldsSet fields_to_restore= GetFieldsToRestore({node.condition_node}, {node.next_true, node.next_false});
 
 	// TODO - do not save state here if next node is "look" which saves state too.
-	SaveState(llvm_ir_builder, state_ptr, state_backup_ptr);
-	const auto call_res= llvm_ir_builder.CreateCall(GetOrCreateNodeFunction(node.condition_node), {state_ptr});
-	RestoreState(llvm_ir_builder, state_ptr, state_backup_ptr);
+	SaveState(llvm_ir_builder, state_ptr, state_backup_ptr, fields_to_restore);
+	const auto call_res= CreateNodeCall(llvm_ir_builder, state_ptr, str_begin_value, str_end_value, node.condition_node);
+	RestoreState(llvm_ir_builder, state_ptr, state_backup_ptr, fields_to_restore);
 
 	const auto true_block = llvm::BasicBlock::Create(context_, "true_block" , function);
 	const auto false_block= llvm::BasicBlock::Create(context_, "false_block", function);
-	llvm_ir_builder.CreateCondBr(call_res, true_block, false_block);
+	llvm_ir_builder.CreateCondBr(llvm_ir_builder.CreateIsNull(call_res), false_block, true_block);
 
 	// True block.
 	llvm_ir_builder.SetInsertPoint(true_block );
-	CreateNextCallRet(llvm_ir_builder, state_ptr, node.next_true);
+	CreateNextCallRet(llvm_ir_builder, state_ptr, str_begin_value, str_end_value, node.next_true);
 
 	// False block.
 	llvm_ir_builder.SetInsertPoint(false_block);
-	CreateNextCallRet(llvm_ir_builder, state_ptr, node.next_false);
+	CreateNextCallRet(llvm_ir_builder, state_ptr, str_begin_value, str_end_value, node.next_false);
 }
 
 void Generator::BuildNodeFunctionBodyImpl(
-	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, const GraphElements::SequenceCounterReset& node)
+	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, llvm::Value* const str_begin_value, llvm::Value* const str_end_value, const GraphElements::SequenceCounterReset& node)
 {
 	const auto counter_ptr=
 		llvm_ir_builder.CreateGEP(
@@ -1386,16 +2547,14 @@ void Generator::BuildNodeFunctionBodyImpl(
 
 	llvm_ir_builder.CreateStore(llvm::ConstantInt::getNullValue(ptr_size_int_type_), counter_ptr);
 
-	CreateNextCallRet(llvm_ir_builder, state_ptr, node.next);
+	CreateNextCallRet(llvm_ir_builder, state_ptr, str_begin_value, str_end_value, node.next);
 }
 
 void Generator::BuildNodeFunctionBodyImpl(
-	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, const GraphElements::SequenceCounter& node)
+	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, llvm::Value* const str_begin_value, llvm::Value* const str_end_value, const GraphElements::SequenceCounter& node)
 {
 	const auto function= llvm_ir_builder.GetInsertBlock()->getParent();
 
-	const auto state_backup_ptr= llvm_ir_builder.CreateAlloca(state_type_, 0, "state_backup");
-
 	const auto counter_ptr=
 		llvm_ir_builder.CreateGEP(
 			state_type_,
@@ -1425,7 +2584,7 @@ void Generator::BuildNodeFunctionBodyImpl(
 		llvm_ir_builder.CreateCondBr(less, less_block, next_block);
 
 		llvm_ir_builder.SetInsertPoint(less_block);
-		CreateNextCallRet(llvm_ir_builder, state_ptr, node.next_iteration);
+		CreateNextCallRet(llvm_ir_builder, state_ptr, str_begin_value, str_end_value, node.next_iteration);
 
 		llvm_ir_builder.SetInsertPoint(next_block);
 	}
@@ -1443,7 +2602,7 @@ void Generator::BuildNodeFunctionBodyImpl(
 		llvm_ir_builder.CreateCondBr(greater_equal, greater_equal_block, next_block);
 
 		llvm_ir_builder.SetInsertPoint(greater_equal_block);
-		CreateNextCallRet(llvm_ir_builder, state_ptr, node.next_sequence_end);
+		CreateNextCallRet(llvm_ir_builder, state_ptr, str_begin_value, str_end_value, node.next_sequence_end);
 
 		llvm_ir_builder.SetInsertPoint(next_block);
 	}
@@ -1460,28 +2619,48 @@ void Generator::BuildNodeFunctionBodyImpl(
 		branches[1]= node.next_iteration;
 	}
 
-	SaveState(llvm_ir_builder, state_ptr, state_backup_ptr);
-	const auto first_call_res= llvm_ir_builder.CreateCall(GetOrCreateNodeFunction(branches[0]), {state_ptr});
-
-	const auto ok_block= llvm::BasicBlock::Create(context_, "", function);
-	const auto next_block= llvm::BasicBlock::Create(context_, "", function);
-
-	llvm_ir_builder.CreateCondBr(first_call_res, ok_block, next_block);
-
-	llvm_ir_builder.SetInsertPoint(ok_block);
-	llvm_ir_builder.CreateRet(llvm::ConstantInt::getTrue(context_));
-
-	llvm_ir_builder.SetInsertPoint(next_block);
-	RestoreState(llvm_ir_builder, state_ptr, state_backup_ptr);
-	CreateNextCallRet(llvm_ir_builder, state_ptr, branches[1]);
+	CreateNextAlternativesCallRet(llvm_ir_builder, state_ptr, str_begin_value, str_end_value, branches);
 }
 
 void Generator::BuildNodeFunctionBodyImpl(
-	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, const GraphElements::PossessiveSequence& node)
+	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, llvm::Value* const str_begin_value, llvm::Value* const str_end_value, const GraphElements::PossessiveSequence& node)
 {
 	const auto function= llvm_ir_builder.GetInsertBlock()->getParent();
 
-	const auto state_backup_ptr= llvm_ir_builder.CreateAlloca(state_type_, 0, "state_backup");
+	// Number of elements in span is known only for elements with same length.
+	const auto span_function= GetSpanFunction(node.sequence_element);
+	if(span_function != std::nullopt &&
+		(span_function->element_length != 0 || (node.max_elements == Sequence::c_max && node.min_elements <= 1)))
+	{
+		// Each element is single class check - skip all matching code points at once.
+		const auto span_end= CreateSpanCall(llvm_ir_builder, *span_function, str_begin_value, str_end_value, node.max_elements);
+		if(node.min_elements > 0)
+		{
+			const auto not_enough_elements_condition=
+				span_function->element_length == 0
+					? llvm_ir_builder.CreateICmpEQ(span_end, str_begin_value, "less_than_needed")
+					: llvm_ir_builder.CreateICmpULT(
+						llvm_ir_builder.CreatePtrDiff(char_type_, span_end, str_begin_value, "span_size"),
+						GetConstant(ptr_size_int_type_, node.min_elements * span_function->element_length),
+						"less_than_needed");
+
+			const auto ret_false_block= llvm::BasicBlock::Create(context_, "ret_false", function);
+			const auto end_block= llvm::BasicBlock::Create(context_, "end", function);
+			llvm_ir_builder.CreateCondBr(not_enough_elements_condition, ret_false_block, end_block);
+
+			// Ret false block.
+			llvm_ir_builder.SetInsertPoint(ret_false_block);
+			CreateFailRet(llvm_ir_builder);
+
+			// End block.
+			llvm_ir_builder.SetInsertPoint(end_block);
+		}
+		CreateNextCallRet(llvm_ir_builder, state_ptr, span_end, str_end_value, node.next);
+		return;
+	}
+
+	const auto state_backup_ptr= CreateStateAlloca(llvm_ir_builder, "state_backup");
+	const StateFieldsSet fields_to_restore= GetFieldsToRestore({node.sequence_element}, {node.next});
 
 	const auto counter_value_initial= llvm::ConstantInt::getNullValue(ptr_size_int_type_);
 
@@ -1497,6 +2676,8 @@ void Generator::BuildNodeFunctionBodyImpl(
 
 	const auto counter_value_current= llvm_ir_builder.CreatePHI(ptr_size_int_type_, 2, "counter_value_current");
 	counter_value_current->addIncoming(counter_value_initial, start_block);
+	const auto str_begin_current= llvm_ir_builder.CreatePHI(char_type_ptr_, 2, "str_begin_current");
+	str_begin_current->addIncoming(str_begin_value, start_block);
 	if(node.max_elements < Sequence::c_max)
 	{
 		const auto loop_end_condition=
@@ -1512,13 +2693,14 @@ void Generator::BuildNodeFunctionBodyImpl(
 	// Iteration block.
 	llvm_ir_builder.SetInsertPoint(iteration_block);
 
-	SaveState(llvm_ir_builder, state_ptr, state_backup_ptr);
-	const auto call_res= llvm_ir_builder.CreateCall(GetOrCreateNodeFunction(node.sequence_element), {state_ptr});
+	SaveState(llvm_ir_builder, state_ptr, state_backup_ptr, fields_to_restore);
+	const auto call_res= CreateNodeCall(llvm_ir_builder, state_ptr, str_begin_current, str_end_value, node.sequence_element);
+	call_res->setName("element_end");
 
 	const auto ok_block= llvm::BasicBlock::Create(context_, "ok", function);
 	const auto fail_block= llvm::BasicBlock::Create(context_, "fail", function);
 
-	llvm_ir_builder.CreateCondBr(call_res, ok_block, fail_block);
+	llvm_ir_builder.CreateCondBr(llvm_ir_builder.CreateIsNull(call_res), fail_block, ok_block);
 
 	// Ok block.
 	llvm_ir_builder.SetInsertPoint(ok_block);
@@ -1526,12 +2708,13 @@ void Generator::BuildNodeFunctionBodyImpl(
 	const auto counter_value_next=
 		llvm_ir_builder.CreateAdd(counter_value_current, GetConstant(ptr_size_int_type_, 1), "counter_value_next", no_unsiged_wrap);
 	counter_value_current->addIncoming(counter_value_next, ok_block);
+	str_begin_current->addIncoming(call_res, ok_block);
 
 	llvm_ir_builder.CreateBr(counter_check_block);
 
 	// Fail block.
 	llvm_ir_builder.SetInsertPoint(fail_block);
-	RestoreState(llvm_ir_builder, state_ptr, state_backup_ptr);
+	RestoreState(llvm_ir_builder, state_ptr, state_backup_ptr, fields_to_restore);
 
 	if(node.min_elements > 0)
 	{
@@ -1543,7 +2726,7 @@ void Generator::BuildNodeFunctionBodyImpl(
 
 		// Ret false block.
 		llvm_ir_builder.SetInsertPoint(ret_false_block);
-		llvm_ir_builder.CreateRet(llvm::ConstantInt::getFalse(context_));
+		CreateFailRet(llvm_ir_builder);
 	}
 	else
 		llvm_ir_builder.CreateBr(end_block);
@@ -1551,111 +2734,189 @@ void Generator::BuildNodeFunctionBodyImpl(
 	// End block.
 	end_block->insertInto(function);
 	llvm_ir_builder.SetInsertPoint(end_block);
-	CreateNextCallRet(llvm_ir_builder, state_ptr, node.next);
+	CreateNextCallRet(llvm_ir_builder, state_ptr, str_begin_current, str_end_value, node.next);
 }
 
 void Generator::BuildNodeFunctionBodyImpl(
-	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, const GraphElements::SingleRollbackPointSequence& node)
+	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, llvm::Value* const str_begin_value, llvm::Value* const str_end_value, const GraphElements::SingleRollbackPointSequence& node)
 {
 	const auto function= llvm_ir_builder.GetInsertBlock()->getParent();
 
-	const auto state_backup_ptr= llvm_ir_builder.CreateAlloca(state_type_, 0, "state_backup");
-	const auto state_next_ptr= llvm_ir_builder.CreateAlloca(state_type_, 0, "state_next");
+	const auto state_backup_ptr= CreateStateAlloca(llvm_ir_builder, "state_backup");
+	const auto state_next_ptr= CreateStateAlloca(llvm_ir_builder, "state_next");
+	const StateFieldsSet fields_to_restore= GetFieldsToRestore({node.next}, {node.sequence_element, node.next});
+	// Restore all fields, changed after last successfull next node call.
+	StateFieldsSet next_state_fields= state_fields_liveness_.modified_fields.at(node.next);
+	Unite(next_state_fields, state_fields_liveness_.modified_fields.at(node.sequence_element));
 
-	// Store nullptr inside state_next.str_begin to indicate non-existing next state.
-	const auto next_str_begin_ptr= llvm_ir_builder.CreateGEP(state_type_, state_next_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(StateFieldIndex::StrBegin)});
-	const auto null_ptr= llvm::ConstantInt::getNullValue(char_type_ptr_);
-	llvm_ir_builder.CreateStore(null_ptr, next_str_begin_ptr);
+	// Counter is necessary only for sequences with limited number of elements.
+	const bool has_min= node.min_elements > 0;
+	const bool has_max= node.max_elements < Sequence::c_max;
 
+	const auto loop_block= llvm::BasicBlock::Create(context_, "loop", function);
 	const auto next_check_block= llvm::BasicBlock::Create(context_, "next_check_block", function);
 	const auto save_next_state_block= llvm::BasicBlock::Create(context_, "save_next_state", function);
+	const auto restore_state_block= llvm::BasicBlock::Create(context_, "restore_state", function);
 	const auto sequence_element_check_block= llvm::BasicBlock::Create(context_, "sequence_element_check", function);
+	const auto sequence_element_call_block= has_max ? llvm::BasicBlock::Create(context_, "sequence_element_call", function) : sequence_element_check_block;
 	const auto loop_end_block= llvm::BasicBlock::Create(context_, "loop_end", function);
 	const auto ret_true_block= llvm::BasicBlock::Create(context_, "ret_true", function);
 	const auto ret_false_block= llvm::BasicBlock::Create(context_, "ret_false", function);
 
-	llvm_ir_builder.CreateBr(next_check_block);
+	const auto start_block= llvm_ir_builder.GetInsertBlock();
+	llvm_ir_builder.CreateBr(loop_block);
+
+	// Loop block.
+	llvm_ir_builder.SetInsertPoint(loop_block);
+	const auto str_begin_current= llvm_ir_builder.CreatePHI(char_type_ptr_, 2, "str_begin_current");
+	str_begin_current->addIncoming(str_begin_value, start_block);
+	// Result of last successfull next node call. Null indicates non-existing next state.
+	const auto next_res_current= llvm_ir_builder.CreatePHI(char_type_ptr_, 2, "next_res_current");
+	next_res_current->addIncoming(GetNullStrPtr(), start_block);
+	llvm::PHINode* counter_current= nullptr;
+	if(has_min || has_max)
+	{
+		counter_current= llvm_ir_builder.CreatePHI(ptr_size_int_type_, 2, "counter_current");
+		counter_current->addIncoming(llvm::ConstantInt::getNullValue(ptr_size_int_type_), start_block);
+	}
+
+	if(has_min)
+		llvm_ir_builder.CreateCondBr(
+			llvm_ir_builder.CreateICmpUGE(counter_current, GetConstant(ptr_size_int_type_, node.min_elements)),
+			next_check_block,
+			sequence_element_check_block);
+	else
+		llvm_ir_builder.CreateBr(next_check_block);
 
 	// Next check block.
 	llvm_ir_builder.SetInsertPoint(next_check_block);
-	SaveState(llvm_ir_builder, state_ptr, state_backup_ptr);
-	const auto next_is_ok= llvm_ir_builder.CreateCall(GetOrCreateNodeFunction(node.next), {state_ptr});
-	llvm_ir_builder.CreateCondBr(next_is_ok, save_next_state_block, sequence_element_check_block);
+	SaveState(llvm_ir_builder, state_ptr, state_backup_ptr, fields_to_restore);
+	const auto next_res= CreateNodeCall(llvm_ir_builder, state_ptr, str_begin_current, str_end_value, node.next);
+	next_res->setName("next_res");
+	llvm_ir_builder.CreateCondBr(llvm_ir_builder.CreateIsNull(next_res), restore_state_block, save_next_state_block);
 
 	// Save next state block.
 	llvm_ir_builder.SetInsertPoint(save_next_state_block);
-	SaveState(llvm_ir_builder, state_ptr, state_next_ptr);
+	SaveState(llvm_ir_builder, state_ptr, state_next_ptr, next_state_fields);
+	llvm_ir_builder.CreateBr(restore_state_block);
+
+	// Restore state block.
+	llvm_ir_builder.SetInsertPoint(restore_state_block);
+	const auto next_res_after_check= llvm_ir_builder.CreatePHI(char_type_ptr_, 2, "next_res_after_check");
+	next_res_after_check->addIncoming(next_res_current, next_check_block);
+	next_res_after_check->addIncoming(next_res, save_next_state_block);
+	RestoreState(llvm_ir_builder, state_ptr, state_backup_ptr, fields_to_restore);
 	llvm_ir_builder.CreateBr(sequence_element_check_block);
 
 	// Sequence element check block.
 	llvm_ir_builder.SetInsertPoint(sequence_element_check_block);
-	RestoreState(llvm_ir_builder, state_ptr, state_backup_ptr);
-	const auto sequence_element_is_ok= llvm_ir_builder.CreateCall(GetOrCreateNodeFunction(node.sequence_element), {state_ptr});
-	llvm_ir_builder.CreateCondBr(sequence_element_is_ok, next_check_block, loop_end_block);
+	const auto next_res_last= llvm_ir_builder.CreatePHI(char_type_ptr_, 2, "next_res_last");
+	next_res_last->addIncoming(next_res_after_check, restore_state_block);
+	if(has_min)
+		next_res_last->addIncoming(next_res_current, loop_block);
+
+	if(has_max)
+	{
+		llvm_ir_builder.CreateCondBr(
+			llvm_ir_builder.CreateICmpEQ(counter_current, GetConstant(ptr_size_int_type_, node.max_elements)),
+			loop_end_block,
+			sequence_element_call_block);
+
+		llvm_ir_builder.SetInsertPoint(sequence_element_call_block);
+	}
+
+	const auto element_end= CreateNodeCall(llvm_ir_builder, state_ptr, str_begin_current, str_end_value, node.sequence_element);
+	element_end->setName("element_end");
+	const auto element_end_block= llvm_ir_builder.GetInsertBlock();
+	str_begin_current->addIncoming(element_end, element_end_block);
+	next_res_current->addIncoming(next_res_last, element_end_block);
+	if(counter_current != nullptr)
+		counter_current->addIncoming(
+			llvm_ir_builder.CreateAdd(counter_current, GetConstant(ptr_size_int_type_, 1), "counter_next"),
+			element_end_block);
+	llvm_ir_builder.CreateCondBr(llvm_ir_builder.CreateIsNull(element_end), loop_end_block, loop_block);
 
 	// End block.
 	llvm_ir_builder.SetInsertPoint(loop_end_block);
-	const auto next_str_begin= llvm_ir_builder.CreateLoad(char_type_ptr_, next_str_begin_ptr, "next_str_begin");
-	const auto next_str_begin_is_null= llvm_ir_builder.CreateICmpEQ(next_str_begin, null_ptr);
-	llvm_ir_builder.CreateCondBr(next_str_begin_is_null, ret_false_block, ret_true_block);
+	llvm_ir_builder.CreateCondBr(llvm_ir_builder.CreateIsNull(next_res_last), ret_false_block, ret_true_block);
 
 	// Ret true block.
 	llvm_ir_builder.SetInsertPoint(ret_true_block);
-	RestoreState(llvm_ir_builder, state_ptr, state_next_ptr);
-	llvm_ir_builder.CreateRet(llvm::ConstantInt::getTrue(context_));
+	RestoreState(llvm_ir_builder, state_ptr, state_next_ptr, next_state_fields);
+	llvm_ir_builder.CreateRet(next_res_last);
 
 	// Ret false block.
 	llvm_ir_builder.SetInsertPoint(ret_false_block);
-	llvm_ir_builder.CreateRet(llvm::ConstantInt::getFalse(context_));
+	CreateFailRet(llvm_ir_builder);
 }
 
 void Generator::BuildNodeFunctionBodyImpl(
-	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, const GraphElements::FixedLengthElementSequence& node)
+	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, llvm::Value* const str_begin_value, llvm::Value* const str_end_value, const GraphElements::FixedLengthElementSequence& node)
 {
 	const auto function= llvm_ir_builder.GetInsertBlock()->getParent();
 
-	const auto state_backup_ptr= llvm_ir_builder.CreateAlloca(state_type_, 0, "state_backup");
-
-	const auto str_begin_ptr= llvm_ir_builder.CreateGEP(state_type_, state_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(StateFieldIndex::StrBegin)}, "str_begin_ptr");
-	const auto str_begin_value= llvm_ir_builder.CreateLoad(char_type_ptr_, str_begin_ptr, "str_begin_initial");
+	const auto state_backup_ptr= CreateStateAlloca(llvm_ir_builder, "state_backup");
+	const StateFieldsSet fields_to_restore= GetFieldsToRestore({node.next}, {node.next});
 
 	const auto start_block= llvm_ir_builder.GetInsertBlock();
-	const auto extract_element_loop_block= llvm::BasicBlock::Create(context_, "extract_element", function);
-	const auto sequence_counter_increase_block= llvm::BasicBlock::Create(context_, "counter_increase", function);
+	const auto extract_element_loop_block= llvm::BasicBlock::Create(context_, "extract_element");
+	const auto sequence_counter_increase_block= llvm::BasicBlock::Create(context_, "counter_increase");
 	const auto block_after_extract_loop= llvm::BasicBlock::Create(context_, "block_after_extract_loop", function);
 	const auto tail_check_block= llvm::BasicBlock::Create(context_, "tail_check", function);
 	const auto tail_check_continue_block= llvm::BasicBlock::Create(context_, "tail_check_continue", function);
 	const auto ret_true_block= llvm::BasicBlock::Create(context_, "ret_true", function);
 	const auto ret_false_block= llvm::BasicBlock::Create(context_, "ret_false", function);
 
-	llvm_ir_builder.CreateBr(extract_element_loop_block);
-
-	llvm::Value* counter_value_for_extract_element_block= nullptr;
-	llvm::Value* counter_value_for_counter_increase_block= nullptr;
+	// Pairs of counter value and block for counter after extract loop.
+	llvm::SmallVector<std::pair<llvm::Value*, llvm::BasicBlock*>, 2> counter_values_after_extract_loop;
 
+	const auto span_function= GetSpanFunction(node.sequence_element);
+	if(span_function != std::nullopt && span_function->element_length == node.element_length)
+	{
+		// Each element is single class check - find all elements at once.
+		delete extract_element_loop_block;
+		delete sequence_counter_increase_block;
+
+		const auto span_end= CreateSpanCall(llvm_ir_builder, *span_function, str_begin_value, str_end_value, node.max_elements);
+		const auto span_size= llvm_ir_builder.CreatePtrDiff(char_type_, span_end, str_begin_value, "span_size");
+		const auto counter_value=
+			node.element_length == 1
+				? span_size
+				: llvm_ir_builder.CreateExactUDiv(span_size, GetConstant(ptr_size_int_type_, node.element_length), "span_elements");
+		counter_values_after_extract_loop.emplace_back(counter_value, start_block);
+		llvm_ir_builder.CreateBr(block_after_extract_loop);
+	}
+	else
 	{
+		extract_element_loop_block->insertInto(function, block_after_extract_loop);
+		sequence_counter_increase_block->insertInto(function, block_after_extract_loop);
+		llvm_ir_builder.CreateBr(extract_element_loop_block);
+
 		// extract_element_loop_block
 		llvm_ir_builder.SetInsertPoint(extract_element_loop_block);
 		const auto counter_value= llvm_ir_builder.CreatePHI(ptr_size_int_type_, 0, "counter_value_for_extract_element_block");
 		counter_value->addIncoming(GetConstant(ptr_size_int_type_, 0), start_block);
-		counter_value_for_extract_element_block= counter_value;
+		counter_values_after_extract_loop.emplace_back(counter_value, extract_element_loop_block);
 
-		// No need to update "str_begin" here, because in case if successfull previous iteration match it will advanced exactly by "element_length" bytes.
+		const auto str_begin_current= llvm_ir_builder.CreatePHI(char_type_ptr_, 2, "str_begin_current");
+		str_begin_current->addIncoming(str_begin_value, start_block);
 
-		const auto call_res= llvm_ir_builder.CreateCall(GetOrCreateNodeFunction(node.sequence_element), {state_ptr});
-		llvm_ir_builder.CreateCondBr(call_res, sequence_counter_increase_block, block_after_extract_loop);
+		const auto call_res= CreateNodeCall(llvm_ir_builder, state_ptr, str_begin_current, str_end_value, node.sequence_element);
+		call_res->setName("element_end");
+		llvm_ir_builder.CreateCondBr(llvm_ir_builder.CreateIsNull(call_res), block_after_extract_loop, sequence_counter_increase_block);
 
 		// sequence_counter_increase_block
 		llvm_ir_builder.SetInsertPoint(sequence_counter_increase_block);
 		const auto counter_value_next= llvm_ir_builder.CreateAdd(counter_value, GetConstant(ptr_size_int_type_, 1), "counter_value_next", no_unsiged_wrap);
 		counter_value->addIncoming(counter_value_next, sequence_counter_increase_block);
+		str_begin_current->addIncoming(call_res, sequence_counter_increase_block);
 
 		if(node.max_elements == Sequence::c_max)
 			llvm_ir_builder.CreateBr(extract_element_loop_block);
 		else
 		{
-			counter_value_for_counter_increase_block= counter_value_next;
-			const auto loop_continue_condition= llvm_ir_builder.CreateICmpULT(counter_value_next, GetConstant(ptr_size_int_type_, node.max_elements * node.element_length));
+			counter_values_after_extract_loop.emplace_back(counter_value_next, sequence_counter_increase_block);
+			const auto loop_continue_condition= llvm_ir_builder.CreateICmpULT(counter_value_next, GetConstant(ptr_size_int_type_, node.max_elements));
 			llvm_ir_builder.CreateCondBr(loop_continue_condition, extract_element_loop_block, block_after_extract_loop);
 		}
 	}
@@ -1663,28 +2924,32 @@ void Generator::BuildNodeFunctionBodyImpl(
 	// block_after_extract_loop
 	llvm_ir_builder.SetInsertPoint(block_after_extract_loop);
 	const auto counter_value= llvm_ir_builder.CreatePHI(ptr_size_int_type_, 0, "counter_value_for_end_loop");
-	counter_value->addIncoming(counter_value_for_extract_element_block, extract_element_loop_block);
-	if(counter_value_for_counter_increase_block != nullptr)
-		counter_value->addIncoming(counter_value_for_counter_increase_block, sequence_counter_increase_block);
+	for(const auto& counter_value_pair : counter_values_after_extract_loop)
+		counter_value->addIncoming(counter_value_pair.first, counter_value_pair.second);
 
 	const auto tail_check=
 	[&]
 	{
-		SaveState(llvm_ir_builder, state_ptr, state_backup_ptr);
+		SaveState(llvm_ir_builder, state_ptr, state_backup_ptr, fields_to_restore);
 
-		const auto str_begin_for_current_iteration= llvm_ir_builder.CreateGEP(char_type_, str_begin_value, counter_value, "str_begin_for_current_iteration");
-		llvm_ir_builder.CreateStore(str_begin_for_current_iteration, str_begin_ptr);
+		// Each element has exactly "element_length" code units, so, it is possible to calculate position without storing it for each element.
+		const auto str_begin_for_current_iteration=
+			llvm_ir_builder.CreateGEP(
+				char_type_,
+				str_begin_value,
+				llvm_ir_builder.CreateMul(counter_value, GetConstant(ptr_size_int_type_, node.element_length), "", no_unsiged_wrap),
+				"str_begin_for_current_iteration");
 
-		const auto call_res= llvm_ir_builder.CreateCall(GetOrCreateNodeFunction(node.next), {state_ptr});
-		llvm_ir_builder.CreateCondBr(call_res, ret_true_block, tail_check_continue_block);
+		const auto call_res= CreateNodeCall(llvm_ir_builder, state_ptr, str_begin_for_current_iteration, str_end_value, node.next);
+		llvm_ir_builder.CreateCondBr(llvm_ir_builder.CreateIsNull(call_res), tail_check_continue_block, ret_true_block);
 
 		// Ret true block.
 		llvm_ir_builder.SetInsertPoint(ret_true_block);
-		llvm_ir_builder.CreateRet(llvm::ConstantInt::getTrue(context_));
+		llvm_ir_builder.CreateRet(call_res);
 
 		// tail_check_continue_block
 		llvm_ir_builder.SetInsertPoint(tail_check_continue_block);
-		RestoreState(llvm_ir_builder, state_ptr, state_backup_ptr);
+		RestoreState(llvm_ir_builder, state_ptr, state_backup_ptr, fields_to_restore);
 	};
 
 	if(node.min_elements > 0)
@@ -1693,19 +2958,19 @@ void Generator::BuildNodeFunctionBodyImpl(
 		while(counter >= node.min_elements)
 		{
 			SaveState();
-			state.str_begin= str_begin + count * length;
-			if(MatchNode(next))
+			str_begin_current= str_begin + count * length;
+			if(const auto res= MatchNode(next, str_begin_current))
 			{
-				return true;
+				return res;
 			}
 			RestoreState();
 			--counter;
 			continue;
 		}
-		return false;
+		return null;
 		*/
 
-		const auto loop_continue_condition= llvm_ir_builder.CreateICmpUGE(counter_value, GetConstant(ptr_size_int_type_, node.min_elements * node.element_length));
+		const auto loop_continue_condition= llvm_ir_builder.CreateICmpUGE(counter_value, GetConstant(ptr_size_int_type_, node.min_elements));
 		llvm_ir_builder.CreateCondBr(loop_continue_condition, tail_check_block, ret_false_block);
 
 		// tail_check_block
@@ -1719,14 +2984,14 @@ void Generator::BuildNodeFunctionBodyImpl(
 		while(true)
 		{
 			SaveState();
-			state.str_begin= str_begin + count * length;
-			if(MatchNode(next))
+			str_begin_current= str_begin + count * length;
+			if(const auto res= MatchNode(next, str_begin_current))
 			{
-				return true;
+				return res;
 			}
 			RestoreState();
 			if(counter == 0)
-				return false;
+				return null;
 			--counter;
 			continue;
 		}
@@ -1742,37 +3007,38 @@ void Generator::BuildNodeFunctionBodyImpl(
 		tail_check_block->setName("counter_decrease_block");
 	}
 
-	const auto counter_value_next= llvm_ir_builder.CreateSub(counter_value, GetConstant(ptr_size_int_type_, node.element_length), "counter_value_next", no_unsiged_wrap);
+	const auto counter_value_next= llvm_ir_builder.CreateSub(counter_value, GetConstant(ptr_size_int_type_, 1), "counter_value_next", no_unsiged_wrap);
 	counter_value->addIncoming(counter_value_next, llvm_ir_builder.GetInsertBlock());
 	llvm_ir_builder.CreateBr(block_after_extract_loop);
 
 	// Ret false block.
 	llvm_ir_builder.SetInsertPoint(ret_false_block);
-	llvm_ir_builder.CreateRet(llvm::ConstantInt::getFalse(context_));
+	CreateFailRet(llvm_ir_builder);
 }
 
 void Generator::BuildNodeFunctionBodyImpl(
-	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, const GraphElements::AtomicGroup& node)
+	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, llvm::Value* const str_begin_value, llvm::Value* const str_end_value, const GraphElements::AtomicGroup& node)
 {
 	const auto function= llvm_ir_builder.GetInsertBlock()->getParent();
 
-	const auto call_res= llvm_ir_builder.CreateCall(GetOrCreateNodeFunction(node.group_element), {state_ptr});
+	const auto call_res= CreateNodeCall(llvm_ir_builder, state_ptr, str_begin_value, str_end_value, node.group_element);
+	call_res->setName("group_element_end");
 
 	const auto ok_block= llvm::BasicBlock::Create(context_, "ok", function);
 	const auto fail_block= llvm::BasicBlock::Create(context_, "fail", function);
-	llvm_ir_builder.CreateCondBr(call_res, ok_block, fail_block);
+	llvm_ir_builder.CreateCondBr(llvm_ir_builder.CreateIsNull(call_res), fail_block, ok_block);
 
-	// Ok block.
+	// Ok block - continue from group element end.
 	llvm_ir_builder.SetInsertPoint(ok_block);
-	CreateNextCallRet(llvm_ir_builder, state_ptr, node.next);
+	CreateNextCallRet(llvm_ir_builder, state_ptr, call_res, str_end_value, node.next);
 
 	// Fail block.
 	llvm_ir_builder.SetInsertPoint(fail_block);
-	llvm_ir_builder.CreateRet(llvm::ConstantInt::getFalse(context_));
+	CreateFailRet(llvm_ir_builder);
 }
 
 void Generator::BuildNodeFunctionBodyImpl(
-	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, const GraphElements::SubroutineEnter& node)
+	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, llvm::Value* const str_begin_value, llvm::Value* const str_end_value, const GraphElements::SubroutineEnter& node)
 {
 	const auto subroutine_call_return_chain_node=
 		llvm_ir_builder.CreateAlloca(subroutine_call_return_chain_node_type_, 0, "subroutine_call_return_chain_node");
@@ -1797,11 +3063,11 @@ void Generator::BuildNodeFunctionBodyImpl(
 
 	llvm_ir_builder.CreateStore(subroutine_call_return_chain_node, prev_node_ptr);
 
-	CreateNextCallRet(llvm_ir_builder, state_ptr, node.subroutine_node);
+	CreateNextCallRet(llvm_ir_builder, state_ptr, str_begin_value, str_end_value, node.subroutine_node);
 }
 
 void Generator::BuildNodeFunctionBodyImpl(
-	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, const GraphElements::SubroutineLeave& node)
+	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, llvm::Value* const str_begin_value, llvm::Value* const str_end_value, const GraphElements::SubroutineLeave& node)
 {
 	(void)node;
 
@@ -1820,16 +3086,16 @@ void Generator::BuildNodeFunctionBodyImpl(
 			subroutine_call_return_chain_node_type_,
 			node_value,
 			{GetZeroGEPIndex(), GetFieldGEPIndex(SubroutineCallReturnChainNodeFieldIndex::Prev)});
-	const auto prev_node_value= llvm_ir_builder.CreateLoad(llvm::PointerType::get(node_function_type_, 0), prev_node_ptr);
+	const auto prev_node_value= llvm_ir_builder.CreateLoad(llvm::PointerType::get(subroutine_call_return_chain_node_type_, 0), prev_node_ptr);
 
 	llvm_ir_builder.CreateStore(prev_node_value, node_ptr);
 
-	const auto call_res= llvm_ir_builder.CreateCall(node_function_type_, next_function, {state_ptr});
+	const auto call_res= llvm_ir_builder.CreateCall(node_function_type_, next_function, {state_ptr, str_begin_value, str_end_value});
 	llvm_ir_builder.CreateRet(call_res);
 }
 
 void Generator::BuildNodeFunctionBodyImpl(
-	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, const GraphElements::StateSave& node)
+	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, llvm::Value* const str_begin_value, llvm::Value* const str_end_value, const GraphElements::StateSave& node)
 {
 	// Allocate node.
 	const auto subroutine_state_save_chain_node=
@@ -1915,11 +3181,11 @@ void Generator::BuildNodeFunctionBodyImpl(
 			GetConstant(gep_index_type_, data_layout.getTypeAllocSize(group_type_)));
 	}
 
-	CreateNextCallRet(llvm_ir_builder, state_ptr, node.next);
+	CreateNextCallRet(llvm_ir_builder, state_ptr, str_begin_value, str_end_value, node.next);
 }
 
 void Generator::BuildNodeFunctionBodyImpl(
-	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, const GraphElements::StateRestore& node)
+	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, llvm::Value* const str_begin_value, llvm::Value* const str_end_value, const GraphElements::StateRestore& node)
 {
 	const auto node_ptr= llvm_ir_builder.CreateGEP(state_type_, state_ptr, {GetZeroGEPIndex(), GetFieldGEPIndex(StateFieldIndex::SubroutineCallStateSaveChainHead)});
 	const auto node_value= llvm_ir_builder.CreateLoad(llvm::PointerType::get(subroutine_call_state_save_chain_node_type_, 0), node_ptr);
@@ -2001,27 +3267,1417 @@ void Generator::BuildNodeFunctionBodyImpl(
 			GetConstant(gep_index_type_, data_layout.getTypeAllocSize(group_type_)));
 	}
 
-	CreateNextCallRet(llvm_ir_builder, state_ptr, node.next);
+	CreateNextCallRet(llvm_ir_builder, state_ptr, str_begin_value, str_end_value, node.next);
+}
+
+std::pair<llvm::Value*, llvm::Value*> Generator::CreateCodePointExtraction(
+	IRBuilder& llvm_ir_builder,
+	llvm::Value* const str_begin_value,
+	llvm::Value* const str_end_value,
+	llvm::Value* const char_value,
+	llvm::BasicBlock* const not_enough_data_block)
+{
+	switch(encoding_)
+	{
+	case Encoding::UTF8:
+		if(utf8_validation_ != Utf8Validation::PerSymbol)
+			return CreateCodePointExtractionUTF8Trusted(llvm_ir_builder, str_begin_value, str_end_value, char_value, not_enough_data_block);
+		return CreateCodePointExtractionUTF8(llvm_ir_builder, str_begin_value, str_end_value, char_value, not_enough_data_block);
+	case Encoding::UTF16:
+		return CreateCodePointExtractionUTF16(llvm_ir_builder, str_begin_value, str_end_value, char_value, not_enough_data_block);
+	case Encoding::UTF32:
+	case Encoding::Bytes:
+		break;
+	};
+
+	// Code unit is code point.
+	return
+		std::make_pair(
+			llvm_ir_builder.CreateZExtOrTrunc(char_value, code_point_type_),
+			llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(1)));
+}
+
+std::pair<llvm::Value*, llvm::Value*> Generator::CreateCodePointExtractionUTF8(
+	IRBuilder& llvm_ir_builder,
+	llvm::Value* const str_begin_value,
+	llvm::Value* const str_end_value,
+	llvm::Value* const char_value,
+	llvm::BasicBlock* const not_enough_data_block)
+{
+	static const CharType c_bit_masks[9]=
+	{
+		(1 << 0) - 1,
+		(1 << 1) - 1,
+		(1 << 2) - 1,
+		(1 << 3) - 1,
+		(1 << 4) - 1,
+		(1 << 5) - 1,
+		(1 << 6) - 1,
+		(1 << 7) - 1,
+		(1 << 8) - 1,
+	};
+
+	const auto function= llvm_ir_builder.GetInsertBlock()->getParent();
+
+	const auto block_0= llvm::BasicBlock::Create(context_, "block_0", function);
+	const auto block_1_check= llvm::BasicBlock::Create(context_, "block_check1", function);
+	const auto block_1= llvm::BasicBlock::Create(context_, "block_1", function);
+	const auto block_1_after_size_check= llvm::BasicBlock::Create(context_, "block_1_after_size_check", function);
+	const auto block_2_check= llvm::BasicBlock::Create(context_, "block_2_check", function);
+	const auto block_2= llvm::BasicBlock::Create(context_, "block_2", function);
+	const auto block_2_after_size_check= llvm::BasicBlock::Create(context_, "block_2_after_size_check", function);
+	const auto block_3_check= llvm::BasicBlock::Create(context_, "block_3_check", function);
+	const auto block_3= llvm::BasicBlock::Create(context_, "block_3", function);
+	const auto block_3_after_size_check= llvm::BasicBlock::Create(context_, "block_3_after_size_check", function);
+	const auto block_invalid_utf8= llvm::BasicBlock::Create(context_, "block_invalid_utf8", function);
+	const auto extract_end_block= llvm::BasicBlock::Create(context_, "extract_end", function);
+
+	const auto first_char_value= llvm_ir_builder.CreateZExt(char_value, code_point_type_, "first_char_value");
+
+	// Block 0 check.
+	const auto and_mask0= llvm_ir_builder.CreateAnd(first_char_value, GetConstant(code_point_type_, 0b10000000));
+	const auto cond_0= llvm_ir_builder.CreateICmpEQ(and_mask0, GetConstant(code_point_type_, 0));
+	llvm_ir_builder.CreateCondBr(cond_0, block_0, block_1_check);
+
+	// Block 0.
+	llvm_ir_builder.SetInsertPoint(block_0);
+	const auto char_code0= first_char_value;
+	const auto str_begin0= llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(1), "str_begin0");
+	llvm_ir_builder.CreateBr(extract_end_block);
+
+	// Block 1 check.
+	llvm_ir_builder.SetInsertPoint(block_1_check);
+	const auto and_mask1= llvm_ir_builder.CreateAnd(first_char_value, GetConstant(code_point_type_, 0b11100000));
+	const auto cond_1= llvm_ir_builder.CreateICmpEQ(and_mask1, GetConstant(code_point_type_, 0b11000000));
+	llvm_ir_builder.CreateCondBr(cond_1, block_1, block_2_check);
+
+	// Block 1.
+	llvm_ir_builder.SetInsertPoint(block_1);
+	const auto str_begin1= llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(2), "str_begin1");
+	llvm_ir_builder.CreateCondBr(
+		llvm_ir_builder.CreateICmpULE(str_begin1, str_end_value),
+		block_1_after_size_check,
+		not_enough_data_block);
+
+	// Block 1 after size check.
+	llvm_ir_builder.SetInsertPoint(block_1_after_size_check);
+	const auto char_code1= [&]
+	{
+		const auto b0= first_char_value;
+		const auto b1=
+			llvm_ir_builder.CreateZExt(
+				llvm_ir_builder.CreateLoad(char_type_, llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(1))),
+				code_point_type_);
+		const auto and0= llvm_ir_builder.CreateAnd(b0, GetConstant(code_point_type_, c_bit_masks[5]));
+		const auto and1= llvm_ir_builder.CreateAnd(b1, GetConstant(code_point_type_, c_bit_masks[6]));
+		const auto shift0= llvm_ir_builder.CreateShl(and0, GetConstant(code_point_type_, 6));
+		const auto shift1= and1;
+		return llvm_ir_builder.CreateOr(shift0, shift1, "char_code1");
+	}();
+	llvm_ir_builder.CreateBr(extract_end_block);
+
+	// Block 2 check.
+	llvm_ir_builder.SetInsertPoint(block_2_check);
+	const auto and_mask2= llvm_ir_builder.CreateAnd(first_char_value, GetConstant(code_point_type_, 0b11110000));
+	const auto cond_2= llvm_ir_builder.CreateICmpEQ(and_mask2, GetConstant(code_point_type_, 0b11100000));
+	llvm_ir_builder.CreateCondBr(cond_2, block_2, block_3_check);
+
+	// Block 2.
+	llvm_ir_builder.SetInsertPoint(block_2);
+	const auto str_begin2= llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(3), "str_begin2");
+	llvm_ir_builder.CreateCondBr(
+		llvm_ir_builder.CreateICmpULE(str_begin2, str_end_value),
+		block_2_after_size_check,
+		not_enough_data_block);
+
+	// Block 2 after size check.
+	llvm_ir_builder.SetInsertPoint(block_2_after_size_check);
+	const auto char_code2= [&]
+	{
+		const auto b0= first_char_value;
+		const auto b1=
+			llvm_ir_builder.CreateZExt(
+				llvm_ir_builder.CreateLoad(char_type_, llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(1))),
+				code_point_type_);
+		const auto b2=
+			llvm_ir_builder.CreateZExt(
+				llvm_ir_builder.CreateLoad(char_type_, llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(2))),
+				code_point_type_);
+		const auto and0= llvm_ir_builder.CreateAnd(b0, GetConstant(code_point_type_, c_bit_masks[4]));
+		const auto and1= llvm_ir_builder.CreateAnd(b1, GetConstant(code_point_type_, c_bit_masks[6]));
+		const auto and2= llvm_ir_builder.CreateAnd(b2, GetConstant(code_point_type_, c_bit_masks[6]));
+		const auto shift0= llvm_ir_builder.CreateShl(and0, GetConstant(code_point_type_, 12));
+		const auto shift1= llvm_ir_builder.CreateShl(and1, GetConstant(code_point_type_,  6));
+		const auto shift2= and2;
+		return llvm_ir_builder.CreateOr(llvm_ir_builder.CreateOr(shift0, shift1), shift2, "char_code2");
+	}();
+	llvm_ir_builder.CreateBr(extract_end_block);
+
+	// Block 3 check.
+	llvm_ir_builder.SetInsertPoint(block_3_check);
+	const auto and_mask3= llvm_ir_builder.CreateAnd(first_char_value, GetConstant(code_point_type_, 0b11111000));
+	const auto cond_3= llvm_ir_builder.CreateICmpEQ(and_mask3, GetConstant(code_point_type_, 0b11110000));
+	llvm_ir_builder.CreateCondBr(cond_3, block_3, block_invalid_utf8);
+
+	// Block 3.
+	llvm_ir_builder.SetInsertPoint(block_3);
+	const auto str_begin3= llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(4), "str_begin2");
+	llvm_ir_builder.CreateCondBr(
+		llvm_ir_builder.CreateICmpULE(str_begin3, str_end_value),
+		block_3_after_size_check,
+		not_enough_data_block);
+
+	// Block 3 after size check.
+	llvm_ir_builder.SetInsertPoint(block_3_after_size_check);
+	const auto char_code3= [&]
+	{
+		const auto b0= first_char_value;
+		const auto b1=
+			llvm_ir_builder.CreateZExt(
+				llvm_ir_builder.CreateLoad(char_type_, llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(1))),
+				code_point_type_);
+		const auto b2=
+			llvm_ir_builder.CreateZExt(
+				llvm_ir_builder.CreateLoad(char_type_, llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(2))),
+				code_point_type_);
+		const auto b3=
+			llvm_ir_builder.CreateZExt(
+				llvm_ir_builder.CreateLoad(char_type_, llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(3))),
+				code_point_type_);
+		const auto and0= llvm_ir_builder.CreateAnd(b0, GetConstant(code_point_type_, c_bit_masks[3]));
+		const auto and1= llvm_ir_builder.CreateAnd(b1, GetConstant(code_point_type_, c_bit_masks[6]));
+		const auto and2= llvm_ir_builder.CreateAnd(b2, GetConstant(code_point_type_, c_bit_masks[6]));
+		const auto and3= llvm_ir_builder.CreateAnd(b3, GetConstant(code_point_type_, c_bit_masks[6]));
+		const auto shift0= llvm_ir_builder.CreateShl(and0, GetConstant(code_point_type_, 18));
+		const auto shift1= llvm_ir_builder.CreateShl(and1, GetConstant(code_point_type_, 12));
+		const auto shift2= llvm_ir_builder.CreateShl(and2, GetConstant(code_point_type_,  6));
+		const auto shift3= and3;
+		return llvm_ir_builder.CreateOr(llvm_ir_builder.CreateOr(shift0, shift1), llvm_ir_builder.CreateOr(shift2, shift3), "char_code3");
+	}();
+	llvm_ir_builder.CreateBr(extract_end_block);
+
+	// Invalid UTF-8 block.
+	llvm_ir_builder.SetInsertPoint(block_invalid_utf8);
+	const auto str_invalid_utf8= llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(1), "str_invalid_utf8");
+	llvm_ir_builder.CreateBr(extract_end_block);
+
+	// Extract end block.
+	llvm_ir_builder.SetInsertPoint(extract_end_block);
+
+	const auto result_char_value= llvm_ir_builder.CreatePHI(code_point_type_, 5, "result_char_value");
+	result_char_value->addIncoming(char_code0, block_0);
+	result_char_value->addIncoming(char_code1, block_1_after_size_check);
+	result_char_value->addIncoming(char_code2, block_2_after_size_check);
+	result_char_value->addIncoming(char_code3, block_3_after_size_check);
+	result_char_value->addIncoming(first_char_value, block_invalid_utf8);
+
+	const auto new_str_begin_value_phi= llvm_ir_builder.CreatePHI(char_type_ptr_, 5, "new_str_begin_value");
+	new_str_begin_value_phi->addIncoming(str_begin0, block_0);
+	new_str_begin_value_phi->addIncoming(str_begin1, block_1_after_size_check);
+	new_str_begin_value_phi->addIncoming(str_begin2, block_2_after_size_check);
+	new_str_begin_value_phi->addIncoming(str_begin3, block_3_after_size_check);
+	new_str_begin_value_phi->addIncoming(str_invalid_utf8, block_invalid_utf8);
+
+	return std::make_pair(result_char_value, new_str_begin_value_phi);
+}
+
+std::pair<llvm::Value*, llvm::Value*> Generator::CreateCodePointExtractionUTF8Trusted(
+	IRBuilder& llvm_ir_builder,
+	llvm::Value* const str_begin_value,
+	llvm::Value* const str_end_value,
+	llvm::Value* const char_value,
+	llvm::BasicBlock* const not_enough_data_block)
+{
+	// Input is valid UTF-8, so, all continuation bytes of a sequence are present.
+	// But search may start at continuation byte - in such case return this byte, like for invalid UTF-8.
+
+	const auto function= llvm_ir_builder.GetInsertBlock()->getParent();
+
+	const auto start_block= llvm_ir_builder.GetInsertBlock();
+	const auto multi_byte_block= llvm::BasicBlock::Create(context_, "multi_byte", function);
+	const auto multi_byte_after_size_check_block= llvm::BasicBlock::Create(context_, "multi_byte_after_size_check", function);
+	const auto block_2= llvm::BasicBlock::Create(context_, "block_2", function);
+	const auto block_3= llvm::BasicBlock::Create(context_, "block_3", function);
+	const auto block_4= llvm::BasicBlock::Create(context_, "block_4", function);
+	const auto extract_end_block= llvm::BasicBlock::Create(context_, "extract_end", function);
+
+	const auto first_char_value= llvm_ir_builder.CreateZExt(char_value, code_point_type_, "first_char_value");
+	const auto str_begin_next= llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(1), "str_begin_next");
+
+	// ASCII symbol or continuation byte.
+	llvm_ir_builder.CreateCondBr(
+		llvm_ir_builder.CreateICmpULT(first_char_value, GetConstant(code_point_type_, 0b11000000)),
+		extract_end_block,
+		multi_byte_block);
+
+	// Multi-byte block. Sequence length is number of leading ones of lead byte.
+	// Check string end, since search with non-zero start offset relies on validation of previous search and input may be actually invalid.
+	// Invalid lead bytes give length greater than 4, it's fine, since only bytes up to 4 are read.
+	llvm_ir_builder.SetInsertPoint(multi_byte_block);
+	const auto sequence_size=
+		llvm_ir_builder.CreateZExt(
+			llvm_ir_builder.CreateBinaryIntrinsic(llvm::Intrinsic::ctlz, llvm_ir_builder.CreateNot(char_value), llvm::ConstantInt::getFalse(context_)),
+			code_point_type_,
+			"sequence_size");
+	llvm_ir_builder.CreateCondBr(
+		llvm_ir_builder.CreateICmpULE(
+			llvm_ir_builder.CreateGEP(char_type_, str_begin_value, sequence_size, "sequence_end"),
+			str_end_value),
+		multi_byte_after_size_check_block,
+		not_enough_data_block);
+
+	llvm_ir_builder.SetInsertPoint(multi_byte_after_size_check_block);
+	const auto lead_bits=
+		llvm_ir_builder.CreateAnd(
+			first_char_value,
+			llvm_ir_builder.CreateLShr(GetConstant(code_point_type_, 0x7F), sequence_size));
+
+	const auto append_continuation_byte=
+	[&](llvm::Value* const code, const uint32_t index)
+	{
+		const auto b=
+			llvm_ir_builder.CreateZExt(
+				llvm_ir_builder.CreateLoad(char_type_, llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(index))),
+				code_point_type_);
+		return
+			llvm_ir_builder.CreateOr(
+				llvm_ir_builder.CreateShl(code, GetConstant(code_point_type_, 6)),
+				llvm_ir_builder.CreateAnd(b, GetConstant(code_point_type_, 0b00111111)));
+	};
+
+	const auto char_code2= append_continuation_byte(lead_bits, 1);
+	llvm_ir_builder.CreateCondBr(
+		llvm_ir_builder.CreateICmpEQ(sequence_size, GetConstant(code_point_type_, 2)),
+		block_2,
+		block_3);
+
+	llvm_ir_builder.SetInsertPoint(block_2);
+	const auto str_begin2= llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(2), "str_begin2");
+	llvm_ir_builder.CreateBr(extract_end_block);
+
+	llvm_ir_builder.SetInsertPoint(block_3);
+	const auto char_code3= append_continuation_byte(char_code2, 2);
+	const auto str_begin3= llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(3), "str_begin3");
+	llvm_ir_builder.CreateCondBr(
+		llvm_ir_builder.CreateICmpEQ(sequence_size, GetConstant(code_point_type_, 3)),
+		extract_end_block,
+		block_4);
+
+	llvm_ir_builder.SetInsertPoint(block_4);
+	const auto char_code4= append_continuation_byte(char_code3, 3);
+	const auto str_begin4= llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(4), "str_begin4");
+	llvm_ir_builder.CreateBr(extract_end_block);
+
+	// Extract end block.
+	llvm_ir_builder.SetInsertPoint(extract_end_block);
+
+	const auto result_char_value= llvm_ir_builder.CreatePHI(code_point_type_, 4, "result_char_value");
+	result_char_value->addIncoming(first_char_value, start_block);
+	result_char_value->addIncoming(char_code2, block_2);
+	result_char_value->addIncoming(char_code3, block_3);
+	result_char_value->addIncoming(char_code4, block_4);
+
+	const auto new_str_begin_value_phi= llvm_ir_builder.CreatePHI(char_type_ptr_, 4, "new_str_begin_value");
+	new_str_begin_value_phi->addIncoming(str_begin_next, start_block);
+	new_str_begin_value_phi->addIncoming(str_begin2, block_2);
+	new_str_begin_value_phi->addIncoming(str_begin3, block_3);
+	new_str_begin_value_phi->addIncoming(str_begin4, block_4);
+
+	return std::make_pair(result_char_value, new_str_begin_value_phi);
+}
+
+std::pair<llvm::Value*, llvm::Value*> Generator::CreateCodePointExtractionUTF16(
+	IRBuilder& llvm_ir_builder,
+	llvm::Value* const str_begin_value,
+	llvm::Value* const str_end_value,
+	llvm::Value* const char_value,
+	llvm::BasicBlock* const not_enough_data_block)
+{
+	const auto function= llvm_ir_builder.GetInsertBlock()->getParent();
+
+	const auto single_unit_block= llvm::BasicBlock::Create(context_, "single_unit", function);
+	const auto surrogate_pair_block= llvm::BasicBlock::Create(context_, "surrogate_pair", function);
+	const auto surrogate_pair_after_size_check= llvm::BasicBlock::Create(context_, "surrogate_pair_after_size_check", function);
+	const auto surrogate_pair_valid_block= llvm::BasicBlock::Create(context_, "surrogate_pair_valid", function);
+	const auto extract_end_block= llvm::BasicBlock::Create(context_, "extract_end", function);
+
+	const auto first_char_value= llvm_ir_builder.CreateZExt(char_value, code_point_type_, "first_char_value");
+
+	// Check for high surrogate.
+	const auto and_mask0= llvm_ir_builder.CreateAnd(first_char_value, GetConstant(code_point_type_, 0xFC00));
+	const auto is_high_surrogate= llvm_ir_builder.CreateICmpEQ(and_mask0, GetConstant(code_point_type_, 0xD800));
+	llvm_ir_builder.CreateCondBr(is_high_surrogate, surrogate_pair_block, single_unit_block);
+
+	// Single unit block. Process also unpaired low surrogates here.
+	llvm_ir_builder.SetInsertPoint(single_unit_block);
+	const auto str_begin_single= llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(1), "str_begin_single");
+	llvm_ir_builder.CreateBr(extract_end_block);
+
+	// Surrogate pair block.
+	llvm_ir_builder.SetInsertPoint(surrogate_pair_block);
+	const auto str_begin_pair= llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(2), "str_begin_pair");
+	llvm_ir_builder.CreateCondBr(
+		llvm_ir_builder.CreateICmpULE(str_begin_pair, str_end_value),
+		surrogate_pair_after_size_check,
+		not_enough_data_block);
+
+	// Surrogate pair after size check block.
+	llvm_ir_builder.SetInsertPoint(surrogate_pair_after_size_check);
+	const auto second_char_value=
+		llvm_ir_builder.CreateZExt(
+			llvm_ir_builder.CreateLoad(char_type_, llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetFieldGEPIndex(1))),
+			code_point_type_,
+			"second_char_value");
+	const auto and_mask1= llvm_ir_builder.CreateAnd(second_char_value, GetConstant(code_point_type_, 0xFC00));
+	const auto is_low_surrogate= llvm_ir_builder.CreateICmpEQ(and_mask1, GetConstant(code_point_type_, 0xDC00));
+	// Treat high surrogate without low surrogate as single unit.
+	llvm_ir_builder.CreateCondBr(is_low_surrogate, surrogate_pair_valid_block, single_unit_block);
+
+	// Surrogate pair valid block.
+	llvm_ir_builder.SetInsertPoint(surrogate_pair_valid_block);
+	const auto char_code_pair= [&]
+	{
+		const auto and0= llvm_ir_builder.CreateAnd(first_char_value , GetConstant(code_point_type_, 0x3FF));
+		const auto and1= llvm_ir_builder.CreateAnd(second_char_value, GetConstant(code_point_type_, 0x3FF));
+		const auto shift0= llvm_ir_builder.CreateShl(and0, GetConstant(code_point_type_, 10));
+		const auto combined= llvm_ir_builder.CreateOr(shift0, and1);
+		return llvm_ir_builder.CreateAdd(combined, GetConstant(code_point_type_, 0x10000), "char_code_pair");
+	}();
+	llvm_ir_builder.CreateBr(extract_end_block);
+
+	// Extract end block.
+	llvm_ir_builder.SetInsertPoint(extract_end_block);
+
+	const auto result_char_value= llvm_ir_builder.CreatePHI(code_point_type_, 2, "result_char_value");
+	result_char_value->addIncoming(first_char_value, single_unit_block);
+	result_char_value->addIncoming(char_code_pair, surrogate_pair_valid_block);
+
+	const auto new_str_begin_value= llvm_ir_builder.CreatePHI(char_type_ptr_, 2, "new_str_begin_value");
+	new_str_begin_value->addIncoming(str_begin_single, single_unit_block);
+	new_str_begin_value->addIncoming(str_begin_pair, surrogate_pair_valid_block);
+
+	return std::make_pair(result_char_value, new_str_begin_value);
+}
+
+CharType Generator::GetMaxSingleCodeUnitCodePoint() const
+{
+	switch(encoding_)
+	{
+	case Encoding::UTF8: return 0x7F;
+	case Encoding::UTF16: return 0xD7FF; // Code points after surrogates range are also single-unit, but this is not important.
+	case Encoding::UTF32: return std::numeric_limits<CharType>::max();
+	case Encoding::Bytes: return 0xFF;
+	};
+
+	assert(false);
+	return 0x7F;
+}
+
+std::vector<uint32_t> Generator::EncodeString(const std::string& str_utf8) const
+{
+	std::vector<uint32_t> result;
+	switch(encoding_)
+	{
+	case Encoding::UTF8:
+		for(const char c : str_utf8)
+			result.push_back(uint8_t(c));
+		break;
+	case Encoding::UTF16:
+		for(const char16_t c : Utf8ToUtf16(str_utf8))
+			result.push_back(c);
+		break;
+	case Encoding::UTF32:
+		for(const char32_t c : Utf8ToUtf32(str_utf8))
+			result.push_back(c);
+		break;
+	case Encoding::Bytes:
+		for(const char32_t c : Utf8ToUtf32(str_utf8))
+		{
+			assert(c <= 0xFF);
+			result.push_back(c);
+		}
+		break;
+	};
+
+	return result;
+}
+
+bool Generator::ShouldUseUtf8Automaton(const GraphElements::OneOf& node) const
+{
+	if(encoding_ != Encoding::UTF8)
+		return false;
+
+	// Inverse sets are checked via automaton too, since classes should not match invalid UTF-8 sequences and continuation bytes.
+	// But any symbol (empty inverse set) is checked via code point extraction, since it matches invalid bytes as single symbols.
+	if(node.inverse_flag)
+		return !(node.variants.empty() && node.ranges.empty());
+
+	// Sets of ASCII symbols are checked via comparisons of first byte.
+	for(const CharType c : node.variants)
+		if(c > 0x7F)
+			return true;
+	for(const auto& range : node.ranges)
+		if(range.second > 0x7F)
+			return true;
+
+	return false;
+}
+
+llvm::Function* Generator::GetOrCreateUtf8AutomatonFunction(const GraphElements::OneOf& node)
+{
+	const CodePointRanges ranges= GetNormalizedCodePointRanges(node);
+
+	const std::string function_name= "utf8_automaton" + GetCodePointRangesName(ranges);
+	if(const auto prev_function= module_.getFunction(function_name))
+		return prev_function;
+
+	const auto function_type= llvm::FunctionType::get(char_type_ptr_, {char_type_ptr_, char_type_ptr_}, false);
+	const auto function= llvm::Function::Create(function_type, llvm::GlobalValue::PrivateLinkage, function_name, module_);
+
+	const auto arg_begin= &*function->arg_begin();
+	const auto arg_end= &*std::next(function->arg_begin());
+	arg_begin->setName("begin");
+	arg_end->setName("end");
+
+	const std::vector<Utf8AutomatonState> states= Utf8AutomatonBuilder(ranges).TakeStates();
+
+	llvm::SmallVector<llvm::BasicBlock*, 64> state_blocks;
+	for(size_t i= 0; i < states.size(); ++i)
+		state_blocks.push_back(llvm::BasicBlock::Create(context_, "state" + std::to_string(i), function));
+
+	std::map<size_t, llvm::BasicBlock*> final_blocks; // Key - sequence length.
+	const auto fail_block= llvm::BasicBlock::Create(context_, "fail", function);
+
+	IRBuilder llvm_ir_builder(fail_block);
+	llvm_ir_builder.CreateRet(llvm::ConstantPointerNull::get(char_type_ptr_));
+
+	for(size_t i= 0; i < states.size(); ++i)
+	{
+		const Utf8AutomatonState& state= states[i];
+
+		// Split all bytes into segments with same target block.
+		std::vector< std::pair<uint32_t, llvm::BasicBlock*> > segments; // Segment begin and target.
+		const auto add_segment=
+			[&](const uint32_t begin, llvm::BasicBlock* const target)
+			{
+				if(segments.empty() || segments.back().second != target)
+					segments.emplace_back(begin, target);
+			};
+		uint32_t next_begin= 0;
+		for(const Utf8AutomatonState::Transition& transition : state.transitions)
+		{
+			if(transition.begin > next_begin)
+				add_segment(next_begin, fail_block);
+
+			llvm::BasicBlock* target= nullptr;
+			if(transition.next_state != std::nullopt)
+				target= state_blocks[*transition.next_state];
+			else
+			{
+				llvm::BasicBlock*& final_block= final_blocks[state.depth + 1];
+				if(final_block == nullptr)
+				{
+					final_block= llvm::BasicBlock::Create(context_, "final" + std::to_string(state.depth + 1), function);
+					llvm_ir_builder.SetInsertPoint(final_block);
+					llvm_ir_builder.CreateRet(llvm_ir_builder.CreateGEP(char_type_, arg_begin, GetFieldGEPIndex(uint32_t(state.depth + 1))));
+				}
+				target= final_block;
+			}
+
+			add_segment(transition.begin, target);
+			next_begin= uint32_t(transition.end) + 1;
+		}
+		if(next_begin < 256)
+			add_segment(next_begin, fail_block);
+
+		// State block - check string end and load byte.
+		llvm_ir_builder.SetInsertPoint(state_blocks[i]);
+		const auto byte_ptr= llvm_ir_builder.CreateGEP(char_type_, arg_begin, GetFieldGEPIndex(uint32_t(state.depth)));
+		const auto load_block= llvm::BasicBlock::Create(context_, "load", function);
+		llvm_ir_builder.CreateCondBr(llvm_ir_builder.CreateICmpULT(byte_ptr, arg_end), load_block, fail_block);
+
+		llvm_ir_builder.SetInsertPoint(load_block);
+		const auto byte_value= llvm_ir_builder.CreateLoad(char_type_, byte_ptr, "byte_value");
+
+		// Binary search of segment.
+		const std::function<void(size_t, size_t)> create_segments_search=
+			[&](const size_t begin, const size_t end)
+			{
+				if(end - begin == 1)
+				{
+					llvm_ir_builder.CreateBr(segments[begin].second);
+					return;
+				}
+
+				const size_t middle= (begin + end) / 2;
+				const auto lower_block= llvm::BasicBlock::Create(context_, "lower", function);
+				const auto upper_block= llvm::BasicBlock::Create(context_, "upper", function);
+				llvm_ir_builder.CreateCondBr(
+					llvm_ir_builder.CreateICmpULT(byte_value, GetConstant(char_type_, segments[middle].first)),
+					lower_block,
+					upper_block);
+
+				llvm_ir_builder.SetInsertPoint(lower_block);
+				create_segments_search(begin, middle);
+
+				llvm_ir_builder.SetInsertPoint(upper_block);
+				create_segments_search(middle, end);
+			};
+		create_segments_search(0, segments.size());
+	}
+
+	return function;
+}
+
+std::optional<SpanFunction> Generator::GetSpanFunction(const GraphElements::NodePtr sequence_element)
+{
+	if(sequence_element == nullptr)
+		return std::nullopt;
+
+	const auto one_of= std::get_if<GraphElements::OneOf>(sequence_element);
+	if(one_of == nullptr || one_of->next != nullptr)
+		return std::nullopt;
+
+	if(const auto byte_ranges= GetSingleByteClassRanges(*one_of))
+	{
+		SpanFunction span_function;
+		span_function.function= GetOrCreateSpanFunction(*byte_ranges);
+		span_function.element_length= 1;
+		return span_function;
+	}
+
+	if(ShouldUseUtf8Automaton(*one_of))
+	{
+		SpanFunction span_function;
+		span_function.function= GetOrCreateUtf8SpanFunction(*one_of);
+
+		// Ranges are sorted, so, all code points have same length if first and last code points have same length.
+		const CodePointRanges ranges= GetNormalizedCodePointRanges(*one_of);
+		if(!ranges.empty())
+		{
+			const size_t first_code_point_size= GetCodePointSize(ranges.front().first, Encoding::UTF8);
+			if(first_code_point_size == GetCodePointSize(ranges.back().second, Encoding::UTF8))
+				span_function.element_length= first_code_point_size;
+		}
+		return span_function;
+	}
+
+	return std::nullopt;
+}
+
+std::optional<CodePointRanges> Generator::GetSingleByteClassRanges(const GraphElements::OneOf& node) const
+{
+	const CodePointRanges ranges= GetMergedCodePointRanges(node);
+
+	if(encoding_ == Encoding::Bytes)
+	{
+		CodePointRanges byte_ranges;
+		for(const auto& range : ranges)
+			if(range.first <= 0xFF)
+				byte_ranges.emplace_back(range.first, std::min(range.second, CharType(0xFF)));
+
+		if(!node.inverse_flag)
+			return byte_ranges;
+
+		CodePointRanges inverse_byte_ranges;
+		CharType next_begin= 0;
+		for(const auto& range : byte_ranges)
+		{
+			if(range.first > next_begin)
+				inverse_byte_ranges.emplace_back(next_begin, range.first - 1);
+			next_begin= range.second + 1;
+		}
+		if(next_begin <= 0xFF)
+			inverse_byte_ranges.emplace_back(next_begin, 0xFF);
+		return inverse_byte_ranges;
+	}
+
+	// For UTF-8 only ASCII sets are single byte.
+	if(encoding_ == Encoding::UTF8 && !node.inverse_flag && (ranges.empty() || ranges.back().second <= 0x7F))
+		return ranges;
+
+	return std::nullopt;
+}
+
+llvm::Function* Generator::GetOrCreateSpanFunction(const CodePointRanges& byte_ranges)
+{
+	const std::string function_name= "span" + GetCodePointRangesName(byte_ranges);
+	if(const auto prev_function= module_.getFunction(function_name))
+		return prev_function;
+
+	const auto function_type= llvm::FunctionType::get(char_type_ptr_, {char_type_ptr_, char_type_ptr_}, false);
+	const auto function= llvm::Function::Create(function_type, llvm::GlobalValue::PrivateLinkage, function_name, module_);
+
+	const auto arg_begin= &*function->arg_begin();
+	const auto arg_end= &*std::next(function->arg_begin());
+	arg_begin->setName("begin");
+	arg_end->setName("end");
+
+	const auto byte_type= llvm::Type::getInt8Ty(context_);
+
+	const auto start_block= llvm::BasicBlock::Create(context_, "start", function);
+	const auto loop_block= llvm::BasicBlock::Create(context_, "loop", function);
+	const auto vector_check_block= llvm::BasicBlock::Create(context_, "vector_check", function);
+	const auto vector_next_block= llvm::BasicBlock::Create(context_, "vector_next", function);
+	const auto vector_found_block= llvm::BasicBlock::Create(context_, "vector_found", function);
+	const auto scalar_check_block= llvm::BasicBlock::Create(context_, "scalar_check", function);
+	const auto byte_check_block= llvm::BasicBlock::Create(context_, "byte_check", function);
+	const auto scalar_next_block= llvm::BasicBlock::Create(context_, "scalar_next", function);
+	const auto end_block= llvm::BasicBlock::Create(context_, "end", function);
+
+	IRBuilder llvm_ir_builder(start_block);
+	llvm_ir_builder.CreateBr(loop_block);
+
+	// Loop block.
+	llvm_ir_builder.SetInsertPoint(loop_block);
+	const auto pos= llvm_ir_builder.CreatePHI(char_type_ptr_, 2, "pos");
+	pos->addIncoming(arg_begin, start_block);
+	const auto remaining_size= llvm_ir_builder.CreatePtrDiff(char_type_, arg_end, pos, "remaining_size");
+
+	// Check 16 bytes at once. Each range check is single unsigned comparison of vector lanes.
+	// For targets without vector instructions LLVM splits vector operations into scalar operations.
+	const uint32_t vector_size= 16;
+	llvm_ir_builder.CreateCondBr(
+		llvm_ir_builder.CreateICmpUGE(remaining_size, GetConstant(ptr_size_int_type_, vector_size)),
+		vector_check_block,
+		scalar_check_block);
+
+	// Vector check block.
+	llvm_ir_builder.SetInsertPoint(vector_check_block);
+	const auto vector_type= llvm::FixedVectorType::get(byte_type, vector_size);
+	const auto vector_value=
+		llvm_ir_builder.CreateAlignedLoad(
+			vector_type,
+			llvm_ir_builder.CreateBitCast(pos, llvm::PointerType::get(vector_type, 0)),
+			llvm::MaybeAlign(1),
+			"vector_value");
+
+	const auto get_vector_constant=
+		[&](const CharType c)
+		{
+			return llvm::ConstantVector::getSplat(llvm::ElementCount::getFixed(vector_size), GetConstant(byte_type, c));
+		};
+
+	llvm::Value* in_set= llvm::Constant::getNullValue(llvm::FixedVectorType::get(llvm::Type::getInt1Ty(context_), vector_size));
+	for(const auto& range : byte_ranges)
+	{
+		llvm::Value* in_range= nullptr;
+		if(range.first == range.second)
+			in_range= llvm_ir_builder.CreateICmpEQ(vector_value, get_vector_constant(range.first));
+		else
+			in_range=
+				llvm_ir_builder.CreateICmpULE(
+					llvm_ir_builder.CreateSub(vector_value, get_vector_constant(range.first)),
+					get_vector_constant(range.second - range.first));
+		in_set= llvm_ir_builder.CreateOr(in_set, in_range);
+	}
+
+	// Get mask of bytes not in set (like "movemask" instruction) and find first such byte.
+	const auto mask_type= llvm::IntegerType::get(context_, vector_size);
+	const auto not_in_set_mask= llvm_ir_builder.CreateBitCast(llvm_ir_builder.CreateNot(in_set), mask_type, "not_in_set_mask");
+	llvm_ir_builder.CreateCondBr(
+		llvm_ir_builder.CreateICmpEQ(not_in_set_mask, llvm::ConstantInt::getNullValue(mask_type)),
+		vector_next_block,
+		vector_found_block);
+
+	// Vector next block.
+	llvm_ir_builder.SetInsertPoint(vector_next_block);
+	const auto pos_vector_next= llvm_ir_builder.CreateGEP(char_type_, pos, GetFieldGEPIndex(vector_size));
+	pos->addIncoming(pos_vector_next, vector_next_block);
+	llvm_ir_builder.CreateBr(loop_block);
+
+	// Vector found block.
+	llvm_ir_builder.SetInsertPoint(vector_found_block);
+	const auto first_not_in_set_index=
+		llvm_ir_builder.CreateBinaryIntrinsic(llvm::Intrinsic::cttz, not_in_set_mask, llvm::ConstantInt::getTrue(context_));
+	llvm_ir_builder.CreateRet(
+		llvm_ir_builder.CreateGEP(char_type_, pos, llvm_ir_builder.CreateZExt(first_not_in_set_index, ptr_size_int_type_)));
+
+	// Scalar check block - check remaining bytes one by one.
+	llvm_ir_builder.SetInsertPoint(scalar_check_block);
+	const auto scalar_pos= llvm_ir_builder.CreatePHI(char_type_ptr_, 2, "scalar_pos");
+	scalar_pos->addIncoming(pos, loop_block);
+	llvm_ir_builder.CreateCondBr(llvm_ir_builder.CreateICmpEQ(scalar_pos, arg_end), end_block, byte_check_block);
+
+	// Byte check block.
+	llvm_ir_builder.SetInsertPoint(byte_check_block);
+	const auto byte_value= llvm_ir_builder.CreateLoad(char_type_, scalar_pos, "byte_value");
+	CreateCodePointRangesCheck(llvm_ir_builder, byte_value, byte_ranges, scalar_next_block, end_block);
+
+	// Scalar next block.
+	llvm_ir_builder.SetInsertPoint(scalar_next_block);
+	const auto scalar_pos_next= llvm_ir_builder.CreateGEP(char_type_, scalar_pos, GetFieldGEPIndex(1));
+	scalar_pos->addIncoming(scalar_pos_next, scalar_next_block);
+	llvm_ir_builder.CreateBr(scalar_check_block);
+
+	// End block.
+	llvm_ir_builder.SetInsertPoint(end_block);
+	llvm_ir_builder.CreateRet(scalar_pos);
+
+	return function;
+}
+
+llvm::Function* Generator::GetOrCreateUtf8SpanFunction(const GraphElements::OneOf& node)
+{
+	const CodePointRanges ranges= GetNormalizedCodePointRanges(node);
+
+	const std::string function_name= "utf8_span" + GetCodePointRangesName(ranges);
+	if(const auto prev_function= module_.getFunction(function_name))
+		return prev_function;
+
+	const auto automaton_function= GetOrCreateUtf8AutomatonFunction(node);
+
+	const auto function_type= llvm::FunctionType::get(char_type_ptr_, {char_type_ptr_, char_type_ptr_}, false);
+	const auto function= llvm::Function::Create(function_type, llvm::GlobalValue::PrivateLinkage, function_name, module_);
+
+	const auto arg_begin= &*function->arg_begin();
+	const auto arg_end= &*std::next(function->arg_begin());
+	arg_begin->setName("begin");
+	arg_end->setName("end");
+
+	// Code points up to 3 bytes are decoded in vector lanes as 16-bit values.
+	// Surrogates are excluded, since they are invalid in UTF-8.
+	CodePointRanges vector_ranges;
+	for(const auto& range : ranges)
+	{
+		if(range.first < 0xD800)
+			vector_ranges.emplace_back(range.first, std::min(range.second, CharType(0xD7FF)));
+		if(range.first <= 0xFFFF && range.second > 0xDFFF)
+			vector_ranges.emplace_back(std::max(range.first, CharType(0xE000)), std::min(range.second, CharType(0xFFFF)));
+	}
+
+	const size_t c_max_vector_ranges= 16;
+	const bool use_vector_check= !vector_ranges.empty() && vector_ranges.size() <= c_max_vector_ranges;
+
+	const auto start_block= llvm::BasicBlock::Create(context_, "start", function);
+	const auto loop_block= llvm::BasicBlock::Create(context_, "loop", function);
+	const auto scalar_check_block= llvm::BasicBlock::Create(context_, "scalar_check", function);
+	const auto scalar_next_block= llvm::BasicBlock::Create(context_, "scalar_next", function);
+	const auto end_block= llvm::BasicBlock::Create(context_, "end", function);
+
+	IRBuilder llvm_ir_builder(start_block);
+	llvm_ir_builder.CreateBr(loop_block);
+
+	// Loop block.
+	llvm_ir_builder.SetInsertPoint(loop_block);
+	const auto pos= llvm_ir_builder.CreatePHI(char_type_ptr_, 3, "pos");
+	pos->addIncoming(arg_begin, start_block);
+
+	// Scalar check block - check single code point via automaton.
+	llvm_ir_builder.SetInsertPoint(scalar_check_block);
+	const auto scalar_pos= llvm_ir_builder.CreatePHI(char_type_ptr_, 2, "scalar_pos");
+	scalar_pos->addIncoming(pos, loop_block);
+	const auto code_point_end= llvm_ir_builder.CreateCall(automaton_function, {scalar_pos, arg_end}, "code_point_end");
+	llvm_ir_builder.CreateCondBr(llvm_ir_builder.CreateIsNull(code_point_end), end_block, scalar_next_block);
+
+	// Scalar next block.
+	llvm_ir_builder.SetInsertPoint(scalar_next_block);
+	pos->addIncoming(code_point_end, scalar_next_block);
+	llvm_ir_builder.CreateBr(loop_block);
+
+	// End block.
+	llvm_ir_builder.SetInsertPoint(end_block);
+	llvm_ir_builder.CreateRet(scalar_pos);
+
+	if(!use_vector_check)
+	{
+		llvm_ir_builder.SetInsertPoint(loop_block);
+		llvm_ir_builder.CreateBr(scalar_check_block);
+		return function;
+	}
+
+	const auto vector_check_block= llvm::BasicBlock::Create(context_, "vector_check", function, scalar_check_block);
+	const auto vector_next_block= llvm::BasicBlock::Create(context_, "vector_next", function, scalar_check_block);
+	const auto vector_found_block= llvm::BasicBlock::Create(context_, "vector_found", function, scalar_check_block);
+
+	// Check 16 bytes at once. Lanes with lead bytes need up to 2 bytes after them.
+	const uint32_t vector_size= 16;
+	const uint32_t max_sequence_tail_size= 2;
+
+	llvm_ir_builder.SetInsertPoint(loop_block);
+	const auto remaining_size= llvm_ir_builder.CreatePtrDiff(char_type_, arg_end, pos, "remaining_size");
+	llvm_ir_builder.CreateCondBr(
+		llvm_ir_builder.CreateICmpUGE(remaining_size, GetConstant(ptr_size_int_type_, vector_size + max_sequence_tail_size)),
+		vector_check_block,
+		scalar_check_block);
+
+	// Vector check block.
+	// Lane is valid if it starts valid sequence of code point in set or if it is continuation byte of valid lane before it.
+	llvm_ir_builder.SetInsertPoint(vector_check_block);
+	const auto byte_type= llvm::Type::getInt8Ty(context_);
+	const auto vector_type= llvm::FixedVectorType::get(byte_type, vector_size);
+	const auto code_points_vector_type= llvm::FixedVectorType::get(llvm::Type::getInt16Ty(context_), vector_size);
+
+	const auto load_vector=
+		[&](const uint32_t offset, const char* const name)
+		{
+			return
+				llvm_ir_builder.CreateAlignedLoad(
+					vector_type,
+					llvm_ir_builder.CreateBitCast(
+						llvm_ir_builder.CreateGEP(char_type_, pos, GetFieldGEPIndex(offset)),
+						llvm::PointerType::get(vector_type, 0)),
+					llvm::MaybeAlign(1),
+					name);
+		};
+	const auto b0= load_vector(0, "b0");
+	const auto b1= load_vector(1, "b1");
+	const auto b2= load_vector(2, "b2");
+
+	// Constants of vector types are splatted.
+	const auto get_byte_constant= [&](const uint64_t value){ return llvm::ConstantInt::get(vector_type, value); };
+	const auto get_code_point_constant= [&](const uint64_t value){ return llvm::ConstantInt::get(code_points_vector_type, value); };
+
+	const auto is_continuation_byte=
+		[&](llvm::Value* const b)
+		{
+			return llvm_ir_builder.CreateICmpEQ(llvm_ir_builder.CreateAnd(b, get_byte_constant(0xC0)), get_byte_constant(0x80));
+		};
+
+	const auto is_continuation= is_continuation_byte(b0);
+	const auto is_ascii= llvm_ir_builder.CreateICmpULT(b0, get_byte_constant(0x80), "is_ascii");
+	// Lead bytes 0xC0 and 0xC1 are used only in overlong sequences.
+	const auto is_lead2=
+		llvm_ir_builder.CreateICmpULE(
+			llvm_ir_builder.CreateSub(b0, get_byte_constant(0xC2)),
+			get_byte_constant(0xDF - 0xC2),
+			"is_lead2");
+	const auto is_lead3= llvm_ir_builder.CreateICmpEQ(llvm_ir_builder.CreateAnd(b0, get_byte_constant(0xF0)), get_byte_constant(0xE0), "is_lead3");
+	const auto is_continuation1= is_continuation_byte(b1);
+	const auto is_continuation2= is_continuation_byte(b2);
+	const auto is_valid2= llvm_ir_builder.CreateAnd(is_lead2, is_continuation1);
+	const auto is_valid3= llvm_ir_builder.CreateAnd(llvm_ir_builder.CreateAnd(is_lead3, is_continuation1), is_continuation2);
+
+	const auto w0= llvm_ir_builder.CreateZExt(b0, code_points_vector_type);
+	const auto w1_bits= llvm_ir_builder.CreateAnd(llvm_ir_builder.CreateZExt(b1, code_points_vector_type), get_code_point_constant(0x3F));
+	const auto w2_bits= llvm_ir_builder.CreateAnd(llvm_ir_builder.CreateZExt(b2, code_points_vector_type), get_code_point_constant(0x3F));
+
+	const auto code_point2=
+		llvm_ir_builder.CreateOr(
+			llvm_ir_builder.CreateShl(llvm_ir_builder.CreateAnd(w0, get_code_point_constant(0x1F)), get_code_point_constant(6)),
+			w1_bits,
+			"code_point2");
+	const auto code_point3=
+		llvm_ir_builder.CreateOr(
+			llvm_ir_builder.CreateOr(
+				llvm_ir_builder.CreateShl(llvm_ir_builder.CreateAnd(w0, get_code_point_constant(0x0F)), get_code_point_constant(12)),
+				llvm_ir_builder.CreateShl(w1_bits, get_code_point_constant(6))),
+			w2_bits,
+			"code_point3");
+
+	const auto code_point=
+		llvm_ir_builder.CreateSelect(
+			is_ascii,
+			w0,
+			llvm_ir_builder.CreateSelect(is_lead2, code_point2, code_point3),
+			"code_point");
+	// Overlong 3-byte sequences are invalid. Surrogates are not in ranges.
+	const auto is_valid_sequence=
+		llvm_ir_builder.CreateOr(
+			llvm_ir_builder.CreateOr(is_ascii, is_valid2),
+			llvm_ir_builder.CreateAnd(is_valid3, llvm_ir_builder.CreateICmpUGE(code_point3, get_code_point_constant(0x800))),
+			"is_valid_sequence");
+
+	llvm::Value* in_set= llvm::Constant::getNullValue(llvm::FixedVectorType::get(llvm::Type::getInt1Ty(context_), vector_size));
+	for(const auto& range : vector_ranges)
+	{
+		llvm::Value* in_range= nullptr;
+		if(range.first == range.second)
+			in_range= llvm_ir_builder.CreateICmpEQ(code_point, get_code_point_constant(range.first));
+		else
+			in_range=
+				llvm_ir_builder.CreateICmpULE(
+					llvm_ir_builder.CreateSub(code_point, get_code_point_constant(range.first)),
+					get_code_point_constant(range.second - range.first));
+		in_set= llvm_ir_builder.CreateOr(in_set, in_range);
+	}
+
+	// Continuation bytes are expected after lead bytes of multi-byte sequences in previous lanes.
+	// Lanes are shifted via shuffle with zero vector, since each iteration starts at code point boundary.
+	const auto zero_vector= llvm::Constant::getNullValue(vector_type);
+	llvm::SmallVector<int, vector_size> shift1_mask, shift2_mask;
+	for(uint32_t i= 0; i < vector_size; ++i)
+	{
+		shift1_mask.push_back(int(vector_size + i - 1));
+		shift2_mask.push_back(int(vector_size + i - 2));
+	}
+	const auto b_prev1= llvm_ir_builder.CreateShuffleVector(zero_vector, b0, shift1_mask, "b_prev1");
+	const auto b_prev2= llvm_ir_builder.CreateShuffleVector(zero_vector, b0, shift2_mask, "b_prev2");
+	const auto is_continuation_expected=
+		llvm_ir_builder.CreateOr(
+			llvm_ir_builder.CreateICmpUGE(b_prev1, get_byte_constant(0xC0)),
+			llvm_ir_builder.CreateICmpUGE(b_prev2, get_byte_constant(0xE0)),
+			"is_continuation_expected");
+
+	const auto is_valid_lane=
+		llvm_ir_builder.CreateSelect(
+			is_continuation,
+			is_continuation_expected,
+			llvm_ir_builder.CreateAnd(is_valid_sequence, in_set),
+			"is_valid_lane");
+
+	// Get mask of invalid lanes (like "movemask" instruction).
+	const auto mask_type= llvm::IntegerType::get(context_, vector_size);
+	const auto invalid_lanes_mask= llvm_ir_builder.CreateBitCast(llvm_ir_builder.CreateNot(is_valid_lane), mask_type, "invalid_lanes_mask");
+	llvm_ir_builder.CreateCondBr(
+		llvm_ir_builder.CreateICmpEQ(invalid_lanes_mask, llvm::ConstantInt::getNullValue(mask_type)),
+		vector_next_block,
+		vector_found_block);
+
+	// Vector next block - skip all lanes and tail of sequence, started in last lanes.
+	llvm_ir_builder.SetInsertPoint(vector_next_block);
+	const auto last_byte= llvm_ir_builder.CreateExtractElement(b0, uint64_t(vector_size - 1), "last_byte");
+	const auto penultimate_byte= llvm_ir_builder.CreateExtractElement(b0, uint64_t(vector_size - 2), "penultimate_byte");
+	const auto vector_step=
+		llvm_ir_builder.CreateSelect(
+			llvm_ir_builder.CreateICmpUGE(last_byte, GetConstant(byte_type, 0xE0)),
+			GetConstant(ptr_size_int_type_, vector_size + 2),
+			llvm_ir_builder.CreateSelect(
+				llvm_ir_builder.CreateOr(
+					llvm_ir_builder.CreateICmpUGE(last_byte, GetConstant(byte_type, 0xC0)),
+					llvm_ir_builder.CreateICmpUGE(penultimate_byte, GetConstant(byte_type, 0xE0))),
+				GetConstant(ptr_size_int_type_, vector_size + 1),
+				GetConstant(ptr_size_int_type_, vector_size)),
+			"vector_step");
+	const auto pos_vector_next= llvm_ir_builder.CreateGEP(char_type_, pos, vector_step);
+	pos->addIncoming(pos_vector_next, vector_next_block);
+	llvm_ir_builder.CreateBr(loop_block);
+
+	// Vector found block - check code point at first invalid lane via automaton.
+	llvm_ir_builder.SetInsertPoint(vector_found_block);
+	const auto first_invalid_lane=
+		llvm_ir_builder.CreateBinaryIntrinsic(llvm::Intrinsic::cttz, invalid_lanes_mask, llvm::ConstantInt::getTrue(context_));
+	const auto first_invalid_pos=
+		llvm_ir_builder.CreateGEP(char_type_, pos, llvm_ir_builder.CreateZExt(first_invalid_lane, ptr_size_int_type_), "first_invalid_pos");
+	scalar_pos->addIncoming(first_invalid_pos, vector_found_block);
+	llvm_ir_builder.CreateBr(scalar_check_block);
+
+	return function;
+}
+
+llvm::Value* Generator::CreateSpanCall(
+	IRBuilder& llvm_ir_builder,
+	const SpanFunction& span_function,
+	llvm::Value* const str_begin_value,
+	llvm::Value* const str_end_value,
+	const size_t max_elements)
+{
+	llvm::Value* span_end_limit= str_end_value;
+	if(max_elements < Sequence::c_max)
+	{
+		assert(span_function.element_length != 0);
+		const size_t max_size= max_elements * span_function.element_length;
+
+		const auto str_size= llvm_ir_builder.CreatePtrDiff(char_type_, str_end_value, str_begin_value, "str_size");
+		span_end_limit=
+			llvm_ir_builder.CreateSelect(
+				llvm_ir_builder.CreateICmpUGT(str_size, GetConstant(ptr_size_int_type_, max_size)),
+				llvm_ir_builder.CreateGEP(char_type_, str_begin_value, GetConstant(ptr_size_int_type_, max_size)),
+				str_end_value,
+				"span_end_limit");
+	}
+
+	return llvm_ir_builder.CreateCall(span_function.function, {str_begin_value, span_end_limit}, "span_end");
+}
+
+void Generator::CreateCodePointRangesCheck(
+	IRBuilder& llvm_ir_builder,
+	llvm::Value* const value,
+	const llvm::ArrayRef< std::pair<CharType, CharType> > ranges,
+	llvm::BasicBlock* const found_block,
+	llvm::BasicBlock* const not_found_block)
+{
+	const auto function= llvm_ir_builder.GetInsertBlock()->getParent();
+	const auto value_type= llvm::cast<llvm::IntegerType>(value->getType());
+
+	// Check "value < bound", if it isn't guaranteed by value type.
+	const auto create_upper_bound_check=
+		[&](const CharType bound)
+		{
+			if(value_type->getBitMask() < bound)
+				return;
+
+			const auto in_bounds_block= llvm::BasicBlock::Create(context_, "in_bounds", function);
+			llvm_ir_builder.CreateCondBr(llvm_ir_builder.CreateICmpULT(value, GetConstant(value_type, bound)), in_bounds_block, not_found_block);
+			llvm_ir_builder.SetInsertPoint(in_bounds_block);
+		};
+
+	if(ranges.empty())
+	{
+		llvm_ir_builder.CreateBr(not_found_block);
+		return;
+	}
+
+	// Sequence of comparisons is fast enough for small number of ranges.
+	const size_t c_max_comparison_ranges= 3;
+	if(ranges.size() <= c_max_comparison_ranges)
+	{
+		for(const auto& range : ranges)
+		{
+			llvm::Value* in_range= nullptr;
+			if(range.first == range.second)
+				in_range= llvm_ir_builder.CreateICmpEQ(value, GetConstant(value_type, range.first));
+			else
+			{
+				// "begin <= value && value <= end" is equivalent to "value - begin <= end - begin" for unsigned values.
+				const auto value_shifted= llvm_ir_builder.CreateSub(value, GetConstant(value_type, range.first));
+				in_range= llvm_ir_builder.CreateICmpULE(value_shifted, GetConstant(value_type, range.second - range.first));
+			}
+
+			const auto next_block=
+				&range == &ranges.back()
+					? not_found_block
+					: llvm::BasicBlock::Create(context_, "next", function);
+
+			llvm_ir_builder.CreateCondBr(in_range, found_block, next_block);
+			if(next_block != not_found_block)
+				llvm_ir_builder.SetInsertPoint(next_block);
+		}
+		return;
+	}
+
+	const CharType c_max_two_level_table_value= 0xFFFF;
+
+	if(ranges.back().second <= 0xFF)
+	{
+		// Use 128-bit or 256-bit bitmap. For byte values use 256-bit bitmap even for ASCII ranges to avoid bounds check.
+		const CharType bitmap_size= (ranges.back().second <= 0x7F && value_type->getBitMask() > 0xFF) ? 0x80 : 0x100;
+
+		std::vector<uint8_t> bitmap(bitmap_size / 8, 0);
+		for(const auto& range : ranges)
+			for(CharType c= range.first; c <= range.second; ++c)
+				bitmap[c >> 3]|= uint8_t(1 << (c & 7));
+
+		create_upper_bound_check(bitmap_size);
+		const auto in_set= CreateBitmapCheck(llvm_ir_builder, value, GetOrCreateConstantTable(bitmap, "bitmap"));
+		llvm_ir_builder.CreateCondBr(in_set, found_block, not_found_block);
+	}
+	else if(ranges.back().second <= c_max_two_level_table_value)
+	{
+		// Use two-level table - block index for high byte of value and bitmap block for low byte.
+		// Blocks with same contents (including empty and full blocks) are stored only once.
+		const size_t c_block_size= 256 / 8;
+
+		std::vector<uint8_t> first_level_table(256, 0);
+		std::vector<uint8_t> second_level_table;
+		std::map<std::vector<uint8_t>, uint8_t> blocks_indices;
+		for(uint32_t high_byte= 0; high_byte < 256; ++high_byte)
+		{
+			std::vector<uint8_t> block(c_block_size, 0);
+			const CharType block_begin= high_byte << 8, block_end= block_begin + 0xFF;
+			for(const auto& range : ranges)
+				for(CharType c= std::max(range.first, block_begin); c <= std::min(range.second, block_end); ++c)
+					block[(c & 0xFF) >> 3]|= uint8_t(1 << (c & 7));
+
+			const auto it= blocks_indices.emplace(block, uint8_t(blocks_indices.size())).first;
+			if(it->second == second_level_table.size() / c_block_size)
+				second_level_table.insert(second_level_table.end(), block.begin(), block.end());
+			first_level_table[high_byte]= it->second;
+		}
+
+		create_upper_bound_check(CharType(c_max_two_level_table_value + 1));
+		const auto in_set=
+			CreateTwoLevelTableCheck(
+				llvm_ir_builder,
+				value,
+				GetOrCreateConstantTable(first_level_table, "table_first_level"),
+				GetOrCreateConstantTable(second_level_table, "table_second_level"));
+		llvm_ir_builder.CreateCondBr(in_set, found_block, not_found_block);
+	}
+	else if(ranges.front().first <= c_max_two_level_table_value)
+	{
+		// Check BMP and supplementary planes separately.
+		CodePointRanges bmp_ranges, supplementary_ranges;
+		for(const auto& range : ranges)
+		{
+			if(range.first <= c_max_two_level_table_value)
+				bmp_ranges.emplace_back(range.first, std::min(range.second, c_max_two_level_table_value));
+			if(range.second > c_max_two_level_table_value)
+				supplementary_ranges.emplace_back(std::max(range.first, CharType(c_max_two_level_table_value + 1)), range.second);
+		}
+
+		const auto bmp_block= llvm::BasicBlock::Create(context_, "bmp", function);
+		const auto supplementary_block= llvm::BasicBlock::Create(context_, "supplementary", function);
+		llvm_ir_builder.CreateCondBr(
+			llvm_ir_builder.CreateICmpULE(value, GetConstant(value_type, c_max_two_level_table_value)),
+			bmp_block,
+			supplementary_block);
+
+		llvm_ir_builder.SetInsertPoint(bmp_block);
+		CreateCodePointRangesCheck(llvm_ir_builder, value, bmp_ranges, found_block, not_found_block);
+
+		llvm_ir_builder.SetInsertPoint(supplementary_block);
+		CreateCodePointRangesCheck(llvm_ir_builder, value, supplementary_ranges, found_block, not_found_block);
+	}
+	else
+	{
+		// Binary search of range for large values.
+		const size_t middle= ranges.size() / 2;
+
+		const auto lower_block= llvm::BasicBlock::Create(context_, "lower", function);
+		const auto upper_block= llvm::BasicBlock::Create(context_, "upper", function);
+		llvm_ir_builder.CreateCondBr(
+			llvm_ir_builder.CreateICmpULT(value, GetConstant(value_type, ranges[middle].first)),
+			lower_block,
+			upper_block);
+
+		llvm_ir_builder.SetInsertPoint(lower_block);
+		CreateCodePointRangesCheck(llvm_ir_builder, value, ranges.take_front(middle), found_block, not_found_block);
+
+		llvm_ir_builder.SetInsertPoint(upper_block);
+		CreateCodePointRangesCheck(llvm_ir_builder, value, ranges.drop_front(middle), found_block, not_found_block);
+	}
+}
+
+llvm::Value* Generator::CreateBitmapCheck(IRBuilder& llvm_ir_builder, llvm::Value* const value, llvm::GlobalVariable* const bitmap)
+{
+	const auto byte_type= llvm::Type::getInt8Ty(context_);
+	const auto value_type= llvm::cast<llvm::IntegerType>(value->getType());
+
+	// bit= (bitmap[value >> 3] >> (value & 7)) & 1
+	const auto index= llvm_ir_builder.CreateLShr(value, GetConstant(value_type, 3), "bitmap_index");
+	const auto index_extended= llvm_ir_builder.CreateZExtOrTrunc(index, gep_index_type_);
+	const auto element_ptr= llvm_ir_builder.CreateGEP(bitmap->getValueType(), bitmap, {GetZeroGEPIndex(), index_extended});
+	const auto element= llvm_ir_builder.CreateLoad(byte_type, element_ptr, "bitmap_element");
+	const auto shift= llvm_ir_builder.CreateTrunc(llvm_ir_builder.CreateAnd(value, GetConstant(value_type, 7)), byte_type);
+	const auto shifted= llvm_ir_builder.CreateLShr(element, shift);
+	return llvm_ir_builder.CreateTrunc(shifted, llvm::Type::getInt1Ty(context_), "in_set");
+}
+
+llvm::Value* Generator::CreateTwoLevelTableCheck(
+	IRBuilder& llvm_ir_builder, llvm::Value* const value, llvm::GlobalVariable* const first_level_table, llvm::GlobalVariable* const second_level_table)
+{
+	const auto byte_type= llvm::Type::getInt8Ty(context_);
+	const auto value_type= llvm::cast<llvm::IntegerType>(value->getType());
+
+	// block= first_level_table[value >> 8]
+	const auto high_byte= llvm_ir_builder.CreateLShr(value, GetConstant(value_type, 8), "high_byte");
+	const auto block_index_ptr=
+		llvm_ir_builder.CreateGEP(
+			first_level_table->getValueType(),
+			first_level_table,
+			{GetZeroGEPIndex(), llvm_ir_builder.CreateZExtOrTrunc(high_byte, gep_index_type_)});
+	const auto block_index= llvm_ir_builder.CreateLoad(byte_type, block_index_ptr, "block_index");
+
+	// bit= (second_level_table[block * 32 + ((value >> 3) & 31)] >> (value & 7)) & 1
+	const auto block_offset= llvm_ir_builder.CreateShl(llvm_ir_builder.CreateZExt(block_index, gep_index_type_), GetConstant(gep_index_type_, 5));
+	const auto offset_in_block=
+		llvm_ir_builder.CreateZExtOrTrunc(
+			llvm_ir_builder.CreateAnd(llvm_ir_builder.CreateLShr(value, GetConstant(value_type, 3)), GetConstant(value_type, 31)),
+			gep_index_type_);
+	const auto element_ptr=
+		llvm_ir_builder.CreateGEP(
+			second_level_table->getValueType(),
+			second_level_table,
+			{GetZeroGEPIndex(), llvm_ir_builder.CreateOr(block_offset, offset_in_block)});
+	const auto element= llvm_ir_builder.CreateLoad(byte_type, element_ptr, "table_element");
+	const auto shift= llvm_ir_builder.CreateTrunc(llvm_ir_builder.CreateAnd(value, GetConstant(value_type, 7)), byte_type);
+	const auto shifted= llvm_ir_builder.CreateLShr(element, shift);
+	return llvm_ir_builder.CreateTrunc(shifted, llvm::Type::getInt1Ty(context_), "in_set");
+}
+
+llvm::GlobalVariable* Generator::GetOrCreateConstantTable(const std::vector<uint8_t>& data, const std::string& name_prefix)
+{
+	// Constant data arrays are unique within context, so, it is enough to compare pointers.
+	const auto initializer= llvm::ConstantDataArray::get(context_, data);
+
+	const std::string name= name_prefix + "_" + std::to_string(std::hash<std::string>()(std::string(data.begin(), data.end())));
+	if(const auto prev_table= module_.getNamedGlobal(name))
+		if(prev_table->getInitializer() == initializer)
+			return prev_table;
+
+	// In case of hash collision new table gets unique name.
+	const auto table=
+		new llvm::GlobalVariable(
+			module_,
+			initializer->getType(),
+			true,
+			llvm::GlobalValue::PrivateLinkage,
+			initializer,
+			name);
+	table->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+	return table;
+}
+
+llvm::CallInst* Generator::CreateNodeCall(
+	IRBuilder& llvm_ir_builder,
+	llvm::Value* const state_ptr,
+	llvm::Value* const str_begin_value,
+	llvm::Value* const str_end_value,
+	const GraphElements::NodePtr node)
+{
+	return llvm_ir_builder.CreateCall(GetOrCreateNodeFunction(node), {state_ptr, str_begin_value, str_end_value});
 }
 
 void Generator::CreateNextCallRet(
-	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, const GraphElements::NodePtr next_node)
+	IRBuilder& llvm_ir_builder,
+	llvm::Value* const state_ptr,
+	llvm::Value* const str_begin_value,
+	llvm::Value* const str_end_value,
+	const GraphElements::NodePtr next_node)
 {
-	const auto next_call= llvm_ir_builder.CreateCall(GetOrCreateNodeFunction(next_node), {state_ptr}, "next_call_res");
+	if(single_function_data_ != nullptr)
+	{
+		const auto next_block= GetOrCreateNodeBlock(next_node);
+		next_block.second->addIncoming(str_begin_value, llvm_ir_builder.GetInsertBlock());
+		llvm_ir_builder.CreateBr(next_block.first);
+		return;
+	}
+
+	const auto next_call= CreateNodeCall(llvm_ir_builder, state_ptr, str_begin_value, str_end_value, next_node);
+	next_call->setName("next_call_res");
 	llvm_ir_builder.CreateRet(next_call);
 }
 
-void Generator::SaveState(IRBuilder& llvm_ir_builder, llvm::Value* const state, llvm::Value* const state_backup)
+void Generator::CreateNextAlternativesCallRet(
+	IRBuilder& llvm_ir_builder,
+	llvm::Value* const state_ptr,
+	llvm::Value* const str_begin_value,
+	llvm::Value* const str_end_value,
+	const llvm::ArrayRef<GraphElements::NodePtr> next_nodes,
+	const llvm::ArrayRef<size_t> next_nodes_offsets)
 {
-	CopyState(llvm_ir_builder, state_backup, state);
+	assert(next_nodes_offsets.empty() || next_nodes_offsets.size() == next_nodes.size());
+	const StateFieldsSet fields_to_restore= GetFieldsToRestore(next_nodes.drop_back(), next_nodes.drop_front());
+
+	const auto get_next_node_str_begin=
+	[&](llvm::Value* const current_str_begin, const size_t i) -> llvm::Value*
+	{
+		if(next_nodes_offsets.empty() || next_nodes_offsets[i] == 0)
+			return current_str_begin;
+		return llvm_ir_builder.CreateGEP(char_type_, current_str_begin, GetFieldGEPIndex(uint32_t(next_nodes_offsets[i])), "next_str_begin");
+	};
+
+	if(single_function_data_ != nullptr)
+	{
+		// Push continuation for next alternative, go to current alternative.
+		// After backtracking state is restored and execution is continued from next alternative.
+		llvm::Value* current_str_begin= str_begin_value;
+		for(size_t i= 0; i < next_nodes.size(); ++i)
+		{
+			if(i + 1 == next_nodes.size())
+			{
+				CreateNextCallRet(llvm_ir_builder, state_ptr, get_next_node_str_begin(current_str_begin, i), str_end_value, next_nodes[i]);
+				break;
+			}
+
+			const auto resume_block= CreateContinuationPush(llvm_ir_builder, state_ptr, current_str_begin, fields_to_restore);
+			CreateNextCallRet(llvm_ir_builder, state_ptr, get_next_node_str_begin(current_str_begin, i), str_end_value, next_nodes[i]);
+
+			llvm_ir_builder.SetInsertPoint(resume_block.first);
+			current_str_begin= resume_block.second;
+		}
+		return;
+	}
+
+	const auto function= llvm_ir_builder.GetInsertBlock()->getParent();
+
+	const auto state_backup_ptr= CreateStateAlloca(llvm_ir_builder, "state_backup");
+
+	const auto found_block= llvm::BasicBlock::Create(context_, "found");
+	const auto found_res= llvm::PHINode::Create(char_type_ptr_, uint32_t(next_nodes.size() - 1), "found_res", found_block);
+
+	for(size_t i= 0; i < next_nodes.size(); ++i)
+	{
+		if(i + 1 < next_nodes.size())
+		{
+			SaveState(llvm_ir_builder, state_ptr, state_backup_ptr, fields_to_restore);
+			const auto variant_res= CreateNodeCall(llvm_ir_builder, state_ptr, get_next_node_str_begin(str_begin_value, i), str_end_value, next_nodes[i]);
+			const auto next_block= llvm::BasicBlock::Create(context_, "", function);
+
+			found_res->addIncoming(variant_res, llvm_ir_builder.GetInsertBlock());
+			llvm_ir_builder.CreateCondBr(llvm_ir_builder.CreateIsNull(variant_res), next_block, found_block);
+			llvm_ir_builder.SetInsertPoint(next_block);
+			RestoreState(llvm_ir_builder, state_ptr, state_backup_ptr, fields_to_restore);
+		}
+		else
+		{
+			// Do not call state copy functions in last alternative, just call alternative node function with initial state and return call result.
+			CreateNextCallRet(llvm_ir_builder, state_ptr, get_next_node_str_begin(str_begin_value, i), str_end_value, next_nodes[i]);
+		}
+	}
+
+	// Return result of first successfull variant.
+	found_block->insertInto(function);
+	llvm_ir_builder.SetInsertPoint(found_block);
+	llvm_ir_builder.CreateRet(found_res);
 }
 
-void Generator::RestoreState(IRBuilder& llvm_ir_builder, llvm::Value* const state, llvm::Value* const state_backup)
+void Generator::CreateFailRet(IRBuilder& llvm_ir_builder)
 {
-	CopyState(llvm_ir_builder, state, state_backup);
+	if(single_function_data_ != nullptr)
+		llvm_ir_builder.CreateBr(single_function_data_->backtrack_block);
+	else
+		llvm_ir_builder.CreateRet(GetNullStrPtr());
 }
 
-void Generator::CopyState(IRBuilder& llvm_ir_builder, llvm::Value* const dst, llvm::Value* const src)
+SingleFunctionData::BlockWithPosition Generator::CreateContinuationPush(
+	IRBuilder& llvm_ir_builder, llvm::Value* const state_ptr, llvm::Value* const str_begin_value, const StateFieldsSet& fields_to_restore)
+{
+	SingleFunctionData& function_data= *single_function_data_;
+
+	const auto resume_point= uint32_t(function_data.resume_points.size());
+	const auto resume_block= llvm::BasicBlock::Create(context_, "resume", function_data.function);
+	const auto resumed_str_begin= llvm::PHINode::Create(char_type_ptr_, 1, "str_begin", resume_block);
+	function_data.resume_points.push_back(SingleFunctionData::ResumePoint{ SingleFunctionData::BlockWithPosition(resume_block, resumed_str_begin), fields_to_restore });
+
+	// Allocate frame dynamically on native stack. Stack pointer is restored after frame pop.
+	const auto stack_pointer= llvm_ir_builder.CreateIntrinsic(llvm::Intrinsic::stacksave, {}, {}, nullptr, "stack_pointer");
+	const auto frame= llvm_ir_builder.CreateAlloca(continuation_frame_type_, 0, "frame");
+
+	const auto get_frame_field_ptr=
+	[&](const uint32_t field_index)
+	{
+		return llvm_ir_builder.CreateGEP(continuation_frame_type_, frame, {GetZeroGEPIndex(), GetFieldGEPIndex(field_index)});
+	};
+
+	const auto continuation_frame_ptr_type= llvm::PointerType::get(continuation_frame_type_, 0);
+
+	llvm_ir_builder.CreateStore(stack_pointer, get_frame_field_ptr(ContinuationFrameFieldIndex::StackPointer));
+	llvm_ir_builder.CreateStore(
+		llvm_ir_builder.CreateLoad(continuation_frame_ptr_type, function_data.continuation_head_ptr),
+		get_frame_field_ptr(ContinuationFrameFieldIndex::Prev));
+	llvm_ir_builder.CreateStore(llvm::ConstantInt::get(llvm::Type::getInt32Ty(context_), resume_point), get_frame_field_ptr(ContinuationFrameFieldIndex::ResumePoint));
+	llvm_ir_builder.CreateStore(str_begin_value, get_frame_field_ptr(ContinuationFrameFieldIndex::StrBegin));
+	SaveState(llvm_ir_builder, state_ptr, get_frame_field_ptr(ContinuationFrameFieldIndex::State), fields_to_restore);
+
+	llvm_ir_builder.CreateStore(frame, function_data.continuation_head_ptr);
+
+	return SingleFunctionData::BlockWithPosition(resume_block, resumed_str_begin);
+}
+
+llvm::Value* Generator::CreateStateAlloca(IRBuilder& llvm_ir_builder, const char* const name)
+{
+	llvm::BasicBlock& entry_block= llvm_ir_builder.GetInsertBlock()->getParent()->getEntryBlock();
+	IRBuilder entry_block_builder(&entry_block, entry_block.begin());
+	return entry_block_builder.CreateAlloca(state_type_, 0, name);
+}
+
+StateFieldsSet Generator::GetFieldsToRestore(
+	const llvm::ArrayRef<GraphElements::NodePtr> evaluated_nodes, const llvm::ArrayRef<GraphElements::NodePtr> next_nodes) const
+{
+	StateFieldsSet modified_fields;
+	for(const GraphElements::NodePtr node : evaluated_nodes)
+		Unite(modified_fields, state_fields_liveness_.modified_fields.at(node));
+
+	StateFieldsSet live_fields;
+	for(const GraphElements::NodePtr node : next_nodes)
+		Unite(live_fields, state_fields_liveness_.live_fields.at(node));
+
+	return Intersect(modified_fields, live_fields);
+}
+
+void Generator::SaveState(IRBuilder& llvm_ir_builder, llvm::Value* const state, llvm::Value* const state_backup, const StateFieldsSet& fields)
+{
+	CopyState(llvm_ir_builder, state_backup, state, fields);
+}
+
+void Generator::RestoreState(IRBuilder& llvm_ir_builder, llvm::Value* const state, llvm::Value* const state_backup, const StateFieldsSet& fields)
+{
+	CopyState(llvm_ir_builder, state, state_backup, fields);
+}
+
+void Generator::CopyState(IRBuilder& llvm_ir_builder, llvm::Value* const dst, llvm::Value* const src, const StateFieldsSet& fields)
 {
 	const auto copy_scalar_field=
 	[&](const uint32_t field_index)
@@ -2032,22 +4688,31 @@ void Generator::CopyState(IRBuilder& llvm_ir_builder, llvm::Value* const dst, ll
 			llvm_ir_builder.CreateGEP(state_type_, dst, indices));
 	};
 
-	// Do not copy constant fields - StrEnd, StrBeginInitial.
-	copy_scalar_field(StateFieldIndex::StrBegin);
+	// Do not copy constant field StrBeginInitial. Current position is not stored in state.
+
+	// Copy sequence counters. Sort field numbers to produce same code for same regex.
+	std::vector<uint32_t> sequence_counter_field_numbers;
+	for(const GraphElements::SequenceId sequence_id : fields.sequence_counters)
+		if(const auto it= sequence_id_to_counter_filed_number_.find(sequence_id); it != sequence_id_to_counter_filed_number_.end())
+			sequence_counter_field_numbers.push_back(it->second);
+	std::sort(sequence_counter_field_numbers.begin(), sequence_counter_field_numbers.end());
 
-	// Copy sequence counters.
-	const uint64_t sequence_counters_array_size= state_type_->elements()[StateFieldIndex::SequenceContersArray]->getArrayNumElements();
-	for(uint64_t i= 0; i < sequence_counters_array_size; ++i)
+	for(const uint32_t field_number : sequence_counter_field_numbers)
 	{
-		llvm::Value* const indices[]{GetZeroGEPIndex(), GetFieldGEPIndex(StateFieldIndex::SequenceContersArray), GetFieldGEPIndex(uint32_t(i))};
+		llvm::Value* const indices[]{GetZeroGEPIndex(), GetFieldGEPIndex(StateFieldIndex::SequenceContersArray), GetFieldGEPIndex(field_number)};
 		llvm_ir_builder.CreateStore(
 			llvm_ir_builder.CreateLoad(ptr_size_int_type_, llvm_ir_builder.CreateGEP(state_type_, src, indices)),
 			llvm_ir_builder.CreateGEP(state_type_, dst, indices));
 	}
 
 	// Copy groups.
-	const uint64_t groups_array_size= state_type_->elements()[StateFieldIndex::GroupsArray]->getArrayNumElements();
-	for(uint64_t i= 0; i < groups_array_size; ++i)
+	std::vector<uint32_t> group_field_numbers;
+	for(const size_t group_index : fields.groups)
+		if(const auto it= group_number_to_field_number_.find(group_index); it != group_number_to_field_number_.end())
+			group_field_numbers.push_back(it->second);
+	std::sort(group_field_numbers.begin(), group_field_numbers.end());
+
+	for(const uint32_t field_number : group_field_numbers)
 	{
 		for(size_t j= 0; j < 2; ++j)
 		{
@@ -2055,7 +4720,7 @@ void Generator::CopyState(IRBuilder& llvm_ir_builder, llvm::Value* const dst, ll
 			{
 				GetZeroGEPIndex(),
 				GetFieldGEPIndex(StateFieldIndex::GroupsArray),
-				GetFieldGEPIndex(uint32_t(i)),
+				GetFieldGEPIndex(field_number),
 				GetFieldGEPIndex(uint32_t(j)),
 			};
 			llvm_ir_builder.CreateStore(
@@ -2076,6 +4741,11 @@ llvm::ConstantInt* Generator::GetConstant(llvm::IntegerType* const type, const u
 	return llvm::ConstantInt::get(type, value);
 }
 
+llvm::Constant* Generator::GetNullStrPtr() const
+{
+	return llvm::ConstantPointerNull::get(char_type_ptr_);
+}
+
 llvm::Constant* Generator::GetZeroGEPIndex() const
 {
 	return llvm::Constant::getNullValue(gep_index_type_);
@@ -2091,8 +4761,15 @@ llvm::Constant* Generator::GetFieldGEPIndex(const uint32_t field_index) const
 void GenerateMatcherFunction(
 	llvm::Module& module, const RegexGraphBuildResult& regex_graph, const std::string& function_name)
 {
-	Generator generator(module);
+	Generator generator(module, regex_graph.options);
 	generator.GenerateMatcherFunction(regex_graph, function_name);
 }
 
+void GenerateMatchesCounterFunction(
+	llvm::Module& module, const RegexGraphBuildResult& regex_graph, const std::string& function_name)
+{
+	Generator generator(module, regex_graph.options);
+	generator.GenerateMatchesCounterFunction(regex_graph, function_name);
+}
+
 } // namespace RegPanzer
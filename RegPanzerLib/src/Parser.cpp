@@ -1,4 +1,6 @@
+#include "../CaseFolding.hpp"
 #include "../Parser.hpp"
+#include "../UnicodeClasses.hpp"
 #include "../Utils.hpp"
 #include "../PushDisableLLVMWarnings.hpp"
 #include <llvm/Support/ConvertUTF.h>
@@ -25,6 +27,8 @@ class Parser
 public:
 	using StrView= std::basic_string_view<CharType>;
 
+	explicit Parser(const Options& options);
+
 	ParseResult Parse(StrView str);
 
 private:
@@ -34,20 +38,33 @@ private:
 	Sequence ParseSequence();
 	Look ParseLook();
 	RegexElementsChain ParseChain();
+	// Parse chain with given case-insensitivity modifier. Previous modifier is restored after chain end.
+	RegexElementsChain ParseChain(bool case_insensitive);
+	RegexElementsChain ParseChainImpl();
+
+	void MakeCaseInsensitive(RegexElementFull::ElementType& element);
 
 	void ReportUnexpectedEndOfLineError();
 	void ReportUnexpectedSymbol(CharType symbol);
 	void ReportError(std::string message);
+	void CheckCodePoint(CharType c);
 
 private:
+	const Options options_;
+	bool case_insensitive_= false;
 	size_t next_group_index_= 0;
 	StrView str_;
 	const CharType* str_initial_= nullptr;
 	ParseErrors errors_;
 };
 
+Parser::Parser(const Options& options)
+	: options_(options)
+{}
+
 ParseResult Parser::Parse(const StrView str)
 {
+	case_insensitive_= options_.case_insensitive;
 	next_group_index_= 1;
 	str_= str;
 	str_initial_= str_.data();
@@ -107,6 +124,8 @@ RegexElementFull::ElementType Parser::ParseEscapeSequence()
 
 	case 's':
 	case 'S':
+		if(options_.encoding == Encoding::Bytes)
+			return OneOf{ { ' ', '\r', '\n', '\t', '\f', '\v', 0x00A0 }, {}, c == 'S' };
 		return OneOf{ { ' ', '\r', '\n', '\t', '\f', '\v', 0x00A0, 0x1680, 0x2028, 0x2029, 0x202F, 0x3000, 0xFEFF }, { {0x2000, 0x200A} }, c == 'S' };
 
 	case 'x':
@@ -136,6 +155,7 @@ RegexElementFull::ElementType Parser::ParseEscapeSequence()
 				return AnySymbol();
 			}
 		}
+		CheckCodePoint(code);
 		str_.remove_prefix(digiths);
 		return SpecificSymbol{ code };
 	}
@@ -152,9 +172,60 @@ RegexElementFull::ElementType Parser::ParseEscapeSequence()
 		return BackReference{ size_t( c - '0' ) };
 
 	case 'p':
-		// TODO - parse special symbol classes here.
-		ReportError("Unicode classes not implemented yet.");
-		return AnySymbol();
+	case 'P':
+	{
+		// Unicode class - "\pL", "\p{L}", "\p{Greek}", "\p{^L}".
+		bool inverse= c == 'P';
+		std::string name;
+		if(str_.empty())
+		{
+			ReportUnexpectedEndOfLineError();
+			return AnySymbol();
+		}
+		if(str_.front() == '{')
+		{
+			str_.remove_prefix(1);
+			if(!str_.empty() && str_.front() == '^')
+			{
+				inverse= !inverse;
+				str_.remove_prefix(1);
+			}
+			while(!str_.empty() && str_.front() != '}')
+			{
+				name+= CharTypeToString(str_.front());
+				str_.remove_prefix(1);
+			}
+			if(str_.empty())
+			{
+				ReportUnexpectedEndOfLineError();
+				return AnySymbol();
+			}
+			str_.remove_prefix(1);
+		}
+		else
+		{
+			name= CharTypeToString(str_.front());
+			str_.remove_prefix(1);
+		}
+
+		auto ranges= GetUnicodeClassRanges(name);
+		if(ranges == std::nullopt)
+		{
+			ReportError("Unknown Unicode class: " + name);
+			return AnySymbol();
+		}
+
+		if(options_.encoding == Encoding::Bytes)
+		{
+			// Only Latin-1 part of class may be matched in bytes mode.
+			while(!ranges->empty() && ranges->back().first > 0xFF)
+				ranges->pop_back();
+			if(!ranges->empty())
+				ranges->back().second= std::min(ranges->back().second, CharType(0xFF));
+		}
+
+		return OneOf{ {}, std::move(*ranges), inverse };
+	}
 	}
 
 	ReportError("Unknown escape sequence: " + CharTypeToString(c));
@@ -217,7 +288,10 @@ OneOf Parser::ParseOneOf()
 				ReportError("Unexpected excape sequence inside \"OneOf\"");
 		}
 		else
+		{
+			CheckCodePoint(c);
 			str_.remove_prefix(1);
+		}
 
 		if(str_.empty())
 		{
@@ -234,6 +308,7 @@ OneOf Parser::ParseOneOf()
 				return one_of;
 			}
 			const CharType end_c= str_.front();
+			CheckCodePoint(end_c);
 
 			if(end_c < c)
 				ReportError("Invalid char range");
@@ -428,6 +503,21 @@ Look Parser::ParseLook()
 }
 
 RegexElementsChain Parser::ParseChain()
+{
+	return ParseChain(case_insensitive_);
+}
+
+RegexElementsChain Parser::ParseChain(const bool case_insensitive)
+{
+	// Modifiers are applied until end of current group.
+	const bool case_insensitive_prev= case_insensitive_;
+	case_insensitive_= case_insensitive;
+	auto chain= ParseChainImpl();
+	case_insensitive_= case_insensitive_prev;
+	return chain;
+}
+
+RegexElementsChain Parser::ParseChainImpl()
 {
 	RegexElementsChain chain;
 
@@ -519,6 +609,59 @@ RegexElementsChain Parser::ParseChain()
 
 					res.el= SubroutineCall{ index };
 				}
+				else if(str_.front() == 'i' || str_.front() == '-')
+				{
+					// Modifiers - "(?i)", "(?-i)" for rest of current group or "(?i:...)", "(?-i:...)" for non-capturing group.
+					const bool case_insensitive= str_.front() == 'i';
+					if(!case_insensitive)
+						str_.remove_prefix(1);
+
+					if(str_.empty())
+					{
+						ReportUnexpectedEndOfLineError();
+						return chain;
+					}
+					if(str_.front() != 'i')
+					{
+						ReportError("Unsupported modifier: " + CharTypeToString(str_.front()));
+						return chain;
+					}
+					str_.remove_prefix(1);
+
+					if(str_.empty())
+					{
+						ReportUnexpectedEndOfLineError();
+						return chain;
+					}
+					if(str_.front() == ')')
+					{
+						str_.remove_prefix(1);
+						case_insensitive_= case_insensitive;
+						continue;
+					}
+					if(str_.front() != ':')
+					{
+						ReportUnexpectedSymbol(':');
+						return chain;
+					}
+					str_.remove_prefix(1);
+
+					auto sub_elements= ParseChain(case_insensitive);
+
+					if(str_.empty())
+					{
+						ReportUnexpectedEndOfLineError();
+						return chain;
+					}
+					if(str_.front() != ')')
+					{
+						ReportUnexpectedSymbol(')');
+						return chain;
+					}
+					str_.remove_prefix(1);
+
+					res.el= NonCapturingGroup{ std::move(sub_elements) };
+				}
 				else if(str_.front() == ':')
 				{
 					str_.remove_prefix(1);
@@ -648,11 +791,15 @@ RegexElementsChain Parser::ParseChain()
 			break;
 
 		default:
+			CheckCodePoint(str_.front());
 			res.el= SpecificSymbol{ str_.front() };
 			str_.remove_prefix(1);
 			break;
 		};
 
+		if(case_insensitive_)
+			MakeCaseInsensitive(res.el);
+
 		res.seq= ParseSequence();
 
 		chain.push_back(std::move(res));
@@ -661,6 +808,40 @@ RegexElementsChain Parser::ParseChain()
 	return chain;
 }
 
+void Parser::MakeCaseInsensitive(RegexElementFull::ElementType& element)
+{
+	// Other case variant should be matchable in bytes mode.
+	const CharType max_code_point= options_.encoding == Encoding::Bytes ? 0xFF : std::numeric_limits<CharType>::max();
+
+	if(const auto specific_symbol= std::get_if<SpecificSymbol>(&element))
+	{
+		const auto other_case= GetOtherCase(specific_symbol->code);
+		specific_symbol->case_insensitive= other_case != std::nullopt && *other_case <= max_code_point;
+	}
+	else if(const auto one_of= std::get_if<OneOf>(&element))
+	{
+		// Add other case variants of all symbols. For inverse sets this excludes other case variants too.
+		std::vector< std::pair<CharType, CharType> > other_case_ranges;
+		for(const CharType c : one_of->variants)
+			for(const auto& range : GetOtherCaseRanges(c, c))
+				other_case_ranges.push_back(range);
+		for(const auto& one_of_range : one_of->ranges)
+			for(const auto& range : GetOtherCaseRanges(one_of_range.first, one_of_range.second))
+				other_case_ranges.push_back(range);
+
+		for(const auto& range : other_case_ranges)
+		{
+			if(range.first > max_code_point)
+				continue;
+
+			if(range.first == range.second)
+				one_of->variants.push_back(range.first);
+			else
+				one_of->ranges.emplace_back(range.first, std::min(range.second, max_code_point));
+		}
+	}
+}
+
 void Parser::ReportUnexpectedEndOfLineError()
 {
 	ReportError("Unexpected end of line");
@@ -677,12 +858,18 @@ void Parser::ReportError(std::string message)
 	errors_.push_back(ParseError{pos, std::move(message)});
 }
 
+void Parser::CheckCodePoint(const CharType c)
+{
+	if(options_.encoding == Encoding::Bytes && c > 0xFF)
+		ReportError("Code point " + CharTypeToString(c) + " can't be matched in bytes mode");
+}
+
 } // namespace
 
-ParseResult ParseRegexString(const std::string_view str)
+ParseResult ParseRegexString(const std::string_view str, const Options& options)
 {
 	// Do internal parsing in UTF-32 format (with fixed codepoint size). Convert input string into UTF-32.
-	Parser parser;
+	Parser parser(options);
 	return parser.Parse(Utf8ToUtf32(str));
 }
 
@@ -1,3 +1,4 @@
+#include "../CaseFolding.hpp"
 #include "../RegexGraph.hpp"
 #include "../Utils.hpp"
 #include <cassert>
@@ -204,113 +205,112 @@ void SearchRecursiveGroupCalls(GroupStats& group_stats)
 // GetRegexChainSize
 //
 
-// Size in UTF-8 bytes.
+// Size in code units of given encoding.
 using MinMaxSize= std::pair<size_t, size_t>;
 
-MinMaxSize GetRegexChainSize(const RegexElementsChain& regex_chain);
+MinMaxSize GetRegexChainSize(const RegexElementsChain& regex_chain, Encoding encoding);
 
-MinMaxSize GetRegexElementSize_impl(const AnySymbol&)
+MinMaxSize GetAnyCodePointSize(const Encoding encoding)
+{
+	return MinMaxSize{GetCodePointSize(0, encoding), GetCodePointSize(0x10FFFF, encoding)};
+}
+
+MinMaxSize GetRegexElementSize_impl(const AnySymbol&, const Encoding encoding)
 {
 	// All sizes are possible for any symbol.
 	// TODO - maybe process just raw bytes in "any" symbol?
-	return MinMaxSize{1, 6};
+	return GetAnyCodePointSize(encoding);
 }
 
-MinMaxSize GetRegexElementSize_impl(const SpecificSymbol& specific_symbol)
+MinMaxSize GetRegexElementSize_impl(const SpecificSymbol& specific_symbol, const Encoding encoding)
 {
-	const CharType str_utf32[]{specific_symbol.code, 0};
-	const size_t size= Utf32ToUtf8(str_utf32).size();
+	const size_t size= GetCodePointSize(specific_symbol.code, encoding);
 	return MinMaxSize{size, size};
 }
 
-MinMaxSize GetRegexElementSize_impl(const OneOf& one_of)
+MinMaxSize GetRegexElementSize_impl(const OneOf& one_of, const Encoding encoding)
 {
 	if(one_of.inverse_flag)
-		return MinMaxSize{1, 6};
+		return GetAnyCodePointSize(encoding);
 
 	MinMaxSize res{100, 0};
 
 	for(const CharType c : one_of.variants)
 	{
-		const CharType str_utf32[]{c, 0};
-		const size_t size= Utf32ToUtf8(str_utf32).size();
+		const size_t size= GetCodePointSize(c, encoding);
 		res.first = std::min(res.first , size);
 		res.second= std::max(res.second, size);
 	}
 
 	for(const auto& range : one_of.ranges)
 	{
-		const CharType begin_str_utf32[]{range.first , 0};
-		const CharType   end_str_utf32[]{range.second, 0};
-		const size_t min_size= Utf32ToUtf8(begin_str_utf32).size();
-		const size_t max_size= Utf32ToUtf8(  end_str_utf32).size();
-		res.first = std::min(res.first , min_size);
-		res.second= std::max(res.second, max_size);
+		res.first = std::min(res.first , GetCodePointSize(range.first , encoding));
+		res.second= std::max(res.second, GetCodePointSize(range.second, encoding));
 	}
 
 	return res;
 }
 
-MinMaxSize GetRegexElementSize_impl(const Group& group)
+MinMaxSize GetRegexElementSize_impl(const Group& group, const Encoding encoding)
 {
-	return GetRegexChainSize(group.elements);
+	return GetRegexChainSize(group.elements, encoding);
 }
 
-MinMaxSize GetRegexElementSize_impl(const BackReference&)
+MinMaxSize GetRegexElementSize_impl(const BackReference&, Encoding)
 {
 	return MinMaxSize{0, Sequence::c_max};
 }
 
-MinMaxSize GetRegexElementSize_impl(const NonCapturingGroup& group)
+MinMaxSize GetRegexElementSize_impl(const NonCapturingGroup& group, const Encoding encoding)
 {
-	return GetRegexChainSize(group.elements);
+	return GetRegexChainSize(group.elements, encoding);
 }
 
-MinMaxSize GetRegexElementSize_impl(const AtomicGroup& group)
+MinMaxSize GetRegexElementSize_impl(const AtomicGroup& group, const Encoding encoding)
 {
-	return GetRegexChainSize(group.elements);
+	return GetRegexChainSize(group.elements, encoding);
 }
 
-MinMaxSize GetRegexElementSize_impl(const Alternatives& alternatives)
+MinMaxSize GetRegexElementSize_impl(const Alternatives& alternatives, const Encoding encoding)
 {
 	MinMaxSize s{Sequence::c_max, 0};
 	for(const RegexElementsChain& alternative : alternatives.alternatives)
 	{
-		const auto el_s= GetRegexChainSize(alternative);
+		const auto el_s= GetRegexChainSize(alternative, encoding);
 		s.first= std::min(s.first, el_s.first);
 		s.second= std::max(s.second, el_s.second);
 	}
 	return s;
 }
 
-MinMaxSize GetRegexElementSize_impl(const Look&)
+MinMaxSize GetRegexElementSize_impl(const Look&, Encoding)
 {
 	return MinMaxSize{0, 0};
 }
 
-MinMaxSize GetRegexElementSize_impl(const LineStartAssertion&)
+MinMaxSize GetRegexElementSize_impl(const LineStartAssertion&, Encoding)
 {
 	return MinMaxSize{0, 0};
 }
 
-MinMaxSize GetRegexElementSize_impl(const LineEndAssertion&)
+MinMaxSize GetRegexElementSize_impl(const LineEndAssertion&, Encoding)
 {
 	return MinMaxSize{0, 0};
 }
 
-MinMaxSize GetRegexElementSize_impl(const ConditionalElement& conditional_element)
+MinMaxSize GetRegexElementSize_impl(const ConditionalElement& conditional_element, const Encoding encoding)
 {
-	return GetRegexElementSize_impl(conditional_element.alternatives);
+	return GetRegexElementSize_impl(conditional_element.alternatives, encoding);
 }
 
-MinMaxSize GetRegexElementSize_impl(const SubroutineCall&)
+MinMaxSize GetRegexElementSize_impl(const SubroutineCall&, Encoding)
 {
 	return MinMaxSize{0, Sequence::c_max};
 }
 
-MinMaxSize GetRegexElementSize(const RegexElementFull& element)
+MinMaxSize GetRegexElementSize(const RegexElementFull& element, const Encoding encoding)
 {
-	MinMaxSize el_size= std::visit([&](const auto& el){ return GetRegexElementSize_impl(el); }, element.el);
+	MinMaxSize el_size= std::visit([&](const auto& el){ return GetRegexElementSize_impl(el, encoding); }, element.el);
 
 	el_size.first*= element.seq.min_elements;
 	if(element.seq.max_elements == Sequence::c_max)
@@ -321,12 +321,12 @@ MinMaxSize GetRegexElementSize(const RegexElementFull& element)
 	return el_size;
 }
 
-MinMaxSize GetRegexChainSize(const RegexElementsChain& regex_chain)
+MinMaxSize GetRegexChainSize(const RegexElementsChain& regex_chain, const Encoding encoding)
 {
 	MinMaxSize s{0, 0};
 	for(const RegexElementFull& el : regex_chain)
 	{
-		const auto el_s= GetRegexElementSize(el);
+		const auto el_s= GetRegexElementSize(el, encoding);
 		s.first+= el_s.first;
 		s.second+= el_s.second;
 	}
@@ -431,8 +431,6 @@ GraphElements::NodePtr RegexGraphBuilder::BuildRegexGraphChain(const GraphElemen
 
 	const auto next_node= BuildRegexGraphChain(next, std::next(begin), end);
 
-	const auto node_possessive= BuildRegexGraphNode(nullptr, element.el);
-
 	if(element.seq.min_elements == 1 && element.seq.max_elements == 1)
 		return BuildRegexGraphNode(next_node, element.el);
 	else if(element.seq.mode == SequenceMode::Possessive)
@@ -441,7 +439,7 @@ GraphElements::NodePtr RegexGraphBuilder::BuildRegexGraphChain(const GraphElemen
 			nodes_storage_.Allocate(
 				GraphElements::PossessiveSequence{
 					next_node,
-					node_possessive,
+					BuildRegexGraphNode(nullptr, element.el),
 					element.seq.min_elements,
 					element.seq.max_elements,
 					});
@@ -532,6 +530,13 @@ GraphElements::NodePtr RegexGraphBuilder::BuildRegexGraphNodeImpl(const GraphEle
 
 GraphElements::NodePtr RegexGraphBuilder::BuildRegexGraphNodeImpl(const GraphElements::NodePtr next, const SpecificSymbol& specific_symbol)
 {
+	if(specific_symbol.case_insensitive)
+	{
+		// Use string node for case-insensitive symbol, it is stored in folded case.
+		const char32_t folded_code= FoldCase(specific_symbol.code);
+		return nodes_storage_.Allocate(GraphElements::String{next, Utf32ToUtf8(std::basic_string_view<char32_t>(&folded_code, 1)), true});
+	}
+
 	return nodes_storage_.Allocate(GraphElements::SpecificSymbol{next, specific_symbol.code});
 }
 
@@ -635,7 +640,7 @@ GraphElements::NodePtr RegexGraphBuilder::BuildRegexGraphNodeImpl(const GraphEle
 		out_node.next= next;
 		out_node.look_graph= look_graph;
 		out_node.positive= look.positive;
-		out_node.size= GetRegexChainSize(look.elements).first; // TODO - raise error is size is not exact. Now - just use minimum size.
+		out_node.size= GetRegexChainSize(look.elements, options_.encoding).first; // TODO - raise error is size is not exact. Now - just use minimum size.
 
 		return nodes_storage_.Allocate(std::move(out_node));
 	}
@@ -753,6 +758,203 @@ void RegexGraphBuilder::SetupSubroutineCalls()
 	}
 }
 
+//
+// Node children enumeration
+//
+
+template<typename Func>
+void ForEachNodeChildPtrImpl(GraphElements::AnySymbol& any_symbol, const Func& func)
+{
+	func(any_symbol.next);
+}
+
+template<typename Func>
+void ForEachNodeChildPtrImpl(GraphElements::SpecificSymbol& specific_symbol, const Func& func)
+{
+	func(specific_symbol.next);
+}
+
+template<typename Func>
+void ForEachNodeChildPtrImpl(GraphElements::String& string, const Func& func)
+{
+	func(string.next);
+}
+
+template<typename Func>
+void ForEachNodeChildPtrImpl(GraphElements::OneOf& one_of, const Func& func)
+{
+	func(one_of.next);
+}
+
+template<typename Func>
+void ForEachNodeChildPtrImpl(GraphElements::Alternatives& alternatives, const Func& func)
+{
+	for(auto& next : alternatives.next)
+		func(next);
+}
+
+template<typename Func>
+void ForEachNodeChildPtrImpl(GraphElements::AlternativesPossessive& alternatives_possessive, const Func& func)
+{
+	func(alternatives_possessive.path0_element);
+	func(alternatives_possessive.path0_next);
+	func(alternatives_possessive.path1_next);
+}
+
+template<typename Func>
+void ForEachNodeChildPtrImpl(GraphElements::AlternativesTrie& alternatives_trie, const Func& func)
+{
+	for(auto& alternative : alternatives_trie.alternatives)
+		func(alternative.next);
+}
+
+template<typename Func>
+void ForEachNodeChildPtrImpl(GraphElements::GroupStart& group_start, const Func& func)
+{
+	func(group_start.next);
+}
+
+template<typename Func>
+void ForEachNodeChildPtrImpl(GraphElements::GroupEnd& group_end, const Func& func)
+{
+	func(group_end.next);
+}
+
+template<typename Func>
+void ForEachNodeChildPtrImpl(GraphElements::BackReference& back_reference, const Func& func)
+{
+	func(back_reference.next);
+}
+
+template<typename Func>
+void ForEachNodeChildPtrImpl(GraphElements::LookAhead& look_ahead, const Func& func)
+{
+	func(look_ahead.look_graph);
+	func(look_ahead.next);
+}
+
+template<typename Func>
+void ForEachNodeChildPtrImpl(GraphElements::LookBehind& look_behind, const Func& func)
+{
+	func(look_behind.look_graph);
+	func(look_behind.next);
+}
+
+template<typename Func>
+void ForEachNodeChildPtrImpl(GraphElements::StringStartAssertion& string_start_assertion, const Func& func)
+{
+	func(string_start_assertion.next);
+}
+
+template<typename Func>
+void ForEachNodeChildPtrImpl(GraphElements::StringEndAssertion& string_end_assertion, const Func& func)
+{
+	func(string_end_assertion.next);
+}
+
+template<typename Func>
+void ForEachNodeChildPtrImpl(GraphElements::ConditionalElement& conditional_element, const Func& func)
+{
+	func(conditional_element.condition_node);
+	func(conditional_element.next_true);
+	func(conditional_element.next_false);
+}
+
+template<typename Func>
+void ForEachNodeChildPtrImpl(GraphElements::SequenceCounterReset& sequence_counter_reset, const Func& func)
+{
+	func(sequence_counter_reset.next);
+}
+
+template<typename Func>
+void ForEachNodeChildPtrImpl(GraphElements::SequenceCounter& sequence_counter, const Func& func)
+{
+	func(sequence_counter.next_iteration);
+	func(sequence_counter.next_sequence_end);
+}
+
+template<typename Func>
+void ForEachNodeChildPtrImpl(GraphElements::PossessiveSequence& possesive_sequence, const Func& func)
+{
+	func(possesive_sequence.sequence_element);
+	func(possesive_sequence.next);
+}
+
+template<typename Func>
+void ForEachNodeChildPtrImpl(GraphElements::SingleRollbackPointSequence& single_rollback_point_sequence, const Func& func)
+{
+	func(single_rollback_point_sequence.sequence_element);
+	func(single_rollback_point_sequence.next);
+}
+
+template<typename Func>
+void ForEachNodeChildPtrImpl(GraphElements::FixedLengthElementSequence& fixed_length_element_sequence, const Func& func)
+{
+	func(fixed_length_element_sequence.sequence_element);
+	func(fixed_length_element_sequence.next);
+}
+
+template<typename Func>
+void ForEachNodeChildPtrImpl(GraphElements::AtomicGroup& atomic_group, const Func& func)
+{
+	func(atomic_group.group_element);
+	func(atomic_group.next);
+}
+
+template<typename Func>
+void ForEachNodeChildPtrImpl(GraphElements::SubroutineEnter& subroutine_enter, const Func& func)
+{
+	func(subroutine_enter.subroutine_node);
+	func(subroutine_enter.next);
+}
+
+template<typename Func>
+void ForEachNodeChildPtrImpl(GraphElements::SubroutineLeave& subroutine_leave, const Func& func)
+{
+	(void)func;
+	(void)subroutine_leave;
+}
+
+template<typename Func>
+void ForEachNodeChildPtrImpl(GraphElements::StateSave& state_save, const Func& func)
+{
+	func(state_save.next);
+}
+
+template<typename Func>
+void ForEachNodeChildPtrImpl(GraphElements::StateRestore& state_restore, const Func& func)
+{
+	func(state_restore.next);
+}
+
+//
+// Node enumeration
+//
+
+using VisitedNodesSet= std::unordered_set<GraphElements::NodePtr>;
+
+void EnumerateAllNodesOnceImpl(
+	const NodeEnumerationFunction& func,
+	VisitedNodesSet& visited_nodes_set,
+	const GraphElements::NodePtr node)
+{
+	if(node == nullptr)
+		return;
+
+	if(visited_nodes_set.count(node) != 0)
+		return;
+	visited_nodes_set.insert(node);
+
+	func(node);
+
+	std::visit(
+		[&](auto& el)
+		{
+			ForEachNodeChildPtrImpl(el, [&](const GraphElements::NodePtr child){ EnumerateAllNodesOnceImpl(func, visited_nodes_set, child); });
+		},
+		*node);
+}
+
 } // namespace
 
 RegexGraphBuildResult BuildRegexGraph(const RegexElementsChain& regex_chain, const Options& options)
@@ -761,4 +963,15 @@ RegexGraphBuildResult BuildRegexGraph(const RegexElementsChain& regex_chain, con
 	return builder.BuildRegexGraph(regex_chain);
 }
 
+void EnumerateAllNodesOnce(const NodeEnumerationFunction& func, const GraphElements::NodePtr start_node)
+{
+	VisitedNodesSet nodes_set;
+	return EnumerateAllNodesOnceImpl(func, nodes_set, start_node);
+}
+
+void ForEachNodeChildPtr(GraphElements::Node& node, const NodeChildPtrFunction& func)
+{
+	std::visit([&](auto& el){ ForEachNodeChildPtrImpl(el, func); }, node);
+}
+
 } // namespace RegPanzer
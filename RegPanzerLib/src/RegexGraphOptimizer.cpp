@@ -1,6 +1,13 @@
+#include "../CaseFolding.hpp"
 #include "../RegexGraphOptimizer.hpp"
 #include "../Utils.hpp"
+#include <algorithm>
+#include <cassert>
+#include <map>
 #include <optional>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace RegPanzer
 {
@@ -10,27 +17,76 @@ namespace
 
 using VisitedNodesSet= std::unordered_set<GraphElements::NodePtr>;
 
+//
+// Symbol sets stuff
+//
+
+using SymbolRanges= std::vector< std::pair<CharType, CharType> >;
+
+// Returns sorted, non-overlapping and non-adjacent ranges for given symbols set (ignoring inverse flag).
+SymbolRanges GetMergedSymbolRanges(const std::vector<CharType>& variants, const SymbolRanges& ranges)
+{
+	SymbolRanges sorted_ranges;
+	sorted_ranges.reserve(variants.size() + ranges.size());
+	for(const CharType c : variants)
+		sorted_ranges.emplace_back(c, c);
+	for(const auto& range : ranges)
+		if(range.first <= range.second) // Skip invalid (empty) ranges.
+			sorted_ranges.push_back(range);
+	std::sort(sorted_ranges.begin(), sorted_ranges.end());
+
+	SymbolRanges merged_ranges;
+	for(const auto& range : sorted_ranges)
+	{
+		if(!merged_ranges.empty() && (range.first <= merged_ranges.back().second || range.first - 1 == merged_ranges.back().second))
+			merged_ranges.back().second= std::max(merged_ranges.back().second, range.second);
+		else
+			merged_ranges.push_back(range);
+	}
+
+	return merged_ranges;
+}
+
+// Stores ranges of single symbol as variants and other ranges as ranges.
+void SetSymbolRanges(const SymbolRanges& merged_ranges, std::vector<CharType>& out_variants, SymbolRanges& out_ranges)
+{
+	out_variants.clear();
+	out_ranges.clear();
+	for(const auto& range : merged_ranges)
+	{
+		if(range.first == range.second)
+			out_variants.push_back(range.first);
+		else
+			out_ranges.push_back(range);
+	}
+}
+
 //
 // Start symbols stuff
 //
 
-std::optional<size_t> GetOneOfLength(const GraphElements::OneOf& one_of)
+std::optional<size_t> GetOneOfLength(const GraphElements::OneOf& one_of, const Encoding encoding)
 {
+	if(one_of.inverse_flag)
+	{
+		// Inverse set may match any code point.
+		if(encoding == Encoding::UTF32 || encoding == Encoding::Bytes)
+			return 1;
+		return std::nullopt;
+	}
+
 	size_t min_size= 100, max_size= 0;
 	for(const CharType c : one_of.variants)
 	{
-		const CharType str_utf32[]{c, 0};
-		const size_t size= Utf32ToUtf8(str_utf32).size();
+		const size_t size= GetCodePointSize(c, encoding);
 		min_size= std::min(min_size, size);
 		max_size= std::max(max_size, size);
 	}
 
 	for(const auto& range : one_of.ranges)
 	{
-		const CharType begin_str_utf32[]{range.first , 0};
-		const CharType   end_str_utf32[]{range.second, 0};
-		min_size= std::min(min_size, Utf32ToUtf8(begin_str_utf32).size());
-		max_size= std::max(max_size, Utf32ToUtf8(  end_str_utf32).size());
+		min_size= std::min(min_size, GetCodePointSize(range.first , encoding));
+		max_size= std::max(max_size, GetCodePointSize(range.second, encoding));
 	}
 
 	if(min_size != max_size)
@@ -44,11 +100,14 @@ OneOf CombineSymbolSets(const OneOf& l, const OneOf& r)
 	if(l.inverse_flag || r.inverse_flag) // TODO - support merging inversed "OneOf"
 		return OneOf{ {}, {}, true };
 
+	std::vector<CharType> variants= l.variants;
+	SymbolRanges ranges= l.ranges;
+	variants.insert(variants.end(), r.variants.begin(), r.variants.end());
+	ranges.insert(ranges.end(), r.ranges.begin(), r.ranges.end());
+
+	// Keep result normalized in order to avoid growing of sets, combined many times.
 	OneOf res;
-	res.variants.insert(res.variants.end(), l.variants.begin(), l.variants.end());
-	res.ranges.insert(res.ranges.end(), l.ranges.begin(), l.ranges.end());
-	res.variants.insert(res.variants.end(), r.variants.begin(), r.variants.end());
-	res.ranges.insert(res.ranges.end(), r.ranges.begin(), r.ranges.end());
+	SetSymbolRanges(GetMergedSymbolRanges(variants, ranges), res.variants, res.ranges);
 	return res;
 }
 
@@ -109,9 +168,25 @@ OneOf GetPossibleStartSybmolsImpl(VisitedNodesSet& visited_nodes, const GraphEle
 
 OneOf GetPossibleStartSybmolsImpl(VisitedNodesSet& visited_nodes, const GraphElements::String& string)
 {
-	const auto str_utf32= Utf8ToUtf32(string.str);
-	if(!str_utf32.empty())
-		return OneOf{ {str_utf32.front()}, {}, false };
+	if(!string.str.empty())
+	{
+		// Decode only first code point, since string may start or end in the middle of code point (result of alternatives start unite).
+		size_t first_code_point_size= 1;
+		while(first_code_point_size < string.str.size() && (string.str[first_code_point_size] & 0b11000000) == 0b10000000)
+			++first_code_point_size;
+
+		const auto str_utf32= Utf8ToUtf32(std::string_view(string.str).substr(0, first_code_point_size));
+		if(str_utf32.empty())
+			return GetAnySymbol(); // Not a whole code point.
+
+		OneOf res{ {str_utf32.front()}, {}, false };
+		if(string.case_insensitive)
+		{
+			if(const auto other_case= GetOtherCase(str_utf32.front()))
+				res.variants.push_back(*other_case);
+		}
+		return res;
+	}
 	return GetPossibleStartSybmols(visited_nodes, string.next);
 }
 
@@ -137,6 +212,20 @@ OneOf GetPossibleStartSybmolsImpl(VisitedNodesSet& visited_nodes, const GraphEle
 			GetPossibleStartSybmols(visited_nodes, alternatives_possessive.path1_next));
 }
 
+OneOf GetPossibleStartSybmolsImpl(VisitedNodesSet& visited_nodes, const GraphElements::AlternativesTrie& alternatives_trie)
+{
+	(void)visited_nodes;
+	OneOf res;
+	for(const auto& alternative : alternatives_trie.alternatives)
+	{
+		const auto str_utf32= Utf8ToUtf32(alternative.str);
+		assert(!str_utf32.empty());
+		res= CombineSymbolSets(res, OneOf{ {str_utf32.front()}, {}, false });
+	}
+
+	return res;
+}
+
 OneOf GetPossibleStartSybmolsImpl(VisitedNodesSet& visited_nodes, const GraphElements::GroupStart& group_start)
 {
 	return GetPossibleStartSybmols(visited_nodes, group_start.next);
@@ -196,15 +285,17 @@ OneOf GetPossibleStartSybmolsImpl(VisitedNodesSet& visited_nodes, const GraphEle
 
 OneOf GetPossibleStartSybmolsImpl(VisitedNodesSet& visited_nodes, const GraphElements::SequenceCounterReset& sequence_counter_reset)
 {
+	// Counter is zero after reset, so, if at least one iteration is needed - can use only sequence element.
+	if(const auto sequence_counter= std::get_if<GraphElements::SequenceCounter>(sequence_counter_reset.next))
+		if(sequence_counter->min_elements > 0)
+			return GetPossibleStartSybmols(visited_nodes, sequence_counter->next_iteration);
+
 	return GetPossibleStartSybmols(visited_nodes, sequence_counter_reset.next);
 }
 
 OneOf GetPossibleStartSybmolsImpl(VisitedNodesSet& visited_nodes, const GraphElements::SequenceCounter& sequence_counter)
 {
-	if(sequence_counter.min_elements > 0)
-		return GetPossibleStartSybmols(visited_nodes, sequence_counter.next_iteration); // At least one iteration - can use only sequence element.
-
-	// Combine for cases of empty sequence.
+	// Counter value is unknown here (sequence counter may be reached from sequence element), so, combine both paths.
 	return CombineSymbolSets(
 		GetPossibleStartSybmols(visited_nodes, sequence_counter.next_iteration),
 		GetPossibleStartSybmols(visited_nodes, sequence_counter.next_sequence_end));
@@ -287,238 +378,399 @@ OneOf GetPossibleStartSybmolsEntry(const GraphElements::NodePtr node)
 }
 
 //
-// Node enumeration
+// Empty path stuff
 //
 
-using NodeEnumerationFunction= std::function<void(GraphElements::NodePtr)>;
+// Possibility of successful match of graph part without consuming any symbol.
+// Values are ordered - greater value means more possibilities.
+enum class EmptyPathKind
+{
+	None, // Each successful match consumes at least one symbol.
+	Conditional, // Match without consuming symbols may be possible, depending on position and state.
+	Unconditional, // Match is always successful, regardless of position and state.
+};
+
+using EmptyPathKinds= std::unordered_map<GraphElements::NodePtr, EmptyPathKind>;
+
+// Returns kind, calculated for given node, or kind for the end of the graph for null node.
+EmptyPathKind GetEmptyPathKind(const EmptyPathKinds& kinds, GraphElements::NodePtr node);
 
-void EnumerateAllNodesOnceImpl(
-	const NodeEnumerationFunction& func,
-	VisitedNodesSet& visited_nodes_set,
-	GraphElements::NodePtr node);
+EmptyPathKind GetEmptyPathKindImpl(const EmptyPathKinds& kinds, const GraphElements::AnySymbol& any_symbol)
+{
+	(void)kinds;
+	(void)any_symbol;
+	return EmptyPathKind::None;
+}
 
-void EnumerateAllNodesOnceVisitImpl(const NodeEnumerationFunction& func, VisitedNodesSet& visited_nodes_set, const GraphElements::AnySymbol& any_symbol)
+EmptyPathKind GetEmptyPathKindImpl(const EmptyPathKinds& kinds, const GraphElements::SpecificSymbol& specific_symbol)
 {
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, any_symbol.next);
+	(void)kinds;
+	(void)specific_symbol;
+	return EmptyPathKind::None;
 }
 
-void EnumerateAllNodesOnceVisitImpl(const NodeEnumerationFunction& func, VisitedNodesSet& visited_nodes_set, const GraphElements::SpecificSymbol& specific_symbol)
+EmptyPathKind GetEmptyPathKindImpl(const EmptyPathKinds& kinds, const GraphElements::String& string)
 {
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, specific_symbol.next);
+	if(string.str.empty())
+		return GetEmptyPathKind(kinds, string.next);
+	return EmptyPathKind::None;
 }
 
-void EnumerateAllNodesOnceVisitImpl(const NodeEnumerationFunction& func, VisitedNodesSet& visited_nodes_set, const GraphElements::String& string)
+EmptyPathKind GetEmptyPathKindImpl(const EmptyPathKinds& kinds, const GraphElements::OneOf& one_of)
 {
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, string.next);
+	(void)kinds;
+	(void)one_of;
+	return EmptyPathKind::None;
 }
 
-void EnumerateAllNodesOnceVisitImpl(const NodeEnumerationFunction& func, VisitedNodesSet& visited_nodes_set, const GraphElements::OneOf& one_of)
+EmptyPathKind GetEmptyPathKindImpl(const EmptyPathKinds& kinds, const GraphElements::Alternatives& alternatives)
 {
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, one_of.next);
+	// Alternatives are evaluated with backtracking, so, one alternative is enough.
+	EmptyPathKind res= EmptyPathKind::None;
+	for(const GraphElements::NodePtr next : alternatives.next)
+		res= std::max(res, GetEmptyPathKind(kinds, next));
+
+	return res;
 }
 
-void EnumerateAllNodesOnceVisitImpl(const NodeEnumerationFunction& func, VisitedNodesSet& visited_nodes_set, const GraphElements::Alternatives& alternatives)
+EmptyPathKind GetEmptyPathKindImpl(const EmptyPathKinds& kinds, const GraphElements::AlternativesPossessive& alternatives_possessive)
 {
-	for(const auto& next : alternatives.next)
-		EnumerateAllNodesOnceImpl(func, visited_nodes_set, next);
+	const EmptyPathKind path0_element_kind= GetEmptyPathKind(kinds, alternatives_possessive.path0_element);
+	const EmptyPathKind path0_next_kind= GetEmptyPathKind(kinds, alternatives_possessive.path0_next);
+	const EmptyPathKind path1_next_kind= GetEmptyPathKind(kinds, alternatives_possessive.path1_next);
+
+	// There is no backtracking after successful match of path0 element, so, both paths should always match.
+	if(path0_next_kind == EmptyPathKind::Unconditional && path1_next_kind == EmptyPathKind::Unconditional)
+		return EmptyPathKind::Unconditional;
+
+	if(path1_next_kind != EmptyPathKind::None ||
+		(path0_element_kind != EmptyPathKind::None && path0_next_kind != EmptyPathKind::None))
+		return EmptyPathKind::Conditional;
+
+	return EmptyPathKind::None;
 }
 
-void EnumerateAllNodesOnceVisitImpl(const NodeEnumerationFunction& func, VisitedNodesSet& visited_nodes_set, const GraphElements::AlternativesPossessive& alternatives_possessive)
+EmptyPathKind GetEmptyPathKindImpl(const EmptyPathKinds& kinds, const GraphElements::AlternativesTrie& alternatives_trie)
 {
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, alternatives_possessive.path0_element);
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, alternatives_possessive.path0_next);
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, alternatives_possessive.path1_next);
+	(void)kinds;
+	(void)alternatives_trie;
+	// All strings are non-empty.
+	return EmptyPathKind::None;
 }
 
-void EnumerateAllNodesOnceVisitImpl(const NodeEnumerationFunction& func, VisitedNodesSet& visited_nodes_set, const GraphElements::GroupStart& group_start)
+EmptyPathKind GetEmptyPathKindImpl(const EmptyPathKinds& kinds, const GraphElements::GroupStart& group_start)
 {
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, group_start.next);
+	return GetEmptyPathKind(kinds, group_start.next);
 }
 
-void EnumerateAllNodesOnceVisitImpl(const NodeEnumerationFunction& func, VisitedNodesSet& visited_nodes_set, const GraphElements::GroupEnd& group_end)
+EmptyPathKind GetEmptyPathKindImpl(const EmptyPathKinds& kinds, const GraphElements::GroupEnd& group_end)
 {
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, group_end.next);
+	return GetEmptyPathKind(kinds, group_end.next);
 }
 
-void EnumerateAllNodesOnceVisitImpl(const NodeEnumerationFunction& func, VisitedNodesSet& visited_nodes_set, const GraphElements::BackReference& back_reference)
+EmptyPathKind GetEmptyPathKindImpl(const EmptyPathKinds& kinds, const GraphElements::BackReference& back_reference)
 {
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, back_reference.next);
+	// Back reference may be empty, but it may also fail.
+	return std::min(GetEmptyPathKind(kinds, back_reference.next), EmptyPathKind::Conditional);
 }
 
-void EnumerateAllNodesOnceVisitImpl(const NodeEnumerationFunction& func, VisitedNodesSet& visited_nodes_set, const GraphElements::LookAhead& look_ahead)
+EmptyPathKind GetEmptyPathKindImpl(const EmptyPathKinds& kinds, const GraphElements::LookAhead& look_ahead)
 {
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, look_ahead.look_graph);
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, look_ahead.next);
+	return std::min(GetEmptyPathKind(kinds, look_ahead.next), EmptyPathKind::Conditional);
 }
 
-void EnumerateAllNodesOnceVisitImpl(const NodeEnumerationFunction& func, VisitedNodesSet& visited_nodes_set, const GraphElements::LookBehind& look_behind)
+EmptyPathKind GetEmptyPathKindImpl(const EmptyPathKinds& kinds, const GraphElements::LookBehind& look_behind)
 {
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, look_behind.look_graph);
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, look_behind.next);
+	return std::min(GetEmptyPathKind(kinds, look_behind.next), EmptyPathKind::Conditional);
 }
 
-void EnumerateAllNodesOnceVisitImpl(const NodeEnumerationFunction& func, VisitedNodesSet& visited_nodes_set, const GraphElements::StringStartAssertion& string_start_assertion)
+EmptyPathKind GetEmptyPathKindImpl(const EmptyPathKinds& kinds, const GraphElements::StringStartAssertion& string_start_assertion)
 {
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, string_start_assertion.next);
+	return std::min(GetEmptyPathKind(kinds, string_start_assertion.next), EmptyPathKind::Conditional);
 }
 
-void EnumerateAllNodesOnceVisitImpl(const NodeEnumerationFunction& func, VisitedNodesSet& visited_nodes_set, const GraphElements::StringEndAssertion& string_end_assertion)
+EmptyPathKind GetEmptyPathKindImpl(const EmptyPathKinds& kinds, const GraphElements::StringEndAssertion& string_end_assertion)
 {
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, string_end_assertion.next);
+	return std::min(GetEmptyPathKind(kinds, string_end_assertion.next), EmptyPathKind::Conditional);
 }
 
-void EnumerateAllNodesOnceVisitImpl(const NodeEnumerationFunction& func, VisitedNodesSet& visited_nodes_set, const GraphElements::ConditionalElement& conditional_element)
+EmptyPathKind GetEmptyPathKindImpl(const EmptyPathKinds& kinds, const GraphElements::ConditionalElement& conditional_element)
 {
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, conditional_element.condition_node);
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, conditional_element.next_true);
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, conditional_element.next_false);
+	return
+		std::min(
+			std::max(
+				GetEmptyPathKind(kinds, conditional_element.next_true),
+				GetEmptyPathKind(kinds, conditional_element.next_false)),
+			EmptyPathKind::Conditional);
 }
 
-void EnumerateAllNodesOnceVisitImpl(const NodeEnumerationFunction& func, VisitedNodesSet& visited_nodes_set, const GraphElements::SequenceCounterReset& sequence_counter_reset)
+EmptyPathKind GetEmptyPathKindImpl(const EmptyPathKinds& kinds, const GraphElements::SequenceCounterReset& sequence_counter_reset)
 {
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, sequence_counter_reset.next);
+	return GetEmptyPathKind(kinds, sequence_counter_reset.next);
 }
 
-void EnumerateAllNodesOnceVisitImpl(const NodeEnumerationFunction& func, VisitedNodesSet& visited_nodes_set, const GraphElements::SequenceCounter& sequence_counter)
+EmptyPathKind GetEmptyPathKindImpl(const EmptyPathKinds& kinds, const GraphElements::SequenceCounter& sequence_counter)
 {
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, sequence_counter.next_iteration);
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, sequence_counter.next_sequence_end);
+	// Path depends on counter value.
+	return
+		std::min(
+			std::max(
+				GetEmptyPathKind(kinds, sequence_counter.next_iteration),
+				GetEmptyPathKind(kinds, sequence_counter.next_sequence_end)),
+			EmptyPathKind::Conditional);
 }
 
-void EnumerateAllNodesOnceVisitImpl(const NodeEnumerationFunction& func, VisitedNodesSet& visited_nodes_set, const GraphElements::PossessiveSequence& possesive_sequence)
+EmptyPathKind GetEmptyPathKindImpl(const EmptyPathKinds& kinds, const GraphElements::PossessiveSequence& possessive_sequence)
 {
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, possesive_sequence.sequence_element);
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, possesive_sequence.next);
+	if(possessive_sequence.min_elements == 0)
+		return GetEmptyPathKind(kinds, possessive_sequence.next);
+
+	return
+		std::min(
+			std::min(
+				GetEmptyPathKind(kinds, possessive_sequence.sequence_element),
+				GetEmptyPathKind(kinds, possessive_sequence.next)),
+			EmptyPathKind::Conditional);
 }
 
-void EnumerateAllNodesOnceVisitImpl(const NodeEnumerationFunction& func, VisitedNodesSet& visited_nodes_set, const GraphElements::SingleRollbackPointSequence& single_rollback_point_sequence)
+EmptyPathKind GetEmptyPathKindImpl(const EmptyPathKinds& kinds, const GraphElements::SingleRollbackPointSequence& single_rollback_point_sequence)
 {
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, single_rollback_point_sequence.sequence_element);
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, single_rollback_point_sequence.next);
+	return GetEmptyPathKind(kinds, single_rollback_point_sequence.next);
 }
 
-void EnumerateAllNodesOnceVisitImpl(const NodeEnumerationFunction& func, VisitedNodesSet& visited_nodes_set, const GraphElements::FixedLengthElementSequence& fixed_length_element_sequence)
+EmptyPathKind GetEmptyPathKindImpl(const EmptyPathKinds& kinds, const GraphElements::FixedLengthElementSequence& fixed_length_element_sequence)
 {
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, fixed_length_element_sequence.sequence_element);
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, fixed_length_element_sequence.next);
+	if(fixed_length_element_sequence.min_elements == 0)
+		return GetEmptyPathKind(kinds, fixed_length_element_sequence.next);
+
+	return
+		std::min(
+			std::min(
+				GetEmptyPathKind(kinds, fixed_length_element_sequence.sequence_element),
+				GetEmptyPathKind(kinds, fixed_length_element_sequence.next)),
+			EmptyPathKind::Conditional);
 }
 
-void EnumerateAllNodesOnceVisitImpl(const NodeEnumerationFunction& func, VisitedNodesSet& visited_nodes_set, const GraphElements::AtomicGroup& atomic_group)
+EmptyPathKind GetEmptyPathKindImpl(const EmptyPathKinds& kinds, const GraphElements::AtomicGroup& atomic_group)
 {
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, atomic_group.group_element);
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, atomic_group.next);
+	return
+		std::min(
+			GetEmptyPathKind(kinds, atomic_group.group_element),
+			GetEmptyPathKind(kinds, atomic_group.next));
 }
 
-void EnumerateAllNodesOnceVisitImpl(const NodeEnumerationFunction& func, VisitedNodesSet& visited_nodes_set, const GraphElements::SubroutineEnter& subroutine_enter)
+EmptyPathKind GetEmptyPathKindImpl(const EmptyPathKinds& kinds, const GraphElements::SubroutineEnter& subroutine_enter)
 {
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, subroutine_enter.subroutine_node);
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, subroutine_enter.next);
+	(void)kinds;
+	(void)subroutine_enter;
+	// Nodes after subroutine leave are not known statically.
+	return EmptyPathKind::Conditional;
 }
 
-void EnumerateAllNodesOnceVisitImpl(const NodeEnumerationFunction& func, VisitedNodesSet& visited_nodes_set, const GraphElements::SubroutineLeave& subroutine_leave)
+EmptyPathKind GetEmptyPathKindImpl(const EmptyPathKinds& kinds, const GraphElements::SubroutineLeave& subroutine_leave)
 {
-	(void)func;
-	(void)visited_nodes_set;
+	(void)kinds;
 	(void)subroutine_leave;
+	// Nodes after subroutine leave are not known statically.
+	return EmptyPathKind::Conditional;
 }
 
-void EnumerateAllNodesOnceVisitImpl(const NodeEnumerationFunction& func, VisitedNodesSet& visited_nodes_set, const GraphElements::StateSave& state_save)
+EmptyPathKind GetEmptyPathKindImpl(const EmptyPathKinds& kinds, const GraphElements::StateSave& state_save)
 {
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, state_save.next);
+	return GetEmptyPathKind(kinds, state_save.next);
 }
 
-void EnumerateAllNodesOnceVisitImpl(const NodeEnumerationFunction& func, VisitedNodesSet& visited_nodes_set, const GraphElements::StateRestore& state_restore)
+EmptyPathKind GetEmptyPathKindImpl(const EmptyPathKinds& kinds, const GraphElements::StateRestore& state_restore)
 {
-	EnumerateAllNodesOnceImpl(func, visited_nodes_set, state_restore.next);
+	return GetEmptyPathKind(kinds, state_restore.next);
 }
 
-void EnumerateAllNodesOnceImpl(
-	const NodeEnumerationFunction& func,
-	VisitedNodesSet& visited_nodes_set,
-	const GraphElements::NodePtr node)
+EmptyPathKind GetEmptyPathKind(const EmptyPathKinds& kinds, const GraphElements::NodePtr node)
 {
 	if(node == nullptr)
-		return;
-
-	if(visited_nodes_set.count(node) != 0)
-		return;
-	visited_nodes_set.insert(node);
+		return EmptyPathKind::Unconditional; // End of the graph (or subgraph) is reached.
 
-	func(node);
-
-	return std::visit([&](const auto& el){ return EnumerateAllNodesOnceVisitImpl(func, visited_nodes_set, el); }, *node);
+	const auto it= kinds.find(node);
+	if(it == kinds.end())
+		return EmptyPathKind::None;
+	return it->second;
 }
 
-void EnumerateAllNodesOnce(const NodeEnumerationFunction& func, const GraphElements::NodePtr start_node)
+EmptyPathKinds CalculateEmptyPathKinds(const GraphElements::NodePtr graph_start)
 {
-	VisitedNodesSet nodes_set;
-	return EnumerateAllNodesOnceImpl(func, nodes_set, start_node);
+	std::vector<GraphElements::NodePtr> nodes;
+	EnumerateAllNodesOnce([&](const GraphElements::NodePtr node){ nodes.push_back(node); }, graph_start);
+
+	EmptyPathKinds kinds;
+	for(const GraphElements::NodePtr node : nodes)
+		kinds.emplace(node, EmptyPathKind::None);
+
+	// Kinds only grow, so, iterate until fixed point is reached.
+	// Start with "None" for all nodes - loops without consuming symbols give nothing new.
+	// Nodes are enumerated in depth-first order, so, iteration in reverse order converges fast.
+	bool changed= true;
+	while(changed)
+	{
+		changed= false;
+		for(auto it= nodes.rbegin(); it != nodes.rend(); ++it)
+		{
+			const EmptyPathKind kind= std::visit([&](const auto& el){ return GetEmptyPathKindImpl(kinds, el); }, **it);
+			EmptyPathKind& prev_kind= kinds.at(*it);
+			if(kind > prev_kind)
+			{
+				prev_kind= kind;
+				changed= true;
+			}
+		}
+	}
+
+	return kinds;
 }
 
 //
-// Symbols combination.
+// "OneOf" normalization.
 //
 
-// Returns true if something changed.
-bool ApplySymbolsCombiningOptimizationToNode(const GraphElements::NodePtr node)
+// Returns true if node was rewritten.
+bool ApplyOneOfNormalizationToNode(const GraphElements::NodePtr node, const Encoding encoding)
 {
-	if(const auto specific_symbol= std::get_if<GraphElements::SpecificSymbol>(node))
+	/*
+		Bring "OneOf" nodes into canonical form:
+		sort and merge ranges (including single symbol variants), store ranges of single symbol as variants.
+		Replace inverted sets with positive sets if it is smaller (only for bytes, where all possible symbols are known).
+		Replace sets of single symbol with specific symbol nodes.
+	*/
+
+	const auto one_of= std::get_if<GraphElements::OneOf>(node);
+	if(one_of == nullptr)
+		return false;
+
+	SymbolRanges merged_ranges= GetMergedSymbolRanges(one_of->variants, one_of->ranges);
+	bool inverse_flag= one_of->inverse_flag;
+
+	if(encoding == Encoding::Bytes)
 	{
-		if(const auto specific_symbol_tail= std::get_if<GraphElements::SpecificSymbol>(specific_symbol->next))
+		// Symbols above 0xFF are not possible.
+		const CharType c_max_byte= 0xFF;
+		while(!merged_ranges.empty() && merged_ranges.back().first > c_max_byte)
+			merged_ranges.pop_back();
+		if(!merged_ranges.empty())
+			merged_ranges.back().second= std::min(merged_ranges.back().second, c_max_byte);
+
+		if(inverse_flag)
 		{
-			// Append symbol to symbol.
-			GraphElements::String string;
-			const CharType str_utf32[]{specific_symbol->code, specific_symbol_tail->code, 0};
-			string.str= Utf32ToUtf8(str_utf32);
-			string.next= specific_symbol_tail->next;
+			SymbolRanges inverse_ranges;
+			CharType next_begin= 0;
+			for(const auto& range : merged_ranges)
+			{
+				if(range.first > next_begin)
+					inverse_ranges.emplace_back(next_begin, range.first - 1);
+				next_begin= range.second + 1;
+			}
+			if(next_begin <= c_max_byte)
+				inverse_ranges.emplace_back(next_begin, c_max_byte);
 
-			*node= std::move(string);
-			return true;
-		}
-		if(const auto string_tail= std::get_if<GraphElements::String>(specific_symbol->next))
-		{
-			// Append string to symbol.
-			GraphElements::String string;
-			const CharType str_utf32[]{specific_symbol->code, 0};
-			string.str= Utf32ToUtf8(str_utf32);
-			string.str+= string_tail->str;
-			string.next= string_tail->next;
-
-			*node= std::move(string);
-			return true;
+			if(inverse_ranges.size() < merged_ranges.size())
+			{
+				merged_ranges= std::move(inverse_ranges);
+				inverse_flag= false;
+			}
 		}
 	}
-	if(const auto string= std::get_if<GraphElements::String>(node))
+
+	if(!inverse_flag && merged_ranges.size() == 1 && merged_ranges.front().first == merged_ranges.front().second)
 	{
-		if(const auto specific_symbol_tail= std::get_if<GraphElements::SpecificSymbol>(string->next))
-		{
-			// Append string to symbol.
-			const CharType str_utf32[]{specific_symbol_tail->code, 0};
-			string->str+= Utf32ToUtf8(str_utf32);
+		*node= GraphElements::SpecificSymbol{ one_of->next, merged_ranges.front().first };
+		return true;
+	}
 
-			GraphElements::NodePtr next= specific_symbol_tail->next;
-			string->next= std::move(next);
+	const GraphElements::OneOf one_of_original= *one_of;
+	SetSymbolRanges(merged_ranges, one_of->variants, one_of->ranges);
+	one_of->inverse_flag= inverse_flag;
 
-			return true;
-		}
-		if(const auto string_tail= std::get_if<GraphElements::String>(string->next))
+	return
+		one_of->inverse_flag != one_of_original.inverse_flag ||
+		one_of->variants != one_of_original.variants ||
+		one_of->ranges != one_of_original.ranges;
+}
+
+size_t ApplyOneOfNormalization(const GraphElements::NodePtr graph_start, const Encoding encoding)
+{
+	size_t nodes_rewritten= 0;
+	EnumerateAllNodesOnce(
+		[&](const GraphElements::NodePtr node)
 		{
-			// Append string to string.
-			string->str+= string_tail->str;
+			if(ApplyOneOfNormalizationToNode(node, encoding))
+				++nodes_rewritten;
+		},
+		graph_start);
 
-			GraphElements::NodePtr next= string_tail->next;
-			string->next= std::move(next);
+	return nodes_rewritten;
+}
 
-			return true;
-		}
+//
+// Symbols combination.
+//
+
+struct StringNodeContent
+{
+	std::string str;
+	bool case_insensitive= false;
+	GraphElements::NodePtr next= nullptr;
+};
+
+std::optional<StringNodeContent> GetStringNodeContent(const GraphElements::NodePtr node)
+{
+	if(const auto specific_symbol= std::get_if<GraphElements::SpecificSymbol>(node))
+	{
+		const CharType str_utf32[]{specific_symbol->code, 0};
+		return StringNodeContent{ Utf32ToUtf8(str_utf32), false, specific_symbol->next };
 	}
+	if(const auto string= std::get_if<GraphElements::String>(node))
+		return StringNodeContent{ string->str, string->case_insensitive, string->next };
+
+	return std::nullopt;
+}
+
+bool StringHasCaseVariants(const std::string& str)
+{
+	for(const char32_t c : Utf8ToUtf32(str))
+		if(GetOtherCase(c) != std::nullopt)
+			return true;
 
 	return false;
 }
 
-void ApplySymbolsCombiningOptimization(const GraphElements::NodePtr graph_start)
+// Returns true if something changed.
+bool ApplySymbolsCombiningOptimizationToNode(const GraphElements::NodePtr node)
+{
+	const auto head= GetStringNodeContent(node);
+	if(head == std::nullopt)
+		return false;
+
+	const auto tail= GetStringNodeContent(head->next);
+	if(tail == std::nullopt)
+		return false;
+
+	// Case-sensitive part may be appended to case-insensitive part only if it has no symbols with case variants.
+	if(head->case_insensitive != tail->case_insensitive &&
+		StringHasCaseVariants(head->case_insensitive ? tail->str : head->str))
+		return false;
+
+	// Append symbol or string to symbol or string.
+	GraphElements::String string;
+	string.str= head->str + tail->str;
+	string.case_insensitive= head->case_insensitive || tail->case_insensitive;
+	string.next= tail->next;
+
+	*node= std::move(string);
+	return true;
+}
+
+size_t ApplySymbolsCombiningOptimization(const GraphElements::NodePtr graph_start)
 {
 	// Perform several steps to ensure full combination.
+	size_t nodes_rewritten= 0;
 	while(true)
 	{
 		bool something_changed= false;
@@ -526,13 +778,18 @@ void ApplySymbolsCombiningOptimization(const GraphElements::NodePtr graph_start)
 			[&](const GraphElements::NodePtr node)
 			{
 				if(ApplySymbolsCombiningOptimizationToNode(node))
+				{
 					something_changed= true;
+					++nodes_rewritten;
+				}
 			},
 			graph_start);
 
 		if(!something_changed)
 			break;
 	}
+
+	return nodes_rewritten;
 }
 
 //
@@ -542,7 +799,7 @@ void ApplySymbolsCombiningOptimization(const GraphElements::NodePtr graph_start)
 std::string GetNodeStartString(const GraphElements::NodePtr node)
 {
 	if(const auto string= std::get_if<GraphElements::String>(node))
-		return string->str;
+		return string->case_insensitive ? "" : string->str;
 
 	if(const auto specific_symbol= std::get_if<GraphElements::SpecificSymbol>(node))
 	{
@@ -558,6 +815,9 @@ std::optional<GraphElements::NodePtr> CutNodeStartString(const GraphElements::No
 {
 	if(const auto string= std::get_if<GraphElements::String>(node))
 	{
+		if(string->case_insensitive)
+			return std::nullopt;
+
 		assert(symbols_cut <= string->str.size());
 
 		if(symbols_cut == string->str.size())
@@ -591,7 +851,7 @@ std::optional<GraphElements::NodePtr> CutNodeStartString(const GraphElements::No
 // Alternatives start unite.
 //
 
-bool ApplyAlternativeStartUniteToNode(const GraphElements::NodePtr node, GraphElements::NodesStorage& nodes_storage)
+bool ApplyAlternativeStartUniteToNode(const GraphElements::NodePtr node, GraphElements::NodesStorage& nodes_storage, const Encoding encoding)
 {
 	/*
 		If alternative variants starts with common prefix - extract it - move branching point further.
@@ -630,6 +890,13 @@ bool ApplyAlternativeStartUniteToNode(const GraphElements::NodePtr node, GraphEl
 		++num_common_symbols;
 	}
 
+	if(encoding != Encoding::UTF8)
+	{
+		// Strings are stored in UTF-8, but matched against non-UTF-8 input. So, cut prefix only at code point boundary.
+		while(num_common_symbols > 0 && num_common_symbols < start_strings[0].size() && (start_strings[0][num_common_symbols] & 0b11000000) == 0b10000000)
+			--num_common_symbols;
+	}
+
 	if(num_common_symbols == 0)
 		return false; // No common prefix.
 
@@ -657,344 +924,1277 @@ bool ApplyAlternativeStartUniteToNode(const GraphElements::NodePtr node, GraphEl
 	return true;
 }
 
-void ApplyAlternativeStartUnite(const GraphElements::NodePtr graph_start, GraphElements::NodesStorage& nodes_storage)
+size_t ApplyAlternativeStartUnite(const GraphElements::NodePtr graph_start, GraphElements::NodesStorage& nodes_storage, const Encoding encoding)
 {
 	// Perform several steps to ensure full combination.
+	size_t nodes_rewritten= 0;
 	while(true)
 	{
 		bool something_changed= false;
 		EnumerateAllNodesOnce(
 			[&](const GraphElements::NodePtr node)
 			{
-				if(ApplyAlternativeStartUniteToNode(node, nodes_storage))
+				if(ApplyAlternativeStartUniteToNode(node, nodes_storage, encoding))
+				{
 					something_changed= true;
+					++nodes_rewritten;
+				}
 			},
 			graph_start);
 
 		if(!something_changed)
 			break;
 	}
+
+	return nodes_rewritten;
 }
 
 //
-// Alternatives possessification.
+// Alternatives suffix factoring.
 //
 
-void ApplyAlternativesPossessificationOptimizationToNode(const GraphElements::NodePtr node, GraphElements::NodesStorage& nodes_storage)
+struct SuffixFactoringEntry
 {
-	/*
-		Perform following optimization:
-		If alternative node has only two branches and both branches starts with some fixed symbols
-		and first alternative branch is single symobl/string/one_of
-		it is possible to disable backtracking after matching of first element of first alternative,
-		since if it matches, the second alternative is guaranteed not to match.
-	*/
-
-	const auto alternatives= std::get_if<GraphElements::Alternatives>(node);
-	if(alternatives == nullptr)
-		return;
+	size_t alternative_index= 0;
+	std::string str; // Rest of string, which is not yet factored.
+	GraphElements::NodePtr original_node= nullptr; // Set if string and its next node are unchanged.
+};
 
-	// TODO - support more than 2 branches - combine leftover branches into leftover "Alternative" node.
-	if(alternatives->next.size() != 2)
-		return;
-	const GraphElements::NodePtr first_alternative= alternatives->next[0];
-	const GraphElements::NodePtr second_alternative= alternatives->next[1];
-
-	if(HasIntersection(GetPossibleStartSybmolsEntry(first_alternative), GetPossibleStartSybmolsEntry(second_alternative)))
-		return;
+GraphElements::NodePtr CreateStringNode(
+	std::string str, const bool case_insensitive, const GraphElements::NodePtr next, GraphElements::NodesStorage& nodes_storage)
+{
+	GraphElements::String string;
+	string.str= std::move(str);
+	string.case_insensitive= case_insensitive;
+	string.next= next;
+	return nodes_storage.Allocate(std::move(string));
+}
 
-	// Create copy of first alternative node in order to avoid modifying existing node.
-	GraphElements::NodePtr next= nullptr;
-	GraphElements::NodePtr first_alternative_modified= nullptr;
-	if(const auto specific_symbol= std::get_if<GraphElements::SpecificSymbol>(first_alternative))
-	{
-		next= specific_symbol->next;
-		GraphElements::SpecificSymbol copy= *specific_symbol;
-		copy.next= nullptr;
-		first_alternative_modified= nodes_storage.Allocate(std::move(copy));
-	}
-	else if(const auto string= std::get_if<GraphElements::String>(first_alternative))
+// Builds tree of shared suffixes (reversed trie) for given strings with common next node.
+// Writes heads of new chains into given alternatives list.
+void FactorAlternativesSuffixes(
+	std::vector<SuffixFactoringEntry> entries,
+	const bool case_insensitive,
+	const GraphElements::NodePtr next,
+	std::vector<GraphElements::NodePtr>& alternatives_next,
+	GraphElements::NodesStorage& nodes_storage,
+	const Encoding encoding)
+{
+	// Group strings by last byte. Strings with different last bytes can't share suffix.
+	std::map< char, std::vector<SuffixFactoringEntry> > entries_by_last_byte;
+	for(SuffixFactoringEntry& entry : entries)
 	{
-		next= string->next;
-		GraphElements::String copy= *string;
-		copy.next= nullptr;
-		first_alternative_modified= nodes_storage.Allocate(std::move(copy));
+		if(entry.str.empty())
+			alternatives_next[entry.alternative_index]= next;
+		else
+			entries_by_last_byte[entry.str.back()].push_back(std::move(entry));
 	}
-	else if(const auto one_of= std::get_if<GraphElements::OneOf>(first_alternative))
+
+	for(auto& last_byte_entries_pair : entries_by_last_byte)
 	{
-		next= one_of->next;
-		GraphElements::OneOf copy= *one_of;
-		copy.next= nullptr;
-		first_alternative_modified= nodes_storage.Allocate(std::move(copy));
-	}
-	else
-		return; // Unsupported kind.
+		std::vector<SuffixFactoringEntry>& group= last_byte_entries_pair.second;
+		const std::string& first_str= group.front().str;
 
-	// Perform the optimization, replace node with new one.
-	GraphElements::AlternativesPossessive alternatives_possessive;
-	alternatives_possessive.path0_element= first_alternative_modified;
-	alternatives_possessive.path0_next= next;
-	alternatives_possessive.path1_next= second_alternative;
+		size_t suffix_size= 0;
+		if(group.size() > 1)
+		{
+			suffix_size= 1;
+			while(true)
+			{
+				bool matches= true;
+				for(const SuffixFactoringEntry& entry : group)
+				{
+					if(entry.str.size() <= suffix_size || entry.str[entry.str.size() - 1 - suffix_size] != first_str[first_str.size() - 1 - suffix_size])
+					{
+						matches= false;
+						break;
+					}
+				}
+
+				if(!matches)
+					break;
+				++suffix_size;
+			}
 
-	*node= std::move(alternatives_possessive);
-}
+			if(encoding != Encoding::UTF8 || case_insensitive)
+			{
+				// Strings are stored in UTF-8, but matched against non-UTF-8 input or matched by code points. So, cut suffix only at code point boundary.
+				while(suffix_size > 0 && (first_str[first_str.size() - suffix_size] & 0b11000000) == 0b10000000)
+					--suffix_size;
+			}
+		}
 
-void ApplyAlternativesPossessificationOptimization(const GraphElements::NodePtr graph_start, GraphElements::NodesStorage& nodes_storage)
-{
-	EnumerateAllNodesOnce(
-		[&](const GraphElements::NodePtr node)
+		if(suffix_size == 0)
 		{
-			ApplyAlternativesPossessificationOptimizationToNode(node, nodes_storage);
-		},
-		graph_start);
-}
-
-void ApplyFixedLengthElementSequenceOptimizationForNode(const GraphElements::NodePtr node,  GraphElements::NodesStorage& nodes_storage)
-{
-	// For now apply the optimization only for sequences, implemented via alternatives node.
-	const auto alternatives= std::get_if<GraphElements::Alternatives>(node);
-	if(alternatives == nullptr)
-		return;
+			// No common suffix - create separate nodes.
+			for(SuffixFactoringEntry& entry : group)
+				alternatives_next[entry.alternative_index]=
+					entry.original_node != nullptr
+						? entry.original_node
+						: CreateStringNode(std::move(entry.str), case_insensitive, next, nodes_storage);
+			continue;
+		}
 
-	// Assume sequence is implemetded via alternatives node with loop trough first alternative path.
-	// There is no reason to optimize sequences, implemented via second alternative path, because such sequences will be optimized
-	// by the compiler backend, because they are tail calls.
+		const GraphElements::NodePtr suffix_node=
+			CreateStringNode(first_str.substr(first_str.size() - suffix_size), case_insensitive, next, nodes_storage);
 
-	if(alternatives->next.size() != 2)
-		return;
-	const GraphElements::NodePtr first_alternative= alternatives->next[0];
-	const GraphElements::NodePtr second_alternative= alternatives->next[1];
+		for(SuffixFactoringEntry& entry : group)
+		{
+			entry.str.resize(entry.str.size() - suffix_size);
+			entry.original_node= nullptr;
+		}
 
-	// For now support only sequence body, consisting of single simple element.
-	size_t element_length= 0;
-	GraphElements::NodePtr sequence_element= nullptr;
-	if(const auto specific_symbol= std::get_if<GraphElements::SpecificSymbol>(first_alternative))
-	{
-		if(specific_symbol->next != node)
-			return; // Too complicated sequence body.
+		FactorAlternativesSuffixes(std::move(group), case_insensitive, suffix_node, alternatives_next, nodes_storage, encoding);
+	}
+}
 
-		const CharType str_utf32[]{specific_symbol->code, 0};
-		element_length= Utf32ToUtf8(str_utf32).size();
+// Returns true if node was rewritten.
+bool ApplyAlternativesSuffixFactoringToNode(const GraphElements::NodePtr node, GraphElements::NodesStorage& nodes_storage, const Encoding encoding)
+{
+	/*
+		If several alternatives are strings with common suffix and same next node - make them share single node for this suffix.
+		This doesn't change matching results, but reduces size of the graph and thus size of the generated code.
+		Shared suffixes are extracted recursively, so, alternatives of words are converted into tree of suffixes.
+	*/
 
-		GraphElements::SpecificSymbol copy= *specific_symbol;
-		copy.next= nullptr;
-		sequence_element= nodes_storage.Allocate(std::move(copy));
+	const auto alternatives= std::get_if<GraphElements::Alternatives>(node);
+	if(alternatives == nullptr || alternatives->next.size() < 2)
+		return false;
 
-	}
-	else if(const auto string= std::get_if<GraphElements::String>(first_alternative))
+	// Group strings by next node and case-insensitivity flag.
+	std::map< std::pair<GraphElements::NodePtr, bool>, std::vector<SuffixFactoringEntry> > entries_by_next;
+	for(size_t i= 0; i < alternatives->next.size(); ++i)
 	{
-		if(string->next != node)
-			return; // Too complicated sequence body.
-
-		element_length= string->str.size();
-
-		GraphElements::String copy= *string;
-		copy.next= nullptr;
-		sequence_element= nodes_storage.Allocate(std::move(copy));
+		const GraphElements::NodePtr alternative= alternatives->next[i];
+		if(const auto content= GetStringNodeContent(alternative))
+		{
+			SuffixFactoringEntry entry;
+			entry.alternative_index= i;
+			entry.str= content->str;
+			entry.original_node= alternative;
+			entries_by_next[ std::make_pair(content->next, content->case_insensitive) ].push_back(std::move(entry));
+		}
 	}
-	else if(const auto one_of= std::get_if<GraphElements::OneOf>(first_alternative))
-	{
-		if(one_of->next != node)
-			return; // Too complicated sequence body.
 
-		const auto on_of_length= GetOneOfLength(*one_of);
-		if(on_of_length == std::nullopt)
-			return;
-
-		element_length= *on_of_length;
-
-		GraphElements::OneOf copy= *one_of;
-		copy.next= nullptr;
-		sequence_element= nodes_storage.Allocate(std::move(copy));
+	bool something_changed= false;
+	for(auto& next_entries_pair : entries_by_next)
+	{
+		std::vector<SuffixFactoringEntry>& entries= next_entries_pair.second;
+
+		// Process only groups with at least two strings with same last byte.
+		std::unordered_set<char> last_bytes;
+		bool has_common_suffix= false;
+		for(const SuffixFactoringEntry& entry : entries)
+			has_common_suffix|= !last_bytes.insert(entry.str.back()).second;
+
+		if(!has_common_suffix)
+			continue;
+
+		FactorAlternativesSuffixes(
+			std::move(entries),
+			next_entries_pair.first.second,
+			next_entries_pair.first.first,
+			alternatives->next,
+			nodes_storage,
+			encoding);
+		something_changed= true;
 	}
-	else
-		return; // Unsupported kind.
-
-	GraphElements::FixedLengthElementSequence fixed_length_element_sequence;
-	fixed_length_element_sequence.next= second_alternative;
-	fixed_length_element_sequence.sequence_element= std::move(sequence_element);
-	fixed_length_element_sequence.min_elements= 0;
-	fixed_length_element_sequence.max_elements= std::numeric_limits<size_t>::max();
-	fixed_length_element_sequence.element_length= element_length;
 
-	// Replace alternatives node with fixed length element sequence node.
-	*node= GraphElements::Node(std::move(fixed_length_element_sequence));
+	return something_changed;
 }
 
-void ApplyFixedLengthElementSequenceOptimization(const GraphElements::NodePtr graph_start, GraphElements::NodesStorage& nodes_storage)
+size_t ApplyAlternativesSuffixFactoring(const GraphElements::NodePtr graph_start, GraphElements::NodesStorage& nodes_storage, const Encoding encoding)
 {
+	size_t nodes_rewritten= 0;
 	EnumerateAllNodesOnce(
 		[&](const GraphElements::NodePtr node)
 		{
-			ApplyFixedLengthElementSequenceOptimizationForNode(node, nodes_storage);
+			if(ApplyAlternativesSuffixFactoringToNode(node, nodes_storage, encoding))
+				++nodes_rewritten;
 		},
 		graph_start);
+
+	return nodes_rewritten;
 }
 
 //
-// Sequence with single rollback point optimization.
+// Alternatives trie.
 //
 
-void ApplySequenceWithSingleRollbackPointOptimizationToNode(const GraphElements::NodePtr node, GraphElements::NodesStorage& nodes_storage)
+// For smaller number of alternatives possessive alternatives are good enough.
+constexpr size_t c_min_alternatives_for_trie= 4;
+
+// Returns true if node was rewritten.
+bool ApplyAlternativesTrieOptimizationToNode(const GraphElements::NodePtr node)
 {
 	/*
-		Use following optimization:
-		if sequence element has fixed length and element after sequence has fixed small length and this is the end of whole regexp,
-		create sequence with single rollback point.
-		On each iteration of the sequence perform evaluation of both sequence element and element after sequence.
-		If evaluation of element after the sequence was successfull - save state for this evaluation.
-		Perform sequence element match until first fail. Than return last saved state for element after the sequence (if it is non-empty).
-		It is necessary to have simple element after sequence (like single char or a small fixed string), because its matching is performing on each sequence iteration step.
+		If all alternatives are case-sensitive strings - replace alternatives node with trie node.
+		Trie node finds all matching strings at once and evaluates only next nodes of matched strings,
+		instead of trying each alternative one by one.
 	*/
 
-	// For now apply the optimization only for sequences, implemented via alternatives node.
 	const auto alternatives= std::get_if<GraphElements::Alternatives>(node);
-	if(alternatives == nullptr)
-		return;
-
-	// Assume sequence is implemetded via alternatives node with loop trough first alternative path.
-	// There is no reason to optimize sequences, implemented via second alternative path, because such sequences will be optimized
-	// by the compiler backend, because they are tail calls.
-
-	if(alternatives->next.size() != 2)
-		return;
-	const GraphElements::NodePtr first_alternative= alternatives->next[0];
-	const GraphElements::NodePtr second_alternative= alternatives->next[1];
-
-	// Support only single simple element after sequence.
-
-	size_t element_after_alternative_length= 0;
-	if(const auto specific_symbol= std::get_if<GraphElements::SpecificSymbol>(second_alternative))
-	{
-		if(specific_symbol->next != nullptr)
-			return; // Too complicated tail.
-
-		const CharType str_utf32[]{specific_symbol->code, 0};
-		element_after_alternative_length= Utf32ToUtf8(str_utf32).size();
-	}
-	else if(const auto string= std::get_if<GraphElements::String>(second_alternative))
-	{
-		if(string->next != nullptr)
-			return; // Too complicated tail.
-
-		element_after_alternative_length= string->str.size();
-	}
-	else if(const auto one_of= std::get_if<GraphElements::OneOf>(second_alternative))
-	{
-		if(one_of->next != nullptr)
-			return; // Too complicated tail.
-
-		const auto on_of_length= GetOneOfLength(*one_of);
-		if(on_of_length == std::nullopt)
-			return;
-		element_after_alternative_length= *on_of_length;
-	}
-	else
-		return; // Unsupported kind.
-
-	// For now support only sequence body, consisting of single simple element.
-	size_t sequence_element_length= 0;
-	if(const auto specific_symbol= std::get_if<GraphElements::SpecificSymbol>(first_alternative))
-	{
-		if(specific_symbol->next != node)
-			return; // Too complicated sequence body.
-
-		const CharType str_utf32[]{specific_symbol->code, 0};
-		sequence_element_length= Utf32ToUtf8(str_utf32).size();
-	}
-	else if(const auto string= std::get_if<GraphElements::String>(first_alternative))
-	{
-		if(string->next != node)
-			return; // Too complicated sequence body.
-
-		sequence_element_length= string->str.size();
-	}
-	else if(const auto one_of= std::get_if<GraphElements::OneOf>(first_alternative))
-	{
-		if(one_of->next != node)
-			return; // Too complicated sequence body.
-
-		const auto on_of_length= GetOneOfLength(*one_of);
-		if(on_of_length == std::nullopt)
-			return;
-		sequence_element_length= *on_of_length;
-	}
-	else
-		return; // Unsupported kind.
-
-	// Check if this optimization has sence.
-	const bool element_after_alternative_length_is_moderate=
-		element_after_alternative_length <= 2 ||
-		element_after_alternative_length * 2 <= sequence_element_length;
-	if(!element_after_alternative_length_is_moderate)
-		return;
+	if(alternatives == nullptr || alternatives->next.size() < c_min_alternatives_for_trie)
+		return false;
 
-	// Create sequence element node.
-	GraphElements::NodePtr sequence_element_node= nullptr;
-	if(const auto specific_symbol= std::get_if<GraphElements::SpecificSymbol>(first_alternative))
+	GraphElements::AlternativesTrie alternatives_trie;
+	alternatives_trie.alternatives.reserve(alternatives->next.size());
+	for(const GraphElements::NodePtr alternative : alternatives->next)
 	{
-		GraphElements::SpecificSymbol copy= *specific_symbol;
-		copy.next= nullptr;
-		sequence_element_node= nodes_storage.Allocate(std::move(copy));
+		const auto content= GetStringNodeContent(alternative);
+		if(content == std::nullopt || content->case_insensitive || content->str.empty())
+			return false;
 
+		alternatives_trie.alternatives.push_back(GraphElements::AlternativesTrie::Alternative{ content->str, content->next });
 	}
-	else if(const auto string= std::get_if<GraphElements::String>(first_alternative))
-	{
-		GraphElements::String copy= *string;
-		copy.next= nullptr;
-		sequence_element_node= nodes_storage.Allocate(std::move(copy));
-	}
-	else if(const auto one_of= std::get_if<GraphElements::OneOf>(first_alternative))
-	{
-		GraphElements::OneOf copy= *one_of;
-		copy.next= nullptr;
-		sequence_element_node= nodes_storage.Allocate(std::move(copy));
-	}
-	else
-		return; // Unsupported kind.
-
-	// Replace this alternatives node with optimized one.
-	GraphElements::SingleRollbackPointSequence sequenece;
-	sequenece.sequence_element= sequence_element_node;
-	sequenece.next= second_alternative;
 
-	*node= GraphElements::Node(std::move(sequenece));
+	*node= std::move(alternatives_trie);
+	return true;
 }
 
-void ApplySequenceWithSingleRollbackPointOptimization(const GraphElements::NodePtr graph_start, GraphElements::NodesStorage& nodes_storage)
+size_t ApplyAlternativesTrieOptimization(const GraphElements::NodePtr graph_start)
 {
+	size_t nodes_rewritten= 0;
 	EnumerateAllNodesOnce(
 		[&](const GraphElements::NodePtr node)
 		{
-			ApplySequenceWithSingleRollbackPointOptimizationToNode(node, nodes_storage);
+			if(ApplyAlternativesTrieOptimizationToNode(node))
+				++nodes_rewritten;
 		},
 		graph_start);
+
+	return nodes_rewritten;
 }
 
-} // namespace
+//
+// Alternatives possessification.
+//
 
-RegexGraphBuildResult OptimizeRegexGraph(RegexGraphBuildResult input_graph)
+// Returns pointer to "next" field of simple node (symbol check or group boundary).
+GraphElements::NodePtr* GetSimpleNodeNextPtr(const GraphElements::NodePtr node)
 {
-	RegexGraphBuildResult result= std::move(input_graph);
+	if(const auto specific_symbol= std::get_if<GraphElements::SpecificSymbol>(node))
+		return &specific_symbol->next;
+	if(const auto string= std::get_if<GraphElements::String>(node))
+		return &string->next;
+	if(const auto one_of= std::get_if<GraphElements::OneOf>(node))
+		return &one_of->next;
+	if(const auto group_start= std::get_if<GraphElements::GroupStart>(node))
+		return &group_start->next;
+	if(const auto group_end= std::get_if<GraphElements::GroupEnd>(node))
+		return &group_end->next;
+	return nullptr;
+}
 
-	// Perform symbols combining and alternatives start unite.
-	// Do this multiple times in order to re-combine strings, combined during alternatives start unite.
-	for(size_t i= 0; i < 3; ++i)
-	{
-		ApplySymbolsCombiningOptimization(result.root);
+bool IsGroupBoundary(const GraphElements::NodePtr node)
+{
+	return std::get_if<GraphElements::GroupStart>(node) != nullptr || std::get_if<GraphElements::GroupEnd>(node) != nullptr;
+}
+
+GraphElements::NodePtr SkipGroupBoundaries(GraphElements::NodePtr node)
+{
+	while(IsGroupBoundary(node))
+		node= *GetSimpleNodeNextPtr(node);
+	return node;
+}
+
+// Creates copy of chain of simple nodes from "begin" until "end" (exclusive). "next" of last node is null.
+// Chain should consist only of simple nodes.
+GraphElements::NodePtr CopySimpleNodesChain(const GraphElements::NodePtr begin, const GraphElements::NodePtr end, GraphElements::NodesStorage& nodes_storage)
+{
+	if(begin == end)
+		return nullptr;
+
+	const GraphElements::NodePtr copy= nodes_storage.Allocate(*begin);
+	GraphElements::NodePtr* const next_ptr= GetSimpleNodeNextPtr(copy);
+	assert(next_ptr != nullptr);
+	*next_ptr= CopySimpleNodesChain(*next_ptr, end, nodes_storage);
+	return copy;
+}
+
+// Returns true if node was rewritten.
+bool ApplyAlternativesPossessificationOptimizationToNode(
+	const GraphElements::NodePtr node,
+	GraphElements::NodesStorage& nodes_storage,
+	EmptyPathKinds& empty_path_kinds)
+{
+	/*
+		Perform following optimization:
+		If alternative starts with single symbol/string/one_of (possibly inside groups)
+		and following alternatives can't start with same symbols,
+		it is possible to disable backtracking after matching of first element of this alternative,
+		since if it matches, following alternatives are guaranteed not to match.
+		But following alternatives should not match without consuming symbols, since such match doesn't depend on symbols.
+		The only exception is case where following alternatives always match and this alternative path
+		after first element returns to this node (sequence loop) or reaches the end - such path also always matches.
+
+		Alternatives are processed from last to first, each alternative is checked against all following alternatives.
+		Possessive alternative is created for each suitable alternative, other alternatives are combined into new alternatives nodes.
+	*/
+
+	const auto alternatives= std::get_if<GraphElements::Alternatives>(node);
+	if(alternatives == nullptr || alternatives->next.size() < 2)
+		return false;
+
+	// Copy alternatives list, since this node will be replaced.
+	const std::vector<GraphElements::NodePtr> alternatives_next= alternatives->next;
+
+	std::vector<GraphElements::NodePtr> tail_alternatives{ alternatives_next.back() };
+	OneOf tail_start_symbols= GetPossibleStartSybmolsEntry(alternatives_next.back());
+	EmptyPathKind tail_empty_path_kind= GetEmptyPathKind(empty_path_kinds, alternatives_next.back());
+	std::optional<GraphElements::Node> result_node;
+
+	for(size_t i= alternatives_next.size() - 1; i > 0; --i)
+	{
+		GraphElements::NodePtr new_tail_node= nullptr;
+
+		const GraphElements::NodePtr alternative= alternatives_next[i - 1];
+		const OneOf start_symbols= GetPossibleStartSybmolsEntry(alternative);
+
+		// Find first element of the alternative.
+		const GraphElements::NodePtr first_element= SkipGroupBoundaries(alternative);
+		const bool first_element_is_simple=
+			std::get_if<GraphElements::SpecificSymbol>(first_element) != nullptr ||
+			std::get_if<GraphElements::String>(first_element) != nullptr ||
+			std::get_if<GraphElements::OneOf>(first_element) != nullptr;
+
+		bool can_make_possessive= false;
+		if(first_element_is_simple && !HasIntersection(start_symbols, tail_start_symbols))
+		{
+			if(tail_empty_path_kind == EmptyPathKind::None)
+				can_make_possessive= true;
+			else if(tail_empty_path_kind == EmptyPathKind::Unconditional)
+			{
+				const GraphElements::NodePtr element_next= SkipGroupBoundaries(*GetSimpleNodeNextPtr(first_element));
+				can_make_possessive= element_next == node || element_next == nullptr;
+			}
+		}
+
+		if(can_make_possessive)
+		{
+			// Create copy of alternative start in order to avoid modifying existing nodes.
+			GraphElements::AlternativesPossessive alternatives_possessive;
+			alternatives_possessive.path0_next= *GetSimpleNodeNextPtr(first_element);
+			alternatives_possessive.path0_element= CopySimpleNodesChain(alternative, alternatives_possessive.path0_next, nodes_storage);
+			if(tail_alternatives.size() == 1)
+				alternatives_possessive.path1_next= tail_alternatives.front();
+			else
+			{
+				alternatives_possessive.path1_next= nodes_storage.Allocate(GraphElements::Alternatives{ std::move(tail_alternatives) });
+				empty_path_kinds.emplace(alternatives_possessive.path1_next, tail_empty_path_kind);
+			}
+
+			result_node= std::move(alternatives_possessive);
+			tail_alternatives.clear();
+			if(i > 1)
+			{
+				new_tail_node= nodes_storage.Allocate(std::move(*result_node));
+				tail_alternatives.push_back(new_tail_node);
+			}
+		}
+		else
+		{
+			tail_alternatives.insert(tail_alternatives.begin(), alternative);
+			if(result_node != std::nullopt)
+				result_node= GraphElements::Alternatives{ tail_alternatives };
+		}
+
+		tail_start_symbols= CombineSymbolSets(start_symbols, tail_start_symbols);
+		tail_empty_path_kind= std::max(tail_empty_path_kind, GetEmptyPathKind(empty_path_kinds, alternative));
+
+		// New nodes may be processed later, so, save kinds for them.
+		if(new_tail_node != nullptr)
+			empty_path_kinds.emplace(new_tail_node, tail_empty_path_kind);
+	}
+
+	if(result_node == std::nullopt)
+		return false;
+
+	// Perform the optimization, replace node with new one.
+	*node= std::move(*result_node);
+	return true;
+}
+
+size_t ApplyAlternativesPossessificationOptimization(const GraphElements::NodePtr graph_start, GraphElements::NodesStorage& nodes_storage)
+{
+	// Graph modifications don't change matching results, so, calculate kinds only once.
+	EmptyPathKinds empty_path_kinds= CalculateEmptyPathKinds(graph_start);
+
+	size_t nodes_rewritten= 0;
+	EnumerateAllNodesOnce(
+		[&](const GraphElements::NodePtr node)
+		{
+			if(ApplyAlternativesPossessificationOptimizationToNode(node, nodes_storage, empty_path_kinds))
+				++nodes_rewritten;
+		},
+		graph_start);
+
+	return nodes_rewritten;
+}
+
+//
+// Sequence counter possessification.
+//
+
+// Returns true if node was rewritten.
+bool ApplySequenceCounterPossessificationOptimizationToNode(
+	const GraphElements::NodePtr node,
+	GraphElements::NodesStorage& nodes_storage,
+	const EmptyPathKinds& empty_path_kinds)
+{
+	/*
+		Perform following optimization:
+		If greedy sequence with counter has element, consisting of simple symbol checks (possibly inside groups),
+		and element after the sequence can't start with same symbols as sequence element,
+		replace this sequence with possessive sequence.
+		If sequence element matches, sequence end is guaranteed not to match and thus backtracking is not needed.
+		Sequence end should not match without consuming symbols, except the case where it always matches.
+	*/
+
+	const auto sequence_counter_reset= std::get_if<GraphElements::SequenceCounterReset>(node);
+	if(sequence_counter_reset == nullptr)
+		return false;
+
+	const GraphElements::NodePtr sequence_counter_node= sequence_counter_reset->next;
+	const auto sequence_counter= std::get_if<GraphElements::SequenceCounter>(sequence_counter_node);
+	if(sequence_counter == nullptr || !sequence_counter->greedy)
+		return false;
+
+	// Sequence element should be chain of simple nodes with at least one symbol check.
+	bool has_symbol_check= false;
+	for(GraphElements::NodePtr element_node= sequence_counter->next_iteration; element_node != sequence_counter_node;)
+	{
+		const GraphElements::NodePtr* const next_ptr= GetSimpleNodeNextPtr(element_node);
+		if(next_ptr == nullptr)
+			return false; // Too complicated sequence element.
+
+		has_symbol_check|= !IsGroupBoundary(element_node);
+		element_node= *next_ptr;
+	}
+	if(!has_symbol_check)
+		return false;
+
+	const EmptyPathKind sequence_end_empty_path_kind= GetEmptyPathKind(empty_path_kinds, sequence_counter->next_sequence_end);
+	if(sequence_end_empty_path_kind == EmptyPathKind::Conditional)
+		return false;
+
+	if(HasIntersection(
+			GetPossibleStartSybmolsEntry(sequence_counter->next_iteration),
+			GetPossibleStartSybmolsEntry(sequence_counter->next_sequence_end)))
+		return false;
+
+	GraphElements::PossessiveSequence possessive_sequence;
+	possessive_sequence.next= sequence_counter->next_sequence_end;
+	possessive_sequence.sequence_element= CopySimpleNodesChain(sequence_counter->next_iteration, sequence_counter_node, nodes_storage);
+	possessive_sequence.min_elements= sequence_counter->min_elements;
+	possessive_sequence.max_elements= sequence_counter->max_elements;
+
+	// Replace sequence counter reset node with possessive sequence node.
+	*node= GraphElements::Node(std::move(possessive_sequence));
+	return true;
+}
+
+size_t ApplySequenceCounterPossessificationOptimization(const GraphElements::NodePtr graph_start, GraphElements::NodesStorage& nodes_storage)
+{
+	const EmptyPathKinds empty_path_kinds= CalculateEmptyPathKinds(graph_start);
+
+	size_t nodes_rewritten= 0;
+	EnumerateAllNodesOnce(
+		[&](const GraphElements::NodePtr node)
+		{
+			if(ApplySequenceCounterPossessificationOptimizationToNode(node, nodes_storage, empty_path_kinds))
+				++nodes_rewritten;
+		},
+		graph_start);
+
+	return nodes_rewritten;
+}
+
+//
+// Sequence loops stuff.
+//
+
+// Returns length (in code units) of simple node or none, if node isn't simple or has no fixed length.
+std::optional<size_t> GetSimpleNodeLength(const GraphElements::NodePtr node, const Encoding encoding)
+{
+	if(const auto specific_symbol= std::get_if<GraphElements::SpecificSymbol>(node))
+		return GetCodePointSize(specific_symbol->code, encoding);
+	if(const auto string= std::get_if<GraphElements::String>(node))
+		return GetUtf8StringSize(string->str, encoding);
+	if(const auto one_of= std::get_if<GraphElements::OneOf>(node))
+		return GetOneOfLength(*one_of, encoding);
+	if(IsGroupBoundary(node))
+		return 0;
+	return std::nullopt;
+}
+
+// Returns length of chain of simple nodes from "begin" until "end" (exclusive) or none, if chain doesn't reach "end" or has no fixed length.
+std::optional<size_t> GetSimpleNodesChainLength(const GraphElements::NodePtr begin, const GraphElements::NodePtr end, const Encoding encoding)
+{
+	size_t length= 0;
+	for(GraphElements::NodePtr chain_node= begin; chain_node != end;)
+	{
+		if(chain_node == nullptr)
+			return std::nullopt;
+
+		const auto node_length= GetSimpleNodeLength(chain_node, encoding);
+		if(node_length == std::nullopt)
+			return std::nullopt;
+		length+= *node_length;
+
+		chain_node= *GetSimpleNodeNextPtr(chain_node);
+	}
+
+	return length;
+}
+
+// Returns length of longest chain of simple fixed length nodes, starting from given node.
+size_t GetFixedLengthSimpleNodesPrefixLength(const GraphElements::NodePtr begin, const Encoding encoding)
+{
+	size_t length= 0;
+	for(GraphElements::NodePtr chain_node= begin; chain_node != nullptr;)
+	{
+		const auto node_length= GetSimpleNodeLength(chain_node, encoding);
+		if(node_length == std::nullopt)
+			break;
+		length+= *node_length;
+
+		chain_node= *GetSimpleNodeNextPtr(chain_node);
+	}
+
+	return length;
+}
+
+// Greedy sequence loop - implemented via alternatives node or via sequence counter.
+struct SequenceLoop
+{
+	GraphElements::NodePtr element_begin= nullptr;
+	// Node, where sequence element chain ends.
+	GraphElements::NodePtr loop_node= nullptr;
+	GraphElements::NodePtr end= nullptr;
+	size_t min_elements= 0;
+	size_t max_elements= 0;
+};
+
+std::optional<SequenceLoop> GetGreedySequenceLoop(const GraphElements::NodePtr node)
+{
+	if(const auto alternatives= std::get_if<GraphElements::Alternatives>(node))
+	{
+		// Assume sequence is implemetded via alternatives node with loop trough first alternative path.
+		// There is no reason to optimize sequences, implemented via second alternative path, because such sequences will be optimized
+		// by the compiler backend, because they are tail calls.
+		if(alternatives->next.size() != 2)
+			return std::nullopt;
+
+		SequenceLoop sequence_loop;
+		sequence_loop.element_begin= alternatives->next[0];
+		sequence_loop.loop_node= node;
+		sequence_loop.end= alternatives->next[1];
+		sequence_loop.min_elements= 0;
+		sequence_loop.max_elements= std::numeric_limits<size_t>::max();
+		return sequence_loop;
+	}
+	if(const auto sequence_counter_reset= std::get_if<GraphElements::SequenceCounterReset>(node))
+	{
+		const auto sequence_counter= std::get_if<GraphElements::SequenceCounter>(sequence_counter_reset->next);
+		if(sequence_counter == nullptr || !sequence_counter->greedy)
+			return std::nullopt;
+
+		SequenceLoop sequence_loop;
+		sequence_loop.element_begin= sequence_counter->next_iteration;
+		sequence_loop.loop_node= sequence_counter_reset->next;
+		sequence_loop.end= sequence_counter->next_sequence_end;
+		sequence_loop.min_elements= sequence_counter->min_elements;
+		sequence_loop.max_elements= sequence_counter->max_elements;
+		return sequence_loop;
+	}
+
+	return std::nullopt;
+}
+
+//
+// Fixed length element sequence.
+//
+
+// Returns pointer to "next" field of node, which may be a part of fixed length sequence element.
+// Such element consists only of symbol checks without groups.
+GraphElements::NodePtr* GetFixedLengthElementChainNodeNextPtr(const GraphElements::NodePtr node)
+{
+	if(const auto possessive_sequence= std::get_if<GraphElements::PossessiveSequence>(node))
+		return &possessive_sequence->next;
+	if(IsGroupBoundary(node))
+		return nullptr;
+	return GetSimpleNodeNextPtr(node);
+}
+
+std::optional<size_t> GetFixedLengthElementChainLength(GraphElements::NodePtr begin, GraphElements::NodePtr end, Encoding encoding);
+
+std::optional<size_t> GetFixedLengthElementChainNodeLength(const GraphElements::NodePtr node, const Encoding encoding)
+{
+	if(const auto possessive_sequence= std::get_if<GraphElements::PossessiveSequence>(node))
+	{
+		// Possessive sequence with exact number of fixed length elements has fixed length too.
+		if(possessive_sequence->min_elements != possessive_sequence->max_elements)
+			return std::nullopt;
+
+		const auto element_length= GetFixedLengthElementChainLength(possessive_sequence->sequence_element, nullptr, encoding);
+		if(element_length == std::nullopt)
+			return std::nullopt;
+		return *element_length * possessive_sequence->min_elements;
+	}
+	if(IsGroupBoundary(node))
+		return std::nullopt;
+	return GetSimpleNodeLength(node, encoding);
+}
+
+// Returns length of fixed length element chain from "begin" until "end" (exclusive) or none, if it isn't such chain.
+std::optional<size_t> GetFixedLengthElementChainLength(const GraphElements::NodePtr begin, const GraphElements::NodePtr end, const Encoding encoding)
+{
+	size_t length= 0;
+	for(GraphElements::NodePtr chain_node= begin; chain_node != end;)
+	{
+		if(chain_node == nullptr)
+			return std::nullopt;
+
+		const auto node_length= GetFixedLengthElementChainNodeLength(chain_node, encoding);
+		if(node_length == std::nullopt)
+			return std::nullopt;
+		length+= *node_length;
+
+		chain_node= *GetFixedLengthElementChainNodeNextPtr(chain_node);
+	}
+
+	return length;
+}
+
+GraphElements::NodePtr CopyFixedLengthElementChain(const GraphElements::NodePtr begin, const GraphElements::NodePtr end, GraphElements::NodesStorage& nodes_storage)
+{
+	if(begin == end)
+		return nullptr;
+
+	const GraphElements::NodePtr copy= nodes_storage.Allocate(*begin);
+	GraphElements::NodePtr* const next_ptr= GetFixedLengthElementChainNodeNextPtr(copy);
+	assert(next_ptr != nullptr);
+	*next_ptr= CopyFixedLengthElementChain(*next_ptr, end, nodes_storage);
+	return copy;
+}
+
+// Returns true if node was rewritten.
+bool ApplyFixedLengthElementSequenceOptimizationForNode(const GraphElements::NodePtr node, GraphElements::NodesStorage& nodes_storage, const Encoding encoding)
+{
+	/*
+		Use following optimization:
+		if sequence element has fixed length, scan all sequence elements first and than perform back steps until the rest of the expression matches.
+		Position of each element is calculated from its index, so, no state (like sequence counter) is required for each iteration.
+	*/
+
+	const auto sequence_loop= GetGreedySequenceLoop(node);
+	if(sequence_loop == std::nullopt)
+		return false;
+
+	// Sequence element should be chain of symbol checks with fixed non-zero length.
+	const auto element_length= GetFixedLengthElementChainLength(sequence_loop->element_begin, sequence_loop->loop_node, encoding);
+	if(element_length == std::nullopt || *element_length == 0)
+		return false;
+
+	GraphElements::FixedLengthElementSequence fixed_length_element_sequence;
+	fixed_length_element_sequence.next= sequence_loop->end;
+	fixed_length_element_sequence.sequence_element= CopyFixedLengthElementChain(sequence_loop->element_begin, sequence_loop->loop_node, nodes_storage);
+	fixed_length_element_sequence.min_elements= sequence_loop->min_elements;
+	fixed_length_element_sequence.max_elements= sequence_loop->max_elements;
+	fixed_length_element_sequence.element_length= *element_length;
+
+	// Replace sequence start node with fixed length element sequence node.
+	*node= GraphElements::Node(std::move(fixed_length_element_sequence));
+	return true;
+}
+
+size_t ApplyFixedLengthElementSequenceOptimization(const GraphElements::NodePtr graph_start, GraphElements::NodesStorage& nodes_storage, const Encoding encoding)
+{
+	size_t nodes_rewritten= 0;
+	EnumerateAllNodesOnce(
+		[&](const GraphElements::NodePtr node)
+		{
+			if(ApplyFixedLengthElementSequenceOptimizationForNode(node, nodes_storage, encoding))
+				++nodes_rewritten;
+		},
+		graph_start);
+
+	return nodes_rewritten;
+}
+
+//
+// Sequence with single rollback point optimization.
+//
+
+// Returns true if node was rewritten.
+bool ApplySequenceWithSingleRollbackPointOptimizationToNode(const GraphElements::NodePtr node, GraphElements::NodesStorage& nodes_storage, const Encoding encoding)
+{
+	/*
+		Use following optimization:
+		if sequence element has fixed length and element after sequence starts with chain of fixed small length,
+		create sequence with single rollback point.
+		On each iteration of the sequence perform evaluation of both sequence element and whole rest of the expression after sequence.
+		If evaluation of the rest was successfull - save state for this evaluation.
+		Perform sequence element match until first fail. Than return last saved state for the rest of the expression (if it is non-empty).
+		It is necessary to have simple chain at the start of the rest (like single char or a small fixed string), because its matching is performing on each sequence iteration step.
+	*/
+
+	const auto sequence_loop= GetGreedySequenceLoop(node);
+	if(sequence_loop == std::nullopt)
+		return false;
+
+	// Sequence element should be chain of simple nodes (possibly inside groups) with fixed non-zero length.
+	const auto sequence_element_length= GetSimpleNodesChainLength(sequence_loop->element_begin, sequence_loop->loop_node, encoding);
+	if(sequence_element_length == std::nullopt || *sequence_element_length == 0)
+		return false;
+
+	// Rest of the expression should start with chain of simple fixed length nodes.
+	// Only this chain is matched cheaply on each iteration, further nodes are matched only if it was successful.
+	const size_t element_after_sequence_length= GetFixedLengthSimpleNodesPrefixLength(sequence_loop->end, encoding);
+	if(element_after_sequence_length == 0)
+		return false;
+
+	// Check if this optimization has sence.
+	const bool element_after_sequence_length_is_moderate=
+		element_after_sequence_length <= 2 ||
+		element_after_sequence_length * 2 <= *sequence_element_length;
+	if(!element_after_sequence_length_is_moderate)
+		return false;
+
+	// Rest of the expression is evaluated on each iteration.
+	// Avoid cases where it may reach this sequence again (inside outer loop or via subroutine call) - this may lead to exponential complexity.
+	bool rest_is_too_complex= false;
+	EnumerateAllNodesOnce(
+		[&](const GraphElements::NodePtr rest_node)
+		{
+			rest_is_too_complex|=
+				rest_node == node ||
+				rest_node == sequence_loop->loop_node ||
+				std::get_if<GraphElements::SubroutineEnter>(rest_node) != nullptr ||
+				std::get_if<GraphElements::SubroutineLeave>(rest_node) != nullptr;
+		},
+		sequence_loop->end);
+	if(rest_is_too_complex)
+		return false;
+
+	// Replace sequence start node with optimized one.
+	GraphElements::SingleRollbackPointSequence sequenece;
+	sequenece.sequence_element= CopySimpleNodesChain(sequence_loop->element_begin, sequence_loop->loop_node, nodes_storage);
+	sequenece.next= sequence_loop->end;
+	sequenece.min_elements= sequence_loop->min_elements;
+	sequenece.max_elements= sequence_loop->max_elements;
+
+	*node= GraphElements::Node(std::move(sequenece));
+	return true;
+}
+
+size_t ApplySequenceWithSingleRollbackPointOptimization(const GraphElements::NodePtr graph_start, GraphElements::NodesStorage& nodes_storage, const Encoding encoding)
+{
+	size_t nodes_rewritten= 0;
+	EnumerateAllNodesOnce(
+		[&](const GraphElements::NodePtr node)
+		{
+			if(ApplySequenceWithSingleRollbackPointOptimizationToNode(node, nodes_storage, encoding))
+				++nodes_rewritten;
+		},
+		graph_start);
+
+	return nodes_rewritten;
+}
+
+//
+// Alternatives first code units calculation.
+//
+
+// Adds ranges of code units, which may be first code units of code points in given range.
+void AddFirstCodeUnits(const CharType begin, const CharType end, const Options& options, SymbolRanges& out_ranges)
+{
+	switch(options.encoding)
+	{
+	case Encoding::UTF8:
+		{
+			// Invalid bytes are decoded as code points with same values.
+			if(begin < 0x100)
+				out_ranges.emplace_back(begin, std::min(end, CharType(0xFF)));
+
+			// Lead bytes of multi-byte sequences. Overlong sequences are decoded too, if input isn't validated at entry.
+			struct SequenceKind
+			{
+				CharType min_code_point;
+				CharType max_code_point;
+				CharType lead_byte_bits;
+				uint32_t shift;
+			};
+			static const SequenceKind c_sequence_kinds[]
+			{
+				{ 0x80, 0x7FF, 0xC0, 6 },
+				{ 0x800, 0xFFFF, 0xE0, 12 },
+				{ 0x10000, 0x1FFFFF, 0xF0, 18 },
+			};
+
+			const bool overlong_possible= options.utf8_validation == Utf8Validation::PerSymbol;
+			for(const SequenceKind& sequence_kind : c_sequence_kinds)
+			{
+				const CharType sequence_begin= overlong_possible ? begin : std::max(begin, sequence_kind.min_code_point);
+				const CharType sequence_end= std::min(end, sequence_kind.max_code_point);
+				if(sequence_begin <= sequence_end)
+					out_ranges.emplace_back(
+						sequence_kind.lead_byte_bits | (sequence_begin >> sequence_kind.shift),
+						sequence_kind.lead_byte_bits | (sequence_end >> sequence_kind.shift));
+			}
+		}
+		return;
+
+	case Encoding::UTF16:
+		if(begin < 0x10000)
+			out_ranges.emplace_back(begin, std::min(end, CharType(0xFFFF)));
+		if(end >= 0x10000)
+			out_ranges.emplace_back(0xD800 + ((std::max(begin, CharType(0x10000)) - 0x10000) >> 10), 0xD800 + ((end - 0x10000) >> 10));
+		return;
+
+	case Encoding::UTF32:
+	case Encoding::Bytes:
+		out_ranges.emplace_back(begin, end);
+		return;
+	}
+
+	assert(false);
+}
+
+std::optional<GraphElements::CodeUnitRanges> GetAlternativeFirstCodeUnits(
+	const GraphElements::NodePtr node,
+	const EmptyPathKinds& empty_path_kinds,
+	const Options& options)
+{
+	if(GetEmptyPathKind(empty_path_kinds, node) != EmptyPathKind::None)
+		return std::nullopt; // May match without consuming symbols.
+
+	if(options.encoding == Encoding::UTF8)
+	{
+		// String may start in the middle of code point (result of alternatives start unite), so, use its first byte directly.
+		if(const auto string= std::get_if<GraphElements::String>(SkipGroupBoundaries(node)))
+		{
+			if(!string->case_insensitive && !string->str.empty())
+			{
+				const auto first_byte= CharType(uint8_t(string->str.front()));
+				return GraphElements::CodeUnitRanges{ {first_byte, first_byte} };
+			}
+		}
+	}
+
+	const OneOf start_symbols= GetPossibleStartSybmolsEntry(node);
+	if(start_symbols.inverse_flag)
+		return std::nullopt;
+
+	SymbolRanges code_units;
+	for(const CharType c : start_symbols.variants)
+		AddFirstCodeUnits(c, c, options, code_units);
+	for(const auto& range : start_symbols.ranges)
+		AddFirstCodeUnits(range.first, range.second, options, code_units);
+
+	return GetMergedSymbolRanges({}, code_units);
+}
+
+// Returns true if node was rewritten.
+bool ApplyAlternativesFirstCodeUnitsCalculationToNode(
+	const GraphElements::NodePtr node,
+	const EmptyPathKinds& empty_path_kinds,
+	const Options& options)
+{
+	/*
+		Calculate possible first code units of each alternative.
+		Generated code may check only alternatives, which can start with current code unit,
+		and skip state saving if only one alternative is possible.
+	*/
+
+	const auto alternatives= std::get_if<GraphElements::Alternatives>(node);
+	if(alternatives == nullptr || alternatives->next.size() < 2)
+		return false;
+
+	std::vector< std::optional<GraphElements::CodeUnitRanges> > first_code_units;
+	first_code_units.reserve(alternatives->next.size());
+	bool has_restricted_alternatives= false;
+	for(const GraphElements::NodePtr next : alternatives->next)
+	{
+		first_code_units.push_back(GetAlternativeFirstCodeUnits(next, empty_path_kinds, options));
+		has_restricted_alternatives|= first_code_units.back() != std::nullopt;
+	}
+
+	if(!has_restricted_alternatives)
+		return false;
+
+	alternatives->next_first_code_units= std::move(first_code_units);
+	return true;
+}
+
+size_t ApplyAlternativesFirstCodeUnitsCalculation(const GraphElements::NodePtr graph_start, const Options& options)
+{
+	const EmptyPathKinds empty_path_kinds= CalculateEmptyPathKinds(graph_start);
+
+	size_t nodes_rewritten= 0;
+	EnumerateAllNodesOnce(
+		[&](const GraphElements::NodePtr node)
+		{
+			if(ApplyAlternativesFirstCodeUnitsCalculationToNode(node, empty_path_kinds, options))
+				++nodes_rewritten;
+		},
+		graph_start);
+
+	return nodes_rewritten;
+}
+
+//
+// Graph compaction.
+//
+
+template<typename A, typename B> void AppendToNodeKey(std::string& key, const std::pair<A, B>& pair);
+template<typename T> void AppendToNodeKey(std::string& key, const std::optional<T>& value);
+template<typename T> void AppendToNodeKey(std::string& key, const std::vector<T>& values);
+
+template<typename T>
+void AppendToNodeKey(std::string& key, const T& value)
+{
+	static_assert(std::is_scalar_v<T>, "expected scalar");
+	key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void AppendToNodeKey(std::string& key, const std::string& str)
+{
+	AppendToNodeKey(key, str.size());
+	key+= str;
+}
+
+template<typename A, typename B>
+void AppendToNodeKey(std::string& key, const std::pair<A, B>& pair)
+{
+	AppendToNodeKey(key, pair.first);
+	AppendToNodeKey(key, pair.second);
+}
+
+template<typename T>
+void AppendToNodeKey(std::string& key, const std::optional<T>& value)
+{
+	AppendToNodeKey(key, value.has_value());
+	if(value != std::nullopt)
+		AppendToNodeKey(key, *value);
+}
+
+template<typename T>
+void AppendToNodeKey(std::string& key, const std::vector<T>& values)
+{
+	AppendToNodeKey(key, values.size());
+	for(const T& value : values)
+		AppendToNodeKey(key, value);
+}
+
+// Only nodes without state-related identity (like sequence counters or subroutines) may be shared.
+template<typename T>
+bool AppendNodeKeyImpl(std::string& key, const T& node)
+{
+	(void)key;
+	(void)node;
+	return false;
+}
+
+bool AppendNodeKeyImpl(std::string& key, const GraphElements::AnySymbol& any_symbol)
+{
+	AppendToNodeKey(key, any_symbol.next);
+	return true;
+}
+
+bool AppendNodeKeyImpl(std::string& key, const GraphElements::SpecificSymbol& specific_symbol)
+{
+	AppendToNodeKey(key, specific_symbol.next);
+	AppendToNodeKey(key, specific_symbol.code);
+	return true;
+}
+
+bool AppendNodeKeyImpl(std::string& key, const GraphElements::String& string)
+{
+	AppendToNodeKey(key, string.next);
+	AppendToNodeKey(key, string.str);
+	AppendToNodeKey(key, string.case_insensitive);
+	return true;
+}
+
+bool AppendNodeKeyImpl(std::string& key, const GraphElements::OneOf& one_of)
+{
+	AppendToNodeKey(key, one_of.next);
+	AppendToNodeKey(key, one_of.variants);
+	AppendToNodeKey(key, one_of.ranges);
+	AppendToNodeKey(key, one_of.inverse_flag);
+	return true;
+}
+
+bool AppendNodeKeyImpl(std::string& key, const GraphElements::Alternatives& alternatives)
+{
+	AppendToNodeKey(key, alternatives.next);
+	AppendToNodeKey(key, alternatives.next_first_code_units);
+	return true;
+}
+
+bool AppendNodeKeyImpl(std::string& key, const GraphElements::AlternativesPossessive& alternatives_possessive)
+{
+	AppendToNodeKey(key, alternatives_possessive.path0_element);
+	AppendToNodeKey(key, alternatives_possessive.path0_next);
+	AppendToNodeKey(key, alternatives_possessive.path1_next);
+	return true;
+}
+
+bool AppendNodeKeyImpl(std::string& key, const GraphElements::AlternativesTrie& alternatives_trie)
+{
+	AppendToNodeKey(key, alternatives_trie.alternatives.size());
+	for(const GraphElements::AlternativesTrie::Alternative& alternative : alternatives_trie.alternatives)
+	{
+		AppendToNodeKey(key, alternative.str);
+		AppendToNodeKey(key, alternative.next);
+	}
+	return true;
+}
+
+bool AppendNodeKeyImpl(std::string& key, const GraphElements::GroupStart& group_start)
+{
+	AppendToNodeKey(key, group_start.next);
+	AppendToNodeKey(key, group_start.index);
+	return true;
+}
+
+bool AppendNodeKeyImpl(std::string& key, const GraphElements::GroupEnd& group_end)
+{
+	AppendToNodeKey(key, group_end.next);
+	AppendToNodeKey(key, group_end.index);
+	return true;
+}
+
+bool AppendNodeKeyImpl(std::string& key, const GraphElements::BackReference& back_reference)
+{
+	AppendToNodeKey(key, back_reference.next);
+	AppendToNodeKey(key, back_reference.index);
+	return true;
+}
+
+bool AppendNodeKeyImpl(std::string& key, const GraphElements::StringStartAssertion& string_start_assertion)
+{
+	AppendToNodeKey(key, string_start_assertion.next);
+	return true;
+}
+
+bool AppendNodeKeyImpl(std::string& key, const GraphElements::StringEndAssertion& string_end_assertion)
+{
+	AppendToNodeKey(key, string_end_assertion.next);
+	return true;
+}
+
+// Returns key, identifying node contents (including pointers to other nodes), or none if node can't be shared.
+std::optional<std::string> GetNodeKey(const GraphElements::Node& node)
+{
+	std::string key;
+	AppendToNodeKey(key, node.index());
+	if(!std::visit([&](const auto& el){ return AppendNodeKeyImpl(key, el); }, node))
+		return std::nullopt;
+	return key;
+}
+
+// Copies all reachable nodes into new storage.
+// Structurally identical nodes (with same contents and same next nodes) are copied only once and shared.
+// Because copying is performed from graph end, identical subgraphs are shared too.
+class GraphCompactor
+{
+public:
+	explicit GraphCompactor(GraphElements::NodesStorage& nodes_storage)
+		: nodes_storage_(nodes_storage)
+	{}
+
+	GraphElements::NodePtr Copy(const GraphElements::NodePtr node)
+	{
+		if(node == nullptr)
+			return nullptr;
+
+		if(const auto it= copies_.find(node); it != copies_.end())
+		{
+			if(it->second == nullptr)
+			{
+				// Loop in graph - this node is currently copied. Allocate its copy now and fill it later.
+				// Such node is not shared with other nodes, since its contents are not known yet.
+				it->second= nodes_storage_.Allocate(GraphElements::SubroutineLeave{});
+			}
+			return it->second;
+		}
+		copies_.emplace(node, nullptr);
+
+		GraphElements::Node node_copy= *node;
+		ForEachNodeChildPtr(node_copy, [&](GraphElements::NodePtr& child){ child= Copy(child); });
+
+		GraphElements::NodePtr& result= copies_.at(node);
+		if(result != nullptr)
+			*result= std::move(node_copy);
+		else if(const auto key= GetNodeKey(node_copy))
+		{
+			const auto it= shared_nodes_.find(*key);
+			if(it != shared_nodes_.end())
+				result= it->second;
+			else
+			{
+				result= nodes_storage_.Allocate(std::move(node_copy));
+				shared_nodes_.emplace(std::move(*key), result);
+			}
+		}
+		else
+			result= nodes_storage_.Allocate(std::move(node_copy));
+
+		return result;
+	}
+
+private:
+	GraphElements::NodesStorage& nodes_storage_;
+	// Null for nodes, which are currently copied.
+	std::unordered_map<GraphElements::NodePtr, GraphElements::NodePtr> copies_;
+	std::unordered_map<std::string, GraphElements::NodePtr> shared_nodes_;
+};
+
+// Returns number of removed nodes.
+size_t ApplyGraphCompaction(RegexGraphBuildResult& graph)
+{
+	/*
+		Nodes, replaced during previous optimizations, remain in nodes storage, so, drop them, copying only reachable nodes.
+		Also share structurally identical nodes - this reduces size of the graph and thus size of the generated code.
+	*/
+
+	GraphElements::NodesStorage nodes_storage;
+	graph.root= GraphCompactor(nodes_storage).Copy(graph.root);
+
+	const size_t nodes_removed= graph.nodes_storage.GetSize() - nodes_storage.GetSize();
+	graph.nodes_storage= std::move(nodes_storage);
+	return nodes_removed;
+}
+
+//
+// Passes pipeline.
+//
+
+// Runs given pass function (if pass is enabled) and collects statistics for it. Returns number of rewritten nodes.
+template<typename Func>
+size_t RunOptimizationPass(
+	const OptimizationPass pass,
+	const OptimizationOptions& optimization_options,
+	OptimizationStatistics* const statistics,
+	const Func& func)
+{
+	if(optimization_options.disabled_passes.test(size_t(pass)))
+		return 0;
+
+	const auto start_time= std::chrono::steady_clock::now();
+	const size_t nodes_rewritten= func();
+
+	if(statistics != nullptr)
+	{
+		OptimizationPassStatistics& pass_statistics= (*statistics)[size_t(pass)];
+		++pass_statistics.runs;
+		pass_statistics.nodes_rewritten+= nodes_rewritten;
+		pass_statistics.time_spent+= std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time);
+	}
+
+	return nodes_rewritten;
+}
+
+} // namespace
+
+const char* GetOptimizationPassName(const OptimizationPass pass)
+{
+	switch(pass)
+	{
+	case OptimizationPass::OneOfNormalization: return "one-of-normalization";
+	case OptimizationPass::SymbolsCombining: return "symbols-combining";
+	case OptimizationPass::AlternativesStartUnite: return "alternatives-start-unite";
+	case OptimizationPass::AlternativesSuffixFactoring: return "alternatives-suffix-factoring";
+	case OptimizationPass::AlternativesTrie: return "alternatives-trie";
+	case OptimizationPass::AlternativesPossessification: return "alternatives-possessification";
+	case OptimizationPass::SequenceCounterPossessification: return "sequence-counter-possessification";
+	case OptimizationPass::SingleRollbackPointSequence: return "single-rollback-point-sequence";
+	case OptimizationPass::FixedLengthElementSequence: return "fixed-length-element-sequence";
+	case OptimizationPass::AlternativesFirstCodeUnits: return "alternatives-first-code-units";
+	case OptimizationPass::GraphCompaction: return "graph-compaction";
+	}
+
+	assert(false);
+	return "";
+}
+
+RegexGraphBuildResult OptimizeRegexGraph(
+	RegexGraphBuildResult input_graph,
+	const OptimizationOptions& optimization_options,
+	OptimizationStatistics* const statistics)
+{
+	RegexGraphBuildResult result= std::move(input_graph);
+
+	const auto run_pass=
+		[&](const OptimizationPass pass, const auto& func)
+		{
+			return RunOptimizationPass(pass, optimization_options, statistics, func);
+		};
+
+	// Perform normalization first, since other optimizations work better with canonical symbol sets.
+	run_pass(
+		OptimizationPass::OneOfNormalization,
+		[&]{ return ApplyOneOfNormalization(result.root, result.options.encoding); });
+
+	// Perform symbols combining and alternatives start unite.
+	// Do this until fixpoint is reached in order to re-combine strings, combined during alternatives start unite.
+	for(size_t i= 0; i < optimization_options.max_fixpoint_iterations; ++i)
+	{
+		size_t nodes_rewritten= 0;
+
+		nodes_rewritten+= run_pass(
+			OptimizationPass::SymbolsCombining,
+			[&]{ return ApplySymbolsCombiningOptimization(result.root); });
 
 		// Perform this step before performing alternatives possessification.
-		ApplyAlternativeStartUnite(result.root, result.nodes_storage);
+		nodes_rewritten+= run_pass(
+			OptimizationPass::AlternativesStartUnite,
+			[&]{ return ApplyAlternativeStartUnite(result.root, result.nodes_storage, result.options.encoding); });
+
+		if(nodes_rewritten == 0)
+			break;
 	}
 
-	ApplyAlternativesPossessificationOptimization(result.root, result.nodes_storage);
+	// Perform suffix factoring only after symbols combining, since combining may append shared suffix to its predecessor.
+	run_pass(
+		OptimizationPass::AlternativesSuffixFactoring,
+		[&]{ return ApplyAlternativesSuffixFactoring(result.root, result.nodes_storage, result.options.encoding); });
+
+	// Create tries before alternatives possessification, since trie is better for alternatives of strings.
+	run_pass(
+		OptimizationPass::AlternativesTrie,
+		[&]{ return ApplyAlternativesTrieOptimization(result.root); });
+
+	run_pass(
+		OptimizationPass::AlternativesPossessification,
+		[&]{ return ApplyAlternativesPossessificationOptimization(result.root, result.nodes_storage); });
+	run_pass(
+		OptimizationPass::SequenceCounterPossessification,
+		[&]{ return ApplySequenceCounterPossessificationOptimization(result.root, result.nodes_storage); });
 
 	// Apply sequence with single rollback point optimization before fixed length sequence optimization, because it is faster.
-	ApplySequenceWithSingleRollbackPointOptimization(result.root, result.nodes_storage);
+	run_pass(
+		OptimizationPass::SingleRollbackPointSequence,
+		[&]{ return ApplySequenceWithSingleRollbackPointOptimization(result.root, result.nodes_storage, result.options.encoding); });
 
 	// Apply fixed length sequence optimization only after alternatives possessification optimization,
 	// because first optimization is better (produces faster code).
-	ApplyFixedLengthElementSequenceOptimization(result.root, result.nodes_storage);
+	run_pass(
+		OptimizationPass::FixedLengthElementSequence,
+		[&]{ return ApplyFixedLengthElementSequenceOptimization(result.root, result.nodes_storage, result.options.encoding); });
+
+	// Calculate first code units only after all other optimizations, since they create new alternatives nodes.
+	run_pass(
+		OptimizationPass::AlternativesFirstCodeUnits,
+		[&]{ return ApplyAlternativesFirstCodeUnitsCalculation(result.root, result.options); });
+
+	// Perform compaction last, in order to drop nodes, replaced by all other optimizations.
+	run_pass(
+		OptimizationPass::GraphCompaction,
+		[&]{ return ApplyGraphCompaction(result); });
 
 	return result;
 }
@@ -0,0 +1,302 @@
+#include "../StateFieldsLiveness.hpp"
+
+namespace RegPanzer
+{
+
+namespace
+{
+
+// State fields access of single node and nodes, which may be evaluated directly after it.
+struct NodeInfo
+{
+	std::vector<GraphElements::NodePtr> successors;
+	StateFieldsSet read_fields;
+	StateFieldsSet written_fields;
+	StateFieldsSet overwritten_fields; // Fields, written by this node before evaluation of successors, regardless of their previous value.
+	bool has_sub_graph= false; // Sub-graph ends with null node, but after it node continues evaluation.
+};
+
+void CollectNodeInfoImpl(const GraphElements::AnySymbol& any_symbol, NodeInfo& info)
+{
+	info.successors.push_back(any_symbol.next);
+}
+
+void CollectNodeInfoImpl(const GraphElements::SpecificSymbol& specific_symbol, NodeInfo& info)
+{
+	info.successors.push_back(specific_symbol.next);
+}
+
+void CollectNodeInfoImpl(const GraphElements::String& string, NodeInfo& info)
+{
+	info.successors.push_back(string.next);
+}
+
+void CollectNodeInfoImpl(const GraphElements::OneOf& one_of, NodeInfo& info)
+{
+	info.successors.push_back(one_of.next);
+}
+
+void CollectNodeInfoImpl(const GraphElements::Alternatives& alternatives, NodeInfo& info)
+{
+	info.successors= alternatives.next;
+}
+
+void CollectNodeInfoImpl(const GraphElements::AlternativesPossessive& alternatives_possessive, NodeInfo& info)
+{
+	info.successors.push_back(alternatives_possessive.path0_element);
+	info.successors.push_back(alternatives_possessive.path0_next);
+	info.successors.push_back(alternatives_possessive.path1_next);
+	info.has_sub_graph= true;
+}
+
+void CollectNodeInfoImpl(const GraphElements::AlternativesTrie& alternatives_trie, NodeInfo& info)
+{
+	for(const auto& alternative : alternatives_trie.alternatives)
+		info.successors.push_back(alternative.next);
+}
+
+void CollectNodeInfoImpl(const GraphElements::GroupStart& group_start, NodeInfo& info)
+{
+	info.successors.push_back(group_start.next);
+	// Both begin and end of group are set here.
+	info.written_fields.groups.insert(group_start.index);
+	info.overwritten_fields.groups.insert(group_start.index);
+}
+
+void CollectNodeInfoImpl(const GraphElements::GroupEnd& group_end, NodeInfo& info)
+{
+	info.successors.push_back(group_end.next);
+	info.written_fields.groups.insert(group_end.index);
+}
+
+void CollectNodeInfoImpl(const GraphElements::BackReference& back_reference, NodeInfo& info)
+{
+	info.successors.push_back(back_reference.next);
+	info.read_fields.groups.insert(back_reference.index);
+}
+
+void CollectNodeInfoImpl(const GraphElements::LookAhead& look_ahead, NodeInfo& info)
+{
+	info.successors.push_back(look_ahead.look_graph);
+	info.successors.push_back(look_ahead.next);
+	info.has_sub_graph= true;
+}
+
+void CollectNodeInfoImpl(const GraphElements::LookBehind& look_behind, NodeInfo& info)
+{
+	info.successors.push_back(look_behind.look_graph);
+	info.successors.push_back(look_behind.next);
+	info.has_sub_graph= true;
+}
+
+void CollectNodeInfoImpl(const GraphElements::StringStartAssertion& string_start_assertion, NodeInfo& info)
+{
+	info.successors.push_back(string_start_assertion.next);
+}
+
+void CollectNodeInfoImpl(const GraphElements::StringEndAssertion& string_end_assertion, NodeInfo& info)
+{
+	info.successors.push_back(string_end_assertion.next);
+}
+
+void CollectNodeInfoImpl(const GraphElements::ConditionalElement& conditional_element, NodeInfo& info)
+{
+	info.successors.push_back(conditional_element.condition_node);
+	info.successors.push_back(conditional_element.next_true);
+	info.successors.push_back(conditional_element.next_false);
+	info.has_sub_graph= true;
+}
+
+void CollectNodeInfoImpl(const GraphElements::SequenceCounterReset& sequence_counter_reset, NodeInfo& info)
+{
+	info.successors.push_back(sequence_counter_reset.next);
+	info.written_fields.sequence_counters.insert(sequence_counter_reset.id);
+	info.overwritten_fields.sequence_counters.insert(sequence_counter_reset.id);
+}
+
+void CollectNodeInfoImpl(const GraphElements::SequenceCounter& sequence_counter, NodeInfo& info)
+{
+	info.successors.push_back(sequence_counter.next_iteration);
+	info.successors.push_back(sequence_counter.next_sequence_end);
+	info.read_fields.sequence_counters.insert(sequence_counter.id);
+	info.written_fields.sequence_counters.insert(sequence_counter.id);
+}
+
+void CollectNodeInfoImpl(const GraphElements::PossessiveSequence& possessive_sequence, NodeInfo& info)
+{
+	info.successors.push_back(possessive_sequence.sequence_element);
+	info.successors.push_back(possessive_sequence.next);
+	info.has_sub_graph= true;
+}
+
+void CollectNodeInfoImpl(const GraphElements::SingleRollbackPointSequence& single_rollback_point_sequence, NodeInfo& info)
+{
+	info.successors.push_back(single_rollback_point_sequence.sequence_element);
+	info.successors.push_back(single_rollback_point_sequence.next);
+	info.has_sub_graph= true;
+}
+
+void CollectNodeInfoImpl(const GraphElements::FixedLengthElementSequence& fixed_length_element_sequence, NodeInfo& info)
+{
+	info.successors.push_back(fixed_length_element_sequence.sequence_element);
+	info.successors.push_back(fixed_length_element_sequence.next);
+	info.has_sub_graph= true;
+}
+
+void CollectNodeInfoImpl(const GraphElements::AtomicGroup& atomic_group, NodeInfo& info)
+{
+	info.successors.push_back(atomic_group.group_element);
+	info.successors.push_back(atomic_group.next);
+	info.has_sub_graph= true;
+}
+
+void CollectNodeInfoImpl(const GraphElements::SubroutineEnter& subroutine_enter, NodeInfo& info)
+{
+	info.successors.push_back(subroutine_enter.subroutine_node);
+	info.successors.push_back(subroutine_enter.next);
+}
+
+void CollectNodeInfoImpl(const GraphElements::SubroutineLeave& subroutine_leave, NodeInfo& info)
+{
+	// Successors are not known statically.
+	(void)subroutine_leave;
+	(void)info;
+}
+
+void CollectNodeInfoImpl(const GraphElements::StateSave& state_save, NodeInfo& info)
+{
+	info.successors.push_back(state_save.next);
+	info.read_fields.sequence_counters= state_save.sequence_counters_to_save;
+	info.read_fields.groups= state_save.groups_to_save;
+}
+
+void CollectNodeInfoImpl(const GraphElements::StateRestore& state_restore, NodeInfo& info)
+{
+	info.successors.push_back(state_restore.next);
+	info.written_fields.sequence_counters= state_restore.sequence_counters_to_restore;
+	info.written_fields.groups= state_restore.groups_to_restore;
+}
+
+NodeInfo CollectNodeInfo(const GraphElements::NodePtr node)
+{
+	NodeInfo info;
+	if(node != nullptr)
+		std::visit([&](const auto& el){ CollectNodeInfoImpl(el, info); }, *node);
+	return info;
+}
+
+// Returns true if something was added.
+bool UniteWithCheck(StateFieldsSet& dst, const StateFieldsSet& src, const StateFieldsSet* const excluded)
+{
+	bool changed= false;
+	for(const GraphElements::SequenceId sequence_id : src.sequence_counters)
+		if(excluded == nullptr || excluded->sequence_counters.count(sequence_id) == 0)
+			changed|= dst.sequence_counters.insert(sequence_id).second;
+	for(const size_t group_index : src.groups)
+		if(excluded == nullptr || excluded->groups.count(group_index) == 0)
+			changed|= dst.groups.insert(group_index).second;
+	return changed;
+}
+
+} // namespace
+
+bool IsEmpty(const StateFieldsSet& fields)
+{
+	return fields.sequence_counters.empty() && fields.groups.empty();
+}
+
+void Unite(StateFieldsSet& dst, const StateFieldsSet& src)
+{
+	UniteWithCheck(dst, src, nullptr);
+}
+
+StateFieldsSet Intersect(const StateFieldsSet& l, const StateFieldsSet& r)
+{
+	StateFieldsSet result;
+	for(const GraphElements::SequenceId sequence_id : l.sequence_counters)
+		if(r.sequence_counters.count(sequence_id) != 0)
+			result.sequence_counters.insert(sequence_id);
+	for(const size_t group_index : l.groups)
+		if(r.groups.count(group_index) != 0)
+			result.groups.insert(group_index);
+	return result;
+}
+
+StateFieldsLiveness AnalyzeStateFieldsLiveness(const RegexGraphBuildResult& regex_graph)
+{
+	std::vector<GraphElements::NodePtr> nodes;
+	nodes.push_back(nullptr);
+	EnumerateAllNodesOnce([&](const GraphElements::NodePtr node){ nodes.push_back(node); }, regex_graph.root);
+
+	StateFieldsLiveness result;
+
+	if(!regex_graph.group_stats.at(0).internal_calls.empty())
+	{
+		// State may be saved and restored in subroutine calls and nodes after subroutine leave are not known statically.
+		// So, assume that all fields are modified and live everywhere.
+		StateFieldsSet all_fields;
+		all_fields.sequence_counters= regex_graph.used_sequence_counters;
+		for(const auto& group_pair : regex_graph.group_stats)
+			all_fields.groups.insert(group_pair.first);
+
+		for(const GraphElements::NodePtr node : nodes)
+		{
+			result.modified_fields.emplace(node, all_fields);
+			result.live_fields.emplace(node, all_fields);
+		}
+		return result;
+	}
+
+	std::vector<NodeInfo> nodes_info;
+	nodes_info.reserve(nodes.size());
+	for(const GraphElements::NodePtr node : nodes)
+	{
+		nodes_info.push_back(CollectNodeInfo(node));
+		result.modified_fields.emplace(node, nodes_info.back().written_fields);
+		result.live_fields.emplace(node, nodes_info.back().read_fields);
+	}
+
+	// Extracted groups (except whole match) are read from state after match.
+	if(regex_graph.options.extract_groups)
+		for(const auto& group_pair : regex_graph.group_stats)
+			if(group_pair.first != 0)
+				result.live_fields[nullptr].groups.insert(group_pair.first);
+
+	// Null node is also end of sub-graphs (look graphs, atomic groups, sequence elements, etc.).
+	// After sub-graph end evaluation is continued with next node of enclosing node, so, fields, live here, depend on context.
+	// Use simple conservative approach - consider all fields, read by any node, to be live at end.
+	for(const NodeInfo& info : nodes_info)
+	{
+		if(info.has_sub_graph)
+		{
+			for(const NodeInfo& other_info : nodes_info)
+				Unite(result.live_fields[nullptr], other_info.read_fields);
+			break;
+		}
+	}
+
+	// Propagate fields backwards until fixed point is reached.
+	// Nodes are enumerated in depth-first order, so, iteration in reverse order converges fast.
+	bool changed= true;
+	while(changed)
+	{
+		changed= false;
+		for(size_t i= nodes.size(); i > 0; --i)
+		{
+			const GraphElements::NodePtr node= nodes[i - 1];
+			const NodeInfo& info= nodes_info[i - 1];
+
+			StateFieldsSet& modified_fields= result.modified_fields.at(node);
+			StateFieldsSet& live_fields= result.live_fields.at(node);
+			for(const GraphElements::NodePtr successor : info.successors)
+			{
+				changed|= UniteWithCheck(modified_fields, result.modified_fields.at(successor), nullptr);
+				changed|= UniteWithCheck(live_fields, result.live_fields.at(successor), &info.overwritten_fields);
+			}
+		}
+	}
+
+	return result;
+}
+
+} // namespace RegPanzer
@@ -0,0 +1,28 @@
+#include "../UnicodeClasses.hpp"
+
+namespace RegPanzer
+{
+
+std::optional< std::vector< std::pair<char32_t, char32_t> > > GetUnicodeClassRanges(const std::string_view name)
+{
+	for(size_t i= 0; i < g_unicode_classes_count; ++i)
+	{
+		const UnicodeClassDescription& description= g_unicode_classes[i];
+		if(name != description.name)
+			continue;
+
+		std::vector< std::pair<char32_t, char32_t> > result;
+		result.reserve(description.ranges_count);
+		for(size_t j= 0; j < description.ranges_count; ++j)
+		{
+			const UnicodeClassRange& range= g_unicode_class_ranges[description.ranges_offset + j];
+			result.emplace_back(range.begin, range.end);
+		}
+
+		return result;
+	}
+
+	return std::nullopt;
+}
+
+} // namespace RegPanzer
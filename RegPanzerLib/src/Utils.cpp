@@ -8,6 +8,8 @@
 #include <llvm/Support/ConvertUTF.h>
 #include <llvm/Target/TargetMachine.h>
 #include "../PopLLVMWarnings.hpp"
+#include <algorithm>
+#include <cassert>
 #include <iostream>
 
 namespace RegPanzer
@@ -225,4 +227,100 @@ std::basic_string<char32_t> Utf8ToUtf32(const std::string_view str)
 	return str_utf32;
 }
 
+bool IsValidUtf8(const std::string_view str)
+{
+	auto src_start= reinterpret_cast<const llvm::UTF8*>(str.data());
+	return llvm::isLegalUTF8String(&src_start, src_start + str.size());
+}
+
+std::u16string Utf8ToUtf16(const std::string_view str)
+{
+	std::u16string str_utf16;
+	for(const char32_t c : Utf8ToUtf32(str))
+	{
+		if(c < 0x10000)
+			str_utf16.push_back(char16_t(c));
+		else
+		{
+			// Encode surrogate pair.
+			const char32_t c_minus= c - 0x10000;
+			str_utf16.push_back(char16_t(0xD800 + (c_minus >> 10)));
+			str_utf16.push_back(char16_t(0xDC00 + (c_minus & 0x3FF)));
+		}
+	}
+
+	return str_utf16;
+}
+
+size_t GetCodePointSize(const char32_t code_point, const Encoding encoding)
+{
+	switch(encoding)
+	{
+	case Encoding::UTF8:
+		if(code_point < 0x80)
+			return 1;
+		if(code_point < 0x800)
+			return 2;
+		if(code_point < 0x10000)
+			return 3;
+		return 4;
+	case Encoding::UTF16:
+		return code_point < 0x10000 ? 1 : 2;
+	case Encoding::UTF32:
+	case Encoding::Bytes:
+		return 1;
+	};
+
+	assert(false);
+	return 1;
+}
+
+size_t GetUtf8StringSize(const std::string_view str, const Encoding encoding)
+{
+	if(encoding == Encoding::UTF8)
+		return str.size();
+
+	size_t size= 0;
+	for(const char32_t c : Utf8ToUtf32(str))
+		size+= GetCodePointSize(c, encoding);
+
+	return size;
+}
+
+CodeUnitsTrie BuildCodeUnitsTrie(const std::vector< std::vector<uint32_t> >& strings)
+{
+	CodeUnitsTrie trie(1);
+	for(size_t i= 0; i < strings.size(); ++i)
+	{
+		size_t node_index= 0;
+		for(const uint32_t code_unit : strings[i])
+		{
+			if(const auto it= trie[node_index].children.find(code_unit); it != trie[node_index].children.end())
+				node_index= it->second;
+			else
+			{
+				const size_t child_index= trie.size();
+				trie[node_index].children.emplace(code_unit, child_index);
+				trie.emplace_back();
+				trie.back().depth= trie[node_index].depth + 1;
+				node_index= child_index;
+			}
+		}
+		trie[node_index].matched_strings.push_back(i);
+	}
+
+	// Propagate matched strings from parents to children. Parents are processed first, since they have smaller indices.
+	for(size_t i= 0; i < trie.size(); ++i)
+	{
+		for(const auto& child_pair : trie[i].children)
+		{
+			std::vector<size_t>& child_matched_strings= trie[child_pair.second].matched_strings;
+			child_matched_strings.insert(child_matched_strings.end(), trie[i].matched_strings.begin(), trie[i].matched_strings.end());
+			std::sort(child_matched_strings.begin(), child_matched_strings.end());
+		}
+	}
+
+	return trie;
+}
+
 } // namespace RegPanzer
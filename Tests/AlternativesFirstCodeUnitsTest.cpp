@@ -0,0 +1,105 @@
+#include "../RegPanzerLib/RegexGraph.hpp"
+#include "../RegPanzerLib/RegexGraphOptimizer.hpp"
+#include "../RegPanzerLib/Parser.hpp"
+#include "../RegPanzerLib/PushDisableLLVMWarnings.hpp"
+#include <gtest/gtest.h>
+#include "../RegPanzerLib/PopLLVMWarnings.hpp"
+
+namespace RegPanzer
+{
+
+namespace
+{
+
+struct TestDataElement
+{
+	std::string regex_str;
+	Encoding encoding= Encoding::UTF32;
+	Utf8Validation utf8_validation= Utf8Validation::PerSymbol;
+	// First code units of alternatives of root node. Empty if no alternative has restricted set of first code units.
+	std::vector< std::optional<GraphElements::CodeUnitRanges> > first_code_units;
+};
+
+const TestDataElement g_test_data[]
+{
+	{ // First code units are calculated for each alternative.
+		"[a-f]+b|(?:q|z)+c|[e-x]+y",
+		Encoding::UTF32,
+		Utf8Validation::PerSymbol,
+		{ { { {'a', 'f'} } }, { { {'q', 'q'}, {'z', 'z'} } }, { { {'e', 'x'} } } },
+	},
+	{ // Optional elements are skipped.
+		"a*b|c+d",
+		Encoding::UTF32,
+		Utf8Validation::PerSymbol,
+		{ { { {'a', 'b'} } }, { { {'c', 'c'} } } },
+	},
+	{ // Alternative, which may match without consuming symbols, may be selected for any code unit.
+		"a+b|a+c|x*",
+		Encoding::UTF32,
+		Utf8Validation::PerSymbol,
+		{ { { {'a', 'a'} } }, { { {'a', 'a'} } }, std::nullopt },
+	},
+	{ // Alternative, which may start with any symbol, may be selected for any code unit.
+		"[a-f]+b|[^a-f]+c",
+		Encoding::UTF32,
+		Utf8Validation::PerSymbol,
+		{ { { {'a', 'f'} } }, std::nullopt },
+	},
+	{ // No restrictions for alternatives - first code units aren't calculated.
+		".+a|.+b",
+		Encoding::UTF32,
+		Utf8Validation::PerSymbol,
+		{},
+	},
+	{ // UTF-16 code units.
+		"ж+b|я+c|ж+d",
+		Encoding::UTF16,
+		Utf8Validation::PerSymbol,
+		{ { { {0x436, 0x436} } }, { { {0x436, 0x436}, {0x44F, 0x44F} } } },
+	},
+	{ // High surrogates are first code units of symbols outside BMP.
+		"😀+a|c+b|😀+d",
+		Encoding::UTF16,
+		Utf8Validation::PerSymbol,
+		{ { { {0xD83D, 0xD83D} } }, { { {'c', 'c'}, {0xD83D, 0xD83D} } } },
+	},
+	{ // UTF-8 lead bytes.
+		"ж+b|я+c|ж+d",
+		Encoding::UTF8,
+		Utf8Validation::OnceAtEntry,
+		{ { { {0xD0, 0xD0} } }, { { {0xD0, 0xD1} } } },
+	},
+	{ // Lead bytes of overlong sequences are possible if UTF-8 isn't validated at entry.
+		"ж+b|я+c|ж+d",
+		Encoding::UTF8,
+		Utf8Validation::PerSymbol,
+		{ { { {0xD0, 0xD0}, {0xE0, 0xE0}, {0xF0, 0xF0} } }, { { {0xD0, 0xD1}, {0xE0, 0xE0}, {0xF0, 0xF0} } } },
+	},
+};
+
+class AlternativesFirstCodeUnitsTest : public ::testing::TestWithParam<TestDataElement> {};
+
+TEST_P(AlternativesFirstCodeUnitsTest, TestCalculation)
+{
+	const auto param= GetParam();
+	Options options;
+	options.encoding= param.encoding;
+	options.utf8_validation= param.utf8_validation;
+
+	const auto parse_res= RegPanzer::ParseRegexString(param.regex_str, options);
+	const auto regex_chain= std::get_if<RegexElementsChain>(&parse_res);
+	ASSERT_TRUE(regex_chain != nullptr);
+
+	const auto regex_graph= OptimizeRegexGraph( BuildRegexGraph(*regex_chain, options) );
+
+	const auto alternatives= std::get_if<GraphElements::Alternatives>(regex_graph.root);
+	ASSERT_TRUE(alternatives != nullptr);
+	ASSERT_EQ(alternatives->next_first_code_units, param.first_code_units);
+}
+
+INSTANTIATE_TEST_SUITE_P(AFCU, AlternativesFirstCodeUnitsTest, testing::ValuesIn(g_test_data));
+
+} // namespace
+
+} // namespace RegPanzer
@@ -64,8 +64,16 @@ const TestDataElement g_test_data[]
 		"q|[0-9a-z]",
 		false,
 	},
-	{ // Optimization fails FOR NOW, since only two branches are supported. TODO - fix this.
+	{ // Optimization for more than two alternatives.
 		"a|b|c",
+		true,
+	},
+	{ // Optimization for more than two alternatives - first alternative is possessive, following alternatives are checked against each other.
+		"[0-9]|[a-z]|q",
+		true,
+	},
+	{ // Optimization for more than two alternatives - fails, since start symbols of first alternative intersect with start symbols of last alternative.
+		"a|[0-9]|[a-f]",
 		false,
 	},
 	{ // Optimization fails FOR NOW, because first alternative isn't simple enought. TODO - fix this.
@@ -108,6 +116,34 @@ const TestDataElement g_test_data[]
 		"[0-9]*+",
 		false,
 	},
+	{ // First element inside group.
+		"(a)|b",
+		true,
+	},
+	{ // Sequence of group is implemented as alternative and this alternative is optimized.
+		"(?:([a-z]))*[0-9]",
+		true,
+	},
+	{ // Sequence with several elements in body is optimized.
+		"(?:a[0-9])*b",
+		true,
+	},
+	{ // Sequence with several elements in body is not optimized, since tail may match without consuming symbols.
+		"(?:a[0-9])*",
+		false,
+	},
+	{ // Optimization fails, since second alternative may match without consuming symbols.
+		"a[0-9]|",
+		false,
+	},
+	{ // Optimization works, since second alternative always matches and path of first alternative reaches the end.
+		"ab|",
+		true,
+	},
+	{ // Optimization fails, since second alternative may match without consuming symbols, but only conditionally.
+		"a|$",
+		false,
+	},
 };
 
 class AlternativesPossessificationOptimizationTest : public ::testing::TestWithParam<TestDataElement> {};
@@ -0,0 +1,117 @@
+#include "../RegPanzerLib/RegexGraph.hpp"
+#include "../RegPanzerLib/RegexGraphOptimizer.hpp"
+#include "../RegPanzerLib/Parser.hpp"
+#include "../RegPanzerLib/Utils.hpp"
+#include "../RegPanzerLib/PushDisableLLVMWarnings.hpp"
+#include <gtest/gtest.h>
+#include "../RegPanzerLib/PopLLVMWarnings.hpp"
+
+namespace RegPanzer
+{
+
+namespace
+{
+
+struct TestDataElement
+{
+	std::string regex_str;
+	std::string suffix;
+	size_t num_nodes_with_suffix; // Number of string nodes in result graph, ending with given suffix.
+};
+
+const TestDataElement g_test_data[]
+{
+	{ // Simple optimization - common suffix is shared.
+		"(?:barfoo|bazfoo|foo)[!?]",
+		"foo",
+		1,
+	},
+	{ // Common suffix of single symbol.
+		"(?:ab|cb)[!?]",
+		"b",
+		1,
+	},
+	{ // Suffix is shared only by alternatives with same suffix.
+		"(?:walking|talking|nation|station)[!?]",
+		"ing",
+		1,
+	},
+	{ // Suffixes are factored recursively.
+		"(?:walking|talking|nation|station)[!?]",
+		"alking",
+		1,
+	},
+	{ // Suffixes are factored recursively.
+		"(?:walking|talking|nation|station)[!?]",
+		"ation",
+		1,
+	},
+	{ // Suffix factoring works inside capturing group.
+		"(walking|talking)[!?]",
+		"alking",
+		1,
+	},
+	{ // Suffix factoring works for non-ASCII strings.
+		"(?:большой|малой)[!?]",
+		"ой",
+		1,
+	},
+	{ // Suffix isn't shared by alternatives with different next nodes.
+		"(?:[0-9]cb[!?]|ab)[!?]",
+		"b",
+		2,
+	},
+	{ // Suffix isn't shared by case-sensitive and case-insensitive alternatives.
+		"(?:ab|(?i)cb)[!?]",
+		"b",
+		2,
+	},
+	{ // Suffix factoring works in sequences.
+		"(?:xyz|zyz|s)+[!?]",
+		"yz",
+		1,
+	},
+};
+
+size_t CountStringNodesWithSuffix(const GraphElements::NodePtr graph_start, const std::string& suffix)
+{
+	size_t count= 0;
+	EnumerateAllNodesOnce(
+		[&](const GraphElements::NodePtr node)
+		{
+			std::string str;
+			if(const auto string= std::get_if<GraphElements::String>(node))
+				str= string->str;
+			else if(const auto specific_symbol= std::get_if<GraphElements::SpecificSymbol>(node))
+			{
+				const CharType str_utf32[]{specific_symbol->code, 0};
+				str= Utf32ToUtf8(str_utf32);
+			}
+
+			if(str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0)
+				++count;
+		},
+		graph_start);
+
+	return count;
+}
+
+class AlternativesSuffixFactoringTest : public ::testing::TestWithParam<TestDataElement> {};
+
+TEST_P(AlternativesSuffixFactoringTest, TestOptimization)
+{
+	const auto param= GetParam();
+	const auto parse_res= RegPanzer::ParseRegexString(param.regex_str);
+	const auto regex_chain= std::get_if<RegexElementsChain>(&parse_res);
+	ASSERT_TRUE(regex_chain != nullptr);
+
+	const auto regex_graph= OptimizeRegexGraph( BuildRegexGraph(*regex_chain, Options()) );
+
+	ASSERT_EQ(CountStringNodesWithSuffix(regex_graph.root, param.suffix), param.num_nodes_with_suffix);
+}
+
+INSTANTIATE_TEST_SUITE_P(ASF, AlternativesSuffixFactoringTest, testing::ValuesIn(g_test_data));
+
+} // namespace
+
+} // namespace RegPanzer
@@ -0,0 +1,81 @@
+#include "../RegPanzerLib/RegexGraph.hpp"
+#include "../RegPanzerLib/RegexGraphOptimizer.hpp"
+#include "../RegPanzerLib/Parser.hpp"
+#include "../RegPanzerLib/PushDisableLLVMWarnings.hpp"
+#include <gtest/gtest.h>
+#include "../RegPanzerLib/PopLLVMWarnings.hpp"
+
+namespace RegPanzer
+{
+
+namespace
+{
+
+struct TestDataElement
+{
+	std::string regex_str;
+	size_t num_alternatives; // 0 if trie should not be created.
+};
+
+const TestDataElement g_test_data[]
+{
+	{ // Simple optimization - alternatives of strings are replaced with trie.
+		"GET|POST|PUT|HEAD|DELETE",
+		5,
+	},
+	{ // Alternatives of single symbols.
+		"a|b|c|d",
+		4,
+	},
+	{ // Strings may be prefixes of each other.
+		"a|ab|xyz|abc",
+		4,
+	},
+	{ // Alternatives may continue after strings.
+		"foo|bar|baz|q[0-9]",
+		4,
+	},
+	{ // Non-ASCII strings.
+		"дом|дым|дама|сок",
+		4,
+	},
+	{ // Trie is not created for small number of alternatives.
+		"foo|bar|baz",
+		0,
+	},
+	{ // Trie is not created, since one of alternatives doesn't start with string.
+		"foo|bar|baz|[0-9]",
+		0,
+	},
+	{ // Trie is not created for case-insensitive strings.
+		"(?i)foo|bar|baz|qux",
+		0,
+	},
+};
+
+class AlternativesTrieOptimizationTest : public ::testing::TestWithParam<TestDataElement> {};
+
+TEST_P(AlternativesTrieOptimizationTest, TestOptimization)
+{
+	const auto param= GetParam();
+	const auto parse_res= RegPanzer::ParseRegexString(param.regex_str);
+	const auto regex_chain= std::get_if<RegexElementsChain>(&parse_res);
+	ASSERT_TRUE(regex_chain != nullptr);
+
+	const auto regex_graph= OptimizeRegexGraph( BuildRegexGraph(*regex_chain, Options()) );
+
+	const auto alternatives_trie= std::get_if<GraphElements::AlternativesTrie>(regex_graph.root);
+	if(param.num_alternatives == 0)
+		ASSERT_TRUE(alternatives_trie == nullptr);
+	else
+	{
+		ASSERT_TRUE(alternatives_trie != nullptr);
+		ASSERT_EQ(alternatives_trie->alternatives.size(), param.num_alternatives);
+	}
+}
+
+INSTANTIATE_TEST_SUITE_P(ATO, AlternativesTrieOptimizationTest, testing::ValuesIn(g_test_data));
+
+} // namespace
+
+} // namespace RegPanzer
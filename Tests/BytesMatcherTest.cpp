@@ -0,0 +1,300 @@
+#include "MatcherTestData.hpp"
+#include "../RegPanzerLib/Matcher.hpp"
+#include "../RegPanzerLib/MatcherGeneratorLLVM.hpp"
+#include "../RegPanzerLib/Parser.hpp"
+#include "../RegPanzerLib/RegexGraphOptimizer.hpp"
+#include "../RegPanzerLib/Utils.hpp"
+#include "../RegPanzerLib/PushDisableLLVMWarnings.hpp"
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/ExecutionEngine/SectionMemoryManager.h>
+#include <gtest/gtest.h>
+#include "../RegPanzerLib/PopLLVMWarnings.hpp"
+
+namespace RegPanzer
+{
+
+namespace
+{
+
+using FunctionType= size_t(*)(const char* str, size_t str_size, size_t start_offset, size_t* out_subpatterns, size_t number_of_subpatterns);
+
+// Convert UTF-8 into Latin-1. Returns false if it is not possible.
+bool ConvertToLatin1(const std::string& str, std::string& out_str)
+{
+	const std::u32string str_utf32= Utf8ToUtf32(str);
+	if(str_utf32.empty() && !str.empty())
+		return false; // Invalid UTF-8.
+
+	out_str.clear();
+	for(const char32_t c : str_utf32)
+	{
+		if(c > 0xFF)
+			return false;
+		out_str.push_back(char(c));
+	}
+
+	return true;
+}
+
+// Returns offset in bytes of Latin-1 string for each offset in UTF-8 bytes. Offsets inside code points are invalid.
+std::vector<size_t> BuildOffsetsMap(const std::string& str)
+{
+	const size_t c_invalid_offset= std::numeric_limits<size_t>::max();
+	std::vector<size_t> offsets(str.size() + 1, c_invalid_offset);
+
+	size_t byte_offset= 0, result_offset= 0;
+	for(const char32_t c : Utf8ToUtf32(str))
+	{
+		offsets[byte_offset]= result_offset;
+		byte_offset+= GetCodePointSize(c, Encoding::UTF8);
+		++result_offset;
+	}
+	offsets[byte_offset]= result_offset;
+
+	return offsets;
+}
+
+// Returns null if regex can't be used in bytes mode.
+std::optional<RegexGraphBuildResult> BuildRegexGraphForBytes(const std::string& regex_str, const bool is_multiline)
+{
+	Options options;
+	options.multiline= is_multiline;
+	options.encoding= Encoding::Bytes;
+
+	const auto parse_res= RegPanzer::ParseRegexString(regex_str, options);
+	const auto regex_chain= std::get_if<RegexElementsChain>(&parse_res);
+	if(regex_chain == nullptr)
+		return std::nullopt;
+
+	return OptimizeRegexGraph( BuildRegexGraph(*regex_chain, options) );
+}
+
+struct GeneratedFunction
+{
+	// Context should be destroyed after engine.
+	std::unique_ptr<llvm::LLVMContext> llvm_context;
+	std::unique_ptr<llvm::ExecutionEngine> engine;
+	FunctionType function= nullptr;
+};
+
+GeneratedFunction GenerateFunction(const RegexGraphBuildResult& regex_graph)
+{
+	GeneratedFunction result;
+
+	auto target_machine= CreateTargetMachine();
+	if(target_machine == nullptr)
+		return result;
+
+	result.llvm_context= std::make_unique<llvm::LLVMContext>();
+	auto module= std::make_unique<llvm::Module>("id", *result.llvm_context);
+	module->setDataLayout(target_machine->createDataLayout());
+
+	const std::string function_name= "Match";
+	GenerateMatcherFunction(*module, regex_graph, function_name);
+
+	llvm::EngineBuilder builder(std::move(module));
+	builder.setEngineKind(llvm::EngineKind::JIT);
+	builder.setMemoryManager(std::make_unique<llvm::SectionMemoryManager>());
+	result.engine.reset(builder.create(target_machine.release())); // Engine takes ownership over target machine.
+	if(result.engine == nullptr)
+		return result;
+
+	result.function= reinterpret_cast<FunctionType>(result.engine->getFunctionAddress(function_name));
+	return result;
+}
+
+MatcherTestDataElement::Ranges MatchWithInterpreter(const RegexGraphBuildResult& regex_graph, const std::string& str)
+{
+	MatcherTestDataElement::Ranges result_ranges;
+	for(size_t start_pos= 0; start_pos < str.size();)
+	{
+		std::string_view res;
+		if(Match(regex_graph, str, start_pos, &res, 1) == 0)
+			break;
+
+		const size_t start_offset= size_t(res.data() - str.data());
+		const size_t end_offset= start_offset + res.size();
+		result_ranges.emplace_back(start_offset, end_offset);
+		start_pos= end_offset;
+	}
+
+	return result_ranges;
+}
+
+MatcherTestDataElement::Ranges MatchWithFunction(const FunctionType function, const std::string& str)
+{
+	MatcherTestDataElement::Ranges result_ranges;
+	for(size_t i= 0; i < str.size();)
+	{
+		size_t group[2]{0, 0};
+		if(function(str.data(), str.size(), i, group, 1) == 0)
+			break;
+
+		result_ranges.emplace_back(group[0], group[1]);
+		if(group[1] <= i && group[1] <= group[0])
+			break;
+		i= group[1];
+	}
+
+	return result_ranges;
+}
+
+// Run common matcher tests in bytes mode. Input strings are converted from UTF-8 into Latin-1.
+// Regular expressions with symbols outside Latin-1 and inputs with such symbols are skipped.
+void RunCommonTestCase(const MatcherTestDataElement& param, const bool is_multiline)
+{
+	const auto regex_graph= BuildRegexGraphForBytes(param.regex_str, is_multiline);
+	if(regex_graph == std::nullopt)
+		return;
+
+	const GeneratedFunction generated= GenerateFunction(*regex_graph);
+	ASSERT_TRUE(generated.function != nullptr);
+
+	for(const MatcherTestDataElement::Case& c : param.cases)
+	{
+		std::string input_str;
+		if(!ConvertToLatin1(c.input_str, input_str))
+			continue;
+
+		const std::vector<size_t> offsets= BuildOffsetsMap(c.input_str);
+
+		MatcherTestDataElement::Ranges expected_ranges;
+		for(const auto& range : c.result_ranges)
+			expected_ranges.emplace_back(offsets[range.first], offsets[range.second]);
+
+		EXPECT_EQ(MatchWithInterpreter(*regex_graph, input_str), expected_ranges);
+		EXPECT_EQ(MatchWithFunction(generated.function, input_str), expected_ranges);
+	}
+}
+
+class BytesMatcherTest : public ::testing::TestWithParam<MatcherTestDataElement> {};
+
+TEST_P(BytesMatcherTest, TestMatch)
+{
+	RunCommonTestCase(GetParam(), false);
+}
+
+INSTANTIATE_TEST_SUITE_P(M, BytesMatcherTest, testing::ValuesIn(g_matcher_test_data, g_matcher_test_data + g_matcher_test_data_size));
+
+
+class BytesMatcherMultilineTest : public ::testing::TestWithParam<MatcherTestDataElement> {};
+
+TEST_P(BytesMatcherMultilineTest, TestMatch)
+{
+	RunCommonTestCase(GetParam(), true);
+}
+
+INSTANTIATE_TEST_SUITE_P(M, BytesMatcherMultilineTest, testing::ValuesIn(g_matcher_multiline_test_data, g_matcher_multiline_test_data + g_matcher_multiline_test_data_size));
+
+
+// Tests for raw bytes input - here input strings are not UTF-8 and are used as is.
+const MatcherTestDataElement g_bytes_test_data[]
+{
+	{ // Any symbol is single byte, even if bytes sequence is valid UTF-8.
+		".",
+		{
+			{ "", {} },
+			{ "a", { {0, 1} } },
+			{ "\xD1\x91", { {0, 1}, {1, 2} } },
+			{ "\xFF\x80", { {0, 1}, {1, 2} } },
+		}
+	},
+	{ // Hex escape sequences specify bytes.
+		"\\xFF+",
+		{
+			{ "\xFF\xFF", { {0, 2} } },
+			{ "a\xFF" "b", { {1, 2} } },
+			{ "\xC3\xBF", {} },
+		}
+	},
+	{ // Latin-1 symbols in regex are single bytes.
+		"é",
+		{
+			{ "\xE9", { {0, 1} } },
+			{ "\xC3\xA9", {} },
+		}
+	},
+	{ // Inverse class, which is replaced with smaller positive class.
+		"[^\\x00-/:-ÿ]+",
+		{
+			{ "abc", {} },
+			{ "a01\xFF" "9\x80", { {1, 3}, {4, 5} } },
+		}
+	},
+	{ // Class with ranges of high bytes. Regex itself is UTF-8 - range bounds are Latin-1 symbols U+0080-U+00BF and U+00F0-U+00FF.
+		"[\xC2\x80-\xC2\xBF\xC3\xB0-\xC3\xBF]+",
+		{
+			{ "abc", {} },
+			{ "a\x80\xBF" "b\xC0\xF5", { {1, 3}, {5, 6} } },
+		}
+	},
+	{ // Class with many variants.
+		"[aeiouy\\x00]+",
+		{
+			{ std::string("ba\0e", 4), { {1, 4} } },
+			{ "xyz", { {1, 2} } },
+		}
+	},
+	{ // Inverse class matches any byte except listed.
+		"[^a-zà-ï]+",
+		{
+			{ "ab\xE1\xF1\x01z", { {3, 5} } },
+		}
+	},
+	{ // Space class contains only Latin-1 symbols.
+		"\\s+",
+		{
+			{ "a \xA0\t" "b", { {1, 4} } },
+		}
+	},
+	{ // Strings with high bytes.
+		"ab\\xF0\\x90",
+		{
+			{ "xab\xF0\x90y", { {1, 5} } },
+			{ "ab\xF0", {} },
+		}
+	},
+};
+
+class BytesInputMatcherTest : public ::testing::TestWithParam<MatcherTestDataElement> {};
+
+TEST_P(BytesInputMatcherTest, TestMatch)
+{
+	const auto param= GetParam();
+
+	const auto regex_graph= BuildRegexGraphForBytes(param.regex_str, false);
+	ASSERT_TRUE(regex_graph != std::nullopt);
+
+	const GeneratedFunction generated= GenerateFunction(*regex_graph);
+	ASSERT_TRUE(generated.function != nullptr);
+
+	for(const MatcherTestDataElement::Case& c : param.cases)
+	{
+		EXPECT_EQ(MatchWithInterpreter(*regex_graph, c.input_str), c.result_ranges);
+		EXPECT_EQ(MatchWithFunction(generated.function, c.input_str), c.result_ranges);
+	}
+}
+
+INSTANTIATE_TEST_SUITE_P(M, BytesInputMatcherTest, testing::ValuesIn(g_bytes_test_data));
+
+
+TEST(BytesParserTest, NonLatin1SymbolsAreRejected)
+{
+	Options options;
+	options.encoding= Encoding::Bytes;
+
+	for(const char* const regex_str : { "ё", "[а-я]", "[a-ё]", "\\u0100", "a\\u20ACb" })
+	{
+		const auto parse_res= ParseRegexString(regex_str, options);
+		EXPECT_TRUE(std::get_if<ParseErrors>(&parse_res) != nullptr) << regex_str;
+
+		// Same regex is fine for UTF-8.
+		const auto parse_res_utf8= ParseRegexString(regex_str);
+		EXPECT_TRUE(std::get_if<RegexElementsChain>(&parse_res_utf8) != nullptr) << regex_str;
+	}
+}
+
+} // namespace
+
+} // namespace RegPanzer
@@ -0,0 +1,413 @@
+#include "MatcherTestData.hpp"
+#include "../RegPanzerLib/CaseFolding.hpp"
+#include "../RegPanzerLib/Matcher.hpp"
+#include "../RegPanzerLib/MatcherGeneratorLLVM.hpp"
+#include "../RegPanzerLib/Parser.hpp"
+#include "../RegPanzerLib/RegexGraphOptimizer.hpp"
+#include "../RegPanzerLib/Utils.hpp"
+#include "../RegPanzerLib/PushDisableLLVMWarnings.hpp"
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/ExecutionEngine/SectionMemoryManager.h>
+#include <gtest/gtest.h>
+#include "../RegPanzerLib/PopLLVMWarnings.hpp"
+
+namespace RegPanzer
+{
+
+namespace
+{
+
+std::string ConvertString(const std::string& str, std::string*)
+{
+	return str;
+}
+
+std::u16string ConvertString(const std::string& str, std::u16string*)
+{
+	return Utf8ToUtf16(str);
+}
+
+// Returns offset in code units for each offset in UTF-8 bytes. Offsets inside code points are invalid.
+std::vector<size_t> BuildOffsetsMap(const std::string& str, const Encoding encoding)
+{
+	const size_t c_invalid_offset= std::numeric_limits<size_t>::max();
+	std::vector<size_t> offsets(str.size() + 1, c_invalid_offset);
+
+	size_t byte_offset= 0, code_unit_offset= 0;
+	for(const char32_t c : Utf8ToUtf32(str))
+	{
+		offsets[byte_offset]= code_unit_offset;
+		byte_offset+= GetCodePointSize(c, Encoding::UTF8);
+		code_unit_offset+= GetCodePointSize(c, encoding);
+	}
+	offsets[byte_offset]= code_unit_offset;
+
+	return offsets;
+}
+
+template<typename CharT>
+void RunTestCase(const MatcherTestDataElement& param, const Options& options)
+{
+	using StringType= std::basic_string<CharT>;
+	using StringViewType= std::basic_string_view<CharT>;
+	using FunctionType= size_t(*)(const CharT* str, size_t str_size, size_t start_offset, size_t* out_subpatterns, size_t number_of_subpatterns);
+
+	const auto parse_res= RegPanzer::ParseRegexString(param.regex_str, options);
+	const auto regex_chain= std::get_if<RegexElementsChain>(&parse_res);
+	ASSERT_TRUE(regex_chain != nullptr);
+
+	const auto regex_graph= OptimizeRegexGraph( BuildRegexGraph(*regex_chain, options) );
+
+	auto target_machine= CreateTargetMachine();
+	ASSERT_TRUE(target_machine != nullptr);
+
+	llvm::LLVMContext llvm_context;
+	auto module= std::make_unique<llvm::Module>("id", llvm_context);
+	module->setDataLayout(target_machine->createDataLayout());
+
+	const std::string function_name= "Match";
+	GenerateMatcherFunction(*module, regex_graph, function_name);
+
+	llvm::EngineBuilder builder(std::move(module));
+	builder.setEngineKind(llvm::EngineKind::JIT);
+	builder.setMemoryManager(std::make_unique<llvm::SectionMemoryManager>());
+	const std::unique_ptr<llvm::ExecutionEngine> engine(builder.create(target_machine.release())); // Engine takes ownership over target machine.
+	ASSERT_TRUE(engine != nullptr);
+
+	const auto function= reinterpret_cast<FunctionType>(engine->getFunctionAddress(function_name));
+	ASSERT_TRUE(function != nullptr);
+
+	for(const MatcherTestDataElement::Case& c : param.cases)
+	{
+		const StringType input_str= ConvertString(c.input_str, static_cast<StringType*>(nullptr));
+		const std::vector<size_t> offsets= BuildOffsetsMap(c.input_str, options.encoding);
+
+		MatcherTestDataElement::Ranges expected_ranges;
+		for(const auto& range : c.result_ranges)
+			expected_ranges.emplace_back(offsets[range.first], offsets[range.second]);
+
+		// Check interpreter.
+		{
+			MatcherTestDataElement::Ranges result_ranges;
+			for(size_t start_pos= 0; start_pos < input_str.size();)
+			{
+				StringViewType res;
+				if(Match(regex_graph, input_str, start_pos, &res, 1) == 0)
+					break;
+
+				const size_t start_offset= size_t(res.data() - input_str.data());
+				const size_t end_offset= start_offset + res.size();
+				result_ranges.emplace_back(start_offset, end_offset);
+				start_pos= end_offset;
+			}
+
+			EXPECT_EQ(result_ranges, expected_ranges) << c.input_str;
+		}
+
+		// Check generated function.
+		{
+			MatcherTestDataElement::Ranges result_ranges;
+			for(size_t i= 0; i < input_str.size();)
+			{
+				size_t group[2]{0, 0};
+				if(function(input_str.data(), input_str.size(), i, group, 1) == 0)
+					break;
+
+				result_ranges.emplace_back(group[0], group[1]);
+				if(group[1] <= i && group[1] <= group[0])
+					break;
+				i= group[1];
+			}
+
+			EXPECT_EQ(result_ranges, expected_ranges) << c.input_str;
+		}
+	}
+}
+
+const MatcherTestDataElement g_case_insensitive_test_data[]
+{
+	{ // Simple ASCII string.
+		"(?i)abc",
+		{
+			{ "abc", { {0, 3} } },
+			{ "ABC", { {0, 3} } },
+			{ "aBc", { {0, 3} } },
+			{ "xAbCx", { {1, 4} } },
+			{ "abd", {} },
+			{ "ab", {} },
+		}
+	},
+	{ // Upper case in regex.
+		"(?i)HeLLo",
+		{
+			{ "hello HELLO hElLo", { {0, 5}, {6, 11}, {12, 17} } },
+			{ "help", {} },
+		}
+	},
+	{ // Symbols without case are matched exactly. Symbols differing from each other in same bit as letters ('@' and '`') are not mixed.
+		"(?i)a1@`z",
+		{
+			{ "A1@`Z", { {0, 5} } },
+			{ "A1``Z", {} },
+			{ "A1@@Z", {} },
+			{ "A1`@Z", {} },
+		}
+	},
+	{ // Single symbol.
+		"(?i)q",
+		{
+			{ "qQ", { {0, 1}, {1, 2} } },
+			{ "Pp", {} },
+		}
+	},
+	{ // Long string - checked by chunks.
+		"(?i)the quick brown fox jumps over the lazy dog",
+		{
+			{ "THE QUICK BROWN FOX JUMPS OVER THE LAZY DOG", { {0, 43} } },
+			{ "--The Quick Brown Fox Jumps Over The Lazy Dog--", { {2, 45} } },
+			{ "the quick brown fox jumps over the lazy cat", {} },
+			{ "the quick brown fox jumps over the lazy do", {} },
+			{ "the quick brown fox jumps_over the lazy dog", {} },
+		}
+	},
+	{ // Modifier is applied until end of regex.
+		"a(?i)bc",
+		{
+			{ "aBC", { {0, 3} } },
+			{ "abc", { {0, 3} } },
+			{ "ABC", {} },
+		}
+	},
+	{ // Modifier may be disabled.
+		"(?i)a(?-i)b",
+		{
+			{ "Ab", { {0, 2} } },
+			{ "ab", { {0, 2} } },
+			{ "AB", {} },
+		}
+	},
+	{ // Modifier inside group is applied only until group end.
+		"(a(?i)b)c",
+		{
+			{ "aBc", { {0, 3} } },
+			{ "aBC", {} },
+			{ "ABc", {} },
+		}
+	},
+	{ // Modifier for non-capturing group.
+		"a(?i:b)c",
+		{
+			{ "aBc", { {0, 3} } },
+			{ "aBC", {} },
+		}
+	},
+	{ // Disabling modifier for non-capturing group.
+		"(?i)a(?-i:b)c",
+		{
+			{ "AbC", { {0, 3} } },
+			{ "ABC", {} },
+		}
+	},
+	{ // Modifier is applied to all alternatives after it.
+		"(?i)ab|cd",
+		{
+			{ "AB CD", { {0, 2}, {3, 5} } },
+		}
+	},
+	{ // Alternatives with common prefix.
+		"(?i)abc|abd",
+		{
+			{ "ABC aBd abe", { {0, 3}, {4, 7} } },
+		}
+	},
+	{ // Alternatives with case-sensitive and case-insensitive variants.
+		"(?:(?i)ab)|ac",
+		{
+			{ "AB ac AC", { {0, 2}, {3, 5} } },
+		}
+	},
+	{ // Sequences.
+		"(?i)ab*c",
+		{
+			{ "AbBbC", { {0, 5} } },
+			{ "ac AC", { {0, 2}, {3, 5} } },
+		}
+	},
+	{ // Possessive sequence.
+		"(?i)a+b",
+		{
+			{ "aAaAB", { {0, 5} } },
+			{ "aAaA", {} },
+		}
+	},
+	{ // Sequence of group.
+		"(?i)(ab)+",
+		{
+			{ "abABaBx", { {0, 6} } },
+		}
+	},
+	{ // Class.
+		"(?i)[a-c]+",
+		{
+			{ "AbCd", { {0, 3} } },
+			{ "xBBx", { {1, 3} } },
+		}
+	},
+	{ // Class with single symbols.
+		"(?i)[xyz0]+",
+		{
+			{ "aXy0Zb", { {1, 5} } },
+		}
+	},
+	{ // Inverse class excludes both cases.
+		"(?i)[^a-c]+",
+		{
+			{ "AbdD", { {2, 4} } },
+			{ "ABC", {} },
+		}
+	},
+	{ // Backreferences are case-sensitive.
+		"(?i)(ab)\\1",
+		{
+			{ "ABAB", { {0, 4} } },
+			{ "abAB", {} },
+		}
+	},
+	{ // Cyrillic.
+		"(?i)привет",
+		{
+			{ "привет", { {0, 12} } },
+			{ "ПРИВЕТ", { {0, 12} } },
+			{ "ПрИвЕт", { {0, 12} } },
+			{ "прИВЕД", {} },
+		}
+	},
+	{ // Cyrillic letters with different lead bytes.
+		"(?i)ёжик и яблоко",
+		{
+			{ "ЁЖИК И ЯБЛОКО", { {0, 24} } },
+			{ "Ёжик и Яблоко", { {0, 24} } },
+			{ "ежик и яблоко", {} },
+		}
+	},
+	{ // Cyrillic class.
+		"(?i)[а-я]+",
+		{
+			{ "Мама мыла Раму", { {0, 8}, {9, 17}, {18, 26} } },
+		}
+	},
+	{ // Greek.
+		"(?i)αβγ",
+		{
+			{ "ΑΒΓ", { {0, 6} } },
+			{ "αΒγ", { {0, 6} } },
+		}
+	},
+	{ // Latin Extended-A - case variants are neighbour code points.
+		"(?i)ĀĲ",
+		{
+			{ "āĳ", { {0, 4} } },
+			{ "Āĳ", { {0, 4} } },
+			{ "ĂĲ", {} },
+		}
+	},
+	{ // Latin-1 letters.
+		"(?i)éÿ",
+		{
+			{ "ÉŸ", { {0, 4} } },
+			{ "éÿ", { {0, 4} } },
+		}
+	},
+	{ // Long mixed string.
+		"(?i)Съешь же ещё этих мягких французских булок, да выпей чаю",
+		{
+			{ "СЪЕШЬ ЖЕ ЕЩЁ ЭТИХ МЯГКИХ ФРАНЦУЗСКИХ БУЛОК, ДА ВЫПЕЙ ЧАЮ", { {0, 102} } },
+			{ "съешь же ещё этих мягких французских булок, да выпей чая", {} },
+		}
+	},
+	{ // Alternatives of words with common suffix.
+		"(?i)(?:walkinG|talkiNg|ЛОЙ|злой)[0-9]",
+		{
+			{ "WALKING1 Talking2 talking", { {0, 8}, {9, 17} } },
+			{ "лой1 ЗЛОЙ2 злОй", { {0, 7}, {8, 17} } },
+		}
+	},
+};
+
+class CaseInsensitiveMatcherTest : public ::testing::TestWithParam<MatcherTestDataElement> {};
+
+TEST_P(CaseInsensitiveMatcherTest, TestMatch)
+{
+	RunTestCase<char>(GetParam(), Options());
+}
+
+INSTANTIATE_TEST_SUITE_P(M, CaseInsensitiveMatcherTest, testing::ValuesIn(g_case_insensitive_test_data));
+
+
+class CaseInsensitiveUtf16MatcherTest : public ::testing::TestWithParam<MatcherTestDataElement> {};
+
+TEST_P(CaseInsensitiveUtf16MatcherTest, TestMatch)
+{
+	Options options;
+	options.encoding= Encoding::UTF16;
+	RunTestCase<char16_t>(GetParam(), options);
+}
+
+INSTANTIATE_TEST_SUITE_P(M, CaseInsensitiveUtf16MatcherTest, testing::ValuesIn(g_case_insensitive_test_data));
+
+
+TEST(CaseInsensitiveOptionTest, OptionIsSameAsModifier)
+{
+	Options options;
+	options.case_insensitive= true;
+
+	RunTestCase<char>(
+		{
+			"abc(?-i)d",
+			{
+				{ "ABCd", { {0, 4} } },
+				{ "ABCD", {} },
+			}
+		},
+		options);
+}
+
+TEST(CaseInsensitiveParserTest, InvalidModifiers)
+{
+	for(const char* const regex_str : { "(?i", "(?-", "(?-x)", "(?ix)", "(?i:a", "(?-i:a" })
+	{
+		const auto parse_res= ParseRegexString(regex_str);
+		EXPECT_TRUE(std::get_if<ParseErrors>(&parse_res) != nullptr) << regex_str;
+	}
+}
+
+TEST(CaseFoldingTest, CaseVariantsAreConsistent)
+{
+	for(char32_t c= 0; c < 0x20000; ++c)
+	{
+		const auto other_case= GetOtherCase(c);
+		if(other_case == std::nullopt)
+		{
+			EXPECT_EQ(FoldCase(c), c);
+			continue;
+		}
+
+		EXPECT_EQ(GetOtherCase(*other_case), c);
+		EXPECT_EQ(FoldCase(c), FoldCase(*other_case));
+
+		// Case-insensitive strings rely on same size of both variants.
+		EXPECT_EQ(GetCodePointSize(c, Encoding::UTF8), GetCodePointSize(*other_case, Encoding::UTF8));
+		EXPECT_EQ(GetCodePointSize(c, Encoding::UTF16), GetCodePointSize(*other_case, Encoding::UTF16));
+
+		// Ranges of other case variants should be same as single other case variants.
+		const auto ranges= GetOtherCaseRanges(c, c);
+		ASSERT_EQ(ranges.size(), 1u);
+		EXPECT_EQ(ranges.front().first, *other_case);
+		EXPECT_EQ(ranges.front().second, *other_case);
+	}
+}
+
+} // namespace
+
+} // namespace RegPanzer
@@ -9,6 +9,8 @@
 #include <llvm/Support/Program.h>
 #include <gtest/gtest.h>
 #include "../RegPanzerLib/PopLLVMWarnings.hpp"
+#include <fstream>
+#include <unordered_map>
 
 namespace RegPanzer
 {
@@ -19,6 +21,9 @@ namespace
 const std::string function_name= "test_match";
 const std::string object_file_path= "test.o";
 const std::string compiler_program= "RegPanzerCompiler";
+const std::string manifest_file_path= "test_manifest.txt";
+const std::string manifest_object_file_path= "test_manifest.o";
+const std::string cpu_dispatch_object_file_path= "test_manifest_cpu_dispatch.o";
 
 void RunTestCase(const MatcherTestDataElement& param, const bool is_multiline)
 {
@@ -166,6 +171,160 @@ TEST_P(CompilerGeneratedMatcherGroupsExtractionTest, TestGroupsExtraction)
 
 INSTANTIATE_TEST_SUITE_P(GE, CompilerGeneratedMatcherGroupsExtractionTest, testing::ValuesIn(g_groups_extraction_test_data, g_groups_extraction_test_data + g_groups_extraction_test_data_size));
 
+
+// Compile all test regexes in one compiler launch, using manifest file.
+class ManifestCompiledFunctions
+{
+public:
+	ManifestCompiledFunctions(const std::string& object_file_path, const std::vector<llvm::StringRef>& extra_args)
+	{
+		{
+			std::ofstream file(manifest_file_path);
+			file << "# Single-line tests\n";
+			for(size_t i= 0; i < g_matcher_test_data_size; ++i)
+				AddFunction(file, g_matcher_test_data[i].regex_str, "", functions_);
+
+			file << "# Multiline tests\n";
+			for(size_t i= 0; i < g_matcher_multiline_test_data_size; ++i)
+				AddFunction(file, g_matcher_multiline_test_data[i].regex_str, "-m", multiline_functions_);
+		}
+
+		// Use several threads for generation.
+		std::vector<llvm::StringRef> args{compiler_program, "--manifest", manifest_file_path, "-o", object_file_path, "-O2", "-j4"};
+		args.insert(args.end(), extra_args.begin(), extra_args.end());
+		const int res= llvm::sys::ExecuteAndWait(compiler_program, args);
+		if(res != 0)
+			return;
+
+		auto target_machine= CreateTargetMachine();
+		if(target_machine == nullptr)
+			return;
+
+		auto module= std::make_unique<llvm::Module>("id", llvm_context_);
+		module->setDataLayout(target_machine->createDataLayout());
+
+		llvm::EngineBuilder builder(std::move(module));
+		builder.setEngineKind(llvm::EngineKind::JIT);
+		builder.setMemoryManager(std::make_unique<llvm::SectionMemoryManager>());
+		engine_.reset(builder.create(target_machine.release())); // Engine takes ownership over target machine.
+		if(engine_ == nullptr)
+			return;
+
+		auto object_file= llvm::object::ObjectFile::createObjectFile(object_file_path);
+		if(!object_file)
+		{
+			llvm::consumeError(object_file.takeError());
+			engine_= nullptr;
+			return;
+		}
+
+		engine_->addObjectFile(std::move(*object_file));
+	}
+
+	MatcherFunctionType GetFunction(const std::string& regex_str, const bool is_multiline) const
+	{
+		if(engine_ == nullptr)
+			return nullptr;
+
+		const auto& functions= is_multiline ? multiline_functions_ : functions_;
+		const auto it= functions.find(regex_str);
+		if(it == functions.end())
+			return nullptr;
+		return reinterpret_cast<MatcherFunctionType>(engine_->getFunctionAddress(it->second));
+	}
+
+private:
+	void AddFunction(std::ostream& out, const std::string& regex_str, const std::string& options, std::unordered_map<std::string, std::string>& functions)
+	{
+		if(functions.count(regex_str) > 0)
+			return;
+
+		const std::string function_name= "test_manifest_match_" + std::to_string(function_count_);
+		++function_count_;
+		functions.emplace(regex_str, function_name);
+
+		// Use "--" in order to allow regexes started with "-".
+		out << function_name << " " << options << " -- " << regex_str << "\n";
+	}
+
+private:
+	size_t function_count_= 0;
+	std::unordered_map<std::string, std::string> functions_;
+	std::unordered_map<std::string, std::string> multiline_functions_;
+	llvm::LLVMContext llvm_context_;
+	std::unique_ptr<llvm::ExecutionEngine> engine_;
+};
+
+void RunManifestTestCase(const ManifestCompiledFunctions& compiled_functions, const MatcherTestDataElement& param, const bool is_multiline)
+{
+	const auto function= compiled_functions.GetFunction(param.regex_str, is_multiline);
+	ASSERT_TRUE(function != nullptr);
+
+	for(const MatcherTestDataElement::Case& c : param.cases)
+	{
+		MatcherTestDataElement::Ranges result_ranges;
+		for(size_t i= 0; i < c.input_str.size();)
+		{
+			size_t group[2]{};
+			const auto subpatterns_extracted= function(c.input_str.data(), c.input_str.size(), i, group, 1);
+
+			if(subpatterns_extracted == 0)
+				break;
+
+			result_ranges.emplace_back(group[0], group[1]);
+			if(group[1] <= i && group[1] <= group[0])
+				break;
+			i= group[1];
+		}
+
+		EXPECT_EQ(result_ranges, c.result_ranges);
+	}
+}
+
+const ManifestCompiledFunctions& GetManifestCompiledFunctions()
+{
+	static const ManifestCompiledFunctions compiled_functions(manifest_object_file_path, {});
+	return compiled_functions;
+}
+
+const ManifestCompiledFunctions& GetCpuDispatchManifestCompiledFunctions()
+{
+	// MCJIT can't resolve ifuncs, so, use dispatcher functions.
+	static const ManifestCompiledFunctions compiled_functions(
+		cpu_dispatch_object_file_path,
+		{"--cpu-versions=x86-64-v2,x86-64-v3,x86-64-v4", "--cpu-dispatch=function"});
+	return compiled_functions;
+}
+
+class CompilerGeneratedMatcherManifestTest : public ::testing::TestWithParam<MatcherTestDataElement> {};
+
+TEST_P(CompilerGeneratedMatcherManifestTest, TestMatch)
+{
+	RunManifestTestCase(GetManifestCompiledFunctions(), GetParam(), false);
+}
+
+INSTANTIATE_TEST_SUITE_P(M, CompilerGeneratedMatcherManifestTest, testing::ValuesIn(g_matcher_test_data, g_matcher_test_data + g_matcher_test_data_size));
+
+
+class CompilerGeneratedMatcherManifestMultilineTest : public ::testing::TestWithParam<MatcherTestDataElement> {};
+
+TEST_P(CompilerGeneratedMatcherManifestMultilineTest, TestMatch)
+{
+	RunManifestTestCase(GetManifestCompiledFunctions(), GetParam(), true);
+}
+
+INSTANTIATE_TEST_SUITE_P(M, CompilerGeneratedMatcherManifestMultilineTest, testing::ValuesIn(g_matcher_multiline_test_data, g_matcher_multiline_test_data + g_matcher_multiline_test_data_size));
+
+
+class CompilerGeneratedMatcherCpuDispatchTest : public ::testing::TestWithParam<MatcherTestDataElement> {};
+
+TEST_P(CompilerGeneratedMatcherCpuDispatchTest, TestMatch)
+{
+	RunManifestTestCase(GetCpuDispatchManifestCompiledFunctions(), GetParam(), false);
+}
+
+INSTANTIATE_TEST_SUITE_P(M, CompilerGeneratedMatcherCpuDispatchTest, testing::ValuesIn(g_matcher_test_data, g_matcher_test_data + g_matcher_test_data_size));
+
 } // namespace
 
 } // namespace RegPanzer
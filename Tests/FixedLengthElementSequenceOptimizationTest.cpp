@@ -45,9 +45,25 @@ const TestDataElement g_test_data[]
 		"[a-z]*q",
 		std::nullopt,
 	},
-	{ // FLES optimization for sequence with element size greater than 1.
+	{ // FLES optimization is not used here because single rollback point optimization is used instead.
 		"(?:vRe){3,16}v",
-		/* 3 */ std::nullopt, // TODO - fix it.
+		std::nullopt,
+	},
+	{ // FLES optimization for sequence with counter.
+		"[a-z]{2,8}(?:ing|ed)",
+		1,
+	},
+	{ // FLES optimization for sequence with counter and element size greater than 1.
+		"(?:ab[0-9]){2,}(?:ab|c)",
+		3,
+	},
+	{ // FLES optimization for sequence with counter and fixed length sequence inside.
+		"(?:[a-f0-9]{2}:){5}x",
+		3,
+	},
+	{ // FLES optimization is not used because sequence inside has no fixed length.
+		"(?:[0-9]{2,3}:){5}x",
+		std::nullopt,
 	},
 	{ // FLES optimization for sequence with fixed length sequence inside.
 		"(?:[0-9]{3}c)+0",
@@ -0,0 +1,533 @@
+#include "MatcherTestData.hpp"
+#include "GroupsExtractionTestData.hpp"
+#include "../RegPanzerLib/Matcher.hpp"
+#include "../RegPanzerLib/MatcherFunction.hpp"
+#include "../RegPanzerLib/MatcherGeneratorCpp.hpp"
+#include "../RegPanzerLib/MatcherGeneratorLLVM.hpp"
+#include "../RegPanzerLib/Parser.hpp"
+#include "../RegPanzerLib/RegexGraphOptimizer.hpp"
+#include "../RegPanzerLib/Utils.hpp"
+#include "../RegPanzerLib/PushDisableLLVMWarnings.hpp"
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/ExecutionEngine/SectionMemoryManager.h>
+#include <llvm/Support/Program.h>
+#include <gtest/gtest.h>
+#include "../RegPanzerLib/PopLLVMWarnings.hpp"
+#include <fstream>
+#include <unordered_map>
+
+namespace RegPanzer
+{
+
+namespace
+{
+
+const std::string source_file_path= "test_cpp_matchers.cpp";
+const std::string object_file_path= "test_cpp_matchers.o";
+
+struct EncodingTestDataElement
+{
+	std::string regex_str;
+	Encoding encoding= Encoding::UTF8;
+	Utf8Validation utf8_validation= Utf8Validation::PerSymbol;
+	std::string input_str; // UTF-8, converted into target encoding.
+	size_t expected_matches= 0;
+};
+
+const EncodingTestDataElement g_encoding_test_data[]
+{
+	{ "[а-я]+", Encoding::UTF16, Utf8Validation::PerSymbol, "Съешь же ещё этих мягких французских булок", 7 },
+	{ "\\p{Lu}", Encoding::UTF16, Utf8Validation::PerSymbol, "Ab Ωω ДЖ 𝔸𝔹", 6 },
+	{ "..b", Encoding::UTF16, Utf8Validation::PerSymbol, "😀😁b😂b", 1 },
+	{ "[😀-😂]", Encoding::UTF32, Utf8Validation::PerSymbol, "😀a😁b😂c😃", 3 },
+	{ "(?i)straße", Encoding::UTF32, Utf8Validation::PerSymbol, "STRASSE Straße STRAßE", 2 },
+	{ "[à-ÿ]+", Encoding::Bytes, Utf8Validation::PerSymbol, "façade déjà vu", 3 },
+	{ "(?i)é", Encoding::Bytes, Utf8Validation::PerSymbol, "éÉeE", 2 },
+	{ "(?i)ДОМ", Encoding::UTF8, Utf8Validation::OnceAtEntry, "дом Дом ДОМ дым", 3 },
+	{ "\\p{L}+", Encoding::UTF8, Utf8Validation::None, "слово word λόγος 123", 3 },
+	// Empty matches. Search is continued from next code point, not from next code unit.
+	{ "x*", Encoding::UTF8, Utf8Validation::PerSymbol, "é😀", 3 },
+	{ "y*", Encoding::UTF8, Utf8Validation::None, "жж", 3 },
+	{ "z*", Encoding::UTF16, Utf8Validation::PerSymbol, "😀é", 3 },
+	{ "w*", Encoding::Bytes, Utf8Validation::PerSymbol, "éé", 3 },
+};
+
+// Regular expressions for check of search with non-zero start offset in not validated input.
+const char* const g_utf8_once_regexes[]{ ".", "[^a]", "\\p{So}" };
+
+// Classes with non-ASCII symbols and inverse classes in UTF-8 input. Results should be the same for C++ backend, LLVM backend and interpreter.
+// Continuation bytes (if search starts inside code point) and invalid bytes are not matched by classes.
+const MatcherTestDataElement g_non_ascii_classes_test_data[]
+{
+	{
+		"\\s+\\S",
+		{
+			{ "\u00C0\u00E0\u00C9\u00E9", {} }, // Second byte of "\u00E0" is equal to no-break space code point.
+			{ "a\u00A0\u00E9", { {1, 5} } },
+		},
+	},
+	{
+		"(?:a|b|c|\\s)+",
+		{
+			{ "\u00C0\u00E0\u00C9\u00E9", {} },
+			{ "a b\u00A0c", { {0, 6} } },
+		},
+	},
+	{
+		"\\P{L}+",
+		{
+			{ "\u00E9t\u00E9 \u20AC 100", { {5, 13} } },
+		},
+	},
+	{
+		"\\p{So}|\\p{Sc}",
+		{
+			{ "\u00E9t\u00E9 \u20AC 100", { {6, 9} } }, // Second byte of "\u00E9" is equal to copyright sign code point.
+		},
+	},
+	{
+		"\\p{L}+",
+		{
+			{ "abc\xFF\xFE def", { {0, 3}, {6, 9} } },
+		},
+	},
+	{
+		"[^a]+",
+		{
+			{ "\xFF", {} },
+			{ "b\xFF" "c", { {0, 1}, {2, 3} } },
+			{ "\xC3" "b", { {1, 2} } }, // Continuation byte is missing.
+		},
+	},
+	{
+		"[\\xc2\\xa0]",
+		{
+			{ "\u00E0", {} },
+			{ "\u00C2\u00A0", { {0, 2}, {2, 4} } },
+		},
+	},
+};
+
+// Generate all functions into single source file and compile it only once, because compiler launch is expensive.
+class CompiledFunctions
+{
+public:
+	CompiledFunctions()
+	{
+		std::string source;
+		const auto add_function=
+		[&](const std::string& regex_str, const Options& options, const bool count_matches, std::unordered_map<std::string, std::string>& names)
+		{
+			const auto parse_res= RegPanzer::ParseRegexString(regex_str, options);
+			const auto regex_chain= std::get_if<RegexElementsChain>(&parse_res);
+			if(regex_chain == nullptr || names.count(regex_str) > 0)
+				return;
+
+			const auto regex_graph= OptimizeRegexGraph( BuildRegexGraph(*regex_chain, options) );
+
+			const std::string function_name= "test_cpp_matcher_" + std::to_string(function_count_);
+			++function_count_;
+			names.emplace(regex_str, function_name);
+
+			source+=
+				count_matches
+					? GenerateMatchesCounterFunctionCpp(regex_graph, function_name)
+					: GenerateMatcherFunctionCpp(regex_graph, function_name);
+			source+= "\n";
+		};
+
+		for(size_t i= 0; i < g_matcher_test_data_size; ++i)
+		{
+			Options options;
+			add_function(g_matcher_test_data[i].regex_str, options, false, matcher_functions_);
+			add_function(g_matcher_test_data[i].regex_str, options, true, counter_functions_);
+		}
+		for(const MatcherTestDataElement& element : g_non_ascii_classes_test_data)
+			add_function(element.regex_str, Options(), false, matcher_functions_);
+		for(const char* const regex_str : g_utf8_once_regexes)
+		{
+			Options options;
+			options.utf8_validation= Utf8Validation::OnceAtEntry;
+			add_function(regex_str, options, false, utf8_once_matcher_functions_);
+		}
+		for(size_t i= 0; i < g_matcher_multiline_test_data_size; ++i)
+		{
+			Options options;
+			options.multiline= true;
+			add_function(g_matcher_multiline_test_data[i].regex_str, options, false, multiline_matcher_functions_);
+		}
+		for(size_t i= 0; i < g_groups_extraction_test_data_size; ++i)
+		{
+			Options options;
+			options.extract_groups= true;
+			add_function(g_groups_extraction_test_data[i].regex_str, options, false, groups_extraction_matcher_functions_);
+		}
+		for(const EncodingTestDataElement& element : g_encoding_test_data)
+		{
+			Options options;
+			options.encoding= element.encoding;
+			options.utf8_validation= element.utf8_validation;
+			add_function(element.regex_str, options, true, encoding_counter_functions_);
+		}
+
+		{
+			std::ofstream file(source_file_path);
+			file << source;
+			if(!file)
+				return;
+		}
+
+		// Use system C++ compiler. Generated code should be compiled without any warnings.
+		const auto compiler_program= llvm::sys::findProgramByName("c++");
+		if(!compiler_program)
+			return;
+
+		const int res= llvm::sys::ExecuteAndWait(
+			*compiler_program,
+			{*compiler_program, "-std=c++11", "-O2", "-fPIC", "-Wall", "-Wextra", "-Wconversion", "-Werror", "-c", source_file_path, "-o", object_file_path});
+		if(res != 0)
+		{
+			compilation_failed_= true;
+			return;
+		}
+
+		auto target_machine= CreateTargetMachine();
+		if(target_machine == nullptr)
+			return;
+
+		auto module= std::make_unique<llvm::Module>("id", llvm_context_);
+		module->setDataLayout(target_machine->createDataLayout());
+
+		llvm::EngineBuilder builder(std::move(module));
+		builder.setEngineKind(llvm::EngineKind::JIT);
+		builder.setMemoryManager(std::make_unique<llvm::SectionMemoryManager>());
+		engine_.reset(builder.create(target_machine.release())); // Engine takes ownership over target machine.
+		if(engine_ == nullptr)
+			return;
+
+		auto object_file= llvm::object::ObjectFile::createObjectFile(object_file_path);
+		if(!object_file)
+		{
+			llvm::consumeError(object_file.takeError());
+			engine_= nullptr;
+			return;
+		}
+
+		engine_->addObjectFile(std::move(*object_file));
+	}
+
+	bool CompilationFailed() const { return compilation_failed_; }
+	bool IsAvailable() const { return engine_ != nullptr; }
+
+	template<typename FunctionType>
+	FunctionType GetFunction(const std::unordered_map<std::string, std::string>& names, const std::string& regex_str) const
+	{
+		const auto it= names.find(regex_str);
+		if(it == names.end())
+			return nullptr;
+		return reinterpret_cast<FunctionType>(engine_->getFunctionAddress(it->second));
+	}
+
+	MatcherFunctionType GetMatcherFunction(const std::string& regex_str, const bool is_multiline) const
+	{
+		return GetFunction<MatcherFunctionType>(is_multiline ? multiline_matcher_functions_ : matcher_functions_, regex_str);
+	}
+
+	MatcherFunctionType GetUtf8OnceMatcherFunction(const std::string& regex_str) const
+	{
+		return GetFunction<MatcherFunctionType>(utf8_once_matcher_functions_, regex_str);
+	}
+
+	MatcherFunctionType GetGroupsExtractionMatcherFunction(const std::string& regex_str) const
+	{
+		return GetFunction<MatcherFunctionType>(groups_extraction_matcher_functions_, regex_str);
+	}
+
+	MatchesCounterFunctionType GetMatchesCounterFunction(const std::string& regex_str) const
+	{
+		return GetFunction<MatchesCounterFunctionType>(counter_functions_, regex_str);
+	}
+
+	template<typename FunctionType>
+	FunctionType GetEncodingMatchesCounterFunction(const std::string& regex_str) const
+	{
+		return GetFunction<FunctionType>(encoding_counter_functions_, regex_str);
+	}
+
+private:
+	size_t function_count_= 0;
+	std::unordered_map<std::string, std::string> matcher_functions_;
+	std::unordered_map<std::string, std::string> multiline_matcher_functions_;
+	std::unordered_map<std::string, std::string> utf8_once_matcher_functions_;
+	std::unordered_map<std::string, std::string> groups_extraction_matcher_functions_;
+	std::unordered_map<std::string, std::string> counter_functions_;
+	std::unordered_map<std::string, std::string> encoding_counter_functions_;
+
+	bool compilation_failed_= false;
+	llvm::LLVMContext llvm_context_;
+	std::unique_ptr<llvm::ExecutionEngine> engine_;
+};
+
+const CompiledFunctions& GetCompiledFunctions()
+{
+	static const CompiledFunctions compiled_functions;
+	return compiled_functions;
+}
+
+#define CHECK_COMPILED_FUNCTIONS\
+	ASSERT_FALSE(GetCompiledFunctions().CompilationFailed());\
+	if(!GetCompiledFunctions().IsAvailable())\
+		GTEST_SKIP() << "C++ compiler is not available";
+
+void RunTestCase(const MatcherTestDataElement& param, const bool is_multiline)
+{
+	const auto function= GetCompiledFunctions().GetMatcherFunction(param.regex_str, is_multiline);
+	ASSERT_TRUE(function != nullptr);
+
+	for(const MatcherTestDataElement::Case& c : param.cases)
+	{
+		MatcherTestDataElement::Ranges result_ranges;
+		for(size_t i= 0; i < c.input_str.size();)
+		{
+			size_t group[2]{};
+			const auto subpatterns_extracted= function(c.input_str.data(), c.input_str.size(), i, group, 1);
+
+			if(subpatterns_extracted == 0)
+				break;
+
+			result_ranges.emplace_back(group[0], group[1]);
+			if(group[1] <= i && group[1] <= group[0])
+				break;
+			i= group[1];
+		}
+
+		EXPECT_EQ(result_ranges, c.result_ranges);
+	}
+}
+
+class GeneratedCppMatcherTest : public ::testing::TestWithParam<MatcherTestDataElement> {};
+
+TEST_P(GeneratedCppMatcherTest, TestMatch)
+{
+	CHECK_COMPILED_FUNCTIONS
+	RunTestCase(GetParam(), false);
+}
+
+INSTANTIATE_TEST_SUITE_P(M, GeneratedCppMatcherTest, testing::ValuesIn(g_matcher_test_data, g_matcher_test_data + g_matcher_test_data_size));
+
+
+class GeneratedCppMatcherMultilineTest : public ::testing::TestWithParam<MatcherTestDataElement> {};
+
+TEST_P(GeneratedCppMatcherMultilineTest, TestMatch)
+{
+	CHECK_COMPILED_FUNCTIONS
+	RunTestCase(GetParam(), true);
+}
+
+INSTANTIATE_TEST_SUITE_P(M, GeneratedCppMatcherMultilineTest, testing::ValuesIn(g_matcher_multiline_test_data, g_matcher_multiline_test_data + g_matcher_multiline_test_data_size));
+
+
+class GeneratedCppMatchesCounterTest : public ::testing::TestWithParam<MatcherTestDataElement> {};
+
+TEST_P(GeneratedCppMatchesCounterTest, TestCount)
+{
+	CHECK_COMPILED_FUNCTIONS
+
+	const auto param= GetParam();
+	const auto function= GetCompiledFunctions().GetMatcherFunction(param.regex_str, false);
+	ASSERT_TRUE(function != nullptr);
+	const auto counter_function= GetCompiledFunctions().GetMatchesCounterFunction(param.regex_str);
+	ASSERT_TRUE(counter_function != nullptr);
+
+	// Counter function should find same matches as matches iterator.
+	for(const MatcherTestDataElement::Case& c : param.cases)
+	{
+		size_t expected_count= 0;
+		for(const std::string_view match : FindAllMatches(function, c.input_str))
+		{
+			(void)match;
+			++expected_count;
+		}
+
+		EXPECT_EQ(counter_function(c.input_str.data(), c.input_str.size()), expected_count);
+	}
+}
+
+INSTANTIATE_TEST_SUITE_P(M, GeneratedCppMatchesCounterTest, testing::ValuesIn(g_matcher_test_data, g_matcher_test_data + g_matcher_test_data_size));
+
+
+class GeneratedCppMatcherGroupsExtractionTest : public ::testing::TestWithParam<GroupsExtractionTestDataElement> {};
+
+TEST_P(GeneratedCppMatcherGroupsExtractionTest, TestGroupsExtraction)
+{
+	CHECK_COMPILED_FUNCTIONS
+
+	const auto param= GetParam();
+	const auto function= GetCompiledFunctions().GetGroupsExtractionMatcherFunction(param.regex_str);
+	ASSERT_TRUE(function != nullptr);
+
+	for(const GroupsExtractionTestDataElement::Case& c : param.cases)
+	{
+		std::vector<GroupsExtractionTestDataElement::GroupMatchResults> results;
+		for(size_t i= 0; i < c.input_str.size();)
+		{
+			size_t groups[10][2]{};
+			const auto subpatterns_extracted= function(c.input_str.data(), c.input_str.size(), i, &groups[0][0], std::size(groups));
+
+			if(subpatterns_extracted == 0)
+				break;
+
+			if(groups[0][1] <= i && groups[0][1] <= groups[0][0])
+				break;
+			i= groups[0][1];
+
+			GroupsExtractionTestDataElement::GroupMatchResults result;
+
+			for(size_t j= 0; j < std::min(subpatterns_extracted, std::size(groups)); ++j)
+				result.emplace_back(groups[j][0], groups[j][1]);
+
+			results.push_back(std::move(result));
+		}
+
+		EXPECT_EQ(results, c.results);
+	}
+}
+
+INSTANTIATE_TEST_SUITE_P(GE, GeneratedCppMatcherGroupsExtractionTest, testing::ValuesIn(g_groups_extraction_test_data, g_groups_extraction_test_data + g_groups_extraction_test_data_size));
+
+
+class GeneratedCppMatcherEncodingTest : public ::testing::TestWithParam<EncodingTestDataElement> {};
+
+TEST_P(GeneratedCppMatcherEncodingTest, TestCount)
+{
+	CHECK_COMPILED_FUNCTIONS
+
+	const auto param= GetParam();
+	const auto& compiled_functions= GetCompiledFunctions();
+
+	switch(param.encoding)
+	{
+	case Encoding::UTF8:
+		{
+			const auto function= compiled_functions.GetEncodingMatchesCounterFunction<MatchesCounterFunctionType>(param.regex_str);
+			ASSERT_TRUE(function != nullptr);
+			EXPECT_EQ(function(param.input_str.data(), param.input_str.size()), param.expected_matches);
+		}
+		break;
+	case Encoding::UTF16:
+		{
+			const auto function= compiled_functions.GetEncodingMatchesCounterFunction<size_t(*)(const char16_t*, size_t)>(param.regex_str);
+			ASSERT_TRUE(function != nullptr);
+			const std::u16string str= Utf8ToUtf16(param.input_str);
+			EXPECT_EQ(function(str.data(), str.size()), param.expected_matches);
+		}
+		break;
+	case Encoding::UTF32:
+		{
+			const auto function= compiled_functions.GetEncodingMatchesCounterFunction<size_t(*)(const char32_t*, size_t)>(param.regex_str);
+			ASSERT_TRUE(function != nullptr);
+			const std::u32string str= Utf8ToUtf32(param.input_str);
+			EXPECT_EQ(function(str.data(), str.size()), param.expected_matches);
+		}
+		break;
+	case Encoding::Bytes:
+		{
+			const auto function= compiled_functions.GetEncodingMatchesCounterFunction<MatchesCounterFunctionType>(param.regex_str);
+			ASSERT_TRUE(function != nullptr);
+			std::string str;
+			for(const char32_t c : Utf8ToUtf32(param.input_str))
+				str.push_back(char(uint8_t(c)));
+			EXPECT_EQ(function(str.data(), str.size()), param.expected_matches);
+		}
+		break;
+	};
+}
+
+INSTANTIATE_TEST_SUITE_P(E, GeneratedCppMatcherEncodingTest, testing::ValuesIn(g_encoding_test_data));
+
+TEST(GeneratedCppMatcherUtf8OnceTest, NoReadsAfterStringEndForNonZeroStartOffset)
+{
+	CHECK_COMPILED_FUNCTIONS
+
+	// Input isn't validated for search with non-zero start offset, so, it may contain truncated sequence at end.
+	// Bytes after passed string size should not be read.
+	const std::string buffer= "a\xF0\x9F\x98\x80";
+	const size_t str_size= 2;
+
+	for(const char* const regex_str : g_utf8_once_regexes)
+	{
+		const auto function= GetCompiledFunctions().GetUtf8OnceMatcherFunction(regex_str);
+		ASSERT_TRUE(function != nullptr);
+
+		size_t group[2]{0, 0};
+		EXPECT_EQ(function(buffer.data(), str_size, 0, group, 1), 0u) << regex_str; // Invalid input.
+		EXPECT_EQ(function(buffer.data(), str_size, 1, group, 1), 0u) << regex_str; // Truncated sequence.
+	}
+}
+
+class GeneratedCppMatcherNonAsciiClassesTest : public ::testing::TestWithParam<MatcherTestDataElement> {};
+
+TEST_P(GeneratedCppMatcherNonAsciiClassesTest, TestMatch)
+{
+	CHECK_COMPILED_FUNCTIONS
+
+	const auto param= GetParam();
+	RunTestCase(param, false);
+
+	// Check also LLVM backend and interpreter.
+	const auto parse_res= RegPanzer::ParseRegexString(param.regex_str);
+	const auto regex_chain= std::get_if<RegexElementsChain>(&parse_res);
+	ASSERT_TRUE(regex_chain != nullptr);
+
+	const auto regex_graph= OptimizeRegexGraph( BuildRegexGraph(*regex_chain, Options()) );
+
+	auto target_machine= CreateTargetMachine();
+	ASSERT_TRUE(target_machine != nullptr);
+
+	llvm::LLVMContext llvm_context;
+	auto module= std::make_unique<llvm::Module>("id", llvm_context);
+	module->setDataLayout(target_machine->createDataLayout());
+
+	const std::string function_name= "Match";
+	GenerateMatcherFunction(*module, regex_graph, function_name);
+
+	llvm::EngineBuilder builder(std::move(module));
+	builder.setEngineKind(llvm::EngineKind::JIT);
+	builder.setMemoryManager(std::make_unique<llvm::SectionMemoryManager>());
+	const std::unique_ptr<llvm::ExecutionEngine> engine(builder.create(target_machine.release())); // Engine takes ownership over target machine.
+	ASSERT_TRUE(engine != nullptr);
+
+	const auto function= reinterpret_cast<MatcherFunctionType>(engine->getFunctionAddress(function_name));
+	ASSERT_TRUE(function != nullptr);
+
+	for(const MatcherTestDataElement::Case& c : param.cases)
+	{
+		MatcherTestDataElement::Ranges llvm_result_ranges;
+		for(const std::string_view match : FindAllMatches(function, c.input_str))
+		{
+			const size_t start_offset= size_t(match.data() - c.input_str.data());
+			llvm_result_ranges.emplace_back(start_offset, start_offset + match.size());
+		}
+		EXPECT_EQ(llvm_result_ranges, c.result_ranges) << c.input_str;
+
+		MatcherTestDataElement::Ranges interpreter_result_ranges;
+		for(size_t start_pos= 0; start_pos < c.input_str.size();)
+		{
+			std::string_view res;
+			if(Match(regex_graph, c.input_str, start_pos, &res, 1) == 0)
+				break;
+
+			const size_t start_offset= size_t(res.data() - c.input_str.data());
+			interpreter_result_ranges.emplace_back(start_offset, start_offset + res.size());
+			start_pos= start_offset + res.size();
+		}
+		EXPECT_EQ(interpreter_result_ranges, c.result_ranges) << c.input_str;
+	}
+}
+
+INSTANTIATE_TEST_SUITE_P(N, GeneratedCppMatcherNonAsciiClassesTest, testing::ValuesIn(g_non_ascii_classes_test_data));
+
+} // namespace
+
+} // namespace RegPanzer
@@ -0,0 +1,78 @@
+#include "../RegPanzerLib/RegexGraph.hpp"
+#include "../RegPanzerLib/RegexGraphOptimizer.hpp"
+#include "../RegPanzerLib/Parser.hpp"
+#include "../RegPanzerLib/PushDisableLLVMWarnings.hpp"
+#include <gtest/gtest.h>
+#include "../RegPanzerLib/PopLLVMWarnings.hpp"
+
+namespace RegPanzer
+{
+
+namespace
+{
+
+struct TestDataElement
+{
+	std::string regex_str;
+	size_t num_nodes; // Number of nodes in result graph.
+};
+
+const TestDataElement g_test_data[]
+{
+	{ // Identical tails of alternatives are shared.
+		"(?:a[0-9]x|b[0-9]x)",
+		5,
+	},
+	{ // Identical tails of alternatives inside sequence are shared, sequence node itself isn't.
+		"(?:a[0-9]x|b[0-9]x)+",
+		6,
+	},
+	{ // Sequence loops aren't shared, even if they are identical.
+		"(?:[0-9]+a|[0-9]+b)",
+		8,
+	},
+	{ // Sequences with counters aren't shared.
+		"(?:a[0-9]{2,}x|b[0-9]{2,}x)",
+		7,
+	},
+	{ // Back references are shared.
+		"(a)(?:b\\1|c\\1)",
+		7,
+	},
+};
+
+size_t CountNodes(const GraphElements::NodePtr graph_start)
+{
+	size_t count= 0;
+	EnumerateAllNodesOnce(
+		[&](const GraphElements::NodePtr node)
+		{
+			(void)node;
+			++count;
+		},
+		graph_start);
+
+	return count;
+}
+
+class GraphCompactionTest : public ::testing::TestWithParam<TestDataElement> {};
+
+TEST_P(GraphCompactionTest, TestOptimization)
+{
+	const auto param= GetParam();
+	const auto parse_res= RegPanzer::ParseRegexString(param.regex_str);
+	const auto regex_chain= std::get_if<RegexElementsChain>(&parse_res);
+	ASSERT_TRUE(regex_chain != nullptr);
+
+	const auto regex_graph= OptimizeRegexGraph( BuildRegexGraph(*regex_chain, Options()) );
+
+	ASSERT_EQ(CountNodes(regex_graph.root), param.num_nodes);
+	// Unreachable nodes are dropped.
+	ASSERT_EQ(regex_graph.nodes_storage.GetSize(), param.num_nodes);
+}
+
+INSTANTIATE_TEST_SUITE_P(GC, GraphCompactionTest, testing::ValuesIn(g_test_data));
+
+} // namespace
+
+} // namespace RegPanzer
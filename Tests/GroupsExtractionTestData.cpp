@@ -406,6 +406,31 @@ const GroupsExtractionTestDataElement g_groups_extraction_test_data[]
 		}
 	},
 
+	{ // Group, captured in failed alternative, should not be extracted.
+		"(a)b|ac",
+		{
+			{ // Empty string - no matches.
+				"",
+				{},
+			},
+			{ // Match of first alternative.
+				"ab",
+				{ { {0, 2}, {0, 1} } }
+			},
+			{ // Match of second alternative after failed first alternative.
+				"ac",
+				{ { {0, 2}, {2, 2} } }
+			},
+			{ // Several sequential matches.
+				"xacab",
+				{
+					{ { 1, 3}, { 5, 5} },
+					{ { 3, 5}, { 3, 4} },
+				}
+			},
+		}
+	},
+
 	{ // Alternative groups inside sequence.
 		"(([A-Z])|([a-z])|([0-9]))+",
 		{
@@ -552,6 +577,52 @@ const GroupsExtractionTestDataElement g_groups_extraction_test_data[]
 			},
 		}
 	},
+
+	{ // Extract groups in sequence with single rollback point. Groups of iteration with last successful match of rest of the expression should be extracted.
+		"([a-c][0-9])*(c)7",
+		{
+			{ // Empty string - no matches.
+				"",
+				{},
+			},
+			{ // Sequence iteration after successful match of the rest.
+				"a1c7",
+				{ { {0, 4}, {0, 2}, {2, 3} } }
+			},
+			{ // Two sequential matches.
+				"a1c7 b2c3c7",
+				{ { {0, 4}, {0, 2}, {2, 3} }, { {5, 11}, {7, 9}, {9, 10} } }
+			},
+		}
+	},
+
+	{ // Group, captured in failed alternative inside atomic group, should be restored before back reference after atomic group.
+		"^(?:(?>(\\w)!|\\w)\\.)+\\1",
+		{
+			{
+				"a!.b.a",
+				{ { {0, 6}, {0, 1} } }
+			},
+			{
+				"a!.b.b",
+				{}
+			},
+		}
+	},
+
+	{ // Group, captured in failed alternative inside possessive sequence, should be restored before back reference after sequence.
+		"^(?:(\\w)!|\\w\\.)++\\1",
+		{
+			{
+				"a!b.a",
+				{ { {0, 5}, {0, 1} } }
+			},
+			{
+				"a!b.c",
+				{}
+			},
+		}
+	},
 };
 
 const size_t g_groups_extraction_test_data_size= std::size(g_groups_extraction_test_data);
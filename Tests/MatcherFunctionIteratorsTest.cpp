@@ -0,0 +1,159 @@
+#include "../RegPanzerLib/MatcherFunction.hpp"
+#include "../RegPanzerLib/MatcherGeneratorLLVM.hpp"
+#include "../RegPanzerLib/Parser.hpp"
+#include "../RegPanzerLib/RegexGraphOptimizer.hpp"
+#include "../RegPanzerLib/Utils.hpp"
+#include "../RegPanzerLib/PushDisableLLVMWarnings.hpp"
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/ExecutionEngine/SectionMemoryManager.h>
+#include <gtest/gtest.h>
+#include "../RegPanzerLib/PopLLVMWarnings.hpp"
+
+namespace RegPanzer
+{
+
+namespace
+{
+
+struct TestDataElement
+{
+	std::string regex_str;
+	std::string input_str;
+	std::vector<std::string> matches;
+	std::vector<std::string> pieces;
+};
+
+const TestDataElement g_test_data[]
+{
+	{ // Simple split.
+		",",
+		"foo,bar,baz",
+		{ ",", ",", },
+		{ "foo", "bar", "baz", },
+	},
+	{ // No matches - whole string is single piece.
+		",",
+		"foo bar",
+		{},
+		{ "foo bar", },
+	},
+	{ // Empty input.
+		",",
+		"",
+		{},
+		{ "", },
+	},
+	{ // Empty pieces between adjacent separators and at the edges.
+		",",
+		",foo,,bar,",
+		{ ",", ",", ",", ",", },
+		{ "", "foo", "", "bar", "", },
+	},
+	{ // Separators of different length.
+		"[ \t]+",
+		"lol  wat\tkek \t\t foo",
+		{ "  ", "\t", " \t\t ", },
+		{ "lol", "wat", "kek", "foo", },
+	},
+	{ // Tokenize - matches are tokens.
+		"[a-z]+",
+		"1 lol, 22 wat; kek!",
+		{ "lol", "wat", "kek", },
+		{ "1 ", ", 22 ", "; ", "!", },
+	},
+	{ // Non-ASCII input.
+		"[а-яё]+",
+		"Съешь же ещё",
+		{ "ъешь", "же", "ещё", },
+		{ "С", " ", " ", "", },
+	},
+	{ // Empty matches are possible.
+		"x*",
+		"axb",
+		{ "", "x", "", "", },
+		{ "", "a", "", "b", "", },
+	},
+	{ // Empty matches in non-ASCII input. Search is continued from next code point, not from next byte.
+		"x*",
+		"éxж😀",
+		{ "", "x", "", "", "", },
+		{ "", "é", "", "ж", "😀", "", },
+	},
+	{ // Empty match at string end after non-empty match.
+		"a*",
+		"baa",
+		{ "", "aa", "", },
+		{ "", "b", "", "", },
+	},
+	{ // String start assertion - only one match is possible.
+		"^[0-9]+",
+		"123 456",
+		{ "123", },
+		{ "", " 456", },
+	},
+};
+
+class MatcherFunctionIteratorsTest : public ::testing::TestWithParam<TestDataElement> {};
+
+TEST_P(MatcherFunctionIteratorsTest, TestIterators)
+{
+	const auto param= GetParam();
+
+	auto target_machine= CreateTargetMachine();
+	ASSERT_TRUE(target_machine != nullptr);
+
+	const auto parse_res= RegPanzer::ParseRegexString(param.regex_str);
+	const auto regex_chain= std::get_if<RegexElementsChain>(&parse_res);
+	ASSERT_TRUE(regex_chain != nullptr);
+
+	const auto regex_graph= OptimizeRegexGraph( BuildRegexGraph(*regex_chain, Options()) );
+
+	const std::string function_name= "Match";
+	const std::string counter_function_name= "CountMatches";
+
+	llvm::LLVMContext llvm_context;
+	auto module= std::make_unique<llvm::Module>("id", llvm_context);
+	module->setDataLayout(target_machine->createDataLayout());
+
+	GenerateMatcherFunction(*module, regex_graph, function_name);
+	GenerateMatchesCounterFunction(*module, regex_graph, counter_function_name);
+
+	llvm::EngineBuilder builder(std::move(module));
+	builder.setEngineKind(llvm::EngineKind::JIT);
+	builder.setMemoryManager(std::make_unique<llvm::SectionMemoryManager>());
+	const std::unique_ptr<llvm::ExecutionEngine> engine(builder.create(target_machine.release())); // Engine takes ownership over target machine.
+	ASSERT_TRUE(engine != nullptr);
+
+	const auto function= reinterpret_cast<MatcherFunctionType>(engine->getFunctionAddress(function_name));
+	ASSERT_TRUE(function != nullptr);
+
+	const auto counter_function= reinterpret_cast<MatchesCounterFunctionType>(engine->getFunctionAddress(counter_function_name));
+	ASSERT_TRUE(counter_function != nullptr);
+
+	std::vector<std::string> matches;
+	for(const std::string_view match : FindAllMatches(function, param.input_str))
+	{
+		// Result should be a view into source string.
+		EXPECT_TRUE(match.data() >= param.input_str.data() && match.data() + match.size() <= param.input_str.data() + param.input_str.size());
+		matches.emplace_back(match);
+	}
+
+	std::vector<std::string> pieces;
+	for(const std::string_view piece : SplitString(function, param.input_str))
+	{
+		EXPECT_TRUE(piece.data() >= param.input_str.data() && piece.data() + piece.size() <= param.input_str.data() + param.input_str.size());
+		pieces.emplace_back(piece);
+	}
+
+	EXPECT_EQ(matches, param.matches);
+	EXPECT_EQ(pieces, param.pieces);
+	EXPECT_EQ(pieces.size(), matches.size() + 1);
+	EXPECT_EQ(counter_function(param.input_str.data(), param.input_str.size()), matches.size());
+}
+
+INSTANTIATE_TEST_SUITE_P(M, MatcherFunctionIteratorsTest, testing::ValuesIn(g_test_data));
+
+} // namespace
+
+} // namespace RegPanzer
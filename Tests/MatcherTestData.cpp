@@ -2034,6 +2034,28 @@ const MatcherTestDataElement g_matcher_test_data[]
 		}
 	},
 
+	{ // Identical alternatives with backreference. Last alternative is same as first one.
+		"(x?)(?:\\1a|\\1b|\\1a)",
+		{
+			{ // Empty string - no matches.
+				"",
+				{}
+			},
+			{ // Match second alternative.
+				"b",
+				{ {0, 1} }
+			},
+			{ // Backreference is not matched, match with empty group.
+				"xb",
+				{ {1, 2} }
+			},
+			{ // Match in middle of string.
+				"zb",
+				{ {1, 2} }
+			},
+		}
+	},
+
 	/*
 	{ // Use backreference to previous loop iteration. This works properly for PCRE expressions but not for ECMAScript.
 		"((([a-z])|G)\\3?1)+",
@@ -2766,7 +2788,584 @@ const MatcherTestDataElement g_matcher_test_data[]
 				{ {0, 6} }
 			},
 		}
-	}
+	},
+
+	// "OneOf" with many ASCII ranges.
+	{
+		"[-A-Za-z0-9_.+]+@[a-z]+",
+		{
+			{ // Empty string - no matches.
+				"",
+				{}
+			},
+			{ // Match whole string.
+				"john.doe+tag@example",
+				{ {0, 20} }
+			},
+			{ // Match in middle of string, no match for symbols not in set.
+				"x a_b-9@host !@q",
+				{ {2, 12} }
+			},
+			{ // No match - no symbols after "@".
+				"Ab@",
+				{}
+			},
+		}
+	},
+
+	// Long sequences of single byte class.
+	{
+		"[A-Z_a-z0-9]+",
+		{
+			{ // Empty string - no matches.
+				"",
+				{}
+			},
+			{ // Match whole long string.
+				"Lorem_ipsum_dolor_sit_amet_consectetur",
+				{ {0, 38} }
+			},
+			{ // Multiple long matches.
+				"abcdefghijklmnopq rstuvwxyz0123456789ABCDEFGHIJ",
+				{ {0, 17}, {18, 47} }
+			},
+			{ // Multiple matches with separators near 16 bytes boundary.
+				"0123456789abcde-0123456789abcdef!",
+				{ {0, 15}, {16, 32} }
+			},
+			{ // Non-ASCII symbol after long sequence.
+				"abcdefghijklmnopqrstuvwxyzйabc",
+				{ {0, 26}, {28, 31} }
+			},
+		}
+	},
+
+	// Long possessive sequence with upper limit.
+	{
+		"[0-9]{3,20}+x",
+		{
+			{ // Empty string - no matches.
+				"",
+				{}
+			},
+			{ // Match of sequence with less than maximum elements.
+				"0123456789012345678x",
+				{ {0, 20} }
+			},
+			{ // Match starting after first symbol, since sequence takes maximum elements possessively.
+				"012345678901234567890x",
+				{ {1, 22} }
+			},
+			{ // No match - not enough elements.
+				"12x",
+				{}
+			},
+		}
+	},
+
+	// Long sequence of fixed length elements.
+	{
+		"[0-9]+[0-9][0-9]",
+		{
+			{ // Empty string - no matches.
+				"",
+				{}
+			},
+			{ // Match long sequence, no match for short sequence.
+				"12345678901234567890123 45",
+				{ {0, 23} }
+			},
+		}
+	},
+
+	// Long sequences of multi-byte class.
+	{
+		"[а-яё]+",
+		{
+			{ // Empty string - no matches.
+				"",
+				{}
+			},
+			{ // Match whole long string.
+				"съешьещёэтихмягкихфранцузскихбулок",
+				{ {0, 68} }
+			},
+			{ // Multiple matches with ASCII separators.
+				"съешь же ещё этих мягких французских булок, да выпей чаю",
+				{ {0, 10}, {11, 15}, {16, 22}, {23, 31}, {32, 44}, {45, 67}, {68, 78}, {80, 84}, {85, 95}, {96, 102} }
+			},
+			{ // All symbols of class.
+				"абвгдеёжзийклмнопрстуфхцчшщъыьэюя",
+				{ {0, 66} }
+			},
+		}
+	},
+
+	// Long sequences of class with 3-byte code points.
+	{
+		"[一-龥]+",
+		{
+			{ // Empty string - no matches.
+				"",
+				{}
+			},
+			{ // Match whole long string.
+				"正则表达式引擎的性能测试非常重要",
+				{ {0, 48} }
+			},
+			{ // Multiple matches with separators.
+				"正则表达式引擎, 性能测试非常重要。中文",
+				{ {0, 21}, {23, 47}, {50, 56} }
+			},
+		}
+	},
+
+	// Long sequence of fixed length multi-byte elements.
+	{
+		"[一-龥]+[一-龥]",
+		{
+			{ // Empty string - no matches.
+				"",
+				{}
+			},
+			{ // Match whole long string.
+				"正则表达式引擎的性能测试非常重要",
+				{ {0, 48} }
+			},
+			{ // No match for single code point.
+				"正 则表达式",
+				{ {4, 16} }
+			},
+		}
+	},
+
+	// Long sequences of class with code points of different length.
+	{
+		"[a-zа-яё]+",
+		{
+			{ // Empty string - no matches.
+				"",
+				{}
+			},
+			{ // Match whole long string.
+				"helloмирandприветworldдлинноеслово",
+				{ {0, 55} }
+			},
+			{ // Multiple matches with separators.
+				"hello мир, длинноеслово_and_words",
+				{ {0, 5}, {6, 12}, {14, 38}, {39, 42}, {43, 48} }
+			},
+		}
+	},
+
+	// Long sequences of class with code points outside BMP.
+	{
+		"[а-я😀]+",
+		{
+			{ // Empty string - no matches.
+				"",
+				{}
+			},
+			{ // Match whole long string with 4-byte symbol inside.
+				"приветприветприв😀етприветпривет",
+				{ {0, 64} }
+			},
+			{ // Multiple matches with separators.
+				"приветприветпривет 😀😀 пока",
+				{ {0, 36}, {37, 45}, {46, 54} }
+			},
+		}
+	},
+
+	// Optional alternative, which can't be possessive, since alternative after it may match without consuming symbols.
+	{
+		"b(?:a[bc]|)",
+		{
+			{ // Match only first symbol, since symbol after "a" doesn't match.
+				"bax",
+				{ {0, 1} }
+			},
+			{ // Multiple matches.
+				"bab bac ba",
+				{ {0, 3}, {4, 7}, {8, 9} }
+			},
+		}
+	},
+
+	// Sequence with counter, where sequence end may be reached from sequence element.
+	{
+		"(?:ba?){1,2}a",
+		{
+			{ // Match with rollback of optional element.
+				"ba",
+				{ {0, 2} }
+			},
+			{ // Match of two sequence elements.
+				"baba",
+				{ {0, 4} }
+			},
+			{ // Match with rollback of optional element.
+				"bab",
+				{ {0, 2} }
+			},
+		}
+	},
+
+	// Sequence with counter and empty element.
+	{
+		"(?:x?){2,3}y",
+		{
+			{ // Matches with different number of elements.
+				"y xy xxy xxxy",
+				{ {0, 1}, {2, 4}, {5, 8}, {9, 13} }
+			},
+		}
+	},
+
+	// Possessive sequences with counter.
+	{
+		"[0-9]{2,4}x",
+		{
+			{ // Not enough elements and too many elements.
+				"12x 1x 12345x 123456x",
+				{ {0, 3}, {8, 13}, {16, 21} }
+			},
+		}
+	},
+	{
+		"(?:a[0-9]){2,3}b",
+		{
+			{ // Not enough elements, too many elements and incomplete element.
+				"a1a2b a1b a1a2a3a4b a1a2ab",
+				{ {0, 5}, {12, 19} }
+			},
+		}
+	},
+
+	// Possessive sequences of multiple alternatives.
+	{
+		"(?:[a-z]|[0-9]|_)+!",
+		{
+			{ // Multiple matches.
+				"abc_12! x! !_9!",
+				{ {0, 7}, {8, 10}, {12, 15} }
+			},
+		}
+	},
+	{
+		"(?:(a)|b|c)*d",
+		{
+			{ // Multiple matches, including empty sequence.
+				"abcd bbd d ax",
+				{ {0, 4}, {5, 8}, {9, 10} }
+			},
+		}
+	},
+
+	// "OneOf" with many ranges of non-ASCII code points.
+	{
+		"[a-zа-яё0-9]+",
+		{
+			{ // Empty string - no matches.
+				"",
+				{}
+			},
+			{ // Multiple matches of non-ASCII words.
+				"слово, ёж!",
+				{ {0, 10}, {12, 16} }
+			},
+			{ // No matches for uppercase letters.
+				"ABCЖ",
+				{}
+			},
+			{ // No match for symbol near specified symbol.
+				"Ёё",
+				{ {2, 4} }
+			},
+			{ // No match for symbol near specified range.
+				"ђюя",
+				{ {2, 6} }
+			},
+		}
+	},
+
+	// Inverted "OneOf" with many ranges of non-ASCII code points.
+	// Input strings contain no forbidden non-ASCII symbols, since search from the middle of such symbol finds invalid code unit.
+	{
+		"[^a-zа-яё0-9]+",
+		{
+			{ // Empty string - no matches.
+				"",
+				{}
+			},
+			{ // No match - all symbols are forbidden.
+				"abc",
+				{}
+			},
+			{ // Multiple matches of ASCII symbols.
+				"ab, cd!",
+				{ {2, 4}, {6, 7} }
+			},
+			{ // Match of uppercase letters.
+				"ABCЖ",
+				{ {0, 5} }
+			},
+			{ // Matches of symbols near forbidden symbols.
+				"Ёђ1Ю",
+				{ {0, 4}, {5, 7} }
+			},
+		}
+	},
+
+	// "OneOf" with many ranges of code points outside BMP.
+	{
+		"[a-cΩ𐤈-𐤌𝔸🀄😀]+",
+		{
+			{ // Empty string - no matches.
+				"",
+				{}
+			},
+			{ // Match of single symbol.
+				"x😀y🀅z",
+				{ {1, 5} }
+			},
+			{ // Match of range, no matches for symbols near it.
+				"𐤇𐤈𐤌𐤍",
+				{ {4, 12} }
+			},
+			{ // Multiple matches.
+				"𝔸𝔷aΩ",
+				{ {0, 4}, {8, 11} }
+			},
+			{ // Match of BMP symbol.
+				"dΩe",
+				{ {1, 3} }
+			},
+		}
+	},
+
+	// Inverted "OneOf" with many ranges of code points outside BMP.
+	{
+		"[^a-cΩ𐤈-𐤌𝔸🀄😀]+",
+		{
+			{ // Empty string - no matches.
+				"",
+				{}
+			},
+			{ // No match - all symbols are forbidden.
+				"abc",
+				{}
+			},
+			{ // Matches around forbidden ASCII symbol.
+				"dae",
+				{ {0, 1}, {2, 3} }
+			},
+			{ // Match of symbols near forbidden symbols.
+				"x🀅y😁",
+				{ {0, 10} }
+			},
+			{ // Matches of symbols near forbidden range.
+				"𐤇a𐤍",
+				{ {0, 4}, {5, 9} }
+			},
+			{ // Match of symbols near forbidden symbol.
+				"𝔷𝔹",
+				{ {0, 8} }
+			},
+		}
+	},
+
+	// Alternatives of words with common suffixes.
+	{
+		"(?:walking|talking|nation|station)!",
+		{
+			{ // Multiple matches, including match inside word.
+				"walking! stalking! nation station! nation!",
+				{ {0, 8}, {10, 18}, {26, 34}, {35, 42} }
+			},
+		}
+	},
+	{
+		"(?:большой|малой|злой)[0-9]",
+		{
+			{ // Multiple matches of non-ASCII words.
+				"малой1 большой2 злой злой3",
+				{ {0, 11}, {12, 27}, {37, 46} }
+			},
+		}
+	},
+
+	// Alternatives of strings, matched via trie.
+	{
+		"(?:GET|POST|PUT|HEAD|DELETE) /",
+		{
+			{ // Multiple matches, some words are not matched.
+				"GET / POST /x PUT/ HEAD / PATCH / DELETE /",
+				{ {0, 5}, {6, 12}, {19, 25}, {34, 42} }
+			},
+		}
+	},
+	{
+		"(?:a|ab|abc|abcd)d",
+		{
+			{ // Strings are prefixes of each other.
+				"abcd abcdd ad abd",
+				{ {0, 4}, {5, 9}, {11, 13}, {14, 17} }
+			},
+		}
+	},
+	{
+		"(?:ab|abcd|abc|x)(?:cde)?",
+		{
+			{ // Matched strings are tried in order of alternatives.
+				"abcde abcd abc",
+				{ {0, 5}, {6, 8}, {11, 13} }
+			},
+		}
+	},
+	{
+		"(?:дом|дым|дама|кот)[0-9]",
+		{
+			{ // Non-ASCII strings.
+				"дом1 дым дама2 кот3 кит4",
+				{ {0, 7}, {15, 24}, {25, 32} }
+			},
+		}
+	},
+	{
+		"(?:ab|cd|ef|gh)+x",
+		{
+			{ // Sequence of alternatives.
+				"abcdx efefx ghx abx xx",
+				{ {0, 5}, {6, 11}, {12, 15}, {16, 19} }
+			},
+		}
+	},
+	{
+		"(?:б[xy]|вz|бq)",
+		{
+			{ // Alternatives, starting with same byte of non-ASCII symbol.
+				"бq бx вz вq",
+				{ {0, 3}, {4, 7}, {8, 11} }
+			},
+		}
+	},
+	{
+		"(?:[a-c]+x|[b-d]+y|z*w)",
+		{
+			{ // Alternatives are selected by first symbol.
+				"abx bdy zzw w cx dx",
+				{ {0, 3}, {4, 7}, {8, 11}, {12, 13}, {14, 16} }
+			},
+		}
+	},
+	{
+		"(?:ж+1|я+2|[а-я]+3)",
+		{
+			{ // Alternatives are selected by first non-ASCII symbol.
+				"жж1 я2 юя3 ж2",
+				{ {0, 5}, {6, 9}, {10, 15} }
+			},
+		}
+	},
+	{
+		"(?:ab|cd|x?)z",
+		{
+			{ // Alternative, which may match without consuming symbols, is selected for any symbol and at the end of the string.
+				"abz cdz z xz a",
+				{ {0, 3}, {4, 7}, {8, 9}, {10, 12} }
+			},
+		}
+	},
+	{
+		"[0-9]{2,4}3",
+		{
+			{ // Sequence with counter and single rollback point - last successful match of the rest within counter limits is used.
+				"1233 123 33 9999993",
+				{ {0, 4}, {5, 8}, {14, 19} }
+			},
+		}
+	},
+	{
+		"(?:[a-z][0-9]){2,3}z",
+		{
+			{ // Sequence with counter and complex element.
+				"a1z a1b2z a1b2c3d4z",
+				{ {4, 9}, {12, 19} }
+			},
+		}
+	},
+	{
+		"(?:[a-z][0-9])*z!",
+		{
+			{ // Sequence with complex element and string after it.
+				"a1b2z! z! a1z",
+				{ {0, 6}, {7, 9} }
+			},
+		}
+	},
+	{
+		"[0-9]*5[a-c]+",
+		{
+			{ // Rest of the expression after the sequence is matched only if its fixed start matches.
+				"1525a 55b 5",
+				{ {0, 5}, {6, 9} }
+			},
+		}
+	},
+	{
+		"[a-z]{2,8}(?:ing|ed)",
+		{
+			{ // Fixed length element sequence with counter - back steps are performed until rest of the expression matches.
+				"walking played a ed running123",
+				{ {0, 7}, {8, 14}, {20, 27} }
+			},
+		}
+	},
+	{ // Group, captured in failed alternative inside atomic group, should be restored before back reference after atomic group.
+		"^(?:(?>(\\w)!|\\w)\\.)+\\1",
+		{
+			{ // Back reference to group of first iteration.
+				"a!.b.a",
+				{ {0, 6} }
+			},
+			{ // Group isn't captured in second iteration.
+				"a!.b.b",
+				{}
+			},
+		}
+	},
+	{ // Group, captured in failed alternative inside possessive sequence, should be restored before back reference after sequence.
+		"^(?:(\\w)!|\\w\\.)++\\1",
+		{
+			{ // Back reference to group of first iteration.
+				"a!b.a",
+				{ {0, 5} }
+			},
+			{ // Group isn't captured in last (failed) iteration.
+				"a!b.c",
+				{}
+			},
+		}
+	},
+	{
+		"(?:ab[0-9]){2,}(?:ab|c)",
+		{
+			{ // Fixed length element sequence with counter and element size greater than 1.
+				"ab1ab2ab ab1c ab1ab2ab3c",
+				{ {0, 8}, {14, 24} }
+			},
+		}
+	},
+	{
+		"(?:[a-f0-9]{2}:){5}x",
+		{
+			{ // Fixed length element sequence with exact count sequence inside.
+				"00:1a:2b:3c:4d:x 00:11:22:33:x ff:ff:ff:ff:ff:ff:x",
+				{ {0, 16}, {34, 50} }
+			},
+		}
+	},
 };
 
 const size_t g_matcher_test_data_size= std::size(g_matcher_test_data);
@@ -0,0 +1,174 @@
+#include "../RegPanzerLib/RegexGraph.hpp"
+#include "../RegPanzerLib/RegexGraphOptimizer.hpp"
+#include "../RegPanzerLib/Parser.hpp"
+#include "../RegPanzerLib/PushDisableLLVMWarnings.hpp"
+#include <gtest/gtest.h>
+#include "../RegPanzerLib/PopLLVMWarnings.hpp"
+#include <optional>
+
+namespace RegPanzer
+{
+
+namespace
+{
+
+struct TestDataElement
+{
+	std::string regex_str;
+	Encoding encoding= Encoding::UTF8;
+	std::optional<CharType> specific_symbol; // Set if "OneOf" should be replaced with specific symbol.
+	std::vector<CharType> variants;
+	std::vector< std::pair<CharType, CharType> > ranges;
+	bool inverse_flag= false;
+};
+
+const TestDataElement g_test_data[]
+{
+	{ // Already normalized set.
+		"[a-z]",
+		Encoding::UTF8,
+		std::nullopt,
+		{},
+		{ {'a', 'z'} },
+		false,
+	},
+	{ // Ranges are sorted.
+		"[x-z0-9a-f]",
+		Encoding::UTF8,
+		std::nullopt,
+		{},
+		{ {'0', '9'}, {'a', 'f'}, {'x', 'z'} },
+		false,
+	},
+	{ // Overlapping and adjacent ranges are merged.
+		"[a-fc-kl-p]",
+		Encoding::UTF8,
+		std::nullopt,
+		{},
+		{ {'a', 'p'} },
+		false,
+	},
+	{ // Variants are merged into adjacent ranges.
+		"[b-ya0z]",
+		Encoding::UTF8,
+		std::nullopt,
+		{ '0' },
+		{ {'a', 'z'} },
+		false,
+	},
+	{ // Variants are sorted and duplicates are removed.
+		"[qaqz]",
+		Encoding::UTF8,
+		std::nullopt,
+		{ 'a', 'q', 'z' },
+		{},
+		false,
+	},
+	{ // Adjacent variants are merged into range.
+		"[abcq]",
+		Encoding::UTF8,
+		std::nullopt,
+		{ 'q' },
+		{ {'a', 'c'} },
+		false,
+	},
+	{ // Inverse set is normalized too.
+		"[^zyx_]",
+		Encoding::UTF8,
+		std::nullopt,
+		{ '_' },
+		{ {'x', 'z'} },
+		true,
+	},
+	{ // Set of single symbol is replaced with specific symbol.
+		"[q]",
+		Encoding::UTF8,
+		'q',
+		{},
+		{},
+		false,
+	},
+	{ // Set of single symbol (with duplicates) is replaced with specific symbol.
+		"[яя-я]",
+		Encoding::UTF8,
+		U'я',
+		{},
+		{},
+		false,
+	},
+	{ // Inverse set of single symbol is not replaced.
+		"[^q]",
+		Encoding::UTF8,
+		std::nullopt,
+		{ 'q' },
+		{},
+		true,
+	},
+	{ // Inverse set is not replaced with positive set for UTF-8, even if it is smaller.
+		"[^\\x00-/:-ÿ]",
+		Encoding::UTF8,
+		std::nullopt,
+		{},
+		{ {0x00, 0x2F}, {0x3A, 0xFF} },
+		true,
+	},
+	{ // Inverse set is replaced with smaller positive set for bytes.
+		"[^\\x00-/:-ÿ]",
+		Encoding::Bytes,
+		std::nullopt,
+		{},
+		{ {'0', '9'} },
+		false,
+	},
+	{ // Inverse set is not replaced with positive set for bytes, since positive set isn't smaller.
+		"[^\\x00-/]",
+		Encoding::Bytes,
+		std::nullopt,
+		{},
+		{ {0x00, 0x2F} },
+		true,
+	},
+	{ // Inverse set is replaced with positive set of single symbol for bytes and than with specific symbol.
+		"[^\\x00-@B-ÿ]",
+		Encoding::Bytes,
+		'A',
+		{},
+		{},
+		false,
+	},
+};
+
+class OneOfNormalizationTest : public ::testing::TestWithParam<TestDataElement> {};
+
+TEST_P(OneOfNormalizationTest, TestNormalization)
+{
+	const auto param= GetParam();
+	Options options;
+	options.encoding= param.encoding;
+
+	const auto parse_res= RegPanzer::ParseRegexString(param.regex_str, options);
+	const auto regex_chain= std::get_if<RegexElementsChain>(&parse_res);
+	ASSERT_TRUE(regex_chain != nullptr);
+
+	const auto regex_graph= OptimizeRegexGraph( BuildRegexGraph(*regex_chain, options) );
+
+	if(param.specific_symbol != std::nullopt)
+	{
+		const auto specific_symbol= std::get_if<GraphElements::SpecificSymbol>(regex_graph.root);
+		ASSERT_TRUE(specific_symbol != nullptr);
+		ASSERT_EQ(specific_symbol->code, *param.specific_symbol);
+		return;
+	}
+
+	const auto one_of= std::get_if<GraphElements::OneOf>(regex_graph.root);
+	ASSERT_TRUE(one_of != nullptr);
+	ASSERT_EQ(one_of->variants, param.variants);
+	ASSERT_EQ(one_of->ranges, param.ranges);
+	ASSERT_EQ(one_of->inverse_flag, param.inverse_flag);
+}
+
+INSTANTIATE_TEST_SUITE_P(OON, OneOfNormalizationTest, testing::ValuesIn(g_test_data));
+
+} // namespace
+
+} // namespace RegPanzer
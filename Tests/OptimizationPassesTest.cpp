@@ -0,0 +1,100 @@
+#include "../RegPanzerLib/RegexGraph.hpp"
+#include "../RegPanzerLib/RegexGraphOptimizer.hpp"
+#include "../RegPanzerLib/Parser.hpp"
+#include "../RegPanzerLib/PushDisableLLVMWarnings.hpp"
+#include <gtest/gtest.h>
+#include "../RegPanzerLib/PopLLVMWarnings.hpp"
+
+namespace RegPanzer
+{
+
+namespace
+{
+
+struct TestDataElement
+{
+	std::string regex_str;
+	std::vector<OptimizationPass> disabled_passes;
+	OptimizationPass pass;
+	size_t nodes_rewritten;
+};
+
+const TestDataElement g_test_data[]
+{
+	{ // Symbols are combined into single string.
+		"abcd",
+		{},
+		OptimizationPass::SymbolsCombining,
+		3,
+	},
+	{ // Disabled pass changes nothing.
+		"abcd",
+		{ OptimizationPass::SymbolsCombining },
+		OptimizationPass::SymbolsCombining,
+		0,
+	},
+	{ // Single rollback point optimization is used.
+		"[0-9]*3",
+		{},
+		OptimizationPass::SingleRollbackPointSequence,
+		1,
+	},
+	{ // Fixed length element sequence optimization is used if single rollback point optimization is disabled.
+		"[0-9]*3",
+		{ OptimizationPass::SingleRollbackPointSequence },
+		OptimizationPass::FixedLengthElementSequence,
+		1,
+	},
+	{ // Possessification is used.
+		"[a-z]+[0-9]",
+		{},
+		OptimizationPass::AlternativesPossessification,
+		1,
+	},
+	{ // Alternatives with common prefix are united.
+		"(?:abc|abd)",
+		{},
+		OptimizationPass::AlternativesStartUnite,
+		1,
+	},
+	{ // Trie is created for many strings.
+		"(?:one|two|three|four)",
+		{},
+		OptimizationPass::AlternativesTrie,
+		1,
+	},
+	{ // Possessification is used if trie is disabled.
+		"(?:one|two|three|four)",
+		{ OptimizationPass::AlternativesTrie },
+		OptimizationPass::AlternativesPossessification,
+		1,
+	},
+};
+
+class OptimizationPassesTest : public ::testing::TestWithParam<TestDataElement> {};
+
+TEST_P(OptimizationPassesTest, TestStatistics)
+{
+	const auto param= GetParam();
+	const auto parse_res= RegPanzer::ParseRegexString(param.regex_str);
+	const auto regex_chain= std::get_if<RegexElementsChain>(&parse_res);
+	ASSERT_TRUE(regex_chain != nullptr);
+
+	OptimizationOptions optimization_options;
+	for(const OptimizationPass pass : param.disabled_passes)
+		optimization_options.disabled_passes.set(size_t(pass));
+
+	OptimizationStatistics statistics;
+	OptimizeRegexGraph(BuildRegexGraph(*regex_chain, Options()), optimization_options, &statistics);
+
+	for(const OptimizationPass pass : param.disabled_passes)
+		ASSERT_EQ(statistics[size_t(pass)].runs, 0u);
+
+	ASSERT_EQ(statistics[size_t(param.pass)].nodes_rewritten, param.nodes_rewritten);
+}
+
+INSTANTIATE_TEST_SUITE_P(OP, OptimizationPassesTest, testing::ValuesIn(g_test_data));
+
+} // namespace
+
+} // namespace RegPanzer
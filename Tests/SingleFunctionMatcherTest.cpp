@@ -0,0 +1,158 @@
+#include "MatcherTestData.hpp"
+#include "GroupsExtractionTestData.hpp"
+#include "../RegPanzerLib/MatcherGeneratorLLVM.hpp"
+#include "../RegPanzerLib/Parser.hpp"
+#include "../RegPanzerLib/RegexGraphOptimizer.hpp"
+#include "../RegPanzerLib/Utils.hpp"
+#include "../RegPanzerLib/PushDisableLLVMWarnings.hpp"
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/ExecutionEngine/SectionMemoryManager.h>
+#include <llvm/IR/Verifier.h>
+#include <gtest/gtest.h>
+#include "../RegPanzerLib/PopLLVMWarnings.hpp"
+
+namespace RegPanzer
+{
+
+namespace
+{
+
+// Run common tests for matchers, generated in single function mode.
+
+struct CompiledFunction
+{
+	std::unique_ptr<llvm::LLVMContext> llvm_context;
+	std::unique_ptr<llvm::ExecutionEngine> engine;
+	MatcherFunctionType function= nullptr;
+};
+
+CompiledFunction CompileSingleFunctionMatcher(const std::string& regex_str, Options options)
+{
+	CompiledFunction result;
+
+	auto target_machine= CreateTargetMachine();
+	if(target_machine == nullptr)
+		return result;
+
+	const auto parse_res= RegPanzer::ParseRegexString(regex_str);
+	const auto regex_chain= std::get_if<RegexElementsChain>(&parse_res);
+	if(regex_chain == nullptr)
+		return result;
+
+	options.single_function= true;
+	const auto regex_graph= OptimizeRegexGraph( BuildRegexGraph(*regex_chain, options) );
+
+	const std::string function_name= "Match";
+
+	result.llvm_context= std::make_unique<llvm::LLVMContext>();
+	auto module= std::make_unique<llvm::Module>("id", *result.llvm_context);
+	module->setDataLayout(target_machine->createDataLayout());
+
+	GenerateMatcherFunction(*module, regex_graph, function_name);
+	if(llvm::verifyModule(*module, &llvm::errs()))
+		return result;
+
+	llvm::EngineBuilder builder(std::move(module));
+	builder.setEngineKind(llvm::EngineKind::JIT);
+	builder.setMemoryManager(std::make_unique<llvm::SectionMemoryManager>());
+	result.engine.reset(builder.create(target_machine.release())); // Engine takes ownership over target machine.
+	if(result.engine == nullptr)
+		return result;
+
+	result.function= reinterpret_cast<MatcherFunctionType>(result.engine->getFunctionAddress(function_name));
+	return result;
+}
+
+void RunTestCase(const MatcherTestDataElement& param, const bool is_multiline)
+{
+	Options options;
+	options.multiline= is_multiline;
+	const CompiledFunction compiled_function= CompileSingleFunctionMatcher(param.regex_str, options);
+	ASSERT_TRUE(compiled_function.function != nullptr);
+
+	for(const MatcherTestDataElement::Case& c : param.cases)
+	{
+		MatcherTestDataElement::Ranges result_ranges;
+		for(size_t i= 0; i < c.input_str.size();)
+		{
+			size_t group[2]{};
+			const auto subpatterns_extracted= compiled_function.function(c.input_str.data(), c.input_str.size(), i, group, 1);
+
+			if(subpatterns_extracted == 0)
+				break;
+
+			result_ranges.emplace_back(group[0], group[1]);
+			if(group[1] <= i && group[1] <= group[0])
+				break;
+			i= group[1];
+		}
+
+		EXPECT_EQ(result_ranges, c.result_ranges);
+	}
+}
+
+class SingleFunctionMatcherTest : public ::testing::TestWithParam<MatcherTestDataElement> {};
+
+TEST_P(SingleFunctionMatcherTest, TestMatch)
+{
+	RunTestCase(GetParam(), false);
+}
+
+INSTANTIATE_TEST_SUITE_P(M, SingleFunctionMatcherTest, testing::ValuesIn(g_matcher_test_data, g_matcher_test_data + g_matcher_test_data_size));
+
+
+class SingleFunctionMatcherMultilineTest : public ::testing::TestWithParam<MatcherTestDataElement> {};
+
+TEST_P(SingleFunctionMatcherMultilineTest, TestMatch)
+{
+	RunTestCase(GetParam(), true);
+}
+
+INSTANTIATE_TEST_SUITE_P(M, SingleFunctionMatcherMultilineTest, testing::ValuesIn(g_matcher_multiline_test_data, g_matcher_multiline_test_data + g_matcher_multiline_test_data_size));
+
+
+class SingleFunctionMatcherGroupsExtractionTest : public ::testing::TestWithParam<GroupsExtractionTestDataElement> {};
+
+TEST_P(SingleFunctionMatcherGroupsExtractionTest, TestGroupsExtraction)
+{
+	const auto param= GetParam();
+
+	Options options;
+	options.extract_groups= true;
+	const CompiledFunction compiled_function= CompileSingleFunctionMatcher(param.regex_str, options);
+	ASSERT_TRUE(compiled_function.function != nullptr);
+
+	for(const GroupsExtractionTestDataElement::Case& c : param.cases)
+	{
+		std::vector<GroupsExtractionTestDataElement::GroupMatchResults> results;
+		for(size_t i= 0; i < c.input_str.size();)
+		{
+			size_t groups[10][2]{};
+
+			const auto subpatterns_extracted= compiled_function.function(c.input_str.data(), c.input_str.size(), i, &groups[0][0], std::size(groups));
+
+			if(subpatterns_extracted == 0)
+				break;
+
+			if(groups[0][1] <= i && groups[0][1] <= groups[0][0])
+				break;
+			i= groups[0][1];
+
+			GroupsExtractionTestDataElement::GroupMatchResults result;
+
+			for(size_t j= 0; j < std::min(subpatterns_extracted, std::size(groups)); ++j)
+				result.emplace_back(groups[j][0], groups[j][1]);
+
+			results.push_back(std::move(result));
+		}
+
+		EXPECT_EQ(results, c.results);
+	}
+}
+
+INSTANTIATE_TEST_SUITE_P(GE, SingleFunctionMatcherGroupsExtractionTest, testing::ValuesIn(g_groups_extraction_test_data, g_groups_extraction_test_data + g_groups_extraction_test_data_size));
+
+} // namespace
+
+} // namespace RegPanzer
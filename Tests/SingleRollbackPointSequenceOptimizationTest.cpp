@@ -52,8 +52,32 @@ const TestDataElement g_test_data[]
 		"[0-9]*(3|4)",
 		false,
 	},
-	{ // Single rollback point optimization is not used here, since sequence element is too complex.
+	{ // Single rollback point optimization is used here, since sequence element is a chain of fixed length elements.
 		"([0-9]q)*3",
+		true,
+	},
+	{ // Single rollback point optimization is not used here, since sequence element has no fixed length.
+		"([0-9]+q)*3",
+		false,
+	},
+	{ // Single rollback point optimization is used for sequences with counter.
+		"[0-9]{2,5}3",
+		true,
+	},
+	{ // Single rollback point optimization is used for sequences with counter and complex element.
+		"(?:[a-z][0-9]){3,}z",
+		true,
+	},
+	{ // Single rollback point optimization is not used for lazy sequences.
+		"[0-9]{2,5}?3",
+		false,
+	},
+	{ // Single rollback point optimization is used here, since element after the sequence starts with fixed length chain.
+		"[0-9]*3[a-z]+",
+		true,
+	},
+	{ // Single rollback point optimization is not used here, since rest of the expression may reach the sequence again.
+		"(?:[0-9]*3)+",
 		false,
 	},
 };
@@ -0,0 +1,121 @@
+#include "../RegPanzerLib/Matcher.hpp"
+#include "../RegPanzerLib/MatcherGeneratorLLVM.hpp"
+#include "../RegPanzerLib/Parser.hpp"
+#include "../RegPanzerLib/RegexGraphOptimizer.hpp"
+#include "../RegPanzerLib/Utils.hpp"
+#include "../RegPanzerLib/PushDisableLLVMWarnings.hpp"
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/ExecutionEngine/SectionMemoryManager.h>
+#include <gtest/gtest.h>
+#include "../RegPanzerLib/PopLLVMWarnings.hpp"
+
+namespace RegPanzer
+{
+
+namespace
+{
+
+// Check that only live state fields are saved and restored in backtracking points.
+// Groups, modified in failed paths inside sub-graphs (atomic groups, look graphs, sequence elements), should be restored, if they are read after sub-graph.
+// Groups aren't extracted here, so, they are live only because of back references.
+// Results of generated functions are compared against interpreter results.
+
+struct TestDataElement
+{
+	std::string regex_str;
+	std::vector<std::string> input_strings;
+};
+
+const TestDataElement g_test_data[]
+{
+	{ "(?>(a)b|a)\\1", { "aa", "aba", "abab", "aab", } },
+	{ "(?=(a)b|a)a\\1", { "aa", "aba", "abab", "aab", } },
+	{ "(?:(a)b|a)++\\1", { "aa", "aba", "abab", "aab", } },
+	{ "(?:(a)b|a){2}+\\1", { "aa", "aaa", "abaa", "aaab", } },
+};
+
+using Ranges= std::vector<std::pair<size_t, size_t>>;
+
+Ranges FindAllInterpreter(const RegexGraphBuildResult& regex_graph, const std::string& str)
+{
+	Ranges result;
+	for(size_t start_pos= 0; start_pos <= str.size();)
+	{
+		std::string_view res;
+		if(Match(regex_graph, str, start_pos, &res, 1) == 0)
+			break;
+
+		const size_t begin= size_t(res.data() - str.data());
+		const size_t end= begin + res.size();
+		result.emplace_back(begin, end);
+		start_pos= end > begin ? end : end + 1;
+	}
+	return result;
+}
+
+Ranges FindAllGenerated(const MatcherFunctionType function, const std::string& str)
+{
+	Ranges result;
+	for(size_t start_pos= 0; start_pos <= str.size();)
+	{
+		size_t group[2]{0, 0};
+		if(function(str.data(), str.size(), start_pos, group, 1) == 0)
+			break;
+
+		result.emplace_back(group[0], group[1]);
+		start_pos= group[1] > group[0] ? group[1] : group[1] + 1;
+	}
+	return result;
+}
+
+void RunTestCase(const TestDataElement& param, const bool single_function)
+{
+	const auto parse_res= RegPanzer::ParseRegexString(param.regex_str);
+	const auto regex_chain= std::get_if<RegexElementsChain>(&parse_res);
+	ASSERT_TRUE(regex_chain != nullptr);
+
+	Options options;
+	options.single_function= single_function;
+	const auto regex_graph= OptimizeRegexGraph( BuildRegexGraph(*regex_chain, options) );
+
+	auto target_machine= CreateTargetMachine();
+	ASSERT_TRUE(target_machine != nullptr);
+
+	llvm::LLVMContext llvm_context;
+	auto module= std::make_unique<llvm::Module>("id", llvm_context);
+	module->setDataLayout(target_machine->createDataLayout());
+
+	const std::string function_name= "Match";
+	GenerateMatcherFunction(*module, regex_graph, function_name);
+
+	llvm::EngineBuilder builder(std::move(module));
+	builder.setEngineKind(llvm::EngineKind::JIT);
+	builder.setMemoryManager(std::make_unique<llvm::SectionMemoryManager>());
+	const std::unique_ptr<llvm::ExecutionEngine> engine(builder.create(target_machine.release())); // Engine takes ownership over target machine.
+	ASSERT_TRUE(engine != nullptr);
+
+	const auto function= reinterpret_cast<MatcherFunctionType>(engine->getFunctionAddress(function_name));
+	ASSERT_TRUE(function != nullptr);
+
+	for(const std::string& input_str : param.input_strings)
+		EXPECT_EQ(FindAllGenerated(function, input_str), FindAllInterpreter(regex_graph, input_str)) << input_str;
+}
+
+class StateFieldsLivenessTest : public ::testing::TestWithParam<TestDataElement> {};
+
+TEST_P(StateFieldsLivenessTest, TestMatch)
+{
+	RunTestCase(GetParam(), false);
+}
+
+TEST_P(StateFieldsLivenessTest, TestMatchSingleFunction)
+{
+	RunTestCase(GetParam(), true);
+}
+
+INSTANTIATE_TEST_SUITE_P(L, StateFieldsLivenessTest, testing::ValuesIn(g_test_data));
+
+} // namespace
+
+} // namespace RegPanzer
@@ -0,0 +1,411 @@
+#include "MatcherTestData.hpp"
+#include "../RegPanzerLib/Matcher.hpp"
+#include "../RegPanzerLib/MatcherGeneratorLLVM.hpp"
+#include "../RegPanzerLib/Parser.hpp"
+#include "../RegPanzerLib/RegexGraphOptimizer.hpp"
+#include "../RegPanzerLib/UnicodeClasses.hpp"
+#include "../RegPanzerLib/Utils.hpp"
+#include "../RegPanzerLib/PushDisableLLVMWarnings.hpp"
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/ExecutionEngine/SectionMemoryManager.h>
+#include <gtest/gtest.h>
+#include "../RegPanzerLib/PopLLVMWarnings.hpp"
+#include <functional>
+#include <optional>
+
+namespace RegPanzer
+{
+
+namespace
+{
+
+std::string ConvertString(const std::string& str, std::string*)
+{
+	return str;
+}
+
+std::u16string ConvertString(const std::string& str, std::u16string*)
+{
+	return Utf8ToUtf16(str);
+}
+
+// Returns offset in code units for each offset in UTF-8 bytes. Offsets inside code points are invalid.
+std::vector<size_t> BuildOffsetsMap(const std::string& str, const Encoding encoding)
+{
+	const size_t c_invalid_offset= std::numeric_limits<size_t>::max();
+	std::vector<size_t> offsets(str.size() + 1, c_invalid_offset);
+
+	size_t byte_offset= 0, code_unit_offset= 0;
+	for(const char32_t c : Utf8ToUtf32(str))
+	{
+		offsets[byte_offset]= code_unit_offset;
+		byte_offset+= GetCodePointSize(c, Encoding::UTF8);
+		code_unit_offset+= GetCodePointSize(c, encoding);
+	}
+	offsets[byte_offset]= code_unit_offset;
+
+	return offsets;
+}
+
+template<typename CharT>
+struct GeneratedFunction
+{
+	using FunctionType= size_t(*)(const CharT* str, size_t str_size, size_t start_offset, size_t* out_subpatterns, size_t number_of_subpatterns);
+
+	// Context should be destroyed after engine.
+	std::unique_ptr<llvm::LLVMContext> llvm_context;
+	std::unique_ptr<llvm::ExecutionEngine> engine;
+	FunctionType function= nullptr;
+};
+
+template<typename CharT>
+GeneratedFunction<CharT> GenerateFunction(const RegexGraphBuildResult& regex_graph)
+{
+	GeneratedFunction<CharT> result;
+
+	auto target_machine= CreateTargetMachine();
+	if(target_machine == nullptr)
+		return result;
+
+	result.llvm_context= std::make_unique<llvm::LLVMContext>();
+	auto module= std::make_unique<llvm::Module>("id", *result.llvm_context);
+	module->setDataLayout(target_machine->createDataLayout());
+
+	const std::string function_name= "Match";
+	GenerateMatcherFunction(*module, regex_graph, function_name);
+
+	llvm::EngineBuilder builder(std::move(module));
+	builder.setEngineKind(llvm::EngineKind::JIT);
+	builder.setMemoryManager(std::make_unique<llvm::SectionMemoryManager>());
+	result.engine.reset(builder.create(target_machine.release())); // Engine takes ownership over target machine.
+	if(result.engine == nullptr)
+		return result;
+
+	result.function= reinterpret_cast<typename GeneratedFunction<CharT>::FunctionType>(result.engine->getFunctionAddress(function_name));
+	return result;
+}
+
+std::optional<RegexGraphBuildResult> BuildRegexGraphForString(const std::string& regex_str, const Options& options)
+{
+	const auto parse_res= RegPanzer::ParseRegexString(regex_str, options);
+	const auto regex_chain= std::get_if<RegexElementsChain>(&parse_res);
+	if(regex_chain == nullptr)
+		return std::nullopt;
+
+	return OptimizeRegexGraph( BuildRegexGraph(*regex_chain, options) );
+}
+
+template<typename CharT>
+void RunTestCase(const MatcherTestDataElement& param, const Encoding encoding)
+{
+	using StringType= std::basic_string<CharT>;
+	using StringViewType= std::basic_string_view<CharT>;
+
+	Options options;
+	options.encoding= encoding;
+	const auto regex_graph= BuildRegexGraphForString(param.regex_str, options);
+	ASSERT_TRUE(regex_graph != std::nullopt);
+
+	const GeneratedFunction<CharT> generated= GenerateFunction<CharT>(*regex_graph);
+	ASSERT_TRUE(generated.function != nullptr);
+
+	for(const MatcherTestDataElement::Case& c : param.cases)
+	{
+		const StringType input_str= ConvertString(c.input_str, static_cast<StringType*>(nullptr));
+		const std::vector<size_t> offsets= BuildOffsetsMap(c.input_str, encoding);
+
+		MatcherTestDataElement::Ranges expected_ranges;
+		for(const auto& range : c.result_ranges)
+			expected_ranges.emplace_back(offsets[range.first], offsets[range.second]);
+
+		// Check interpreter.
+		{
+			MatcherTestDataElement::Ranges result_ranges;
+			for(size_t start_pos= 0; start_pos < input_str.size();)
+			{
+				StringViewType res;
+				if(Match(*regex_graph, input_str, start_pos, &res, 1) == 0)
+					break;
+
+				const size_t start_offset= size_t(res.data() - input_str.data());
+				const size_t end_offset= start_offset + res.size();
+				result_ranges.emplace_back(start_offset, end_offset);
+				start_pos= end_offset;
+			}
+
+			EXPECT_EQ(result_ranges, expected_ranges) << c.input_str;
+		}
+
+		// Check generated function.
+		{
+			MatcherTestDataElement::Ranges result_ranges;
+			for(size_t i= 0; i < input_str.size();)
+			{
+				size_t group[2]{0, 0};
+				if(generated.function(input_str.data(), input_str.size(), i, group, 1) == 0)
+					break;
+
+				result_ranges.emplace_back(group[0], group[1]);
+				if(group[1] <= i && group[1] <= group[0])
+					break;
+				i= group[1];
+			}
+
+			EXPECT_EQ(result_ranges, expected_ranges) << c.input_str;
+		}
+	}
+}
+
+const MatcherTestDataElement g_unicode_classes_test_data[]
+{
+	{ // Letters.
+		"\\p{L}+",
+		{
+			{ "Hello, мир! 世界", { {0, 5}, {7, 13}, {15, 21} } },
+			{ "123 ,.!", {} },
+		}
+	},
+	{ // Short form for single-letter class.
+		"\\pL+\\p{Nd}+",
+		{
+			{ "abc123 x9 7", { {0, 6}, {7, 9} } },
+		}
+	},
+	{ // Upper and lower case letters.
+		"\\p{Lu}\\p{Ll}+",
+		{
+			{ "Hello World мир Мир", { {0, 5}, {6, 11}, {19, 25} } },
+		}
+	},
+	{ // Inverse class.
+		"\\P{L}+",
+		{
+			{ "Hello, мир! 世界", { {5, 7}, {13, 15} } },
+		}
+	},
+	{ // Inverse class via "^".
+		"\\p{^L}+",
+		{
+			{ "Hello, мир! 世界", { {5, 7}, {13, 15} } },
+		}
+	},
+	{ // Script.
+		"\\p{Greek}+",
+		{
+			{ "abc αβγ def", { {4, 10} } },
+		}
+	},
+	{ // Script of multiple-byte symbols.
+		"\\p{Han}",
+		{
+			{ "日本語", { {0, 3}, {3, 6}, {6, 9} } },
+			{ "にほんご", {} },
+		}
+	},
+	{ // Space separators.
+		"\\p{Zs}",
+		{
+			{ "a b　c", { {1, 2}, {3, 6} } },
+		}
+	},
+	{ // Symbols outside Basic Multilingual Plane.
+		"\\p{So}",
+		{
+			{ "\xF0\x9F\x98\x80" "a", { {0, 4} } },
+		}
+	},
+	{ // Classes inside symbols class.
+		"[\\p{Nd}\\p{Lu}]+",
+		{
+			{ "abC1d23", { {2, 4}, {5, 7} } },
+		}
+	},
+	{ // Unicode class and ASCII symbols.
+		"[\\p{Cyrillic}_]+",
+		{
+			{ "a_привет_b", { {1, 15} } },
+		}
+	},
+};
+
+class UnicodeClassesMatcherTest : public ::testing::TestWithParam<MatcherTestDataElement> {};
+
+TEST_P(UnicodeClassesMatcherTest, TestMatch)
+{
+	RunTestCase<char>(GetParam(), Encoding::UTF8);
+}
+
+INSTANTIATE_TEST_SUITE_P(M, UnicodeClassesMatcherTest, testing::ValuesIn(g_unicode_classes_test_data));
+
+
+class UnicodeClassesUtf16MatcherTest : public ::testing::TestWithParam<MatcherTestDataElement> {};
+
+TEST_P(UnicodeClassesUtf16MatcherTest, TestMatch)
+{
+	RunTestCase<char16_t>(GetParam(), Encoding::UTF16);
+}
+
+INSTANTIATE_TEST_SUITE_P(M, UnicodeClassesUtf16MatcherTest, testing::ValuesIn(g_unicode_classes_test_data));
+
+
+TEST(UnicodeClassesParserTest, InvalidClasses)
+{
+	for(const char* const regex_str : { "\\p", "\\p{", "\\p{L", "\\p{Unknown}", "\\pX", "[\\p{Unknown}]" })
+	{
+		const auto parse_res= ParseRegexString(regex_str);
+		EXPECT_TRUE(std::get_if<ParseErrors>(&parse_res) != nullptr) << regex_str;
+	}
+}
+
+TEST(UnicodeClassesParserTest, BytesMode)
+{
+	Options options;
+	options.encoding= Encoding::Bytes;
+
+	// Only Latin-1 part of class is used in bytes mode.
+	const auto parse_res= ParseRegexString("\\p{L}", options);
+	const auto regex_chain= std::get_if<RegexElementsChain>(&parse_res);
+	ASSERT_TRUE(regex_chain != nullptr);
+	ASSERT_EQ(regex_chain->size(), 1u);
+
+	const auto one_of= std::get_if<OneOf>(&regex_chain->front().el);
+	ASSERT_TRUE(one_of != nullptr);
+	ASSERT_FALSE(one_of->ranges.empty());
+	EXPECT_EQ(one_of->ranges.back().second, 0xFFu);
+}
+
+TEST(UnicodeClassesTablesTest, RangesAreSortedAndNonOverlapping)
+{
+	for(size_t i= 0; i < g_unicode_classes_count; ++i)
+	{
+		const auto ranges= GetUnicodeClassRanges(g_unicode_classes[i].name);
+		ASSERT_TRUE(ranges != std::nullopt);
+		ASSERT_FALSE(ranges->empty());
+
+		for(size_t j= 0; j < ranges->size(); ++j)
+		{
+			EXPECT_LE((*ranges)[j].first, (*ranges)[j].second);
+			EXPECT_LE((*ranges)[j].second, 0x10FFFFu);
+			if(j > 0)
+			{
+				EXPECT_GT((*ranges)[j].first, (*ranges)[j - 1].second + 1);
+			}
+		}
+	}
+}
+
+// Check UTF-8 automaton in generated code for each code point.
+void CheckAllCodePoints(const std::string& regex_str, const std::function<bool(char32_t)>& expected_predicate)
+{
+	const auto regex_graph= BuildRegexGraphForString(regex_str, Options());
+	ASSERT_TRUE(regex_graph != std::nullopt);
+
+	const GeneratedFunction<char> generated= GenerateFunction<char>(*regex_graph);
+	ASSERT_TRUE(generated.function != nullptr);
+
+	for(char32_t c= 0; c <= 0x10FFFF; ++c)
+	{
+		if(c >= 0xD800 && c <= 0xDFFF)
+			continue; // Surrogates can't be encoded in UTF-8.
+
+		const std::string str= Utf32ToUtf8(std::u32string_view(&c, 1));
+
+		size_t group[2]{0, 0};
+		const bool found= generated.function(str.data(), str.size(), 0, group, 1) != 0;
+		const bool expected= expected_predicate(c);
+		ASSERT_EQ(found, expected) << regex_str << " " << uint32_t(c);
+		if(found)
+		{
+			EXPECT_EQ(group[0], 0u);
+			EXPECT_EQ(group[1], str.size());
+		}
+	}
+}
+
+std::function<bool(char32_t)> MakeClassPredicate(const std::string& name)
+{
+	const auto ranges= GetUnicodeClassRanges(name);
+	return
+		[ranges](const char32_t c)
+		{
+			if(ranges == std::nullopt)
+				return false;
+
+			const auto it= std::upper_bound(ranges->begin(), ranges->end(), std::make_pair(c, char32_t(0x7FFFFFFF)));
+			return it != ranges->begin() && c <= std::prev(it)->second;
+		};
+}
+
+TEST(Utf8AutomatonTest, Letters)
+{
+	CheckAllCodePoints("\\p{L}", MakeClassPredicate("L"));
+}
+
+TEST(Utf8AutomatonTest, NotLetters)
+{
+	const auto letter= MakeClassPredicate("L");
+	CheckAllCodePoints("\\P{L}", [&](const char32_t c){ return !letter(c); });
+}
+
+TEST(Utf8AutomatonTest, DecimalNumbers)
+{
+	CheckAllCodePoints("\\p{Nd}", MakeClassPredicate("Nd"));
+}
+
+TEST(Utf8AutomatonTest, SymbolsClass)
+{
+	CheckAllCodePoints("[а-яё\\u20AC_]", [](const char32_t c){ return (c >= U'а' && c <= U'я') || c == U'ё' || c == 0x20AC || c == '_'; });
+}
+
+TEST(Utf8AutomatonTest, InverseSymbolsClass)
+{
+	CheckAllCodePoints("[^a-z0-9_.,;:!?]", [](const char32_t c){ return !((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || (c < 0x80 && std::string_view("_.,;:!?").find(char(c)) != std::string_view::npos)); });
+}
+
+TEST(Utf8AutomatonTest, InvalidBytesAreNotMatchedByClasses)
+{
+	// Classes match only valid UTF-8 sequences, independent on set size and inverse flag.
+	// Any symbol still matches invalid byte as single symbol.
+	struct Case
+	{
+		std::string regex_str;
+		std::string input_str;
+		std::optional<std::pair<size_t, size_t>> expected_range;
+	};
+
+	const Case cases[]
+	{
+		{ "[\u00FF]", "\xFF", std::nullopt },
+		{ "[^a]", "\xFF", std::nullopt },
+		{ "[^abdfhjlnprtvxz]", "\xFF", std::nullopt },
+		{ "[\\xc2\\xa0]", "\u00E0", std::nullopt }, // Continuation byte inside valid sequence.
+		{ "[^a]", "\xC3" "A", std::pair<size_t, size_t>(1, 2) }, // Continuation byte is missing.
+		{ "[^a]", "\xC0\x80", std::nullopt }, // Overlong sequence.
+		{ "[^a]", "\xED\xA0\x80", std::nullopt }, // Surrogate.
+		{ "\\p{L}+", "abc\xFF\xFE def", std::pair<size_t, size_t>(0, 3) },
+		{ ".", "\xFF", std::pair<size_t, size_t>(0, 1) },
+	};
+
+	for(const Case& c : cases)
+	{
+		const auto regex_graph= BuildRegexGraphForString(c.regex_str, Options());
+		ASSERT_TRUE(regex_graph != std::nullopt);
+
+		const GeneratedFunction<char> generated= GenerateFunction<char>(*regex_graph);
+		ASSERT_TRUE(generated.function != nullptr);
+
+		size_t group[2]{0, 0};
+		const bool found= generated.function(c.input_str.data(), c.input_str.size(), 0, group, 1) != 0;
+		ASSERT_EQ(found, c.expected_range != std::nullopt) << c.regex_str;
+		if(found)
+		{
+			EXPECT_EQ(group[0], c.expected_range->first) << c.regex_str;
+			EXPECT_EQ(group[1], c.expected_range->second) << c.regex_str;
+		}
+	}
+}
+
+} // namespace
+
+} // namespace RegPanzer
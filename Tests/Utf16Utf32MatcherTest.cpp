@@ -0,0 +1,177 @@
+#include "MatcherTestData.hpp"
+#include "../RegPanzerLib/Matcher.hpp"
+#include "../RegPanzerLib/MatcherGeneratorLLVM.hpp"
+#include "../RegPanzerLib/Parser.hpp"
+#include "../RegPanzerLib/RegexGraphOptimizer.hpp"
+#include "../RegPanzerLib/Utils.hpp"
+#include "../RegPanzerLib/PushDisableLLVMWarnings.hpp"
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/ExecutionEngine/SectionMemoryManager.h>
+#include <gtest/gtest.h>
+#include "../RegPanzerLib/PopLLVMWarnings.hpp"
+
+namespace RegPanzer
+{
+
+namespace
+{
+
+// Run common matcher tests for UTF-16 and UTF-32 encodings.
+// Input strings are converted from UTF-8, expected ranges are converted from UTF-8 bytes into code units.
+
+std::u32string ConvertString(const std::string& str, std::u32string*)
+{
+	return Utf8ToUtf32(str);
+}
+
+std::u16string ConvertString(const std::string& str, std::u16string*)
+{
+	return Utf8ToUtf16(str);
+}
+
+// Returns offset in code units for each offset in UTF-8 bytes. Offsets inside code points are invalid.
+std::vector<size_t> BuildOffsetsMap(const std::string& str, const Encoding encoding)
+{
+	const size_t c_invalid_offset= std::numeric_limits<size_t>::max();
+	std::vector<size_t> offsets(str.size() + 1, c_invalid_offset);
+
+	size_t byte_offset= 0, code_unit_offset= 0;
+	for(const char32_t c : Utf8ToUtf32(str))
+	{
+		offsets[byte_offset]= code_unit_offset;
+		byte_offset+= GetCodePointSize(c, Encoding::UTF8);
+		code_unit_offset+= GetCodePointSize(c, encoding);
+	}
+	offsets[byte_offset]= code_unit_offset;
+
+	return offsets;
+}
+
+template<typename CharT>
+void RunTestCase(const MatcherTestDataElement& param, const bool is_multiline, const Encoding encoding)
+{
+	using StringType= std::basic_string<CharT>;
+	using StringViewType= std::basic_string_view<CharT>;
+	using FunctionType= size_t(*)(const CharT* str, size_t str_size, size_t start_offset, size_t* out_subpatterns, size_t number_of_subpatterns);
+
+	const auto parse_res= RegPanzer::ParseRegexString(param.regex_str);
+	const auto regex_chain= std::get_if<RegexElementsChain>(&parse_res);
+	ASSERT_TRUE(regex_chain != nullptr);
+
+	Options options;
+	options.multiline= is_multiline;
+	options.encoding= encoding;
+	const auto regex_graph= OptimizeRegexGraph( BuildRegexGraph(*regex_chain, options) );
+
+	auto target_machine= CreateTargetMachine();
+	ASSERT_TRUE(target_machine != nullptr);
+
+	llvm::LLVMContext llvm_context;
+	auto module= std::make_unique<llvm::Module>("id", llvm_context);
+	module->setDataLayout(target_machine->createDataLayout());
+
+	const std::string function_name= "Match";
+	GenerateMatcherFunction(*module, regex_graph, function_name);
+
+	llvm::EngineBuilder builder(std::move(module));
+	builder.setEngineKind(llvm::EngineKind::JIT);
+	builder.setMemoryManager(std::make_unique<llvm::SectionMemoryManager>());
+	const std::unique_ptr<llvm::ExecutionEngine> engine(builder.create(target_machine.release())); // Engine takes ownership over target machine.
+	ASSERT_TRUE(engine != nullptr);
+
+	const auto function= reinterpret_cast<FunctionType>(engine->getFunctionAddress(function_name));
+	ASSERT_TRUE(function != nullptr);
+
+	for(const MatcherTestDataElement::Case& c : param.cases)
+	{
+		const StringType input_str= ConvertString(c.input_str, static_cast<StringType*>(nullptr));
+		if(input_str.empty() && !c.input_str.empty())
+			continue; // Invalid UTF-8 - can't convert.
+
+		const std::vector<size_t> offsets= BuildOffsetsMap(c.input_str, encoding);
+
+		MatcherTestDataElement::Ranges expected_ranges;
+		for(const auto& range : c.result_ranges)
+			expected_ranges.emplace_back(offsets[range.first], offsets[range.second]);
+
+		// Check interpreter.
+		{
+			MatcherTestDataElement::Ranges result_ranges;
+			for(size_t start_pos= 0; start_pos < input_str.size();)
+			{
+				StringViewType res;
+				if(Match(regex_graph, input_str, start_pos, &res, 1) == 0)
+					break;
+
+				const size_t start_offset= size_t(res.data() - input_str.data());
+				const size_t end_offset= start_offset + res.size();
+				result_ranges.emplace_back(start_offset, end_offset);
+				start_pos= end_offset;
+			}
+
+			EXPECT_EQ(result_ranges, expected_ranges);
+		}
+
+		// Check generated function.
+		{
+			MatcherTestDataElement::Ranges result_ranges;
+			for(size_t i= 0; i < input_str.size();)
+			{
+				size_t group[2]{0, 0};
+				if(function(input_str.data(), input_str.size(), i, group, 1) == 0)
+					break;
+
+				result_ranges.emplace_back(group[0], group[1]);
+				if(group[1] <= i && group[1] <= group[0])
+					break;
+				i= group[1];
+			}
+
+			EXPECT_EQ(result_ranges, expected_ranges);
+		}
+	}
+}
+
+class Utf16MatcherTest : public ::testing::TestWithParam<MatcherTestDataElement> {};
+
+TEST_P(Utf16MatcherTest, TestMatch)
+{
+	RunTestCase<char16_t>(GetParam(), false, Encoding::UTF16);
+}
+
+INSTANTIATE_TEST_SUITE_P(M, Utf16MatcherTest, testing::ValuesIn(g_matcher_test_data, g_matcher_test_data + g_matcher_test_data_size));
+
+
+class Utf16MatcherMultilineTest : public ::testing::TestWithParam<MatcherTestDataElement> {};
+
+TEST_P(Utf16MatcherMultilineTest, TestMatch)
+{
+	RunTestCase<char16_t>(GetParam(), true, Encoding::UTF16);
+}
+
+INSTANTIATE_TEST_SUITE_P(M, Utf16MatcherMultilineTest, testing::ValuesIn(g_matcher_multiline_test_data, g_matcher_multiline_test_data + g_matcher_multiline_test_data_size));
+
+
+class Utf32MatcherTest : public ::testing::TestWithParam<MatcherTestDataElement> {};
+
+TEST_P(Utf32MatcherTest, TestMatch)
+{
+	RunTestCase<char32_t>(GetParam(), false, Encoding::UTF32);
+}
+
+INSTANTIATE_TEST_SUITE_P(M, Utf32MatcherTest, testing::ValuesIn(g_matcher_test_data, g_matcher_test_data + g_matcher_test_data_size));
+
+
+class Utf32MatcherMultilineTest : public ::testing::TestWithParam<MatcherTestDataElement> {};
+
+TEST_P(Utf32MatcherMultilineTest, TestMatch)
+{
+	RunTestCase<char32_t>(GetParam(), true, Encoding::UTF32);
+}
+
+INSTANTIATE_TEST_SUITE_P(M, Utf32MatcherMultilineTest, testing::ValuesIn(g_matcher_multiline_test_data, g_matcher_multiline_test_data + g_matcher_multiline_test_data_size));
+
+} // namespace
+
+} // namespace RegPanzer
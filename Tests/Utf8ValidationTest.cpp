@@ -0,0 +1,312 @@
+#include "MatcherTestData.hpp"
+#include "../RegPanzerLib/Matcher.hpp"
+#include "../RegPanzerLib/MatcherFunction.hpp"
+#include "../RegPanzerLib/MatcherGeneratorLLVM.hpp"
+#include "../RegPanzerLib/Parser.hpp"
+#include "../RegPanzerLib/RegexGraphOptimizer.hpp"
+#include "../RegPanzerLib/Utils.hpp"
+#include "../RegPanzerLib/PushDisableLLVMWarnings.hpp"
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/ExecutionEngine/SectionMemoryManager.h>
+#include <gtest/gtest.h>
+#include "../RegPanzerLib/PopLLVMWarnings.hpp"
+
+namespace RegPanzer
+{
+
+namespace
+{
+
+// Run common matcher tests with UTF-8 validation at entry and without UTF-8 validation.
+// Results for valid input should be the same as for per-symbol validation.
+void RunTestCase(const MatcherTestDataElement& param, const bool is_multiline, const Utf8Validation utf8_validation)
+{
+	const auto parse_res= RegPanzer::ParseRegexString(param.regex_str);
+	const auto regex_chain= std::get_if<RegexElementsChain>(&parse_res);
+	ASSERT_TRUE(regex_chain != nullptr);
+
+	Options options;
+	options.multiline= is_multiline;
+	options.utf8_validation= utf8_validation;
+	const auto regex_graph= OptimizeRegexGraph( BuildRegexGraph(*regex_chain, options) );
+
+	auto target_machine= CreateTargetMachine();
+	ASSERT_TRUE(target_machine != nullptr);
+
+	llvm::LLVMContext llvm_context;
+	auto module= std::make_unique<llvm::Module>("id", llvm_context);
+	module->setDataLayout(target_machine->createDataLayout());
+
+	const std::string function_name= "Match";
+	const std::string counter_function_name= "CountMatches";
+	GenerateMatcherFunction(*module, regex_graph, function_name);
+	GenerateMatchesCounterFunction(*module, regex_graph, counter_function_name);
+
+	llvm::EngineBuilder builder(std::move(module));
+	builder.setEngineKind(llvm::EngineKind::JIT);
+	builder.setMemoryManager(std::make_unique<llvm::SectionMemoryManager>());
+	const std::unique_ptr<llvm::ExecutionEngine> engine(builder.create(target_machine.release())); // Engine takes ownership over target machine.
+	ASSERT_TRUE(engine != nullptr);
+
+	const auto function= reinterpret_cast<MatcherFunctionType>(engine->getFunctionAddress(function_name));
+	ASSERT_TRUE(function != nullptr);
+
+	const auto counter_function= reinterpret_cast<MatchesCounterFunctionType>(engine->getFunctionAddress(counter_function_name));
+	ASSERT_TRUE(counter_function != nullptr);
+
+	for(const MatcherTestDataElement::Case& c : param.cases)
+	{
+		const bool is_valid= IsValidUtf8(c.input_str);
+		if(!is_valid && utf8_validation == Utf8Validation::None)
+			continue; // Result is undefined.
+
+		// Nothing should be found in invalid input.
+		const MatcherTestDataElement::Ranges expected_ranges= is_valid ? c.result_ranges : MatcherTestDataElement::Ranges();
+
+		// Check interpreter.
+		{
+			MatcherTestDataElement::Ranges result_ranges;
+			for(size_t start_pos= 0; start_pos < c.input_str.size();)
+			{
+				std::string_view res;
+				if(Match(regex_graph, c.input_str, start_pos, &res, 1) == 0)
+					break;
+
+				const size_t start_offset= size_t(res.data() - c.input_str.data());
+				const size_t end_offset= start_offset + res.size();
+				result_ranges.emplace_back(start_offset, end_offset);
+				start_pos= end_offset;
+			}
+
+			EXPECT_EQ(result_ranges, expected_ranges);
+		}
+
+		// Check generated function.
+		{
+			MatcherTestDataElement::Ranges result_ranges;
+			for(size_t i= 0; i < c.input_str.size();)
+			{
+				size_t group[2]{0, 0};
+				if(function(c.input_str.data(), c.input_str.size(), i, group, 1) == 0)
+					break;
+
+				result_ranges.emplace_back(group[0], group[1]);
+				if(group[1] <= i && group[1] <= group[0])
+					break;
+				i= group[1];
+			}
+
+			EXPECT_EQ(result_ranges, expected_ranges);
+		}
+
+		if(!is_valid)
+		{
+			EXPECT_EQ(counter_function(c.input_str.data(), c.input_str.size()), 0u);
+		}
+	}
+}
+
+class Utf8ValidationOnceMatcherTest : public ::testing::TestWithParam<MatcherTestDataElement> {};
+
+TEST_P(Utf8ValidationOnceMatcherTest, TestMatch)
+{
+	RunTestCase(GetParam(), false, Utf8Validation::OnceAtEntry);
+}
+
+INSTANTIATE_TEST_SUITE_P(M, Utf8ValidationOnceMatcherTest, testing::ValuesIn(g_matcher_test_data, g_matcher_test_data + g_matcher_test_data_size));
+
+
+class Utf8ValidationNoneMatcherTest : public ::testing::TestWithParam<MatcherTestDataElement> {};
+
+TEST_P(Utf8ValidationNoneMatcherTest, TestMatch)
+{
+	RunTestCase(GetParam(), false, Utf8Validation::None);
+}
+
+INSTANTIATE_TEST_SUITE_P(M, Utf8ValidationNoneMatcherTest, testing::ValuesIn(g_matcher_test_data, g_matcher_test_data + g_matcher_test_data_size));
+
+
+class Utf8ValidationNoneMatcherMultilineTest : public ::testing::TestWithParam<MatcherTestDataElement> {};
+
+TEST_P(Utf8ValidationNoneMatcherMultilineTest, TestMatch)
+{
+	RunTestCase(GetParam(), true, Utf8Validation::None);
+}
+
+INSTANTIATE_TEST_SUITE_P(M, Utf8ValidationNoneMatcherMultilineTest, testing::ValuesIn(g_matcher_multiline_test_data, g_matcher_multiline_test_data + g_matcher_multiline_test_data_size));
+
+
+struct ValidationTestDataElement
+{
+	std::string input_str;
+	bool is_valid= false;
+};
+
+const ValidationTestDataElement g_validation_test_data[]
+{
+	{ "", true },
+	{ "a", true },
+	{ "Съешь же ещё", true },
+	{ "\xF0\x9F\x98\x80", true }, // 4-byte sequence.
+	{ "\xF4\x8F\xBF\xBF", true }, // Maximum code point.
+	{ "\xED\x9F\xBF", true }, // Code point before surrogates.
+	{ "0123456789abcdef0123456789abcdef", true }, // Long ASCII string.
+	{ "0123456789abcdef0123456789abcdefё", true }, // Long ASCII string and non-ASCII symbol at end.
+	{ "0123456789abcdefё0123456789abcdef", true }, // Non-ASCII symbol between ASCII blocks.
+	{ "\x80", false }, // Continuation byte without lead byte.
+	{ "a\xBF" "b", false },
+	{ "\xC0\x80", false }, // Overlong 2-byte sequence.
+	{ "\xC1\xBF", false },
+	{ "\xE0\x80\x80", false }, // Overlong 3-byte sequence.
+	{ "\xF0\x80\x80\x80", false }, // Overlong 4-byte sequence.
+	{ "\xED\xA0\x80", false }, // Surrogate.
+	{ "\xF4\x90\x80\x80", false }, // Code point above 0x10FFFF.
+	{ "\xF5\x80\x80\x80", false }, // Invalid lead byte.
+	{ "\xFF", false },
+	{ "\xD1", false }, // Truncated sequences.
+	{ "\xE0\xA0", false },
+	{ "\xF0\x9F\x98", false },
+	{ "\xD1" "a", false }, // ASCII instead of continuation byte.
+	{ "\xE0\xA0" "a", false },
+	{ "\xF0\x9F\x98" "a", false },
+	{ "0123456789abcdef0123456789abcdef\xFF", false }, // Long ASCII string and invalid byte at end.
+	{ "0123456789abcdef\xD1" "0123456789abcdef", false }, // Truncated sequence between ASCII blocks.
+};
+
+class Utf8ValidationTest : public ::testing::TestWithParam<ValidationTestDataElement> {};
+
+TEST_P(Utf8ValidationTest, TestValidation)
+{
+	const auto param= GetParam();
+
+	EXPECT_EQ(IsValidUtf8(param.input_str), param.is_valid);
+
+	// Validation in generated code should give same result. Use regex matching any string to check it.
+	const auto parse_res= RegPanzer::ParseRegexString(".*");
+	const auto regex_chain= std::get_if<RegexElementsChain>(&parse_res);
+	ASSERT_TRUE(regex_chain != nullptr);
+
+	Options options;
+	options.utf8_validation= Utf8Validation::OnceAtEntry;
+	const auto regex_graph= OptimizeRegexGraph( BuildRegexGraph(*regex_chain, options) );
+
+	auto target_machine= CreateTargetMachine();
+	ASSERT_TRUE(target_machine != nullptr);
+
+	llvm::LLVMContext llvm_context;
+	auto module= std::make_unique<llvm::Module>("id", llvm_context);
+	module->setDataLayout(target_machine->createDataLayout());
+
+	const std::string counter_function_name= "CountMatches";
+	GenerateMatchesCounterFunction(*module, regex_graph, counter_function_name);
+
+	llvm::EngineBuilder builder(std::move(module));
+	builder.setEngineKind(llvm::EngineKind::JIT);
+	builder.setMemoryManager(std::make_unique<llvm::SectionMemoryManager>());
+	const std::unique_ptr<llvm::ExecutionEngine> engine(builder.create(target_machine.release())); // Engine takes ownership over target machine.
+	ASSERT_TRUE(engine != nullptr);
+
+	const auto counter_function= reinterpret_cast<MatchesCounterFunctionType>(engine->getFunctionAddress(counter_function_name));
+	ASSERT_TRUE(counter_function != nullptr);
+
+	EXPECT_EQ(counter_function(param.input_str.data(), param.input_str.size()) != 0, param.is_valid);
+}
+
+INSTANTIATE_TEST_SUITE_P(M, Utf8ValidationTest, testing::ValuesIn(g_validation_test_data));
+
+TEST(Utf8ValidationOnceTest, ValidationOnlyForZeroStartOffset)
+{
+	// Input is validated only for search from string beginning.
+	// Next searches in the same string don't scan whole input again.
+	const std::string input_str= "\xFF abc def";
+
+	const auto parse_res= RegPanzer::ParseRegexString("[a-z]+");
+	const auto regex_chain= std::get_if<RegexElementsChain>(&parse_res);
+	ASSERT_TRUE(regex_chain != nullptr);
+
+	Options options;
+	options.utf8_validation= Utf8Validation::OnceAtEntry;
+	const auto regex_graph= OptimizeRegexGraph( BuildRegexGraph(*regex_chain, options) );
+
+	auto target_machine= CreateTargetMachine();
+	ASSERT_TRUE(target_machine != nullptr);
+
+	llvm::LLVMContext llvm_context;
+	auto module= std::make_unique<llvm::Module>("id", llvm_context);
+	module->setDataLayout(target_machine->createDataLayout());
+
+	const std::string function_name= "Match";
+	GenerateMatcherFunction(*module, regex_graph, function_name);
+
+	llvm::EngineBuilder builder(std::move(module));
+	builder.setEngineKind(llvm::EngineKind::JIT);
+	builder.setMemoryManager(std::make_unique<llvm::SectionMemoryManager>());
+	const std::unique_ptr<llvm::ExecutionEngine> engine(builder.create(target_machine.release())); // Engine takes ownership over target machine.
+	ASSERT_TRUE(engine != nullptr);
+
+	const auto function= reinterpret_cast<MatcherFunctionType>(engine->getFunctionAddress(function_name));
+	ASSERT_TRUE(function != nullptr);
+
+	// Nothing is found in invalid input, if search starts from beginning.
+	size_t group[2]{0, 0};
+	EXPECT_EQ(function(input_str.data(), input_str.size(), 0, group, 1), 0u);
+	EXPECT_EQ(Match(regex_graph, input_str, 0, nullptr, 0), 0u);
+	EXPECT_TRUE(FindAllMatches(function, input_str).begin() == MatchIterator());
+
+	// Search with non-zero start offset relies on previous check.
+	EXPECT_EQ(function(input_str.data(), input_str.size(), 2, group, 1), 1u);
+	EXPECT_EQ(group[0], 2u);
+	EXPECT_EQ(group[1], 5u);
+
+	std::string_view res;
+	EXPECT_EQ(Match(regex_graph, input_str, 2, &res, 1), 1u);
+	EXPECT_EQ(res, "abc");
+}
+
+TEST(Utf8ValidationOnceTest, NoReadsAfterStringEndForNonZeroStartOffset)
+{
+	// Input isn't validated for search with non-zero start offset, so, it may contain truncated sequence at end.
+	// Bytes after passed string size should not be read.
+	const std::string buffer= "a\xF0\x9F\x98\x80";
+	const size_t str_size= 2;
+
+	for(const std::string regex_str : { ".", "[^a]", "\\p{So}" })
+	{
+		const auto parse_res= RegPanzer::ParseRegexString(regex_str);
+		const auto regex_chain= std::get_if<RegexElementsChain>(&parse_res);
+		ASSERT_TRUE(regex_chain != nullptr);
+
+		Options options;
+		options.utf8_validation= Utf8Validation::OnceAtEntry;
+		const auto regex_graph= OptimizeRegexGraph( BuildRegexGraph(*regex_chain, options) );
+
+		auto target_machine= CreateTargetMachine();
+		ASSERT_TRUE(target_machine != nullptr);
+
+		llvm::LLVMContext llvm_context;
+		auto module= std::make_unique<llvm::Module>("id", llvm_context);
+		module->setDataLayout(target_machine->createDataLayout());
+
+		const std::string function_name= "Match";
+		GenerateMatcherFunction(*module, regex_graph, function_name);
+
+		llvm::EngineBuilder builder(std::move(module));
+		builder.setEngineKind(llvm::EngineKind::JIT);
+		builder.setMemoryManager(std::make_unique<llvm::SectionMemoryManager>());
+		const std::unique_ptr<llvm::ExecutionEngine> engine(builder.create(target_machine.release())); // Engine takes ownership over target machine.
+		ASSERT_TRUE(engine != nullptr);
+
+		const auto function= reinterpret_cast<MatcherFunctionType>(engine->getFunctionAddress(function_name));
+		ASSERT_TRUE(function != nullptr);
+
+		size_t group[2]{0, 0};
+		EXPECT_EQ(function(buffer.data(), str_size, 0, group, 1), 0u) << regex_str; // Invalid input.
+		EXPECT_EQ(function(buffer.data(), str_size, 1, group, 1), 0u) << regex_str; // Truncated sequence.
+		EXPECT_EQ(Match(regex_graph, std::string_view(buffer.data(), str_size), 1, nullptr, 0), 0u) << regex_str;
+	}
+}
+
+} // namespace
+
+} // namespace RegPanzer